@@ -206,16 +206,11 @@ if [ "$COMPILE" = "yes" ]; then
         cp blitwizard/src/*.c blitwizard-android/jni/src
         cp blitwizard/src/*.cpp blitwizard-android/jni/src
         cp blitwizard/src/*.h blitwizard-android/jni/src
-        mkdir -p blitwizard-android/jni/src/speex/
-        cp blitwizard/src/speex/*.h blitwizard-android/jni/src/speex/
-        cp blitwizard/src/speex/*.c blitwizard-android/jni/src/speex/
     fi
     cp android/Android-blitwizard.mk blitwizard-android/jni/src/Android.mk
     cat blitwizard-android/jni/src/Android.mk | sed -e "s/SOURCEFILELIST/${source_file_list}/g" > blitwizard-android/jni/src/Android2.mk
     cat blitwizard-android/jni/src/Android2.mk | sed "s/VERSIONINSERT/\\\\\"${blitwizard_version}\\\\\"/g" > blitwizard-android/jni/src/Android.mk
-    SPEEXFLAGS=`cat ../src/speex/flags.txt`
-    cat blitwizard-android/jni/src/Android.mk | sed -e "s/SPEEXFLAGSINSERT/${SPEEXFLAGS}/g" > blitwizard-android/jni/src/Android2.mk
-    mv blitwizard-android/jni/src/Android2.mk blitwizard-android/jni/src/Android.mk
+    rm blitwizard-android/jni/src/Android2.mk
 fi
 
 # Use the Android NDK/SDK to complete our project:
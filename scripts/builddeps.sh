@@ -287,41 +287,6 @@ if [ ! -e libs/libblitwizardFLAC.a ]; then
     fi
 fi
 
-# libspeex:
-if [ ! -e libs/libblitwizardspeex.a ]; then
-    if [ -n "`echo $static_libs_use | grep speex`" ]; then
-        echo "Compiling libspeex..."
-        if [ -n "`echo $static_libs_use | grep ogg`" ]; then
-            # Build speex and remember to tell it where ogg is
-            oggincludedir="`pwd`/src/ogg/include/"
-            ogglibrarydir="`pwd`/src/ogg/src/.libs/"
-            hostoption="--host=\"$HOST\""
-            if [ -z "$HOST" ]; then
-                hostoption=""
-            fi
-            configureline="CC=\"$CC\" ./configure $hostoption --with-ogg-libraries=\"$ogglibrarydir\" --with-ogg-includes=\"$oggincludedir\" --disable-oggtest --disable-shared --enable-static && make clean && make"
-            echo "Speex configure line: $configureline"
-            cd src/speex && eval $configureline || { echo "Failed to compile libspeex"; exit 1; }
-        else
-            # Build speex
-            cd src/speex && CC="$CC" ./configure --host="$HOST" --disable-oggtest --disable-shared --enable-static && make clean && make || { echo "Failed to compile libspeex"; exit 1; }
-        fi
-        cd "$dir"
-    fi
-fi
-
-# Copy compiled libspeex/libspeexdsp:
-if [ ! -e libs/libblitwizardspeex.a ]; then
-    if [ -n "`echo $static_libs_use | grep speex`" ]; then
-        cp src/speex/libspeex/.libs/libspeex.a libs/libblitwizardspeex.a || { echo "Failed to copy libspeex"; exit 1; }
-    fi
-fi
-if [ ! -e libs/libblitwizardspeexdsp.a ]; then
-    if [ -n "`echo $static_libs_use | grep speex`" ]; then
-        cp src/speex/libspeex/.libs/libspeexdsp.a libs/libblitwizardspeexdsp.a || { echo "Failed to copy libspeexdsp"; exit 1; }
-    fi
-fi
-
 NOVORBIS="no"
 if [ ! -e libs/libblitwizardvorbis.a ]; then
     NOVORBIS="yes"
@@ -28,8 +28,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include "logging.h"
+#include "audiotiming.h"
+#include "timefuncs.h"
 
 int failsafeaudio = 0;
+int lowlatencyaudio = 0;
 
 // valid sound buffer sizes for audio:
 #define DEFAULTSOUNDBUFFERSIZE (4096)
@@ -39,6 +42,13 @@ int failsafeaudio = 0;
 // since waveout is shit, we'll need a bigger buffer for it:
 #define WAVEOUTMINBUFFERSIZE (2048)
 
+// In low latency mode, we start with a small buffer and make it larger
+// when callbacks take too long or the device underruns:
+#define LOWLATENCYBUFFERSIZE 256
+#define LOWLATENCYCHECKINTERVAL 1000  // ms between checks
+#define LOWLATENCYSHRINKAFTER 30000  // ms without trouble to shrink
+#define LOWLATENCYFORGETFAILURE 300000  // ms until a failed size is retried
+
 #ifdef USE_AUDIO
 #ifdef USE_SDL_AUDIO
 
@@ -46,9 +56,14 @@ int failsafeaudio = 0;
 
 static void (*samplecallbackptr)(void*, unsigned int) = NULL;
 static int soundenabled = 0;
+static int opens16 = 0;
+static unsigned int openbuffersize = 0;
 
 void audiocallback(void *intentionally_unused, Uint8 *stream, int len) {
+    uint64_t start = time_getMicroseconds();
     samplecallbackptr(stream, (unsigned int)len);
+    audiotiming_callback(start, time_getMicroseconds(),
+        (unsigned int)len / (opens16 ? 4 : 8));
 }
 
 const char* audio_GetCurrentBackendName(void) {
@@ -67,6 +82,9 @@ void audio_Quit(void) {
     }
 }
 
+static int audio_OpenDevice(unsigned int buffersize, int s16,
+    char** error);
+
 #ifndef USE_SDL_GRAPHICS
 static int sdlinit = 0;
 #else
@@ -153,9 +171,10 @@ unsigned int buffersize, const char* backend, int s16, char** error) {
         return 0;
     }
 
-    SDL_AudioSpec fmt,actualfmt;
-
     int custombuffersize = DEFAULTSOUNDBUFFERSIZE;
+    if (lowlatencyaudio) {
+        custombuffersize = LOWLATENCYBUFFERSIZE;
+    }
     if (buffersize > 0) {
         if (buffersize < MINSOUNDBUFFERSIZE) {
             buffersize = MINSOUNDBUFFERSIZE;
@@ -166,6 +185,23 @@ unsigned int buffersize, const char* backend, int s16, char** error) {
         custombuffersize = buffersize;
     }
 
+    samplecallbackptr = samplecallback;
+    if (!audio_OpenDevice(custombuffersize, s16, error)) {
+        SDL_AudioQuit();
+        return 0;
+    }
+
+    soundenabled = 1;
+    SDL_PauseAudio(0);
+    return 1;
+}
+
+// Open the audio device with the given buffer size in frames.
+// Returns 1 on success, 0 on error (with *error set):
+static int audio_OpenDevice(unsigned int buffersize, int s16,
+        char** error) {
+    char errbuf[512];
+    SDL_AudioSpec fmt,actualfmt;
     memset(&fmt,0,sizeof(fmt));
     fmt.freq = 48000;
     if (!s16) {
@@ -174,32 +210,125 @@ unsigned int buffersize, const char* backend, int s16, char** error) {
         fmt.format = AUDIO_S16;
     }
     fmt.channels = 2;
-    fmt.samples = custombuffersize;
+    fmt.samples = buffersize;
     fmt.callback = audiocallback;
     fmt.userdata = NULL;
 
-    samplecallbackptr = samplecallback;
-
+    opens16 = s16;
     if (SDL_OpenAudio(&fmt, &actualfmt) < 0) {
         snprintf(errbuf,sizeof(errbuf),"Failed to open SDL audio: %s", SDL_GetError());
         errbuf[sizeof(errbuf)-1] = 0;
         *error = strdup(errbuf);
-        SDL_AudioQuit();
         return 0;
     }
 
     if (actualfmt.channels != 2 || actualfmt.freq != 48000 ||
     (s16 && actualfmt.format != AUDIO_S16) || (!s16 && actualfmt.format != AUDIO_F32SYS)) {
         *error = strdup("SDL audio delivered wrong/unusable format");
-        SDL_AudioQuit();
+        SDL_CloseAudio();
         return 0;
     }
+    openbuffersize = actualfmt.samples;
+    audiotiming_reset(openbuffersize);
+    return 1;
+}
 
-    soundenabled = 1;
+// Reopen the audio device with another buffer size:
+static int audio_ReopenDevice(unsigned int buffersize) {
+    unsigned int oldbuffersize = openbuffersize;
+    SDL_CloseAudio();
+    char* error = NULL;
+    if (!audio_OpenDevice(buffersize, opens16, &error)) {
+        if (error) {
+            free(error);
+            error = NULL;
+        }
+        // try to get the old device back:
+        if (!audio_OpenDevice(oldbuffersize, opens16, &error)) {
+            printwarning("Warning: [audio] failed to reopen audio "
+                "device: %s", error);
+            if (error) {
+                free(error);
+            }
+            SDL_AudioQuit();
+            soundenabled = 0;
+            return 0;
+        }
+    }
     SDL_PauseAudio(0);
     return 1;
 }
 
+void audio_AdjustLatency(void) {
+    static uint64_t lastcheck = 0;
+    static uint64_t lastproblem = 0;
+    static uint64_t lastxruns = 0;
+    static uint64_t lastslow = 0;
+    static unsigned int failedsize = 0;  // largest size with trouble
+    static uint64_t lastfailure = 0;
+    if (!lowlatencyaudio || !soundenabled) {
+        return;
+    }
+    // real time, even with a fixed timebase:
+    uint64_t now = time_getMicroseconds() / 1000;
+    if (lastcheck == 0) {
+        lastproblem = now;
+    } else if (lastcheck + LOWLATENCYCHECKINTERVAL > now) {
+        return;
+    }
+    lastcheck = now;
+
+    // see if there were any underruns, or callbacks using more than
+    // 60% of their time since the last check:
+    struct audiotiming_stats stats;
+    audiotiming_getStats(&stats);
+    uint64_t slow = 0;
+    int i = 6;
+    while (i < AUDIOTIMING_BUCKETS) {
+        slow += stats.histogram[i];
+        i++;
+    }
+    int problem = (stats.xruns != lastxruns || slow != lastslow);
+    lastxruns = stats.xruns;
+    lastslow = slow;
+
+    // conditions may have changed since a size failed, so allow
+    // trying it again after a long quiet period:
+    if (failedsize > 0 && lastfailure + LOWLATENCYFORGETFAILURE < now) {
+        failedsize = 0;
+    }
+
+    if (problem) {
+        lastproblem = now;
+        // this size isn't safe, so don't go back to it for a while:
+        if (openbuffersize > failedsize) {
+            failedsize = openbuffersize;
+        }
+        lastfailure = now;
+        if (openbuffersize * 2 > MAXSOUNDBUFFERSIZE) {
+            return;
+        }
+        printinfo("[audio] output too slow, growing buffer to %u frames",
+            openbuffersize * 2);
+        audio_ReopenDevice(openbuffersize * 2);
+    } else if (lastproblem + LOWLATENCYSHRINKAFTER < now &&
+            openbuffersize / 2 >= LOWLATENCYBUFFERSIZE &&
+            openbuffersize / 2 > failedsize &&
+            stats.maxdurationus <
+            ((openbuffersize / 2) * 1000000 / 48000) / 4) {
+        // stable for a while, and even the slowest callback would have
+        // been fast enough with half the buffer size. try it:
+        lastproblem = now;
+        audio_ReopenDevice(openbuffersize / 2);
+    } else {
+        return;
+    }
+
+    // the statistics start over with the new device:
+    lastxruns = 0;
+    lastslow = 0;
+}
+
 void audio_LockAudioThread(void) {
     SDL_LockAudio();
 }
@@ -266,7 +395,10 @@ static void queueBlock(void) {
     waveheader[i].dwLoops = 0;
 
     // set block audio data:
+    uint64_t start = time_getMicroseconds();
     samplecallbackptr(blockbuffer[i], (unsigned int)waveoutbytes);
+    audiotiming_callback(start, time_getMicroseconds(),
+        (unsigned int)waveoutbytes / 4);
     waveheader[i].lpData = blockbuffer[i];
 
     // queue up block:
@@ -426,6 +558,10 @@ static void waveout_LaunchWaveoutThread(void) {
     thread_FreeInfo(t);
 }
 
+void audio_AdjustLatency(void) {
+    // the waveout block size is fixed
+}
+
 void audio_Quit(void) {
     if (soundenabled) {
         audio_StopWaveoutThread();
@@ -483,6 +619,7 @@ unsigned int buffersize, const char* backend, int s16, char** error) {
     }
     waveoutbytes = custombuffersize;
     samplecallbackptr = samplecallback;
+    audiotiming_reset(waveoutbytes / 4);
     waveout_LaunchWaveoutThread();
 
     time_Sleep(50);
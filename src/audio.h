@@ -59,6 +59,11 @@ void audio_UnlockAudioThread(void);
 void audio_Quit(void);
 // Quit audio backend completely
 
+void audio_AdjustLatency(void);
+// In low latency mode (lowlatencyaudio set to 1 before audio_Init),
+// the buffer size starts small and is adjusted based on the measured
+// callback timing (see audiotiming.h). Call this once per frame.
+
 #else  // USE_SDL_AUDIO || WINDOWS
 
 #define compiled_without_audio "No audio available - this binary was compiled with audio (including null device) disabled"
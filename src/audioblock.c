@@ -0,0 +1,278 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "config.h"
+#include "os.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "audioblock.h"
+
+void audioblock_initPanVol(struct audioblock_panvol *s) {
+    memset(s, 0, sizeof(*s));
+    s->vol = 1; // run at full volume if not changed
+    s->fadevalueend = 1;
+}
+
+void audioblock_setPanVol(struct audioblock_panvol *s,
+        float vol, float pan, int noamplify) {
+    // limit panning range:
+    if (pan < -1) {
+        pan = -1;
+    }
+    if (pan > 1) {
+        pan = 1;
+    }
+    // limit volume range:
+    if (vol < 0) {
+        vol = 0;
+    }
+    if (vol > 1.5) {
+        vol = 1.5;
+    }
+    // the user wants to avoid excess amplification:
+    if (noamplify) {
+        if (vol > 1) {
+            vol = 1;
+        }
+    }
+
+    s->noamplify = noamplify;
+    s->pan = pan;
+    s->vol = vol;
+
+    s->fadeframestotal = 0;
+    s->fadeframesleft = 0;
+    s->fadevalueend = vol;
+}
+
+void audioblock_startFade(struct audioblock_panvol *s,
+        unsigned int samplerate, float seconds, float targetvol,
+        int terminate) {
+    // if seconds <= 0, terminate current fade:
+    if (seconds <= 0) {
+        s->fadevaluestart = 0;
+        s->fadevalueend = 0;
+        s->fadeframestotal = 0;
+        s->fadeframesleft = 0;
+        return;
+    }
+    // check target volume bounds:
+    if (targetvol < 0) {
+        targetvol = 0;
+    }
+    if (targetvol > 1.5) {
+        targetvol = 1.5;
+    }
+    if (s->noamplify && targetvol > 1) {
+        targetvol = 1;
+    }
+
+    // set fade info:
+    s->terminateafterfade = terminate;
+    s->fadevaluestart = s->vol;
+    s->fadevalueend = targetvol;
+    s->fadeframestotal = (int)((double)samplerate * (double)seconds);
+    s->fadeframesleft = s->fadeframestotal;
+    if (s->fadeframesleft <= 0) {
+        s->fadeframestotal = 1;
+        s->fadeframesleft = 1;
+    }
+}
+
+static float amplify(float value, float amplification) {
+    // amplifies with soft clipping applied
+    float maxamplify = 2;
+    float clippingstart = 0.95;
+    value *= amplification;
+    if (fabsf(value) > clippingstart) {
+        float excess = fabsf(value)-clippingstart;
+        if (value > 0) {
+            value += (excess/(maxamplify-clippingstart))*(1-clippingstart);
+        } else {
+            value -= (excess/(maxamplify-clippingstart))*(1-clippingstart);
+        }
+    }
+    return value;
+}
+
+static float mixsample(float sourcevalue, float targetvalue) {
+    if ((targetvalue < 0 && sourcevalue >= 0)
+    || (targetvalue > 0 && sourcevalue <= 0)) {
+        // different sign -> simply add
+        return sourcevalue + targetvalue;
+    }
+    // same sign -> do intelligent mix thing:
+    float reversed = 1;
+    if (sourcevalue < 0 || targetvalue < 0) {
+        reversed = -1;
+        sourcevalue = -sourcevalue;
+        targetvalue = -targetvalue;
+    }
+    return reversed * ((targetvalue + sourcevalue) -
+        (targetvalue * sourcevalue));
+}
+
+void audioblock_mix(float *target, const float *source,
+        unsigned int samples) {
+    unsigned int i = 0;
+    while (i < samples) {
+        target[i] = mixsample(source[i], target[i]);
+        i++;
+    }
+}
+
+// Uniform noise in [0, 1) for the given position. This is a hash
+// rather than a running random generator, so the conversion loop
+// below has no dependency between samples and can be vectorized:
+static inline float audioblock_noise(uint32_t n) {
+    n *= 0x9E3779B1u;
+    n ^= n >> 16;
+    n *= 0x85EBCA6Bu;
+    n ^= n >> 13;
+    return (float)(n >> 8) * (1.0f / 16777216.0f);
+}
+
+void audioblock_floatToS16(const float *in, void *out,
+        unsigned int samples, uint32_t *dither) {
+    char *o = out;
+    uint32_t pos = 0;
+    float ditheramount = 0;
+    if (dither) {
+        pos = *dither;
+        ditheramount = 1;
+    }
+    unsigned int i;
+    for (i = 0; i < samples; i++) {
+        // triangular noise of +-1 LSB (difference of two uniform ones):
+        uint32_t n = pos + i * 2;
+        float d = (audioblock_noise(n) - audioblock_noise(n + 1)) *
+            ditheramount;
+
+        // scale, round and saturate:
+        float v = in[i] * 32768.0f + d;
+        v += (v >= 0 ? 0.5f : -0.5f);
+        if (v > 32767.0f) {
+            v = 32767.0f;
+        }
+        if (v < -32768.0f) {
+            v = -32768.0f;
+        }
+        int16_t s = (int16_t)v;
+        memcpy(o + i * sizeof(s), &s, sizeof(s));
+    }
+    if (dither) {
+        *dither = pos + samples * 2;
+    }
+}
+
+unsigned int audioblock_processPanVol(struct audioblock_panvol *s,
+        const float *in, float *out, unsigned int frames, int mode) {
+    if (s->terminated) {
+        return 0;
+    }
+
+    // panning factors:
+    float panleft = 1;
+    float panright = 1;
+    if (s->pan < 0) {
+        panleft = 1 + s->pan;
+    }
+    if (s->pan > 0) {
+        panright = 1 - s->pan;
+    }
+    float panamplify = 0.7 + fabsf(s->pan) * 0.3;
+
+    unsigned int i = 0;
+    if (s->noamplify && s->fadeframesleft <= 0) {
+        // fast path: constant linear gain
+        float gainleft = s->vol * panleft;
+        float gainright = s->vol * panright;
+        if (mode == AUDIOBLOCK_WRITE) {
+            while (i < frames) {
+                out[i * 2] = in[i * 2] * gainleft;
+                out[i * 2 + 1] = in[i * 2 + 1] * gainright;
+                i++;
+            }
+        } else {
+            while (i < frames) {
+                out[i * 2] = mixsample(in[i * 2] * gainleft, out[i * 2]);
+                out[i * 2 + 1] = mixsample(in[i * 2 + 1] * gainright,
+                    out[i * 2 + 1]);
+                i++;
+            }
+        }
+        return frames;
+    }
+
+    while (i < frames) {
+        float leftchannel = in[i * 2];
+        float rightchannel = in[i * 2 + 1];
+
+        if (s->fadeframesleft > 0) {
+            // calculate fade volume
+            s->vol = s->fadevaluestart +
+                (s->fadevalueend - s->fadevaluestart) *
+                (1 - (float)s->fadeframesleft / (float)s->fadeframestotal);
+            s->fadeframesleft--;
+            if (s->fadeframesleft <= 0) {
+                // fade ended
+                s->vol = s->fadevalueend;
+                s->fadeframesleft = 0;
+                if (s->terminateafterfade) {
+                    // terminating sound.
+                    s->terminated = 1;
+                    return i;
+                }
+            }
+        }
+
+        // apply volume and panning
+        if (!s->noamplify) {
+            leftchannel = amplify(leftchannel, s->vol) * panleft;
+            rightchannel = amplify(rightchannel, s->vol) * panright;
+
+            // amplify channels when closer to edges:
+            if (s->pan > 0) {
+                leftchannel = amplify(leftchannel, panamplify);
+            } else {
+                rightchannel = amplify(rightchannel, panamplify);
+            }
+        } else {
+            leftchannel *= s->vol * panleft;
+            rightchannel *= s->vol * panright;
+        }
+
+        if (mode == AUDIOBLOCK_WRITE) {
+            out[i * 2] = leftchannel;
+            out[i * 2 + 1] = rightchannel;
+        } else {
+            out[i * 2] = mixsample(leftchannel, out[i * 2]);
+            out[i * 2 + 1] = mixsample(rightchannel, out[i * 2 + 1]);
+        }
+        i++;
+    }
+    return frames;
+}
+
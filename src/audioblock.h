@@ -0,0 +1,86 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIOBLOCK_H_
+#define BLITWIZARD_AUDIOBLOCK_H_
+
+#include <stdint.h>
+
+// Block processing helpers for 32bit float stereo audio.
+// Unlike audio sources (see audiosource.h), which are pulled through
+// a read() call per stage, these functions process a whole block of
+// interleaved stereo frames in one pass, passed in by pointer.
+
+// Fade/pan/volume state of a sound:
+struct audioblock_panvol {
+    float vol;  // 0 to 1.5, 1 is regular volume
+    float pan;  // 1 (left) to -1 (right), 0 is center
+    int noamplify;  // if 1, no volume > 1 and no soft clipping
+
+    // fade info:
+    int fadeframestotal;
+    int fadeframesleft;  // 0 if no fade is running
+    float fadevaluestart;
+    float fadevalueend;
+    int terminateafterfade;
+    int terminated;  // fade with termination has finished
+};
+
+// Set up a fade/pan/volume state at regular volume:
+void audioblock_initPanVol(struct audioblock_panvol *s);
+
+// Change panning and volume (this ends any running fade).
+// See audiosourcefadepanvol.h for the meaning of the values:
+void audioblock_setPanVol(struct audioblock_panvol *s,
+    float vol, float pan, int noamplify);
+
+// Start a fade to a given volume. If terminate is 1, the sound
+// ends when the fade is done:
+void audioblock_startFade(struct audioblock_panvol *s,
+    unsigned int samplerate, float seconds, float targetvol, int terminate);
+
+// Process modes for audioblock_processPanVol:
+#define AUDIOBLOCK_WRITE 0  // write results to the output
+#define AUDIOBLOCK_MIX 1  // mix results into the output
+
+// Apply fade/pan/volume to the given amount of stereo frames from in,
+// and write or mix them to out (in and out may be the same for
+// AUDIOBLOCK_WRITE). Returns the amount of frames processed, which is
+// less than requested if the sound terminated after a fade.
+unsigned int audioblock_processPanVol(struct audioblock_panvol *s,
+    const float *in, float *out, unsigned int frames, int mode);
+
+// Mix the given amount of samples (not frames) into the target:
+void audioblock_mix(float *target, const float *source,
+    unsigned int samples);
+
+// Convert the given amount of samples (not frames) to signed 16bit
+// samples with saturation. out doesn't need to be aligned.
+// If dither is not NULL, TPDF dither is applied and *dither is used
+// and advanced as the noise position (just pass the same counter
+// for each block of a stream):
+void audioblock_floatToS16(const float *in, void *out,
+    unsigned int samples, uint32_t *dither);
+
+#endif  // BLITWIZARD_AUDIOBLOCK_H_
+
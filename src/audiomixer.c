@@ -34,8 +34,10 @@
 
 #include "audio.h"
 #include "audiosource.h"
-#include "audiosourcefadepanvol.h"
+#include "audioblock.h"
+#include "audiomixer.h"
 #include "audiosourceresample.h"
+#include "audioresampler.h"
 #include "audiosourceogg.h"
 #include "audiosourceflac.h"
 #include "audiosourcefile.h"
@@ -43,12 +45,11 @@
 #include "audiosourceffmpeg.h"
 #include "audiosourceprereadcache.h"
 #include "audiosourceformatconvert.h"
-#include "mathhelpers.h"
-
-#ifndef USE_SDL_AUDIO
-#define audio_UnlockAudioThread();
-#define audio_LockAudioThread();
-#endif
+#include "audiosourcepcm.h"
+#include "audiopcmcache.h"
+#include "ringbuffer.h"
+#include "threading.h"
+#include "logging.h"
 
 #ifndef ANDROID
 #define MAXCHANNELS 32
@@ -56,84 +57,379 @@
 #define MAXCHANNELS 8
 #endif
 
+// We keep more channel slots than sounds we allow to play at once,
+// so slots of stopped sounds which haven't been cleaned up by the
+// decoder thread yet don't block new sounds:
+#define MAXCHANNELSLOTS (MAXCHANNELS * 2)
+
+// Size of the per channel ring buffer with decoded samples.
+// This needs to hold more than one full audio callback (up to
+// 4096 samples for the default buffer size):
+#define CHANNELRINGSIZE (64 * 1024)
+
+// Amount of bytes the decoder thread decodes at once:
+#define DECODECHUNKSIZE 4096
+
+#define FRAMESIZE (sizeof(float) * 2)
+
+// channel states:
+#define CHANNEL_FREE 0  // unused, can be taken by a new sound
+#define CHANNEL_STARTING 1  // set up, waiting for the play command
+#define CHANNEL_PLAYING 2  // decoder thread decodes, audio thread mixes
+#define CHANNEL_RETIRED 3  // stopped, decoder thread cleans it up
+
+// mixer commands sent from the main thread to the audio thread:
+#define MIXERCOMMAND_PLAY 1
+#define MIXERCOMMAND_STOP 2
+#define MIXERCOMMAND_STOPWITHFADEOUT 3
+#define MIXERCOMMAND_ADJUST 4
+#define MIXERCOMMAND_ADJUSTGRADUALLY 5
+#define MIXERCOMMAND_BUSVOLUME 6  // slot is the bus here
+
+struct mixercommand {
+    int type;
+    int slot;
+    int id;
+    int noamplify;
+    float volume;
+    float panning;
+    float fadeseconds;
+};
+
+// Size of the command queue:
+#define COMMANDQUEUESIZE (4096 * sizeof(struct mixercommand))
+
 int lastusedsoundid = 0;
 
 struct soundchannel {
+    int state;  // accessed atomically from all threads
+
+    // main thread side (constant while the channel is in use):
     int priority;
     int id;
-    
-    // all the audio sources we use:
-    struct audiosource* mixsource;
-    struct audiosource* fadepanvolsource;
+    int bus;
+    int stoprequested;  // main thread has sent a stop command
+
+    // decoder thread side:
+    struct audiosource* decodesource;  // loop(resample(decoder))
     struct audiosource* loopsource;
+    struct ringbuffer* ring;  // decoded 32bit float stereo frames
+    int decodeeof;  // accessed atomically, set when decoding is done
+    int stoplooping;  // accessed atomically, set by the audio thread
+    unsigned int samplerate;
+
+    // audio thread side:
+    struct audioblock_panvol panvol;  // fade/pan/volume state
+    int inunderrun;  // only count each underrun once
 
     // is this sound just fading out?
     int fadeoutandstop;
 };
-struct soundchannel channels[MAXCHANNELS];
+struct soundchannel channels[MAXCHANNELSLOTS];
+
+// Amount of frames mixed at once, which is the size of the bus buffers:
+#define BUSBLOCKFRAMES 512
+
+// Sounds are mixed into buses, and the buses into the final mix with
+// the bus volume/fade applied once to the sum of all its sounds.
+// Buses at full volume are skipped and their sounds mixed directly:
+struct mixerbus {
+    // main thread side:
+    char name[32];  // empty if unused
+
+    // audio thread side:
+    struct audioblock_panvol panvol;
+    float buffer[BUSBLOCKFRAMES * 2];
+};
+static struct mixerbus buses[AUDIOMIXER_MAXBUSES];
+
+static threadinfo* decodethread = NULL;
+static semaphore* decodesemaphore = NULL;
+static struct ringbuffer* commandqueue = NULL;
+
+// Ids of sounds which stopped playing, sent from the audio thread to
+// the main thread. If it overflows, finishedlost is set instead:
+#define FINISHEDQUEUESIZE (1024 * sizeof(int))
+static struct ringbuffer* finishedqueue = NULL;
+static int finishedlost = 0;  // accessed atomically
+static unsigned int underruns = 0;
+
+// Size of the ring buffer with the final mix (32bit float stereo).
+// The mixer mixes into it in whole frames, and the audio output takes
+// any amount of bytes out of it:
+#define MIXRINGSIZE (16 * 1024)
+static struct ringbuffer* mixring = NULL;
 
 char mixedaudiobuf[256];
 int mixedaudiobuflen = 0;
 
+static int audiomixer_ChannelState(int slot) {
+    return __atomic_load_n(&channels[slot].state, __ATOMIC_ACQUIRE);
+}
+
+// Fill up the ring buffer of a channel with freshly decoded audio.
+// The audio is decoded directly into the ring buffer memory.
+// Called by the decoder thread, or by the main thread before the
+// channel is handed over to the other threads:
+static void audiomixer_DecodeChannel(struct soundchannel* c) {
+    // the loop source belongs to us, so the audio thread only asks
+    // us to stop looping:
+    if (__atomic_exchange_n(&c->stoplooping, 0, __ATOMIC_ACQUIRE)) {
+        audiosourceloop_setLooping(c->loopsource, 0);
+    }
+    while (!c->decodeeof &&
+    ringbuffer_writable(c->ring) >= DECODECHUNKSIZE) {
+        void* p;
+        size_t space = ringbuffer_writeRegion(c->ring, &p);
+        if (space > DECODECHUNKSIZE) {
+            space = DECODECHUNKSIZE;
+        }
+        int i = c->decodesource->read(c->decodesource, p, space);
+        if (i <= 0) {
+            // end of sound or decode error
+            __atomic_store_n(&c->decodeeof, 1, __ATOMIC_RELEASE);
+            break;
+        }
+        ringbuffer_commit(c->ring, i);
+    }
+}
+
+// Close all audio sources of a channel:
+static void audiomixer_CloseChannelSources(struct soundchannel* c) {
+    if (c->decodesource) {
+        c->decodesource->close(c->decodesource);
+    }
+    ringbuffer_destroy(c->ring);
+    c->ring = NULL;
+    c->decodesource = NULL;
+    c->loopsource = NULL;
+}
+
+// Free all resources of a retired channel. Decoder thread only:
+static void audiomixer_CleanupChannel(int slot) {
+    struct soundchannel* c = &channels[slot];
+    audiomixer_CloseChannelSources(c);
+    c->decodeeof = 0;
+    c->stoplooping = 0;
+    c->fadeoutandstop = 0;
+    __atomic_store_n(&c->state, CHANNEL_FREE, __ATOMIC_RELEASE);
+}
+
+// Decode all playing channels and free up retired ones.
+// Decoder thread only (or the audio thread with synchronous decoding):
+static void audiomixer_DecodeAllChannels(void) {
+    int i = 0;
+    while (i < MAXCHANNELSLOTS) {
+        int state = audiomixer_ChannelState(i);
+        if (state == CHANNEL_RETIRED) {
+            audiomixer_CleanupChannel(i);
+        } else if (state == CHANNEL_PLAYING ||
+        state == CHANNEL_STARTING) {
+            audiomixer_DecodeChannel(&channels[i]);
+        }
+        i++;
+    }
+}
+
+static void audiomixer_DecodeThread(__attribute__((unused)) void* userdata) {
+    while (1) {
+        // wait until the audio thread consumed some samples
+        // or channels changed:
+        semaphore_Wait(decodesemaphore);
+
+        audiomixer_DecodeAllChannels();
+    }
+}
+
+// With synchronous decoding, there is no decoder thread and the
+// channels are decoded right before they are mixed:
+static int synchronousdecoding = 0;
+
+void audiomixer_SetSynchronousDecoding(int enabled) {
+    synchronousdecoding = (enabled != 0);
+}
+
 void audiomixer_Init(void) {
-    memset(&channels,0,sizeof(struct soundchannel) * MAXCHANNELS);
+    memset(&channels,0,sizeof(struct soundchannel) * MAXCHANNELSLOTS);
+
+    // set up buses at full volume, with the predefined ones named:
+    memset(&buses, 0, sizeof(buses));
+    int i = 0;
+    while (i < AUDIOMIXER_MAXBUSES) {
+        audioblock_initPanVol(&buses[i].panvol);
+        audioblock_setPanVol(&buses[i].panvol, 1, 0, 1);
+        i++;
+    }
+    strcpy(buses[AUDIOMIXER_BUS_MASTER].name, "master");
+    strcpy(buses[AUDIOMIXER_BUS_MUSIC].name, "music");
+    strcpy(buses[AUDIOMIXER_BUS_SFX].name, "sfx");
+    strcpy(buses[AUDIOMIXER_BUS_UI].name, "ui");
+
+    if (!commandqueue) {
+        commandqueue = ringbuffer_create(COMMANDQUEUESIZE);
+    }
+    if (!finishedqueue) {
+        finishedqueue = ringbuffer_create(FINISHEDQUEUESIZE);
+    }
+    if (!mixring) {
+        mixring = ringbuffer_create(MIXRINGSIZE);
+    }
+
+    // avoid computing resampling filters when the first sound starts:
+    audioresampler_prepareCommonTables();
+
+    // start decoder thread:
+    if (!decodethread && !synchronousdecoding) {
+        decodesemaphore = semaphore_Create(0);
+        decodethread = thread_createInfo();
+        thread_spawnWithPriority(decodethread, 2,
+            &audiomixer_DecodeThread, NULL);
+    }
+}
+
+unsigned int audiomixer_GetUnderrunCount(void) {
+    return __atomic_load_n(&underruns, __ATOMIC_RELAXED);
+}
+
+// Send a command to the audio thread. Main thread only.
+// Returns 1 on success, 0 if the command queue is full:
+static int audiomixer_PostCommand(struct mixercommand* cmd) {
+    if (!cmd || !commandqueue ||
+    ringbuffer_writable(commandqueue) < sizeof(*cmd)) {
+        static int warned = 0;
+        if (!warned) {
+            warned = 1;
+            printwarning("[audio] warning: mixer command queue is full, "
+            "sound commands will be lost");
+        }
+        return 0;
+    }
+    ringbuffer_write(commandqueue, cmd, sizeof(*cmd));
+    return 1;
+}
+
+// A channel is active from the main thread's point of view if it is
+// playing or about to play, and no stop was requested for it yet:
+static int audiomixer_IsChannelActive(int slot) {
+    int state = audiomixer_ChannelState(slot);
+    return ((state == CHANNEL_PLAYING || state == CHANNEL_STARTING)
+        && !channels[slot].stoprequested);
 }
 
 // Check whether no sound is playing right now (1), or if some is playing (0):
 int audiomixer_NoSoundsPlaying(void) {
-    audio_LockAudioThread();
     int i = 0;
-    while (i < MAXCHANNELS) {
-        if (channels[i].mixsource) {
+    while (i < MAXCHANNELSLOTS) {
+        if (audiomixer_IsChannelActive(i)) {
             return 0;
         }
         i++;
     }
-    audio_UnlockAudioThread();
     return 1;
 }
 
 int audiomixer_GetIdFromSoundOnChannel(unsigned int channel) {
-    if (channel >= MAXCHANNELS) {
+    if (channel >= MAXCHANNELSLOTS) {
         return -1;
     }
-    audio_LockAudioThread();
-    int result = channels[channel].id;
-    if (!channels[channel].mixsource) {
-        result = -1;
+    if (!audiomixer_IsChannelActive(channel)) {
+        return -1;
     }
-    audio_UnlockAudioThread();
-    return result;
+    return channels[channel].id;
 }
 
-// Cancel channel, we are in the sound thread
+// Stop a channel. The decoder thread will free it up.
+// Audio thread only:
 static void audiomixer_CancelChannel(int slot) {
-    if (channels[slot].mixsource) {
-        channels[slot].mixsource->close(channels[slot].mixsource);
-        channels[slot].mixsource = NULL;
-        channels[slot].loopsource = NULL;
-        channels[slot].fadepanvolsource = NULL;
-        channels[slot].id = 0;
+    int state = audiomixer_ChannelState(slot);
+    if (state == CHANNEL_PLAYING || state == CHANNEL_STARTING) {
+        __atomic_store_n(&channels[slot].state, CHANNEL_RETIRED,
+            __ATOMIC_RELEASE);
+        if (decodesemaphore) {
+            semaphore_Post(decodesemaphore);
+        }
+
+        // report the finished sound to the main thread:
+        int id = channels[slot].id;
+        if (!finishedqueue ||
+        ringbuffer_writable(finishedqueue) < sizeof(id)) {
+            __atomic_store_n(&finishedlost, 1, __ATOMIC_RELEASE);
+        } else {
+            ringbuffer_write(finishedqueue, &id, sizeof(id));
+        }
+    }
+}
+
+int audiomixer_GetFinishedSound(void) {
+    if (!finishedqueue) {
+        return 0;
+    }
+    if (__atomic_exchange_n(&finishedlost, 0, __ATOMIC_ACQ_REL)) {
+        return AUDIOMIXER_FINISHED_LOST;
+    }
+    int id;
+    if (ringbuffer_read(finishedqueue, &id, sizeof(id)) == sizeof(id)) {
+        return id;
+    }
+    return 0;
+}
+
+// Ask the audio thread to stop a channel. Main thread only:
+static void audiomixer_RequestStop(int slot) {
+    struct mixercommand cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = MIXERCOMMAND_STOP;
+    cmd.slot = slot;
+    cmd.id = channels[slot].id;
+    if (audiomixer_PostCommand(&cmd)) {
+        channels[slot].stoprequested = 1;
+    }
+}
+
+// Check if a sound of the given priority could be played:
+static int audiomixer_CanPlayWithPriority(int priority) {
+    int playing = 0;
+    int canoverride = 0;
+    int i = 0;
+    while (i < MAXCHANNELSLOTS) {
+        if (audiomixer_IsChannelActive(i)) {
+            playing++;
+            if (channels[i].priority <= priority) {
+                canoverride = 1;
+            }
+        }
+        i++;
     }
+    return (playing < MAXCHANNELS || canoverride);
 }
 
 static int audiomixer_GetFreeChannelSlot(int priority) {
+    int playing = 0;
+    int lowest = -1;
     int i = 0;
-    // first, attempt to find an empty slot
-    while (i < MAXCHANNELS) {
-        if (!channels[i].mixsource) {
-            return i;
+    while (i < MAXCHANNELSLOTS) {
+        if (audiomixer_IsChannelActive(i)) {
+            playing++;
+            if (channels[i].priority <= priority && (lowest < 0 ||
+            channels[i].priority < channels[lowest].priority)) {
+                lowest = i;
+            }
         }
         i++;
     }
-    // then override one
+    if (playing >= MAXCHANNELS) {
+        // we need to override a sound with lower priority
+        if (lowest < 0) {
+            return -1;
+        }
+        audiomixer_RequestStop(lowest);
+    }
+
+    // find an empty slot:
     i = 0;
-    while (i < MAXCHANNELS) {
-        if (channels[i].mixsource) {
-            if (channels[i].priority <= priority) {
-                audiomixer_CancelChannel(priority);
-                return i;
-            }
+    while (i < MAXCHANNELSLOTS) {
+        if (audiomixer_ChannelState(i) == CHANNEL_FREE) {
+            return i;
         }
         i++;
     }
@@ -145,8 +441,8 @@ static int audiomixer_GetChannelSlotById(int id) {
         return -1;
     }
     int i = 0;
-    while (i < MAXCHANNELS) {
-        if (channels[i].id == id && channels[i].mixsource) {
+    while (i < MAXCHANNELSLOTS) {
+        if (channels[i].id == id && audiomixer_IsChannelActive(i)) {
             return i;
         }
         i++;
@@ -170,22 +466,17 @@ static int audiomixer_FreeSoundId(void) {
 }
 
 int audiomixer_IsSoundPlaying(int id) {
-    audio_LockAudioThread();
     if (audiomixer_GetChannelSlotById(id) >= 0) {
-        audio_UnlockAudioThread();
         return 1;
     }
-    audio_UnlockAudioThread();
     return 0;
 }
 
 void audiomixer_StopSound(int id) {
-    audio_LockAudioThread();
     int slot = audiomixer_GetChannelSlotById(id);
     if (slot >= 0) {
-        audiomixer_CancelChannel(slot);
+        audiomixer_RequestStop(slot);
     }
-    audio_UnlockAudioThread();
 }
 
 void audiomixer_StopSoundWithFadeout(int id, float fadeoutseconds) {
@@ -193,58 +484,162 @@ void audiomixer_StopSoundWithFadeout(int id, float fadeoutseconds) {
         audiomixer_StopSound(id);
         return;
     }
-    audio_LockAudioThread();
-    
     int slot = audiomixer_GetChannelSlotById(id);
     if (slot >= 0) {
-        if (channels[slot].fadeoutandstop) {
-            // already fading out!
-            audio_UnlockAudioThread();
-            return;
-        }
-
-        // start fadeout:
-        audiosourcefadepanvol_startFade(channels[slot].fadepanvolsource,
-            fadeoutseconds, 0, 1);
-        // make sure it doesn't loop:
-        audiosourceloop_setLooping(channels[slot].loopsource, 0);
+        struct mixercommand cmd;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.type = MIXERCOMMAND_STOPWITHFADEOUT;
+        cmd.slot = slot;
+        cmd.id = id;
+        cmd.fadeseconds = fadeoutseconds;
+        audiomixer_PostCommand(&cmd);
     }
-    audio_UnlockAudioThread();
 }
 
 void audiomixer_AdjustSound(int id, float volume, float panning,
         int noamplify) {
-    audio_LockAudioThread();
     int slot = audiomixer_GetChannelSlotById(id);
-    if (slot >= 0 && channels[slot].fadepanvolsource
-    && !channels[slot].fadeoutandstop) {
-        audiosourcefadepanvol_setPanVol(channels[slot].fadepanvolsource,
-            volume, panning, noamplify);
+    if (slot >= 0) {
+        struct mixercommand cmd;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.type = MIXERCOMMAND_ADJUST;
+        cmd.slot = slot;
+        cmd.id = id;
+        cmd.volume = volume;
+        cmd.panning = panning;
+        cmd.noamplify = noamplify;
+        audiomixer_PostCommand(&cmd);
     }
-    audio_UnlockAudioThread();
 }
 
+void audiomixer_AdjustSoundGradually(int id, float volume, float panning,
+        float seconds) {
+    int slot = audiomixer_GetChannelSlotById(id);
+    if (slot >= 0) {
+        struct mixercommand cmd;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.type = MIXERCOMMAND_ADJUSTGRADUALLY;
+        cmd.slot = slot;
+        cmd.id = id;
+        cmd.volume = volume;
+        cmd.panning = panning;
+        cmd.noamplify = 1;
+        cmd.fadeseconds = seconds;
+        audiomixer_PostCommand(&cmd);
+    }
+}
 
-int audiomixer_PlaySoundFromDisk(const char* path, int priority, float volume, float panning, int noamplify, float fadeinseconds, int loop) {
-    audio_LockAudioThread();
-    int id = audiomixer_FreeSoundId();
-    // see if in theory, the sound could be played:
-    if (audiomixer_GetFreeChannelSlot(priority) < 0) {
-        // all slots are full. do nothing and simply return an unused unplaying id
-        audio_UnlockAudioThread();
-        return id;
+int audiomixer_GetBus(const char* name, int create) {
+    if (!name || strlen(name) == 0 ||
+    strlen(name) >= sizeof(buses[0].name)) {
+        return -1;
+    }
+    int unused = -1;
+    int i = 0;
+    while (i < AUDIOMIXER_MAXBUSES) {
+        if (strcmp(buses[i].name, name) == 0) {
+            return i;
+        }
+        if (unused < 0 && strlen(buses[i].name) == 0) {
+            unused = i;
+        }
+        i++;
+    }
+    if (!create || unused < 0) {
+        return -1;
     }
+    strcpy(buses[unused].name, name);
+    return unused;
+}
 
-    // allow audio thread to do things again while we open the file
-    // and determine its format:
-    audio_UnlockAudioThread();
+void audiomixer_SetBusVolume(int bus, float volume, float fadeseconds) {
+    if (bus < 0 || bus >= AUDIOMIXER_MAXBUSES) {
+        return;
+    }
+    struct mixercommand cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = MIXERCOMMAND_BUSVOLUME;
+    cmd.slot = bus;
+    cmd.volume = volume;
+    cmd.fadeseconds = fadeseconds;
+    audiomixer_PostCommand(&cmd);
+}
 
+// Process all commands sent by the main thread. Audio thread only:
+static void audiomixer_ProcessCommands(void) {
+    struct mixercommand cmd;
+    while (ringbuffer_read(commandqueue, &cmd, sizeof(cmd)) ==
+    sizeof(cmd)) {
+        if (cmd.type == MIXERCOMMAND_BUSVOLUME) {
+            struct audioblock_panvol* b = &buses[cmd.slot].panvol;
+            if (cmd.fadeseconds > 0) {
+                audioblock_startFade(b, 48000, cmd.fadeseconds,
+                    cmd.volume, 0);
+            } else {
+                audioblock_setPanVol(b, cmd.volume, 0, 1);
+            }
+            continue;
+        }
+        struct soundchannel* c = &channels[cmd.slot];
+        int state = audiomixer_ChannelState(cmd.slot);
+        if (c->id != cmd.id || (state != CHANNEL_PLAYING &&
+        state != CHANNEL_STARTING)) {
+            // this sound has already stopped
+            continue;
+        }
+        switch (cmd.type) {
+        case MIXERCOMMAND_PLAY:
+            __atomic_store_n(&c->state, CHANNEL_PLAYING,
+                __ATOMIC_RELEASE);
+            break;
+        case MIXERCOMMAND_STOP:
+            audiomixer_CancelChannel(cmd.slot);
+            break;
+        case MIXERCOMMAND_STOPWITHFADEOUT:
+            if (c->fadeoutandstop) {
+                // already fading out!
+                break;
+            }
+            // start fadeout:
+            c->fadeoutandstop = 1;
+            audioblock_startFade(&c->panvol, c->samplerate,
+                cmd.fadeseconds, 0, 1);
+            // make sure it doesn't loop (the decoder thread does this,
+            // it owns the loop source):
+            __atomic_store_n(&c->stoplooping, 1, __ATOMIC_RELEASE);
+            if (decodesemaphore) {
+                semaphore_Post(decodesemaphore);
+            }
+            break;
+        case MIXERCOMMAND_ADJUST:
+            if (!c->fadeoutandstop) {
+                audioblock_setPanVol(&c->panvol,
+                    cmd.volume, cmd.panning, cmd.noamplify);
+            }
+            break;
+        case MIXERCOMMAND_ADJUSTGRADUALLY:
+            if (!c->fadeoutandstop) {
+                // change panning right away, but fade to the new
+                // volume from wherever we are (this avoids zipper
+                // noise with frequent changes):
+                audioblock_setPanVol(&c->panvol,
+                    c->panvol.vol, cmd.panning, cmd.noamplify);
+                audioblock_startFade(&c->panvol, c->samplerate,
+                    cmd.fadeseconds, cmd.volume, 0);
+            }
+            break;
+        }
+    }
+}
+
+
+struct audiosource* audiomixer_CreateDecodeSource(const char* path) {
     // try ogg format:
     struct audiosource* decodesource = NULL;
     if (!decodesource && strlen(path) > strlen(".ogg") &&
     strcasecmp(path + strlen(path) - strlen(".ogg"), ".ogg") == 0) {
         decodesource = audiosourceogg_create(
-        audiosourceprereadcache_create(audiosourcefile_create(path))
+        audiosourceprereadcache_create(audiosourcefile_create(path), 0)
         );
     }
 
@@ -253,7 +648,7 @@ int audiomixer_PlaySoundFromDisk(const char* path, int priority, float volume, f
     strcasecmp(path + strlen(path) - strlen(".flac"), ".flac") == 0) {
         decodesource = audiosourceformatconvert_create(
             audiosourceflac_create(
-            audiosourceprereadcache_create(audiosourcefile_create(path))
+            audiosourceprereadcache_create(audiosourcefile_create(path), 0)
             ),
             AUDIOSOURCEFORMAT_F32LE
         );
@@ -263,9 +658,31 @@ int audiomixer_PlaySoundFromDisk(const char* path, int priority, float volume, f
     if (!decodesource) {
         decodesource = audiosourceformatconvert_create(
         audiosourceffmpeg_create(
-        audiosourceprereadcache_create(audiosourcefile_create(path))),
+        audiosourceprereadcache_create(audiosourcefile_create(path), 0)),
         AUDIOSOURCEFORMAT_F32LE);
     }
+    return decodesource;
+}
+
+int audiomixer_PlaySoundFromDisk(const char* path, int priority, float volume, float panning, int noamplify, float fadeinseconds, int loop, double loopstart, double loopend, int bus) {
+    if (bus < 0 || bus >= AUDIOMIXER_MAXBUSES) {
+        bus = AUDIOMIXER_BUS_SFX;
+    }
+    int id = audiomixer_FreeSoundId();
+    // see if in theory, the sound could be played:
+    if (!audiomixer_CanPlayWithPriority(priority)) {
+        // all slots are full. do nothing and simply return an unused unplaying id
+        return id;
+    }
+
+    // short sounds are played from the shared decoded PCM cache:
+    struct audiosource* decodesource = audiosourcepcm_create(
+        audiopcmcache_get(path));
+
+    // otherwise, decode from disk:
+    if (!decodesource) {
+        decodesource = audiomixer_CreateDecodeSource(path);
+    }
 
     // if we got no decode source at this point, the audio file is unsupported:
     if (!decodesource) {
@@ -273,280 +690,350 @@ int audiomixer_PlaySoundFromDisk(const char* path, int priority, float volume, f
         return -1;
     }
 
-    // lock audio thread again so we can update the audio channel info:
-    audio_LockAudioThread();
-
-    // obtain free slot:
-    int slot = audiomixer_GetFreeChannelSlot(priority);
-    if (slot < 0) {
-        // no free slot :(
-        audio_UnlockAudioThread();
-        if (decodesource) {
-            decodesource->close(decodesource);
-        }
+    // set up the decoder thread side: resampler and loop audio source
+    struct soundchannel c;
+    memset(&c, 0, sizeof(c));
+    c.loopsource = audiosourceloop_create(
+        audiosourceresample_create(decodesource, 48000));
+    if (!c.loopsource) {
         return -1;
     }
+    audiosourceloop_setLooping(c.loopsource, loop);
+    if (loopstart > 0 || loopend > 0) {
+        // loop points are given in seconds:
+        unsigned int rate = c.loopsource->samplerate;
+        audiosourceloop_setLoopPoints(c.loopsource,
+            (size_t)(loopstart * rate + 0.5),
+            (size_t)(loopend * rate + 0.5));
+    }
+    c.decodesource = c.loopsource;
+    c.samplerate = c.decodesource->samplerate;
 
-    // wrap up the decoded audio into the resampler and fade/pan/vol modifier
-    channels[slot].fadepanvolsource = audiosourcefadepanvol_create(
-        audiosourceresample_create(decodesource, 48000));
-    if (!channels[slot].fadepanvolsource) {
-        audio_UnlockAudioThread();
+    // set up the ring buffer the decoder thread fills for us:
+    c.ring = ringbuffer_create(CHANNELRINGSIZE);
+    if (!c.ring) {
+        c.decodesource->close(c.decodesource);
         return -1;
     }
 
-    // set the options for the fade/pan/vol modifier
-    audiosourcefadepanvol_setPanVol(channels[slot].fadepanvolsource,
-        volume, panning, noamplify);
+    // set the fade/pan/vol options:
+    audioblock_initPanVol(&c.panvol);
+    audioblock_setPanVol(&c.panvol, volume, panning, noamplify);
     if (fadeinseconds > 0) {
         // reset volume to 0 for fadein:
-        audiosourcefadepanvol_setPanVol(channels[slot].fadepanvolsource,
-            0, panning, noamplify);
+        audioblock_setPanVol(&c.panvol, 0, panning, noamplify);
 
         // instruct fadein:
-        audiosourcefadepanvol_startFade(channels[slot].fadepanvolsource,
+        audioblock_startFade(&c.panvol, c.samplerate,
             fadeinseconds, volume, 0);
     }
 
-    // wrap the fade/pan/vol modifier into a loop audio source
-    channels[slot].loopsource = audiosourceloop_create(
-        channels[slot].fadepanvolsource);
-    if (!channels[slot].loopsource) {
-        channels[slot].fadepanvolsource->close(channels[slot].fadepanvolsource);
-        channels[slot].fadepanvolsource = NULL;
-        audio_UnlockAudioThread();
-        return -1;
-    }
-
-    // set the options for the loop audio source
-    audiosourceloop_setLooping(channels[slot].loopsource, loop);
-
-    // remember that loop audio source as final processed audio
-    channels[slot].mixsource = channels[slot].loopsource;
-    
     // initialise various things
-    channels[slot].id = id;
-    channels[slot].fadeoutandstop = 0;
+    c.id = id;
+    c.priority = priority;
+    c.bus = bus;
+    c.fadeoutandstop = 0;
 
-    // we're done, unlock audio thread:
-    audio_UnlockAudioThread();
-    return id;
-}
+    // decode the first samples right away, so the sound can start
+    // playing without waiting for the decoder thread:
+    audiomixer_DecodeChannel(&c);
 
-static void audiomixer_HandleChannelEOF(int channel, int returnvalue) { //  SOUND THREAD
-    if (returnvalue) {
-        // FIXME: we probably want to emit some sort of warning here
+    // obtain free slot:
+    int slot = audiomixer_GetFreeChannelSlot(priority);
+    if (slot < 0) {
+        // no free slot :(
+        audiomixer_CloseChannelSources(&c);
+        return -1;
     }
-    audiomixer_CancelChannel(channel);
-}
 
-#define MIXTYPE float
-#define MIXSIZE (1024*10)
+    // make sure we can send the play command:
+    struct mixercommand cmd;
+    if (!commandqueue || ringbuffer_writable(commandqueue) < sizeof(cmd)) {
+        audiomixer_PostCommand(NULL);  // warn about full queue
+        audiomixer_CloseChannelSources(&c);
+        return -1;
+    }
 
-char mixbuf[MIXSIZE]; // for mixing the final mix
-char mixbuf2[MIXSIZE]; // for keeping the channel's content
-int filledmixpartial = 0;
-int filledmixfull = 0;
+    // hand the channel over to the audio and decoder thread:
+    memcpy(&channels[slot], &c, sizeof(c));
+    __atomic_store_n(&channels[slot].state, CHANNEL_STARTING,
+        __ATOMIC_RELEASE);
+    if (decodesemaphore) {
+        semaphore_Post(decodesemaphore);
+    }
 
-static void audiomixer_RequestMix(unsigned int bytes) { // SOUND THREAD
-    unsigned int filledbytes = filledmixpartial + filledmixfull * sizeof(MIXTYPE);
+    // tell the audio thread to start playing it:
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = MIXERCOMMAND_PLAY;
+    cmd.slot = slot;
+    cmd.id = id;
+    audiomixer_PostCommand(&cmd);
+    return id;
+}
 
-    // calculate the desired amount of samples
-    int sampleamount = (bytes - filledbytes)/sizeof(MIXTYPE);
-    while (sampleamount * sizeof(MIXTYPE) < bytes - filledbytes) {
-        sampleamount += sizeof(MIXTYPE);
-    }
+// Mix the given amount of frames of a channel into the target buffer.
+// The decoded frames are processed directly from the ring buffer
+// memory, applying fade/pan/volume and mixing in one pass:
+static void audiomixer_MixChannel(int slot, float* target,
+        unsigned int frames) { // SOUND THREAD
+    struct soundchannel* c = &channels[slot];
+
+    // check for EOF before checking the available data, so we never
+    // miss data written right before the EOF mark:
+    int decodeeof = __atomic_load_n(&c->decodeeof, __ATOMIC_ACQUIRE);
+
+    while (frames > 0) {
+        void* p;
+        unsigned int available = ringbuffer_readRegion(c->ring, &p)
+            / FRAMESIZE;
+        float straddling[2];
+        if (available == 0 &&
+        ringbuffer_readable(c->ring) >= FRAMESIZE) {
+            // a frame is split by the ring buffer wrap-around:
+            ringbuffer_read(c->ring, straddling, FRAMESIZE);
+            if (audioblock_processPanVol(&c->panvol, straddling, target,
+            1, AUDIOBLOCK_MIX) < 1) {
+                // sound terminated after fade out
+                audiomixer_CancelChannel(slot);
+                return;
+            }
+            target += 2;
+            frames--;
+            continue;
+        }
+        if (available == 0) {
+            if (decodeeof) {
+                // sound is over
+                audiomixer_CancelChannel(slot);
+            } else if (!c->inunderrun) {
+                // the decoder thread doesn't keep up. we will simply
+                // leave this channel silent for now:
+                c->inunderrun = 1;
+                __atomic_add_fetch(&underruns, 1, __ATOMIC_RELAXED);
+            }
+            return;
+        }
+        c->inunderrun = 0;
 
-    // limit to possible buffer maximum
-    while (sampleamount * sizeof(MIXTYPE) + filledbytes > MIXSIZE) {
-        sampleamount--;
+        if (available > frames) {
+            available = frames;
+        }
+        unsigned int processed = audioblock_processPanVol(&c->panvol,
+            p, target, available, AUDIOBLOCK_MIX);
+        ringbuffer_skip(c->ring, processed * FRAMESIZE);
+        if (processed < available) {
+            // sound terminated after fade out
+            audiomixer_CancelChannel(slot);
+            return;
+        }
+        target += available * 2;
+        frames -= available;
     }
+}
 
-    // check if we want any samples at all
-    if (sampleamount <= 0) {
-        return;
-    }
+// Check whether a bus is at full volume and not fading, so its sounds
+// can be mixed without processing the bus:
+static int audiomixer_IsBusUnity(struct mixerbus* b) {
+    return (b->panvol.vol == 1 && b->panvol.fadeframesleft <= 0);
+}
 
-    int samplebytes = sampleamount * sizeof(MIXTYPE);
-
-    // cycle all channels and mix them into the buffer
-    int notzerochannels = 0;
-    unsigned int i = 0;
-    int mixedchannels = 0;
-    while (i < MAXCHANNELS) {
-        if (channels[i].mixsource) {
-            notzerochannels = 1;
-            mixedchannels++;
-            // read bytes
-            int k = channels[i].mixsource->read(channels[i].mixsource,
-                mixbuf2, samplebytes);
-            if (k <= 0) {
-                audiomixer_HandleChannelEOF(i, k);
-                i++;
-                continue;
-            }
+// Mix the given amount of frames into the mix ring buffer
+// (or less if it doesn't have that much space left):
+static void audiomixer_RequestMix(unsigned int frames) { // SOUND THREAD
+    while (frames > 0) {
+        void* p;
+        unsigned int space = ringbuffer_writeRegion(mixring, &p) /
+            FRAMESIZE;
+        if (space == 0) {
+            return;
+        }
+        if (space > frames) {
+            space = frames;
+        }
+        if (space > BUSBLOCKFRAMES) {
+            space = BUSBLOCKFRAMES;
+        }
 
-            // see how many samples we can actually mix from this
-            unsigned int mixsamples,mixbytes;
-            if (k != samplebytes) {
-                mixsamples = k / sizeof(MIXTYPE);
-                while (mixsamples * sizeof(MIXTYPE) > (unsigned int)k) {
-                    mixsamples--;
-                }
-                mixbytes = mixsamples * sizeof(MIXTYPE);
-            } else {
-                mixsamples = sampleamount;
-                mixbytes = samplebytes;
-            }
+        // without decoder thread, provide the channel data ourselves:
+        if (synchronousdecoding) {
+            audiomixer_DecodeAllChannels();
+        }
 
-            if (mixedchannels > 1) {
-                // mix samples
-                MIXTYPE* mixtarget = (MIXTYPE*)((char*)mixbuf + filledbytes);
-                float* mixsource = (float*)mixbuf2;
-                unsigned int r = 0;
-                while (r < mixsamples) {
-                    float sourcevalue = *mixsource;
-                    float targetvalue = *mixtarget;
-
-                    float result;
-                    if ((targetvalue < 0 && sourcevalue >= 0)
-                    || (targetvalue > 0 && sourcevalue <= 0)) {
-                        // different sign -> simply add
-                        result = sourcevalue + targetvalue;
-                    } else {
-                        // same sign -> do intelligent mix thing:
-                        float reversed = 1;
-                        if (sourcevalue < 0 || targetvalue < 0) {
-                            reversed = -1;
-                            sourcevalue = -sourcevalue;
-                            targetvalue = -targetvalue;
-                        }
-                        result = reversed * ((targetvalue + sourcevalue) -
-                            (targetvalue * sourcevalue));
+        // start with silence and mix all channels into it, or into
+        // their bus if it needs processing:
+        float* mixtarget = p;
+        memset(mixtarget, 0, space * FRAMESIZE);
+        int busused[AUDIOMIXER_MAXBUSES];
+        memset(busused, 0, sizeof(busused));
+        unsigned int i = 0;
+        while (i < MAXCHANNELSLOTS) {
+            if (audiomixer_ChannelState(i) == CHANNEL_PLAYING) {
+                struct mixerbus* b = &buses[channels[i].bus];
+                if (channels[i].bus == AUDIOMIXER_BUS_MASTER ||
+                audiomixer_IsBusUnity(b)) {
+                    audiomixer_MixChannel(i, mixtarget, space);
+                } else {
+                    if (!busused[channels[i].bus]) {
+                        busused[channels[i].bus] = 1;
+                        memset(b->buffer, 0, space * FRAMESIZE);
                     }
-                    *mixtarget = (MIXTYPE)result;
-                    r++;
-                    mixsource++;
-                    mixtarget++;
+                    audiomixer_MixChannel(i, b->buffer, space);
                 }
-            } else {
-                // simply copy the channel into the stream
-                memcpy(mixbuf + filledbytes, mixbuf2, mixbytes);
+            }
+            i++;
+        }
 
-                // calculate the amount of additional zeroes we might need:
-                int addzeroes = samplebytes - mixbytes;
-                if (addzeroes > 0) {
-                    memset(mixbuf + filledbytes + mixbytes, 0, addzeroes);
-                }
+        // mix the buses with their volume applied:
+        i = 0;
+        while (i < AUDIOMIXER_MAXBUSES) {
+            struct mixerbus* b = &buses[i];
+            if (busused[i]) {
+                audioblock_processPanVol(&b->panvol, b->buffer,
+                    mixtarget, space, AUDIOBLOCK_MIX);
+            } else if (b->panvol.fadeframesleft > 0 &&
+            i != AUDIOMIXER_BUS_MASTER) {
+                // no sounds, but a running fade still needs to advance:
+                memset(b->buffer, 0, space * FRAMESIZE);
+                audioblock_processPanVol(&b->panvol, b->buffer,
+                    b->buffer, space, AUDIOBLOCK_WRITE);
             }
+            i++;
         }
-        i++;
-    }
 
-    // zero buffer if no channel was copied into it:
-    if (!notzerochannels) {
-        memset(mixbuf + filledbytes, 0, samplebytes);
+        // the master bus applies to everything:
+        if (!audiomixer_IsBusUnity(&buses[AUDIOMIXER_BUS_MASTER])) {
+            audioblock_processPanVol(&buses[AUDIOMIXER_BUS_MASTER].panvol,
+                mixtarget, mixtarget, space, AUDIOBLOCK_WRITE);
+        }
+        ringbuffer_commit(mixring, space * FRAMESIZE);
+        frames -= space;
     }
+}
 
-    // remember how much new mix buffer we processed now
-    filledmixfull += sampleamount;
+// Make sure the mix ring buffer has the given amount of bytes ready:
+static void audiomixer_EnsureMixed(unsigned int bytes) { // SOUND THREAD
+    unsigned int readable = ringbuffer_readable(mixring);
+    if (readable >= bytes) {
+        return;
+    }
+    audiomixer_RequestMix((bytes - readable + FRAMESIZE - 1) / FRAMESIZE);
 }
 
 int s16mixmode = 0;
+int s16mixdither = 1;
 
-void audiomixer_GetBuffer(void* buf, unsigned int len) { // SOUND THREAD
-    char* p = buf;
-    while (len > 0) {
-        audiomixer_RequestMix(len);
+// second byte of a S16 sample which was split up between two calls:
+static char s16carry[2];
+static int s16carried = 0;
+static uint32_t s16ditherpos = 0;
 
-        // see how much bytes we can get
-        unsigned int filledbytes = filledmixpartial + filledmixfull * sizeof(MIXTYPE);
-        unsigned int amount = len+len*s16mixmode;  // doubled for s16mixmode
-        if (amount > filledbytes) {
-            amount = filledbytes;
-        }
-        if (amount == 0) {
-            break;
-        }
+void audiomixer_SetDitherSeed(uint32_t seed) {
+    s16ditherpos = seed;
+}
 
-        // copy the amount of bytes we have
-        if (s16mixmode) {
-            // copy them and convert them to S16 on the fly
-            // FIXME: this doesn't work properly with partial samples
-            unsigned int i = 0;
-            while (i <= amount-sizeof(MIXTYPE)) {
-                MIXTYPE fval = *((MIXTYPE*)((char*)mixbuf+i));
-                fval *= 32767;
-                *((int16_t*)((char*)p)) = (int16_t)fastdoubletoint32(fval);
-                p += sizeof(int16_t);
-                len -= sizeof(int16_t);
-                i += sizeof(MIXTYPE);
+void audiomixer_GetBuffer(void* buf, unsigned int len) { // SOUND THREAD
+    // apply everything the main thread requested since the last block:
+    if (commandqueue) {
+        audiomixer_ProcessCommands();
+    }
+
+    char* p = buf;
+    if (!mixring) {
+        // mixer not initialised yet
+        memset(buf, 0, len);
+        return;
+    }
+    if (!s16mixmode) {
+        // copy float 32 samples (partial samples are no problem here,
+        // the rest of a sample simply stays in the mix ring):
+        while (len > 0) {
+            audiomixer_EnsureMixed(len);
+            void* region;
+            unsigned int amount = ringbuffer_readRegion(mixring, &region);
+            if (amount == 0) {
+                break;
             }
-        } else {
-            // copy them as float 32:
-            memcpy(p, mixbuf, amount);
-            len -= amount;
+            if (amount > len) {
+                amount = len;
+            }
+            memcpy(p, region, amount);
+            ringbuffer_skip(mixring, amount);
             p += amount;
+            len -= amount;
+        }
+    } else {
+        // finish a sample split up at the end of the previous call:
+        if (s16carried && len > 0) {
+            *p = s16carry[1];
+            p++;
+            len--;
+            s16carried = 0;
         }
 
-        // trim mix buffer:
-        if (amount >= filledbytes) {
-            // simply mark mix buffer as empty
-            filledmixpartial = 0;
-            filledmixfull = 0;
-        }else{
-            // move back contents
-            memmove(mixbuf, mixbuf + amount, filledbytes - amount);
-
-            // update fill state
-            unsigned int fullparsedsamples = amount / sizeof(MIXTYPE);
-            if (fullparsedsamples * sizeof(MIXTYPE) > amount) {
-                fullparsedsamples -= sizeof(MIXTYPE);
+        // convert to S16 directly from the mix ring:
+        while (len > 0) {
+            unsigned int samples = (len + 1) / sizeof(int16_t);
+            audiomixer_EnsureMixed(samples * sizeof(float));
+            void* region;
+            unsigned int amount = ringbuffer_readRegion(mixring, &region) /
+                sizeof(float);
+            if (amount == 0) {
+                break;
             }
-            int partialparsedbytes = amount - fullparsedsamples *
-                sizeof(MIXTYPE);
-            filledmixfull -= fullparsedsamples;
-            filledmixpartial -= partialparsedbytes;
-
-            // handle partial bytes correctly
-            while (filledmixpartial < 0) {
-                filledmixpartial += sizeof(MIXTYPE);
-                filledmixfull++;
+            if (amount > len / sizeof(int16_t)) {
+                amount = len / sizeof(int16_t);
             }
-            while (filledmixpartial >= (int)sizeof(MIXTYPE)) {
-                filledmixpartial -= sizeof(MIXTYPE);
-                filledmixfull--;
+            if (amount == 0) {
+                // only one byte is requested. convert a full sample and
+                // keep the second byte for the next call:
+                audioblock_floatToS16(region, s16carry, 1,
+                    (s16mixdither ? &s16ditherpos : NULL));
+                ringbuffer_skip(mixring, sizeof(float));
+                *p = s16carry[0];
+                s16carried = 1;
+                len = 0;
+                break;
             }
+            audioblock_floatToS16(region, p, amount,
+                (s16mixdither ? &s16ditherpos : NULL));
+            ringbuffer_skip(mixring, amount * sizeof(float));
+            p += amount * sizeof(int16_t);
+            len -= amount * sizeof(int16_t);
         }
     }
+    if (len > 0) {
+        // mix ring buffer is full, which should never happen:
+        memset(p, 0, len);
+    }
+
+    // wake up the decoder thread to refill what we consumed:
+    if (decodesemaphore) {
+        semaphore_Post(decodesemaphore);
+    }
 }
 
 unsigned int audiomixer_HighestUsedChannel(void) {
     unsigned int c = 0;
-    audio_LockAudioThread();
-    int i = MAXCHANNELS - 1;
+    int i = MAXCHANNELSLOTS - 1;
     while (i >= 0) {
-        if (channels[i].mixsource) {
+        if (audiomixer_IsChannelActive(i)) {
             c = i;
             break;
         }
         i--;
     }
-    audio_UnlockAudioThread();
     return c;
 }
 
 unsigned int audiomixer_ChannelCount(void) {
     unsigned int c = 0;
-    audio_LockAudioThread();
     int i = 0;
-    while (i < MAXCHANNELS) {
-        if (channels[i].mixsource) {
+    while (i < MAXCHANNELSLOTS) {
+        if (audiomixer_IsChannelActive(i)) {
             c++;
         }
         i++;
     }
-    audio_UnlockAudioThread();
     return c;
 }
 
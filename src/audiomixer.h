@@ -24,18 +24,75 @@
 #ifndef BLITWIZARD_AUDIOMIXER_H_
 #define BLITWIZARD_AUDIOMIXER_H_
 
+#include <stdint.h>
+
 extern int s16mixmode; // 1: output s16 samples, 0: output float32 samples (default)
+extern int s16mixdither; // 1: apply TPDF dither to s16 output (default), 0: don't
 void audiomixer_GetBuffer(void* buf, unsigned int len);
 void audiomixer_Init(void);
-int audiomixer_PlaySoundFromDisk(const char *path, int priority, float volume, float panning, int noamplify, float fadeinseconds, int loop);
+
+// Decode sounds inside audiomixer_GetBuffer instead of on a separate
+// decoder thread. Slower, but the output never depends on thread
+// timing (no underruns). Needs to be set before audiomixer_Init:
+void audiomixer_SetSynchronousDecoding(int enabled);
+
+// Reset the position in the s16 dither noise sequence, to get the
+// same output for the same input every time:
+void audiomixer_SetDitherSeed(uint32_t seed);
+
+// Mixer buses. Each sound plays on a bus, and each bus has its own
+// volume (with fades) applied once to all of its sounds. The master
+// bus applies to everything. Further buses can be added by name:
+#define AUDIOMIXER_MAXBUSES 16
+#define AUDIOMIXER_BUS_MASTER 0
+#define AUDIOMIXER_BUS_MUSIC 1
+#define AUDIOMIXER_BUS_SFX 2  // default for sounds
+#define AUDIOMIXER_BUS_UI 3
+
+// Get the bus with the given name. If create is 1, a new bus is added
+// if it doesn't exist yet. Returns -1 if not found or no bus is left:
+int audiomixer_GetBus(const char* name, int create);
+
+// Change the volume (0 to 1) of a bus, fading over the given amount
+// of seconds if > 0:
+void audiomixer_SetBusVolume(int bus, float volume, float fadeseconds);
+
+// Play a sound from disk on the given bus. With loop enabled, playback
+// wraps from loopend to loopstart (both in seconds, loopend 0 for the
+// end of the sound) without a gap. The part before loopstart is an
+// intro which plays only once.
+int audiomixer_PlaySoundFromDisk(const char *path, int priority, float volume, float panning, int noamplify, float fadeinseconds, int loop, double loopstart, double loopend, int bus);
 void audiomixer_StopSound(int id);
 void audiomixer_AdjustSound(int id, float volume, float panning, int noamplify);
+// Like audiomixer_AdjustSound, but the volume changes smoothly over the
+// given amount of seconds (for sounds which are adjusted every frame):
+void audiomixer_AdjustSoundGradually(int id, float volume, float panning, float seconds);
 int audiomixer_IsSoundPlaying(int id);
+
+// Get the next sound which stopped playing (because it ended, was
+// stopped or was replaced by a sound with higher priority), or 0 if
+// there is none. Returns AUDIOMIXER_FINISHED_LOST if too many sounds
+// stopped to report them all since the last call, in which case all
+// sounds need to be checked with audiomixer_IsSoundPlaying. This lets
+// the main thread track sounds without checking on every one of them
+// regularly. Main thread only:
+#define AUDIOMIXER_FINISHED_LOST (-1)
+int audiomixer_GetFinishedSound(void);
 int audiomixer_NoSoundsPlaying(void);
 void audiomixer_StopSoundWithFadeout(int id, float fadeoutseconds);
 unsigned int audiomixer_ChannelCount(void);
 unsigned int audiomixer_HighestUsedChannel(void);
 int audiomixer_GetIdFromSoundOnChannel(unsigned int channel);
 
+// Total amount of buffer underruns so far (the decoder thread
+// didn't decode sounds fast enough and silence had to be played):
+unsigned int audiomixer_GetUnderrunCount(void);
+
+// Open a sound file and return an audio source decoding it to
+// 32bit float samples (at the file's own sample rate), or NULL
+// if the format is unsupported:
+struct audiosource;
+struct audiosource* audiomixer_CreateDecodeSource(const char* path);
+
 #endif  // BLITWIZARD_AUDIOMIXER_H_
 
@@ -0,0 +1,394 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "config.h"
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "audiosource.h"
+#include "audiosourceresample.h"
+#include "audiomixer.h"
+#include "audiopcmcache.h"
+#include "hash.h"
+#include "threading.h"
+
+// default limits: cache sounds up to 5 seconds, use up to 32MB
+static double maxcachedseconds = 5.0;
+static size_t cachebudget = 32 * 1024 * 1024;
+
+static size_t cacheusedbytes = 0;
+static int cacheentries = 0;
+static unsigned int lastusedcounter = 0;
+
+static struct audiopcmcacheentry* entrylist = NULL;
+static hashmap* cachehashmap = NULL;
+static mutex* cacheMutex = NULL;
+
+// this runs on application start:
+__attribute__((constructor)) static void audiopcmcache_init(void) {
+    cacheMutex = mutex_create();
+}
+
+static size_t audiopcmcache_entrySize(struct audiopcmcacheentry* e) {
+    return e->frames * 2 * sizeof(float);
+}
+
+// the following functions need to be called with cacheMutex held:
+
+static struct audiopcmcacheentry* audiopcmcache_find(const char* path) {
+    if (!cachehashmap) {
+        return NULL;
+    }
+    uint32_t i = hashmap_getIndex(cachehashmap, path, strlen(path), 0);
+    struct audiopcmcacheentry* e = cachehashmap->items[i];
+    while (e) {
+        if (strcmp(e->path, path) == 0) {
+            return e;
+        }
+        e = e->hashbucketnext;
+    }
+    return NULL;
+}
+
+static void audiopcmcache_add(struct audiopcmcacheentry* e) {
+    if (!cachehashmap) {
+        cachehashmap = hashmap_new(1024);
+        if (!cachehashmap) {
+            return;
+        }
+    }
+    uint32_t i = hashmap_getIndex(cachehashmap, e->path,
+        strlen(e->path), 0);
+    e->hashbucketnext = cachehashmap->items[i];
+    cachehashmap->items[i] = e;
+    e->next = entrylist;
+    entrylist = e;
+    cacheusedbytes += audiopcmcache_entrySize(e);
+    cacheentries++;
+}
+
+static void audiopcmcache_removeAndFree(struct audiopcmcacheentry* e) {
+    // remove from hash bucket:
+    uint32_t i = hashmap_getIndex(cachehashmap, e->path,
+        strlen(e->path), 0);
+    struct audiopcmcacheentry* prev = NULL;
+    struct audiopcmcacheentry* e2 = cachehashmap->items[i];
+    while (e2) {
+        if (e2 == e) {
+            if (prev) {
+                prev->hashbucketnext = e->hashbucketnext;
+            } else {
+                cachehashmap->items[i] = e->hashbucketnext;
+            }
+            break;
+        }
+        prev = e2;
+        e2 = e2->hashbucketnext;
+    }
+
+    // remove from entry list:
+    prev = NULL;
+    e2 = entrylist;
+    while (e2) {
+        if (e2 == e) {
+            if (prev) {
+                prev->next = e->next;
+            } else {
+                entrylist = e->next;
+            }
+            break;
+        }
+        prev = e2;
+        e2 = e2->next;
+    }
+
+    cacheusedbytes -= audiopcmcache_entrySize(e);
+    cacheentries--;
+    free(e->samples);
+    free(e->path);
+    free(e);
+}
+
+// Drop least recently used sounds nobody plays right now until
+// the given amount of additional bytes fits into the budget.
+// Returns 1 on success, 0 if not enough memory could be freed.
+static int audiopcmcache_makeRoom(size_t bytes) {
+    while (cacheusedbytes + bytes > cachebudget) {
+        struct audiopcmcacheentry* oldest = NULL;
+        struct audiopcmcacheentry* e = entrylist;
+        while (e) {
+            if (!e->failed && __sync_add_and_fetch(&e->refcount, 0) == 0) {
+                if (!oldest || e->lastused < oldest->lastused) {
+                    oldest = e;
+                }
+            }
+            e = e->next;
+        }
+        if (!oldest) {
+            return 0;
+        }
+        audiopcmcache_removeAndFree(oldest);
+    }
+    return 1;
+}
+
+// Decode a sound fully. This is done without holding the mutex.
+// Returns an unlisted entry (possibly marked as failed), or NULL
+// if we ran out of memory.
+static struct audiopcmcacheentry* audiopcmcache_decode(const char* path,
+        double maxseconds) {
+    struct audiopcmcacheentry* e = malloc(sizeof(*e));
+    if (!e) {
+        return NULL;
+    }
+    memset(e, 0, sizeof(*e));
+    e->path = strdup(path);
+    if (!e->path) {
+        free(e);
+        return NULL;
+    }
+    e->failed = 1;
+
+    struct audiosource* source = audiomixer_CreateDecodeSource(path);
+    if (source) {
+        source = audiosourceresample_create(source, 48000);
+    }
+    if (!source || source->samplerate == 0 ||
+    (source->channels != 1 && source->channels != 2)) {
+        // we can't decode this
+        if (source) {
+            source->close(source);
+        }
+        return e;
+    }
+
+    unsigned int channels = source->channels;
+    size_t maxframes = (size_t)(maxseconds * source->samplerate);
+    size_t maxbytes = maxframes * channels * sizeof(float);
+
+    // check the length before decoding anything, so long sounds (e.g.
+    // music) are skipped right away. Some decoders only know it after
+    // seeking (which reads the stream headers, not the audio):
+    size_t length = 0;
+    if (source->length) {
+        length = source->length(source);
+        if (length == 0 && source->seekable && source->seek(source, 0)) {
+            length = source->length(source);
+        }
+    }
+    if (length == 0 || length > maxframes) {
+        // too long, or unknown length which might be as well
+        source->close(source);
+        return e;
+    }
+
+    // read the whole sound:
+    char* data = NULL;
+    size_t datasize = 0;
+    size_t dataalloc = 0;
+    int toolong = 0;
+    while (1) {
+        if (datasize + 4096 > dataalloc) {
+            size_t newalloc = dataalloc * 2;
+            if (newalloc < 16 * 1024) {
+                newalloc = 16 * 1024;
+            }
+            char* newdata = realloc(data, newalloc);
+            if (!newdata) {
+                toolong = 1;
+                break;
+            }
+            data = newdata;
+            dataalloc = newalloc;
+        }
+        int i = source->read(source, data + datasize, 4096);
+        if (i < 0) {
+            toolong = 1;  // decode error, treat as failed
+            break;
+        }
+        if (i == 0) {
+            break;
+        }
+        datasize += i;
+        if (datasize > maxbytes) {
+            toolong = 1;
+            break;
+        }
+    }
+    e->samplerate = source->samplerate;
+    source->close(source);
+    if (toolong) {
+        free(data);
+        return e;
+    }
+
+    // convert to interleaved stereo:
+    e->frames = datasize / (channels * sizeof(float));
+    if (e->frames == 0) {
+        free(data);
+        return e;
+    }
+    if (channels == 2) {
+        e->samples = (float*)data;
+    } else {
+        e->samples = malloc(e->frames * 2 * sizeof(float));
+        if (!e->samples) {
+            free(data);
+            e->frames = 0;
+            return e;
+        }
+        const float* mono = (const float*)data;
+        size_t k = 0;
+        while (k < e->frames) {
+            e->samples[k * 2] = mono[k];
+            e->samples[k * 2 + 1] = mono[k];
+            k++;
+        }
+        free(data);
+    }
+    e->failed = 0;
+    return e;
+}
+
+struct audiopcmcacheentry* audiopcmcache_get(const char* path) {
+    mutex_lock(cacheMutex);
+    struct audiopcmcacheentry* e = audiopcmcache_find(path);
+    if (e) {
+        if (e->failed) {
+            // we already know this one isn't cacheable
+            mutex_release(cacheMutex);
+            return NULL;
+        }
+        __sync_add_and_fetch(&e->refcount, 1);
+        e->lastused = ++lastusedcounter;
+        mutex_release(cacheMutex);
+        return e;
+    }
+    double maxseconds = maxcachedseconds;
+    mutex_release(cacheMutex);
+
+    if (maxseconds <= 0 || cachebudget == 0) {
+        // caching is disabled
+        return NULL;
+    }
+
+    // decode the sound without blocking other cache users:
+    struct audiopcmcacheentry* newe = audiopcmcache_decode(path, maxseconds);
+    if (!newe) {
+        return NULL;
+    }
+
+    mutex_lock(cacheMutex);
+    e = audiopcmcache_find(path);
+    if (e) {
+        // someone else cached it in the meantime
+        free(newe->samples);
+        free(newe->path);
+        free(newe);
+        if (e->failed) {
+            mutex_release(cacheMutex);
+            return NULL;
+        }
+        __sync_add_and_fetch(&e->refcount, 1);
+        e->lastused = ++lastusedcounter;
+        mutex_release(cacheMutex);
+        return e;
+    }
+    if (!newe->failed &&
+    !audiopcmcache_makeRoom(audiopcmcache_entrySize(newe))) {
+        // doesn't fit. don't remember it as failed, since it might
+        // fit in later when other sounds are no longer in use:
+        mutex_release(cacheMutex);
+        free(newe->samples);
+        free(newe->path);
+        free(newe);
+        return NULL;
+    }
+    audiopcmcache_add(newe);
+    if (newe->failed) {
+        mutex_release(cacheMutex);
+        return NULL;
+    }
+    __sync_add_and_fetch(&newe->refcount, 1);
+    newe->lastused = ++lastusedcounter;
+    mutex_release(cacheMutex);
+    return newe;
+}
+
+void audiopcmcache_release(struct audiopcmcacheentry* entry) {
+    if (!entry) {
+        return;
+    }
+    // the entry is only ever freed by audiopcmcache_makeRoom when
+    // the refcount is zero, so we must not touch it afterwards:
+    __sync_sub_and_fetch(&entry->refcount, 1);
+}
+
+int audiopcmcache_preload(const char* path) {
+    struct audiopcmcacheentry* e = audiopcmcache_get(path);
+    if (!e) {
+        return 0;
+    }
+    audiopcmcache_release(e);
+    return 1;
+}
+
+void audiopcmcache_setLimits(double maxseconds, size_t budgetbytes) {
+    mutex_lock(cacheMutex);
+    maxcachedseconds = maxseconds;
+    cachebudget = budgetbytes;
+
+    // forget about sounds which previously failed, since they might
+    // be short enough now:
+    struct audiopcmcacheentry* e = entrylist;
+    while (e) {
+        struct audiopcmcacheentry* enext = e->next;
+        if (e->failed) {
+            audiopcmcache_removeAndFree(e);
+        }
+        e = enext;
+    }
+
+    // drop unused sounds to respect the new budget:
+    audiopcmcache_makeRoom(0);
+    mutex_release(cacheMutex);
+}
+
+void audiopcmcache_getUsage(size_t* usedbytes, int* entries) {
+    mutex_lock(cacheMutex);
+    if (usedbytes) {
+        *usedbytes = cacheusedbytes;
+    }
+    if (entries) {
+        *entries = cacheentries;
+    }
+    mutex_release(cacheMutex);
+}
+
+#endif  // USE_AUDIO
+
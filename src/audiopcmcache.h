@@ -0,0 +1,75 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIOPCMCACHE_H_
+#define BLITWIZARD_AUDIOPCMCACHE_H_
+
+#include <stddef.h>
+
+// The PCM cache keeps short sounds fully decoded in memory as
+// 32bit float stereo (resampled to 48kHz), so that a sound effect
+// played many times in a row doesn't get opened and decoded from
+// disk again for every single play.
+
+struct audiopcmcacheentry {
+    char* path;
+    float* samples;  // interleaved stereo samples
+    size_t frames;  // amount of stereo sample frames
+    unsigned int samplerate;
+    int refcount;  // amount of audio sources reading from this entry
+    int failed;  // 1 if sound is too long or can't be decoded
+
+    unsigned int lastused;  // for least-recently-used eviction
+    struct audiopcmcacheentry* hashbucketnext;
+    struct audiopcmcacheentry* next;
+};
+
+struct audiopcmcacheentry* audiopcmcache_get(const char* path);
+// Get a decoded copy of the given sound file from the cache.
+// If the file isn't cached yet, it will be decoded right now as long as
+// it is shorter than the configured maximum length.
+// Returns NULL if the sound is too long (or its length is unknown),
+// doesn't fit into the cache budget or fails to decode - play it
+// streamed from disk in that case.
+//
+// A non-NULL entry needs to be returned with audiopcmcache_release
+// when you no longer use it. Don't call this from the audio thread.
+
+void audiopcmcache_release(struct audiopcmcacheentry* entry);
+// Give up a reference obtained with audiopcmcache_get.
+// This is safe to call from the audio thread and never blocks.
+
+int audiopcmcache_preload(const char* path);
+// Decode the given sound into the cache ahead of time.
+// Returns 1 if the sound is now cached, 0 if it can't be cached.
+
+void audiopcmcache_setLimits(double maxseconds, size_t budgetbytes);
+// Set the maximum length of sounds which get cached (in seconds) and
+// the total amount of memory all cached sounds may use.
+// Unused sounds exceeding the new budget are dropped immediately.
+
+void audiopcmcache_getUsage(size_t* usedbytes, int* entries);
+// Query how much memory is currently used by cached sounds.
+
+#endif  // BLITWIZARD_AUDIOPCMCACHE_H_
+
@@ -0,0 +1,462 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "config.h"
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "hash.h"
+#include "audiomixer.h"
+#include "audiopositional.h"
+
+// Below this gain, a voice is inaudible and becomes virtual:
+#define AUDIBLEGAIN 0.001f
+
+// Changes smaller than this aren't sent to the mixer:
+#define GAINEPSILON 0.002f
+#define PANEPSILON 0.01f
+
+// Time over which gain changes are smoothed, and the fade used when
+// a voice changes between virtual and audible:
+#define SMOOTHSECONDS 0.02f
+#define VIRTUALFADESECONDS 0.05f
+
+struct audiopositional_voice {
+    char* path;
+    int priority;
+    double x, y;
+    double mindistance, maxdistance;
+    int curve;
+    double loopstart, loopend;
+    int bus;
+
+    // play state:
+    int playing;  // playing audibly or virtually
+    int loop;
+    float volume;
+    int soundid;  // mixer sound, -1 while virtual
+    float gain, pan;  // last values sent to the mixer
+    void* userdata;  // passed to the finished callback
+
+    // list of playing voices:
+    struct audiopositional_voice* prev, *next;
+
+    // hash bucket of voices by mixer sound id, if soundid >= 0:
+    struct audiopositional_voice* nextbysoundid;
+};
+
+struct audiopositional_listener {
+    int enabled;
+    double x, y;
+};
+
+static struct audiopositional_listener
+    listeners[AUDIOPOSITIONAL_MAXLISTENERS] = {{1, 0, 0}};
+static struct audiopositional_voice* playingvoices = NULL;
+static void (*finishedcallback)(void* userdata) = NULL;
+
+// Voices with a mixer sound by sound id, so finished sounds reported
+// by the mixer are found quickly:
+static hashmap* voicesbysoundid = NULL;
+
+static uint32_t audiopositional_soundIdIndex(int id) {
+    return hashmap_getIndex(voicesbysoundid, (const char*)&id,
+        sizeof(id), 0);
+}
+
+// Set the mixer sound of a voice (-1 for none) and keep the sound id
+// index up to date:
+static void audiopositional_setSoundId(struct audiopositional_voice* v,
+        int id) {
+    if (v->soundid >= 0 && voicesbysoundid) {
+        uint32_t i = audiopositional_soundIdIndex(v->soundid);
+        struct audiopositional_voice* prev = NULL;
+        struct audiopositional_voice* v2 = voicesbysoundid->items[i];
+        while (v2) {
+            if (v2 == v) {
+                if (prev) {
+                    prev->nextbysoundid = v->nextbysoundid;
+                } else {
+                    voicesbysoundid->items[i] = v->nextbysoundid;
+                }
+                break;
+            }
+            prev = v2;
+            v2 = v2->nextbysoundid;
+        }
+        v->nextbysoundid = NULL;
+    }
+    v->soundid = id;
+    if (id < 0) {
+        return;
+    }
+    if (!voicesbysoundid) {
+        voicesbysoundid = hashmap_new(1024);
+        if (!voicesbysoundid) {
+            return;
+        }
+    }
+    uint32_t i = audiopositional_soundIdIndex(id);
+    v->nextbysoundid = voicesbysoundid->items[i];
+    voicesbysoundid->items[i] = v;
+}
+
+static void audiopositional_addToPlaying(
+        struct audiopositional_voice* v) {
+    v->prev = NULL;
+    v->next = playingvoices;
+    if (playingvoices) {
+        playingvoices->prev = v;
+    }
+    playingvoices = v;
+}
+
+static void audiopositional_removeFromPlaying(
+        struct audiopositional_voice* v) {
+    if (v->prev) {
+        v->prev->next = v->next;
+    } else {
+        playingvoices = v->next;
+    }
+    if (v->next) {
+        v->next->prev = v->prev;
+    }
+    v->prev = NULL;
+    v->next = NULL;
+}
+
+// A voice ended on its own (not through audiopositional_stop):
+static void audiopositional_finish(struct audiopositional_voice* v) {
+    v->playing = 0;
+    audiopositional_removeFromPlaying(v);
+    if (finishedcallback) {
+        finishedcallback(v->userdata);
+    }
+}
+
+void audiopositional_setFinishedCallback(void (*callback)(void* userdata)) {
+    finishedcallback = callback;
+}
+
+void audiopositional_setUserdata(struct audiopositional_voice* v,
+        void* userdata) {
+    v->userdata = userdata;
+}
+
+struct audiopositional_voice* audiopositional_create(const char* path,
+        int priority) {
+    struct audiopositional_voice* v = malloc(sizeof(*v));
+    if (!v) {
+        return NULL;
+    }
+    memset(v, 0, sizeof(*v));
+    v->path = strdup(path);
+    if (!v->path) {
+        free(v);
+        return NULL;
+    }
+    v->priority = priority;
+    v->mindistance = 1;
+    v->maxdistance = 20;
+    v->curve = AUDIOPOSITIONAL_CURVE_INVERSE;
+    v->bus = AUDIOMIXER_BUS_SFX;
+    v->soundid = -1;
+    return v;
+}
+
+void audiopositional_destroy(struct audiopositional_voice* v) {
+    if (!v) {
+        return;
+    }
+    audiopositional_stop(v, 0);
+    free(v->path);
+    free(v);
+}
+
+void audiopositional_setPosition(struct audiopositional_voice* v,
+        double x, double y) {
+    v->x = x;
+    v->y = y;
+}
+
+void audiopositional_setAttenuation(struct audiopositional_voice* v,
+        double mindistance, double maxdistance, int curve) {
+    if (mindistance < 0.001) {
+        mindistance = 0.001;
+    }
+    if (maxdistance <= mindistance) {
+        maxdistance = mindistance + 0.001;
+    }
+    v->mindistance = mindistance;
+    v->maxdistance = maxdistance;
+    v->curve = curve;
+}
+
+void audiopositional_setLoopPoints(struct audiopositional_voice* v,
+        double loopstart, double loopend) {
+    v->loopstart = loopstart;
+    v->loopend = loopend;
+}
+
+void audiopositional_setBus(struct audiopositional_voice* v, int bus) {
+    v->bus = bus;
+}
+
+// Gain and panning of a voice for one listener:
+static float audiopositional_calculate(struct audiopositional_voice* v,
+        struct audiopositional_listener* l, float* pan) {
+    double dx = v->x - l->x;
+    double dy = v->y - l->y;
+    double dsquared = dx * dx + dy * dy;
+    if (dsquared >= v->maxdistance * v->maxdistance) {
+        *pan = 0;
+        return 0;
+    }
+    double d = sqrt(dsquared);
+
+    // sounds to the right have negative panning. Closer than the
+    // minimum distance, the direction matters less and less:
+    double panningdistance = d;
+    if (panningdistance < v->mindistance) {
+        panningdistance = v->mindistance;
+    }
+    *pan = (float)(-dx / panningdistance);
+
+    if (d <= v->mindistance) {
+        return 1;
+    }
+    if (v->curve == AUDIOPOSITIONAL_CURVE_LINEAR) {
+        return (float)(1 - (d - v->mindistance) /
+            (v->maxdistance - v->mindistance));
+    }
+    // inverse distance, scaled to reach zero at the maximum distance:
+    double atmax = v->mindistance / v->maxdistance;
+    return (float)((v->mindistance / d - atmax) / (1 - atmax));
+}
+
+// Gain and panning for the nearest (loudest) listener:
+static float audiopositional_calculateForListeners(
+        struct audiopositional_voice* v, float* pan) {
+    float bestgain = 0;
+    *pan = 0;
+    int i = 0;
+    while (i < AUDIOPOSITIONAL_MAXLISTENERS) {
+        if (listeners[i].enabled) {
+            float p;
+            float gain = audiopositional_calculate(v, &listeners[i], &p);
+            if (gain > bestgain) {
+                bestgain = gain;
+                *pan = p;
+            }
+        }
+        i++;
+    }
+    return bestgain;
+}
+
+// Start mixing a voice with the given gain and panning:
+static int audiopositional_startSound(struct audiopositional_voice* v,
+        float gain, float pan, float fadeinseconds) {
+    audiopositional_setSoundId(v, audiomixer_PlaySoundFromDisk(v->path,
+        v->priority, v->volume * gain, pan, 1, fadeinseconds, v->loop,
+        v->loopstart, v->loopend, v->bus));
+    if (v->soundid < 0) {
+        return 0;
+    }
+    v->gain = gain;
+    v->pan = pan;
+    return 1;
+}
+
+int audiopositional_play(struct audiopositional_voice* v, float volume,
+        int loop, float fadeinseconds) {
+    audiopositional_stop(v, 0);
+    if (volume < 0) {
+        volume = 0;
+    }
+    if (volume > 1) {
+        volume = 1;
+    }
+    v->volume = volume;
+    v->loop = loop;
+
+    float pan;
+    float gain = audiopositional_calculateForListeners(v, &pan);
+    if (gain * volume < AUDIBLEGAIN) {
+        if (!loop) {
+            // nobody will ever hear this
+            return 1;
+        }
+        // play virtually until it gets in range:
+        v->playing = 1;
+        audiopositional_addToPlaying(v);
+        return 1;
+    }
+    if (!audiopositional_startSound(v, gain, pan, fadeinseconds)) {
+        return 0;
+    }
+    v->playing = 1;
+    audiopositional_addToPlaying(v);
+    return 1;
+}
+
+void audiopositional_stop(struct audiopositional_voice* v,
+        float fadeoutseconds) {
+    if (!v->playing) {
+        return;
+    }
+    if (v->soundid >= 0) {
+        audiomixer_StopSoundWithFadeout(v->soundid, fadeoutseconds);
+        audiopositional_setSoundId(v, -1);
+    }
+    v->playing = 0;
+    audiopositional_removeFromPlaying(v);
+}
+
+int audiopositional_isPlaying(struct audiopositional_voice* v) {
+    return v->playing;
+}
+
+void audiopositional_setListenerPosition(int listener,
+        double x, double y) {
+    if (listener < 0 || listener >= AUDIOPOSITIONAL_MAXLISTENERS) {
+        return;
+    }
+    listeners[listener].enabled = 1;
+    listeners[listener].x = x;
+    listeners[listener].y = y;
+}
+
+void audiopositional_removeListener(int listener) {
+    if (listener <= 0 || listener >= AUDIOPOSITIONAL_MAXLISTENERS) {
+        return;
+    }
+    listeners[listener].enabled = 0;
+}
+
+// The mixer is done with the sound of a voice:
+static void audiopositional_soundEnded(struct audiopositional_voice* v) {
+    audiopositional_setSoundId(v, -1);
+    if (!v->loop) {
+        // sound is over
+        audiopositional_finish(v);
+    }
+    // otherwise, a looping sound was pushed out by sounds with higher
+    // priority. it continues virtually and is retried on update
+}
+
+void audiopositional_soundFinished(int id) {
+    struct audiopositional_voice* v;
+    if (!voicesbysoundid) {
+        // no index, look at all of them:
+        v = playingvoices;
+        while (v) {
+            if (v->soundid == id) {
+                audiopositional_soundEnded(v);
+                return;
+            }
+            v = v->next;
+        }
+        return;
+    }
+    v = voicesbysoundid->items[
+        audiopositional_soundIdIndex(id)];
+    while (v) {
+        if (v->soundid == id) {
+            audiopositional_soundEnded(v);
+            return;
+        }
+        v = v->nextbysoundid;
+    }
+}
+
+void audiopositional_checkAllSounds(void) {
+    struct audiopositional_voice* v = playingvoices;
+    while (v) {
+        struct audiopositional_voice* vnext = v->next;
+        if (v->soundid >= 0 && !audiomixer_IsSoundPlaying(v->soundid)) {
+            audiopositional_soundEnded(v);
+        }
+        v = vnext;
+    }
+}
+
+void audiopositional_update(void) {
+    struct audiopositional_voice* v = playingvoices;
+    while (v) {
+        struct audiopositional_voice* vnext = v->next;
+
+        float pan;
+        float gain = audiopositional_calculateForListeners(v, &pan);
+        if (gain * v->volume < AUDIBLEGAIN) {
+            // out of range:
+            if (v->soundid >= 0) {
+                audiomixer_StopSoundWithFadeout(v->soundid,
+                    VIRTUALFADESECONDS);
+                audiopositional_setSoundId(v, -1);
+            }
+            if (!v->loop) {
+                audiopositional_finish(v);
+            }
+        } else if (v->soundid < 0) {
+            // in range again:
+            audiopositional_startSound(v, gain, pan, VIRTUALFADESECONDS);
+        } else if (fabsf(gain - v->gain) > GAINEPSILON ||
+                fabsf(pan - v->pan) > PANEPSILON) {
+            // update gain and panning:
+            audiomixer_AdjustSoundGradually(v->soundid, v->volume * gain,
+                pan, SMOOTHSECONDS);
+            v->gain = gain;
+            v->pan = pan;
+        }
+        v = vnext;
+    }
+}
+
+void audiopositional_getStats(int* playing, int* audible) {
+    int p = 0;
+    int a = 0;
+    struct audiopositional_voice* v = playingvoices;
+    while (v) {
+        p++;
+        if (v->soundid >= 0) {
+            a++;
+        }
+        v = v->next;
+    }
+    if (playing) {
+        *playing = p;
+    }
+    if (audible) {
+        *audible = a;
+    }
+}
+
+#endif  // USE_AUDIO
+
@@ -0,0 +1,112 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIOPOSITIONAL_H_
+#define BLITWIZARD_AUDIOPOSITIONAL_H_
+
+// Positional 2d sound voices. Each voice has a position in the game
+// world, and its volume and stereo panning are derived from the
+// distance and direction to the nearest listener. All playing voices
+// are updated in one go per frame with audiopositional_update().
+//
+// Voices which are too far away to be heard are virtual: they aren't
+// decoded or mixed at all. A looping virtual voice starts playing
+// again once it gets in range, a non-looping one simply ends.
+//
+// All of this is main thread only.
+
+// Distance attenuation curves:
+#define AUDIOPOSITIONAL_CURVE_LINEAR 0  // linear falloff
+#define AUDIOPOSITIONAL_CURVE_INVERSE 1  // inverse distance (default)
+
+// Maximum amount of listeners (e.g. for split screen):
+#define AUDIOPOSITIONAL_MAXLISTENERS 4
+
+struct audiopositional_voice;
+
+struct audiopositional_voice* audiopositional_create(const char* path,
+    int priority);
+// Create a voice for the given sound file. Returns NULL on error.
+
+void audiopositional_destroy(struct audiopositional_voice* v);
+// Stop the voice and free it.
+
+void audiopositional_setPosition(struct audiopositional_voice* v,
+    double x, double y);
+// Set the position of the voice in the game world.
+
+void audiopositional_setAttenuation(struct audiopositional_voice* v,
+    double mindistance, double maxdistance, int curve);
+// Set the distance up to which the voice is at full volume, the
+// distance at which it becomes inaudible and the curve in between.
+
+void audiopositional_setLoopPoints(struct audiopositional_voice* v,
+    double loopstart, double loopend);
+// Set the loop section (in seconds) used for looping plays.
+
+void audiopositional_setBus(struct audiopositional_voice* v, int bus);
+// Set the mixer bus (see audiomixer.h) used from the next play on.
+
+int audiopositional_play(struct audiopositional_voice* v, float volume,
+    int loop, float fadeinseconds);
+// Start playing the voice. Returns 0 if the sound can't be played
+// (unsupported format), otherwise 1 (even if it starts virtual).
+
+void audiopositional_stop(struct audiopositional_voice* v,
+    float fadeoutseconds);
+// Stop the voice.
+
+int audiopositional_isPlaying(struct audiopositional_voice* v);
+// Check if the voice is playing (including playing virtually).
+
+void audiopositional_setListenerPosition(int listener,
+    double x, double y);
+// Set the position of the given listener (0 to MAXLISTENERS-1).
+// Listener 0 is always present, others are enabled by setting them.
+
+void audiopositional_removeListener(int listener);
+// Disable the given listener (except for listener 0).
+
+void audiopositional_update(void);
+// Update volume and panning of all playing voices. Call once per frame.
+
+void audiopositional_soundFinished(int id);
+// Pass on a finished mixer sound (see audiomixer_GetFinishedSound).
+
+void audiopositional_checkAllSounds(void);
+// Check all voices for finished mixer sounds, if finished sounds got
+// lost (AUDIOMIXER_FINISHED_LOST).
+
+void audiopositional_setFinishedCallback(void (*callback)(void* userdata));
+// Set a function which is called when a voice ends on its own, with
+// the userdata of the voice.
+
+void audiopositional_setUserdata(struct audiopositional_voice* v,
+    void* userdata);
+// Set the userdata passed to the finished callback.
+
+void audiopositional_getStats(int* playing, int* audible);
+// Amount of playing voices, and how many of them aren't virtual.
+
+#endif  // BLITWIZARD_AUDIOPOSITIONAL_H_
+
@@ -0,0 +1,153 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "config.h"
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "audiomixer.h"
+#include "audiorender.h"
+
+#define RENDERRATE 48000
+#define RENDERCHANNELS 2
+
+// Size of the WAV header written in front of the samples:
+#define WAVHEADERSIZE 44
+
+static FILE* renderfile = NULL;
+static uint64_t renderedframes = 0;
+static int closeatexit = 0;
+
+static void audiorender_put32(unsigned char* p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static void audiorender_put16(unsigned char* p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+// Write the WAV header for the given amount of sample data:
+static int audiorender_writeHeader(uint32_t databytes) {
+    unsigned char h[WAVHEADERSIZE];
+    memcpy(h, "RIFF", 4);
+    audiorender_put32(h + 4, 36 + databytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    audiorender_put32(h + 16, 16);  // fmt chunk size
+    audiorender_put16(h + 20, 1);  // integer PCM
+    audiorender_put16(h + 22, RENDERCHANNELS);
+    audiorender_put32(h + 24, RENDERRATE);
+    audiorender_put32(h + 28, RENDERRATE * RENDERCHANNELS * 2);
+    audiorender_put16(h + 32, RENDERCHANNELS * 2);  // block align
+    audiorender_put16(h + 34, 16);  // bits per sample
+    memcpy(h + 36, "data", 4);
+    audiorender_put32(h + 40, databytes);
+    if (fseek(renderfile, 0, SEEK_SET) != 0) {
+        return 0;
+    }
+    return (fwrite(h, 1, sizeof(h), renderfile) == sizeof(h));
+}
+
+int audiorender_open(const char* path) {
+    audiorender_close();
+    renderfile = fopen(path, "wb");
+    if (!renderfile) {
+        return 0;
+    }
+    renderedframes = 0;
+    if (!audiorender_writeHeader(0)) {
+        fclose(renderfile);
+        renderfile = NULL;
+        return 0;
+    }
+
+    // make sure the header is completed however we quit:
+    if (!closeatexit) {
+        closeatexit = 1;
+        atexit(&audiorender_close);
+    }
+
+    // we always render 16bit, with the same dither noise every time:
+    s16mixmode = 1;
+    audiomixer_SetDitherSeed(0);
+    return 1;
+}
+
+int audiorender_render(unsigned int milliseconds) {
+    if (!renderfile) {
+        return 0;
+    }
+    int16_t buf[1024 * RENDERCHANNELS];
+    unsigned int frames = milliseconds * (RENDERRATE / 1000);
+    while (frames > 0) {
+        unsigned int amount = sizeof(buf) / sizeof(buf[0]) / RENDERCHANNELS;
+        if (amount > frames) {
+            amount = frames;
+        }
+        unsigned int bytes = amount * RENDERCHANNELS * sizeof(int16_t);
+        audiomixer_GetBuffer(buf, bytes);
+#if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        unsigned int i = 0;
+        while (i < amount * RENDERCHANNELS) {
+            buf[i] = (int16_t)__builtin_bswap16((uint16_t)buf[i]);
+            i++;
+        }
+#endif
+        if (fwrite(buf, 1, bytes, renderfile) != bytes) {
+            return 0;
+        }
+        renderedframes += amount;
+        frames -= amount;
+    }
+    return 1;
+}
+
+uint64_t audiorender_renderedFrames(void) {
+    return renderedframes;
+}
+
+void audiorender_close(void) {
+    if (!renderfile) {
+        return;
+    }
+    uint64_t databytes = renderedframes * RENDERCHANNELS * 2;
+    if (databytes > UINT32_MAX - 36) {
+        // too long for a WAV file, the header can't say so
+        databytes = UINT32_MAX - 36;
+    }
+    audiorender_writeHeader((uint32_t)databytes);
+    fclose(renderfile);
+    renderfile = NULL;
+}
+
+#endif  // USE_AUDIO
+
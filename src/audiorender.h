@@ -0,0 +1,52 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIORENDER_H_
+#define BLITWIZARD_AUDIORENDER_H_
+
+#include <stdint.h>
+
+// The audio render mode writes the mixer output to a WAV file
+// instead of playing it on an audio device. This is meant for
+// automated tests and regression checks on machines without sound
+// hardware. The mixer should be initialised with synchronous
+// decoding (see audiomixer_SetSynchronousDecoding) so the rendered
+// audio never depends on decoder thread timing.
+
+int audiorender_open(const char* path);
+// Start rendering into the given file as 16bit stereo at 48kHz.
+// Returns 1 on success, 0 if the file can't be written.
+
+int audiorender_render(unsigned int milliseconds);
+// Pull the given amount of audio from the mixer and append it
+// to the file. Returns 1 on success, 0 on write error.
+
+uint64_t audiorender_renderedFrames(void);
+// Amount of sample frames written so far.
+
+void audiorender_close(void);
+// Complete the WAV header and close the file.
+// Does nothing if no file is being rendered.
+
+#endif  // BLITWIZARD_AUDIORENDER_H_
+
@@ -0,0 +1,360 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "config.h"
+#include "os.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "audioresampler.h"
+#include "threading.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// phase count limit for uncommon ratios (e.g. 44100 to 48001 would
+// need 48001 phases). Those use the nearest of this many phases:
+#define MAXPHASES 1024
+
+// longest filter allowed (for strong downsampling):
+#define MAXTAPS 256
+
+struct audioresamplertable {
+    unsigned int l, m;  // ratio out/in reduced by gcd
+    int quality;
+    unsigned int phases;  // l or MAXPHASES, whatever is less
+    unsigned int taps;  // always a multiple of 4
+
+    // phases * taps * 2 coefficients. Each coefficient is stored
+    // twice in a row, so a stereo frame can be multiplied at once.
+    // With less phases than l, there is one more phase at offset 1,
+    // so positions can be rounded up to it:
+    float *coefficients;
+
+    struct audioresamplertable *next;
+};
+
+struct audioresampler {
+    struct audioresamplertable *table;
+    unsigned int channels;
+    unsigned int frac;  // position between two input frames in 1/l
+};
+
+static int defaultquality = AUDIORESAMPLER_QUALITY_HIGH;
+
+static struct audioresamplertable *tablelist = NULL;
+static mutex *tableMutex = NULL;
+
+// this runs on application start:
+__attribute__((constructor)) static void audioresampler_init(void) {
+    tableMutex = mutex_create();
+#ifdef ANDROID
+    defaultquality = AUDIORESAMPLER_QUALITY_LOW;
+#endif
+}
+
+static unsigned int audioresampler_gcd(unsigned int a, unsigned int b) {
+    while (b != 0) {
+        unsigned int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// zeroth order modified bessel function of the first kind,
+// used for the kaiser window:
+static double audioresampler_besselI0(double x) {
+    double sum = 1;
+    double term = 1;
+    int k = 1;
+    while (k < 64) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+        k++;
+    }
+    return sum;
+}
+
+static struct audioresamplertable *audioresampler_buildTable(
+        unsigned int l, unsigned int m, int quality) {
+    // filter length, cutoff (relative to the input nyquist frequency)
+    // and kaiser window shape per quality level:
+    unsigned int basetaps = 32;
+    double rolloff = 0.94;
+    double beta = 9;
+    if (quality == AUDIORESAMPLER_QUALITY_LOW) {
+        basetaps = 8;
+        rolloff = 0.85;
+        beta = 5;
+    } else if (quality == AUDIORESAMPLER_QUALITY_MEDIUM) {
+        basetaps = 16;
+        rolloff = 0.9;
+        beta = 7;
+    }
+
+    // when downsampling, cut off at the output nyquist frequency
+    // and use a correspondingly longer filter:
+    double cutoff = rolloff;
+    unsigned int taps = basetaps;
+    if (m > l) {
+        cutoff = rolloff * (double)l / (double)m;
+        taps = (unsigned int)ceil(basetaps * (double)m / (double)l);
+        taps = ((taps + 3) / 4) * 4;
+        if (taps > MAXTAPS) {
+            taps = MAXTAPS;
+        }
+    }
+
+    struct audioresamplertable *t = malloc(sizeof(*t));
+    if (!t) {
+        return NULL;
+    }
+    memset(t, 0, sizeof(*t));
+    t->l = l;
+    t->m = m;
+    t->quality = quality;
+    t->phases = l;
+    if (t->phases > MAXPHASES) {
+        t->phases = MAXPHASES;
+    }
+    t->taps = taps;
+    unsigned int rows = t->phases;
+    if (t->phases != l) {
+        rows++;
+    }
+    t->coefficients = malloc(sizeof(float) * rows * taps * 2);
+    if (!t->coefficients) {
+        free(t);
+        return NULL;
+    }
+
+    double half = taps / 2;
+    double window0 = audioresampler_besselI0(beta);
+    unsigned int p = 0;
+    while (p < rows) {
+        // output position for this phase is this far behind the
+        // input frame at index taps/2 - 1 of the filter. (at offset 1,
+        // the window is 0 at the first tap, so this is exactly phase 0
+        // for the next input frame):
+        double offset = (double)p / (double)t->phases;
+        float *c = t->coefficients + p * taps * 2;
+        double sum = 0;
+        unsigned int k = 0;
+        while (k < taps) {
+            double d = (half - 1 - k) + offset;
+            double x = d * cutoff;
+            double sinc = 1;
+            if (fabs(x) > 1e-9) {
+                sinc = sin(M_PI * x) / (M_PI * x);
+            }
+            double w = 0;
+            double r = d / half;
+            if (r > -1 && r < 1) {
+                w = audioresampler_besselI0(beta * sqrt(1 - r * r)) /
+                    window0;
+            }
+            double v = cutoff * sinc * w;
+            c[k * 2] = (float)v;
+            sum += v;
+            k++;
+        }
+
+        // normalize to unity gain and duplicate coefficients:
+        k = 0;
+        while (k < taps) {
+            c[k * 2] = (float)(c[k * 2] / sum);
+            c[k * 2 + 1] = c[k * 2];
+            k++;
+        }
+        p++;
+    }
+    return t;
+}
+
+static struct audioresamplertable *audioresampler_getTable(
+        unsigned int inrate, unsigned int outrate, int quality) {
+    unsigned int g = audioresampler_gcd(inrate, outrate);
+    unsigned int l = outrate / g;
+    unsigned int m = inrate / g;
+
+    mutex_lock(tableMutex);
+    struct audioresamplertable *t = tablelist;
+    while (t) {
+        if (t->l == l && t->m == m && t->quality == quality) {
+            mutex_release(tableMutex);
+            return t;
+        }
+        t = t->next;
+    }
+
+    // tables are small and there are only few distinct rates in use,
+    // so they are kept around until the program ends:
+    t = audioresampler_buildTable(l, m, quality);
+    if (t) {
+        t->next = tablelist;
+        tablelist = t;
+    }
+    mutex_release(tableMutex);
+    return t;
+}
+
+struct audioresampler *audioresampler_create(unsigned int inrate,
+        unsigned int outrate, unsigned int channels, int quality) {
+    if (inrate == 0 || outrate == 0 || channels == 0) {
+        return NULL;
+    }
+    if (quality < AUDIORESAMPLER_QUALITY_LOW ||
+            quality > AUDIORESAMPLER_QUALITY_HIGH) {
+        quality = defaultquality;
+    }
+    struct audioresampler *r = malloc(sizeof(*r));
+    if (!r) {
+        return NULL;
+    }
+    memset(r, 0, sizeof(*r));
+    r->table = audioresampler_getTable(inrate, outrate, quality);
+    if (!r->table) {
+        free(r);
+        return NULL;
+    }
+    r->channels = channels;
+    return r;
+}
+
+unsigned int audioresampler_getTaps(struct audioresampler *r) {
+    return r->table->taps;
+}
+
+unsigned long long audioresampler_getOutputFrames(struct audioresampler *r,
+        unsigned long long inframes) {
+    return (inframes * r->table->l + r->table->m - 1) / r->table->m;
+}
+
+void audioresampler_reset(struct audioresampler *r) {
+    r->frac = 0;
+}
+
+long long audioresampler_startAt(struct audioresampler *r,
+        unsigned long long outframe) {
+    // the output frame is this far into the input:
+    unsigned long long t = outframe * r->table->m;
+    r->frac = t % r->table->l;
+    long long inframe = t / r->table->l;
+
+    // the filter window starts half its length before that:
+    return inframe - (long long)(r->table->taps / 2 - 1);
+}
+
+void audioresampler_destroy(struct audioresampler *r) {
+    free(r);
+}
+
+unsigned int audioresampler_process(struct audioresampler *r,
+        const float *in, unsigned int inframes, unsigned int *consumed,
+        float *out, unsigned int outframes) {
+    const struct audioresamplertable *t = r->table;
+    const unsigned int taps = t->taps;
+    const unsigned int channels = r->channels;
+    unsigned int start = 0;  // first input frame of the filter window
+    unsigned int frac = r->frac;
+    unsigned int produced = 0;
+
+    while (produced < outframes && start + taps <= inframes) {
+        unsigned int phase = frac;
+        if (t->phases != t->l) {
+            // round to the nearest phase (possibly the extra one):
+            phase = (unsigned int)(((unsigned long long)frac *
+                t->phases + t->l / 2) / t->l);
+        }
+        const float *c = t->coefficients + phase * taps * 2;
+
+        if (channels == 2) {
+            // Interleaved stereo frames line up with the duplicated
+            // coefficients, so this is a plain multiply-add over
+            // taps * 2 floats in blocks of 8 which compilers turn
+            // into SIMD code:
+            const float *x = in + start * 2;
+            float acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+            unsigned int i = 0;
+            while (i < taps * 2) {
+                int j;
+                for (j = 0; j < 8; j++) {
+                    acc[j] += c[i + j] * x[i + j];
+                }
+                i += 8;
+            }
+            out[0] = (acc[0] + acc[2]) + (acc[4] + acc[6]);
+            out[1] = (acc[1] + acc[3]) + (acc[5] + acc[7]);
+        } else {
+            const float *x = in + start * channels;
+            unsigned int ch = 0;
+            while (ch < channels) {
+                float acc = 0;
+                unsigned int k = 0;
+                while (k < taps) {
+                    acc += c[k * 2] * x[k * channels + ch];
+                    k++;
+                }
+                out[ch] = acc;
+                ch++;
+            }
+        }
+        out += channels;
+        produced++;
+
+        // advance input position by m/l frames:
+        frac += t->m;
+        start += frac / t->l;
+        frac = frac % t->l;
+    }
+
+    r->frac = frac;
+    *consumed = start;
+    return produced;
+}
+
+void audioresampler_setDefaultQuality(int quality) {
+    if (quality < AUDIORESAMPLER_QUALITY_LOW ||
+            quality > AUDIORESAMPLER_QUALITY_HIGH) {
+        return;
+    }
+    defaultquality = quality;
+}
+
+int audioresampler_getDefaultQuality(void) {
+    return defaultquality;
+}
+
+void audioresampler_prepareCommonTables(void) {
+    audioresampler_getTable(44100, 48000, defaultquality);
+    audioresampler_getTable(22050, 48000, defaultquality);
+    audioresampler_getTable(32000, 48000, defaultquality);
+}
+
@@ -0,0 +1,87 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIORESAMPLER_H_
+#define BLITWIZARD_AUDIORESAMPLER_H_
+
+// Polyphase windowed-sinc resampler for 32bit float audio.
+// This works on interleaved frames in a buffer passed in by pointer,
+// see audiosourceresample.h for an audio source wrapping it.
+//
+// The filter tables are shared between all resamplers with the same
+// rates and quality. The tables for 44.1kHz, 22.05kHz and 32kHz to
+// 48kHz can be precomputed with audioresampler_prepareCommonTables().
+
+#define AUDIORESAMPLER_QUALITY_LOW 0
+#define AUDIORESAMPLER_QUALITY_MEDIUM 1
+#define AUDIORESAMPLER_QUALITY_HIGH 2
+
+struct audioresampler;
+
+// Create a resampler. Returns NULL on failure (out of memory or
+// unsupported rates/channel count):
+struct audioresampler *audioresampler_create(unsigned int inrate,
+    unsigned int outrate, unsigned int channels, int quality);
+
+// The amount of frames the filter spans. A caller should prepend
+// audioresampler_getTaps()/2 - 1 silent frames in front of the input
+// and append audioresampler_getTaps()/2 silent frames after the end
+// of the input, so the output is aligned with the input and complete:
+unsigned int audioresampler_getTaps(struct audioresampler *r);
+
+// The amount of output frames for the given amount of input frames:
+unsigned long long audioresampler_getOutputFrames(struct audioresampler *r,
+    unsigned long long inframes);
+
+// Resample from the given input frames to the output buffer.
+// Produces up to outframes frames and returns the amount produced.
+// *consumed is set to the amount of frames at the start of the input
+// which are no longer needed: the caller should drop them and pass the
+// remaining frames (followed by new ones) at the next call.
+unsigned int audioresampler_process(struct audioresampler *r,
+    const float *in, unsigned int inframes, unsigned int *consumed,
+    float *out, unsigned int outframes);
+
+// Start over as if no input had been processed yet:
+void audioresampler_reset(struct audioresampler *r);
+
+// Start over at the given output frame (for seeking). Returns the
+// input frame which needs to be the first one passed to
+// audioresampler_process() afterwards. If it is negative, pass that
+// many silent frames followed by the input from frame 0 on:
+long long audioresampler_startAt(struct audioresampler *r,
+    unsigned long long outframe);
+
+void audioresampler_destroy(struct audioresampler *r);
+
+// Quality used by audiosourceresample_create() (default is high,
+// or low on Android):
+void audioresampler_setDefaultQuality(int quality);
+int audioresampler_getDefaultQuality(void);
+
+// Compute the filter tables for the common rates to 48kHz at the
+// default quality, so starting a sound doesn't need to do it:
+void audioresampler_prepareCommonTables(void);
+
+#endif  // BLITWIZARD_AUDIORESAMPLER_H_
+
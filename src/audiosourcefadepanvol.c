@@ -30,6 +30,9 @@
 
 #include "audiosource.h"
 #include "audiosourcefadepanvol.h"
+#include "audioblock.h"
+
+#define FRAMESIZE (sizeof(float) * 2)
 
 struct audiosourcefadepanvol_internaldata {
     struct audiosource *source;
@@ -37,19 +40,12 @@ struct audiosourcefadepanvol_internaldata {
     int eof;
     int returnerroroneof;
 
-    int fadesamplestart;
-    int fadesampleend;
-    float fadevaluestart;
-    float fadevalueend;
-    int terminateafterfade;
-
-    float pan;
-    float vol;
+    struct audioblock_panvol panvol;
 
-    char processedsamplesbuf[512];
-    unsigned int processedsamplesbytes;
-
-    int noamplify; // don't amplify with soft clipping
+    // processed frame of which only a part was returned yet:
+    char partialframe[FRAMESIZE];
+    unsigned int partialoffset;
+    unsigned int partialbytes;
 };
 
 static size_t audiosourcefadepanvol_position(struct audiosource *source) {
@@ -73,8 +69,9 @@ static int audiosourcefadepanvol_seek(struct audiosource *source,
         if (idata->source->seek(idata->source, pos)) {
             // it worked!
             idata->eof = 0;
+            idata->sourceeof = 0;
             // reset our buffer to empty:
-            idata->processedsamplesbytes = 0;
+            idata->partialbytes = 0;
             return 1;
         }
         return 0;
@@ -90,27 +87,60 @@ static void audiosourcefadepanvol_rewind(struct audiosource *source) {
         idata->sourceeof = 0;
         idata->eof = 0;
         idata->returnerroroneof = 0;
-        idata->processedsamplesbytes = 0;
-        idata->fadesamplestart = 0;
-        idata->fadesampleend = 0;
-        idata->terminateafterfade = 0;
+        idata->partialbytes = 0;
+        idata->panvol.fadeframesleft = 0;
+        idata->panvol.terminateafterfade = 0;
+        idata->panvol.terminated = 0;
     }
 }
 
-static float amplify(float value, float amplification) {
-    // amplifies with soft clipping applied
-    float maxamplify = 2;
-    float clippingstart = 0.95;
-    value *= amplification;
-    if (abs(value) > clippingstart) {
-        float excess = abs(value)-clippingstart;
-        if (value > 0) {
-            value += (excess/(maxamplify-clippingstart))*(1-clippingstart);
-        } else {
-            value -= (excess/(maxamplify-clippingstart))*(1-clippingstart);
+// Read whole frames from our source into the buffer and process
+// them in place. Returns the amount of frames processed:
+static unsigned int audiosourcefadepanvol_readFrames(
+        struct audiosourcefadepanvol_internaldata *idata,
+        char *buffer, unsigned int frames) {
+    if (idata->sourceeof || frames == 0) {
+        return 0;
+    }
+    unsigned int bytes = frames * FRAMESIZE;
+    int i = idata->source->read(idata->source, buffer, bytes);
+    if (i > 0 && i % FRAMESIZE != 0) {
+        // complete the partially read frame:
+        unsigned int got = i;
+        while (got % FRAMESIZE != 0) {
+            int k = idata->source->read(idata->source, buffer + got,
+                FRAMESIZE - (got % FRAMESIZE));
+            if (k <= 0) {
+                // drop incomplete frame at the end
+                got -= got % FRAMESIZE;
+                if (k < 0) {
+                    idata->returnerroroneof = 1;
+                }
+                idata->sourceeof = 1;
+                break;
+            }
+            got += k;
         }
+        i = got;
     }
-    return value;
+    if (i <= 0) {
+        if (i < 0) {
+            // read function returned error
+            idata->returnerroroneof = 1;
+        }
+        idata->sourceeof = 1;
+        return 0;
+    }
+
+    // process all frames in one go:
+    unsigned int gotframes = i / FRAMESIZE;
+    unsigned int processed = audioblock_processPanVol(&idata->panvol,
+        (float*)buffer, (float*)buffer, gotframes, AUDIOBLOCK_WRITE);
+    if (processed < gotframes) {
+        // terminated after fade
+        idata->sourceeof = 1;
+    }
+    return processed;
 }
 
 static int audiosourcefadepanvol_read(struct audiosource *source,
@@ -121,143 +151,47 @@ static int audiosourcefadepanvol_read(struct audiosource *source,
     }
 
     unsigned int byteswritten = 0;
-    while (bytes > 0) {
-        // see how many samples we want to have minimum
-        int stereosamples = bytes / (sizeof(float) * 2);
-        if (stereosamples * sizeof(float) * 2 < bytes) {
-            stereosamples++;
-        }
 
-        // get new unprocessed samples
-        int unprocessedstart = idata->processedsamplesbytes;
-        if (!idata->sourceeof) {
-            while (idata->processedsamplesbytes + sizeof(float) * 2
-            <= sizeof(idata->processedsamplesbuf) && stereosamples > 0) {
-                int i = idata->source->read(idata->source,
-                idata->processedsamplesbuf + idata->processedsamplesbytes,
-                sizeof(float) * 2);
-                if (i < (int)sizeof(float)*2) {
-                    if (i < 0) {
-                        // read function returned error
-                        idata->returnerroroneof = 1;
-                    }
-                    idata->sourceeof = 1;
-                    break;
-                } else {
-                    idata->processedsamplesbytes += sizeof(float)*2;
-                }
-                stereosamples--;
-            }
-        }
-
-        // process unprocessed samples
-        unsigned int i = unprocessedstart;
-        float faderange, fadeprogress;
-        if (idata->fadesamplestart < 0 || idata->fadesampleend > 0) {
-            faderange = (-idata->fadesamplestart + idata->fadesampleend);
-            fadeprogress = idata->fadesampleend;
+    // return what is left of a partially returned frame:
+    if (idata->partialbytes > 0 && bytes > 0) {
+        unsigned int amount = idata->partialbytes;
+        if (amount > bytes) {
+            amount = bytes;
         }
-        while ((int)i <= ((int)idata->processedsamplesbytes - 
-            ((int)sizeof(float) * 2))) {
-            float leftchannel;
-            memcpy(&leftchannel, (char*)idata->processedsamplesbuf + i,
-                sizeof(float));
-            float rightchannel;
-            memcpy(&rightchannel, (char*)idata->processedsamplesbuf + i
-                + sizeof(float), sizeof(float));
-
-            if (idata->fadesamplestart < 0 || idata->fadesampleend > 0) {
-                // calculate fade volume
-                idata->vol = idata->fadevaluestart +
-                    (idata->fadevalueend - idata->fadevaluestart)*
-                    (1 - fadeprogress/faderange);
-
-                // increase fade progress
-                idata->fadesamplestart--;
-                idata->fadesampleend--;
-                fadeprogress = idata->fadesampleend;
-
-                if (idata->fadesampleend < 0) {
-                    // fade ended
-                    idata->vol = idata->fadevalueend;
-                    idata->fadesamplestart = 0;
-                    idata->fadesampleend = 0;
-
-                    if (idata->terminateafterfade) {
-                        // terminating audio source.
-                        idata->sourceeof = 1;
-                        idata->processedsamplesbytes = 0;
-                        break;
-                    }
-                }
-            }
-
-            // apply volume
-            if (!idata->noamplify) {
-                leftchannel = amplify(leftchannel, idata->vol);
-                rightchannel = amplify(rightchannel, idata->vol);
-            } else {
-                leftchannel *= idata->vol;
-                rightchannel *= idata->vol;
-            }
-
-            // calculate panning
-            if (idata->pan < 0) {
-                leftchannel *= (1+idata->pan);
-            }
-            if (idata->pan > 0) {
-                rightchannel *= (1-idata->pan);
-            }
-
-            // amplify channels when closer to edges:
-            float panningamplifyfactor = abs(idata->pan);
-            float amplifyamount = 0.3;
-            if (!idata->noamplify) {
-                if (idata->pan > 0) {
-                    leftchannel = amplify(leftchannel,
-                    0.7 + panningamplifyfactor * amplifyamount);
-                } else {
-                    rightchannel = amplify(rightchannel,
-                    0.7 + panningamplifyfactor * amplifyamount);
-                }
-            }
+        memcpy(buffer, idata->partialframe + idata->partialoffset, amount);
+        idata->partialoffset += amount;
+        idata->partialbytes -= amount;
+        buffer += amount;
+        bytes -= amount;
+        byteswritten += amount;
+    }
 
-            // write floats back
-            memcpy(idata->processedsamplesbuf+i, &leftchannel, sizeof(float));
-            memcpy(idata->processedsamplesbuf+i+sizeof(float), &rightchannel,
-            sizeof(float));
+    // process as many whole frames as possible directly in the buffer:
+    while (bytes >= FRAMESIZE && !idata->sourceeof) {
+        unsigned int frames = audiosourcefadepanvol_readFrames(idata,
+            buffer, bytes / FRAMESIZE);
+        buffer += frames * FRAMESIZE;
+        bytes -= frames * FRAMESIZE;
+        byteswritten += frames * FRAMESIZE;
+    }
 
-            i += sizeof(float)*2;
+    // if a partial frame is requested, process one more frame:
+    if (bytes > 0 && bytes < FRAMESIZE && !idata->sourceeof) {
+        if (audiosourcefadepanvol_readFrames(idata,
+        idata->partialframe, 1) == 1) {
+            memcpy(buffer, idata->partialframe, bytes);
+            idata->partialoffset = bytes;
+            idata->partialbytes = FRAMESIZE - bytes;
+            byteswritten += bytes;
         }
+    }
 
-        // return from our processed samples
-        unsigned int returnbytes = bytes;
-        if (returnbytes > idata->processedsamplesbytes) {
-            returnbytes = idata->processedsamplesbytes;
-        }
-        if (returnbytes == 0) {
-            if (byteswritten == 0) {
-                idata->eof = 1;
-                if (idata->returnerroroneof) {
-                    return -1;
-                }
-                return 0;
-            } else {
-                return byteswritten;
-            }
-        } else {
-            byteswritten += returnbytes;
-            memcpy(buffer, idata->processedsamplesbuf, returnbytes);
-            buffer += returnbytes;
-            bytes -= returnbytes;
-        }
-        // move away processed & returned samples
-        if (returnbytes > 0) {
-            if (idata->processedsamplesbytes - returnbytes > 0) {
-                memmove(idata->processedsamplesbuf, idata->processedsamplesbuf + returnbytes, sizeof(idata->processedsamplesbuf) - returnbytes);
-            }
-            idata->processedsamplesbytes -= returnbytes;
+    if (byteswritten == 0) {
+        idata->eof = 1;
+        if (idata->returnerroroneof) {
+            return -1;
         }
+        return 0;
     }
     return byteswritten;
 }
@@ -307,7 +241,7 @@ struct audiosource *audiosourcefadepanvol_create(struct audiosource *source) {
     struct audiosourcefadepanvol_internaldata *idata = a->internaldata;
     memset(idata, 0, sizeof(*idata));
     idata->source = source;
-    idata->vol = 1; // run at full volume if not changed
+    audioblock_initPanVol(&idata->panvol);
     a->samplerate = source->samplerate;
     a->channels = source->channels;
     a->format = source->format;
@@ -329,34 +263,7 @@ struct audiosource *audiosourcefadepanvol_create(struct audiosource *source) {
 void audiosourcefadepanvol_setPanVol(struct audiosource *source,
         float vol, float pan, int noamplify) {
     struct audiosourcefadepanvol_internaldata *idata = source->internaldata;
-    // limit panning range:
-    if (pan < -1) {
-        pan = -1;
-    }
-    if (pan > 1) {
-        pan = 1;
-    }
-    // limit volume range:
-    if (vol < 0) {
-        vol = 0;
-    }
-    if (vol > 1.5) {
-        vol = 1.5;
-    }
-    // the user wants to avoid excess amplification:
-    if (noamplify) {
-        if (vol > 1) {
-            vol = 1;
-        }
-    }
-
-    idata->noamplify = noamplify;
-    idata->pan = pan;
-    idata->vol = vol;
-
-    idata->fadesamplestart = 0;
-    idata->fadesampleend = 0;
-    idata->fadevalueend = vol;
+    audioblock_setPanVol(&idata->panvol, vol, pan, noamplify);
 }
 
 void audiosourcefadepanvol_startFade(struct audiosource *source,
@@ -364,30 +271,7 @@ void audiosourcefadepanvol_startFade(struct audiosource *source,
     // start a fade to a specified volume
     // terminate: stop sound when fade is done
     struct audiosourcefadepanvol_internaldata *idata = source->internaldata;
-
-    // if seconds <= 0, terminate current fade:
-    if (seconds <= 0) {
-        idata->fadevaluestart = 0;
-        idata->fadevalueend = 0;
-        idata->fadesamplestart = 0;
-        idata->fadesampleend = 0;
-        return;
-    }
-    // check target volume bounds:
-    if (targetvol < 0) {
-        targetvol = 0;
-    }
-    if (targetvol > 1.5) {
-        targetvol = 1.5;
-    }
-    if (idata->noamplify && targetvol > 1) {
-        targetvol = 1;
-    }
-
-    // set fade info:
-    idata->terminateafterfade = terminate;
-    idata->fadevaluestart = idata->vol;
-    idata->fadevalueend = targetvol;
-    idata->fadesamplestart = 0;
-    idata->fadesampleend = (int)((double)((double)idata->source->samplerate) * ((double)seconds));
+    audioblock_startFade(&idata->panvol, idata->source->samplerate,
+        seconds, targetvol, terminate);
 }
+
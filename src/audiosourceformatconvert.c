@@ -33,9 +33,9 @@
 
 #include "audiosource.h"
 #include "audiosourceformatconvert.h"
-#include "mathhelpers.h"
 
-#define CONVERTBUFSIZE 32
+// amount of samples converted in one block:
+#define CONVERTSAMPLES 1024
 
 struct audiosourceformatconvert_internaldata {
     struct audiosource *source; // internal audio source for format conversion
@@ -43,10 +43,140 @@ struct audiosourceformatconvert_internaldata {
     int erroroneof; // error when eof is reached
     int eof;
     int targetformat;
-    char convertbuf[CONVERTBUFSIZE];
-    int convertbufbytes;
+    unsigned int insamplesize;  // bytes per sample of the source
+    unsigned int outsamplesize;  // bytes per sample of the result
+
+    // source bytes not converted yet (can end with a partial sample):
+    unsigned char inbuf[CONVERTSAMPLES * 4];
+    unsigned int inbytes;
+
+    // converted samples not returned yet:
+    union {
+        float f[CONVERTSAMPLES];
+        int16_t s[CONVERTSAMPLES];
+    } outbuf;
+    unsigned int outbytes;
+    unsigned int outpos;
 };
 
+static unsigned int audiosourceformatconvert_sampleSize(int format) {
+    switch (format) {
+    case AUDIOSOURCEFORMAT_U8:
+        return 1;
+    case AUDIOSOURCEFORMAT_S16LE:
+        return 2;
+    case AUDIOSOURCEFORMAT_S24LE:
+        return 3;
+    case AUDIOSOURCEFORMAT_F32LE:
+    case AUDIOSOURCEFORMAT_S32LE:
+        return 4;
+    }
+    return 0;
+}
+
+// Sample loading helpers. These use memcpy and shifts on purpose:
+// the input may be unaligned, and this way the conversion loops below
+// are free of aliasing problems and get vectorized by the compiler
+// (see -ftree-vectorize in configure.ac).
+
+static inline int32_t audiosourceformatconvert_loadS16(
+        const unsigned char *p) {
+    int16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline int32_t audiosourceformatconvert_loadS24(
+        const unsigned char *p) {
+    // put the 24 bits into the upper bytes and shift back down
+    // to get the sign extended:
+    uint32_t v = ((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) |
+        ((uint32_t)p[2] << 24);
+    return ((int32_t)v) >> 8;
+}
+
+static inline int32_t audiosourceformatconvert_loadS32(
+        const unsigned char *p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Convert the given amount of samples from the input buffer to the
+// output buffer:
+static void audiosourceformatconvert_convert(
+        struct audiosourceformatconvert_internaldata *idata,
+        unsigned int samples) {
+    const unsigned char *restrict in = idata->inbuf;
+    float *restrict outf = idata->outbuf.f;
+    int16_t *restrict outs = idata->outbuf.s;
+    unsigned int i;
+
+    if (idata->targetformat == AUDIOSOURCEFORMAT_F32LE) {
+        switch (idata->source->format) {
+        case AUDIOSOURCEFORMAT_U8:
+            for (i = 0; i < samples; i++) {
+                outf[i] = ((int32_t)in[i] - 128) * (1.0f / 128.0f);
+            }
+            break;
+        case AUDIOSOURCEFORMAT_S16LE:
+            for (i = 0; i < samples; i++) {
+                outf[i] = audiosourceformatconvert_loadS16(in + i * 2) *
+                    (1.0f / 32768.0f);
+            }
+            break;
+        case AUDIOSOURCEFORMAT_S24LE:
+            for (i = 0; i < samples; i++) {
+                outf[i] = audiosourceformatconvert_loadS24(in + i * 3) *
+                    (1.0f / 8388608.0f);
+            }
+            break;
+        case AUDIOSOURCEFORMAT_S32LE:
+            for (i = 0; i < samples; i++) {
+                outf[i] = audiosourceformatconvert_loadS32(in + i * 4) *
+                    (1.0f / 2147483648.0f);
+            }
+            break;
+        }
+        return;
+    }
+
+    // target format is S16LE:
+    switch (idata->source->format) {
+    case AUDIOSOURCEFORMAT_U8:
+        for (i = 0; i < samples; i++) {
+            outs[i] = (int16_t)(((int32_t)in[i] - 128) * 256);
+        }
+        break;
+    case AUDIOSOURCEFORMAT_S24LE:
+        for (i = 0; i < samples; i++) {
+            outs[i] = (int16_t)(audiosourceformatconvert_loadS24(
+                in + i * 3) >> 8);
+        }
+        break;
+    case AUDIOSOURCEFORMAT_S32LE:
+        for (i = 0; i < samples; i++) {
+            outs[i] = (int16_t)(audiosourceformatconvert_loadS32(
+                in + i * 4) >> 16);
+        }
+        break;
+    case AUDIOSOURCEFORMAT_F32LE:
+        for (i = 0; i < samples; i++) {
+            float v;
+            memcpy(&v, in + i * 4, sizeof(v));
+            v *= 32768.0f;
+            if (v > 32767.0f) {
+                v = 32767.0f;
+            }
+            if (v < -32768.0f) {
+                v = -32768.0f;
+            }
+            outs[i] = (int16_t)v;
+        }
+        break;
+    }
+}
+
 static void audiosourceformatconvert_close(struct audiosource *source) {
     struct audiosourceformatconvert_internaldata *idata =
         (struct audiosourceformatconvert_internaldata*)source->internaldata;
@@ -70,7 +200,9 @@ static void audiosourceformatconvert_rewind(struct audiosource *source) {
     idata->source->rewind(idata->source);
     idata->sourceeof = 0;
     idata->eof = 0;
-    idata->convertbufbytes = 0;
+    idata->inbytes = 0;
+    idata->outbytes = 0;
+    idata->outpos = 0;
 }
 
 
@@ -86,207 +218,58 @@ static int audiosourceformatconvert_read(struct audiosource *source,
     }
 
     int writtenbytes = 0;
-
-    // If we have previously converted bytes, return them:
-    if (idata->convertbufbytes > 0 && bytes > 0) {
-        unsigned int amount = idata->convertbufbytes;
-        if (amount > bytes) {
-            amount = bytes;
-        }
-
-        // copy bytes:
-        memcpy(buffer, idata->convertbuf, amount);
-        idata->convertbufbytes -= amount;
-        writtenbytes += amount;
-        buffer += amount;
-        bytes -= amount;
-
-        // move remaining bytes up to beginning:
-        if (idata->convertbufbytes > 0) {
-            memmove(idata->convertbuf, idata->convertbuf + amount, CONVERTBUFSIZE - amount);
-        }
-    }
-
-    // fetch new bytes and return them
     while (bytes > 0) {
-        if (idata->sourceeof) {
-            break;
-        }
-
-        // check how many bytes we want:
-        int wantbytes = 0;
-        if (idata->source->format == AUDIOSOURCEFORMAT_S16LE) {
-            wantbytes = 2;
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_F32LE) {
-            wantbytes = 4;
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_U8) {
-            wantbytes = 1;
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_S32LE) {
-            wantbytes = 4;
+        // If we have previously converted bytes, return them:
+        if (idata->outpos < idata->outbytes) {
+            unsigned int amount = idata->outbytes - idata->outpos;
+            if (amount > bytes) {
+                amount = bytes;
+            }
+            memcpy(buffer, ((char*)&idata->outbuf) + idata->outpos, amount);
+            idata->outpos += amount;
+            writtenbytes += amount;
+            buffer += amount;
+            bytes -= amount;
+            continue;
         }
 
-        char bytebuf[8];
-        // read the bytes we want:
-        int result = idata->source->read(idata->source, bytebuf, wantbytes);
-        if (result < wantbytes) {
+        // fetch a new block of source data if we don't have a
+        // complete sample left:
+        unsigned int samples = idata->inbytes / idata->insamplesize;
+        if (samples == 0) {
+            if (idata->sourceeof) {
+                break;
+            }
+            int result = idata->source->read(idata->source,
+                (char*)idata->inbuf + idata->inbytes,
+                sizeof(idata->inbuf) - idata->inbytes);
             if (result < 0) {
                 idata->erroroneof = 1;
                 idata->eof = 1;
                 return -1;
-            } else {
+            }
+            if (result == 0) {
+                // a trailing partial sample is dropped
                 idata->sourceeof = 1;
                 break;
             }
+            idata->inbytes += result;
+            continue;
         }
 
-        // convert:
-        if (idata->source->format == AUDIOSOURCEFORMAT_S16LE) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_F32LE) {
-#define S16TOF32TYPE double
-                S16TOF32TYPE intmax_big = pow(2, 16)/2;
-                // convert s16le -> f32le
-                int16_t old;
-                memcpy(&old, bytebuf, sizeof(int16_t));
-                S16TOF32TYPE convert = old;
-                convert /= intmax_big;
-                float new = convert;
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_F32LE) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_S16LE) {
-                double intmax_small = pow(2, 16)/2;
-                // convert f32le -> s16le
-                float old;
-                memcpy(&old, bytebuf, sizeof(old));
-                double convert = old;
-                convert *= intmax_small;
-                int16_t new = (int16_t)fastdoubletoint32(convert);
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_U8) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_S16LE) {
-                double uint8max_big = 256;
-                double int16max_small = 32767;
-                // convert u8 -> s16le
-                unsigned char old = *((unsigned char*)bytebuf);
-                double convert = old;
-                convert /= uint8max_big;
-                convert *= int16max_small;
-                int16_t new = (int16_t)fastdoubletoint32(convert);
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-            if (idata->targetformat == AUDIOSOURCEFORMAT_F32LE) {
-                double uint8max_big = pow(2, 8);
-                // convert u8 -> s16le
-                unsigned char old = *((unsigned char*)bytebuf);
-                double convert = old;
-                convert /= uint8max_big;
-                float new = convert;
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_S24LE) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_S16LE) {
-                // FIXME: depends on large endian cpu architecture
-                double int24max_big = pow(2, 24)/2;
-                double int16max_small = 32767;
-                // convert s24le -> s16le
-                int32_t old;
-                memset((((char*)&old)+3), 0, 1);  // null last byte
-                memcpy(&old, (char*)bytebuf, 3);  // copy first 3 bytes (=24 bit)
-                double convert = old;
-                convert /= int24max_big;
-                convert *= int16max_small;
-                int16_t new = (int16_t)fastdoubletoint32(convert);
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-            if (idata->targetformat == AUDIOSOURCEFORMAT_F32LE) {
-                // FIXME: depends on large endian cpu architecture
-                double int24max_big = pow(2, 24)/2;
-                // convert s24le -> s16le
-                int32_t old;
-                memset((((char*)&old)+3), 0, 1);  // null last byte (most significant)
-                memcpy(&old, (char*)bytebuf, 3);  // copy first 3 bytes (=24 bit)
-                double convert = old;
-                convert /= int24max_big;
-                float new = convert;
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_S32LE) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_S16LE) {
-                double int32max_big = pow(2, 32)/2;
-                double int16max_small = 32767;
-                // convert s32le -> s16le
-                int32_t old;
-                memcpy(&old, bytebuf, sizeof(old));
-                double convert = old;
-                convert /= int32max_big;
-                convert *= int16max_small;
-                int16_t new = (int16_t)fastdoubletoint32(convert);
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-            if (idata->targetformat == AUDIOSOURCEFORMAT_F32LE) {
-                double int32max_big = pow(2, 32)/2;
-                // convert s32le -> s16le
-                int32_t old;
-                memcpy(&old, bytebuf, sizeof(old));
-                double convert = old;
-                convert /= int32max_big;
-                float new = convert;
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
+        // convert all complete samples in one go:
+        if (samples > CONVERTSAMPLES) {
+            samples = CONVERTSAMPLES;
         }
-
-        // return converted bytes;
-        unsigned int amount = idata->convertbufbytes;
-        if (amount > bytes) {
-            amount = bytes;
-        }
-        memcpy(buffer, idata->convertbuf, amount);
-        writtenbytes += amount;
-        buffer += amount;
-        bytes -= amount;
-        idata->convertbufbytes -= amount;
-        // we served all requested bytes:
-        if (bytes == 0) {
-            // are some bytes left in buffer?
-            if (idata->convertbufbytes > 0) {
-                // move them up to the beginning
-                memmove(idata->convertbuf, idata->convertbuf + amount,
-                    idata->convertbufbytes);
-            }
-            // all requested bytes served:
-            break;
+        audiosourceformatconvert_convert(idata, samples);
+        idata->outbytes = samples * idata->outsamplesize;
+        idata->outpos = 0;
+
+        // move up the rest (usually just a partial sample):
+        unsigned int used = samples * idata->insamplesize;
+        idata->inbytes -= used;
+        if (idata->inbytes > 0) {
+            memmove(idata->inbuf, idata->inbuf + used, idata->inbytes);
         }
     }
 
@@ -314,7 +297,9 @@ static int audiosourceformatconvert_seek(struct audiosource *source,
     if (idata->source->seek(idata->source, pos)) {
         idata->eof = 0;
         idata->sourceeof = 0;
-        idata->convertbufbytes = 0;
+        idata->inbytes = 0;
+        idata->outbytes = 0;
+        idata->outpos = 0;
         return 1;
     }
     return 0;
@@ -357,10 +342,10 @@ struct audiosource *audiosourceformatconvert_create(
     }
 
     // whitelist of supported formats:
-    if (
+    if ((
     newformat != AUDIOSOURCEFORMAT_S16LE &&
     newformat != AUDIOSOURCEFORMAT_F32LE &&
-    1) {
+    1) || audiosourceformatconvert_sampleSize(source->format) == 0) {
         source->close(source);
         return NULL;
     }
@@ -387,6 +372,9 @@ struct audiosource *audiosourceformatconvert_create(
     // Remember some internal info:
     idata->source = source;
     idata->targetformat = newformat;
+    idata->insamplesize = audiosourceformatconvert_sampleSize(
+        source->format);
+    idata->outsamplesize = audiosourceformatconvert_sampleSize(newformat);
     a->format = newformat;
     a->channels = source->channels;
     a->samplerate = source->samplerate;
@@ -31,6 +31,18 @@
 #include "audiosource.h"
 #include "audiosourceloop.h"
 
+// 32bit float stereo:
+#define FRAMESIZE (sizeof(float) * 2)
+
+// Size of the retained loop head. It is played from memory on each
+// loop restart while the source gets repositioned behind it:
+#define LOOPHEADSIZE (48000 / 2 * FRAMESIZE)
+
+// When the source can't seek, it is rewound and decoded up to the end
+// of the loop head again. This is spread over the reads while the head
+// plays, skipping this many bytes per requested byte:
+#define SKIPAHEADFACTOR 4
+
 struct audiosourceloop_internaldata {
     struct audiosource *source;
     int sourceeof;
@@ -38,11 +50,140 @@ struct audiosourceloop_internaldata {
     int returnerroroneof;
 
     int looping;
+    size_t loopstart;  // in bytes
+    size_t loopend;  // in bytes, 0 for the end of the source
+    size_t position;  // stream position of the next byte we return
+
+    // pre-decoded head of the loop section (from loopstart on):
+    char *head;
+    size_t headbytes;
+    int headcomplete;  // head is no longer extended
+    int loopinhead;  // the whole loop section fits into the head
+
+    // loop restart state:
+    int servinghead;
+    size_t headpos;
+    int repositionpending;  // source still needs to go behind the head
+    size_t skipbytes;  // bytes to skip after rewinding our source
+    int readsincewrap;  // avoid endless loops for empty loop sections
 };
 
 void audiosourceloop_setLooping(struct audiosource *source, int looping) {
     struct audiosourceloop_internaldata *idata = source->internaldata;
     idata->looping = looping;
+    if (looping && !idata->head) {
+        // only looping sources need a head. no head, no gapless loops:
+        idata->head = malloc(LOOPHEADSIZE);
+    }
+}
+
+void audiosourceloop_setLoopPoints(struct audiosource *source,
+        size_t loopstart, size_t loopend) {
+    struct audiosourceloop_internaldata *idata = source->internaldata;
+    if (loopend > 0 && loopend <= loopstart) {
+        loopend = 0;
+    }
+    idata->loopstart = loopstart * FRAMESIZE;
+    idata->loopend = loopend * FRAMESIZE;
+
+    // drop a loop head from the old loop points:
+    idata->headbytes = 0;
+    idata->headcomplete = (idata->position > idata->loopstart);
+    idata->loopinhead = 0;
+}
+
+// Remember data read from the source if it extends the loop head:
+static void audiosourceloop_captureHead(
+        struct audiosourceloop_internaldata *idata,
+        const char *data, size_t bytes) {
+    if (idata->headcomplete || !idata->head || !idata->looping) {
+        return;
+    }
+    size_t headend = idata->loopstart + idata->headbytes;
+    if (idata->position > headend ||
+            idata->position + bytes <= headend) {
+        if (idata->position > headend) {
+            // we skipped past the head (seek)
+            idata->headcomplete = 1;
+        }
+        return;
+    }
+    size_t offset = headend - idata->position;
+    size_t amount = bytes - offset;
+    if (amount > LOOPHEADSIZE - idata->headbytes) {
+        amount = LOOPHEADSIZE - idata->headbytes;
+    }
+    memcpy(idata->head + idata->headbytes, data + offset, amount);
+    idata->headbytes += amount;
+    if (idata->headbytes >= LOOPHEADSIZE) {
+        idata->headcomplete = 1;
+    }
+}
+
+// Skip data after rewinding our source, at most the given amount.
+// Returns 0 on error or end of source:
+static int audiosourceloop_skipAhead(
+        struct audiosourceloop_internaldata *idata, size_t limit) {
+    char skipbuf[4096];
+    while (idata->skipbytes > 0 && limit > 0) {
+        size_t amount = idata->skipbytes;
+        if (amount > sizeof(skipbuf)) {
+            amount = sizeof(skipbuf);
+        }
+        if (amount > limit) {
+            amount = limit;
+        }
+        int i = idata->source->read(idata->source, skipbuf, amount);
+        if (i <= 0) {
+            idata->skipbytes = 0;
+            return 0;
+        }
+        idata->skipbytes -= i;
+        limit -= i;
+    }
+    return 1;
+}
+
+// Move our source to the end of the loop head, so we can continue
+// reading there once the head has been played from memory:
+static void audiosourceloop_reposition(
+        struct audiosourceloop_internaldata *idata) {
+    idata->repositionpending = 0;
+    size_t target = idata->loopstart + idata->headbytes;
+    idata->sourceeof = 0;
+    if (idata->source->seekable &&
+            idata->source->seek(idata->source, target / FRAMESIZE)) {
+        // sample-accurate seek without touching the decoder otherwise
+        idata->skipbytes = 0;
+        return;
+    }
+    idata->source->rewind(idata->source);
+    idata->skipbytes = target;
+}
+
+// The end of the loop section has been reached, start over:
+static int audiosourceloop_wrap(
+        struct audiosourceloop_internaldata *idata) {
+    if (!idata->headcomplete) {
+        // we captured the head up to here, so if it reaches back to
+        // the loop start, the whole loop section is in memory now:
+        if (idata->position == idata->loopstart + idata->headbytes) {
+            idata->loopinhead = 1;
+        }
+        idata->headcomplete = 1;
+    }
+    if (!idata->readsincewrap && idata->headbytes == 0) {
+        // nothing to loop
+        return 0;
+    }
+    idata->readsincewrap = 0;
+    idata->servinghead = 1;
+    idata->headpos = 0;
+    idata->position = idata->loopstart;
+    if (!idata->loopinhead) {
+        idata->repositionpending = 1;
+    }
+    return 1;
 }
 
 static void audiosourceloop_rewind(struct audiosource *source) {
@@ -51,6 +192,10 @@ static void audiosourceloop_rewind(struct audiosource *source) {
     if (!idata->looping) {
         idata->source->rewind(idata->source);
         idata->sourceeof = 0;
+        idata->position = 0;
+        idata->servinghead = 0;
+        idata->repositionpending = 0;
+        idata->skipbytes = 0;
     }
     return;
 }
@@ -62,47 +207,98 @@ static int audiosourceloop_read(struct audiosource *source,
         return -1;
     }
 
-    int rewinded = 0; // avoid endless rewind loops for empty sources
+    // reposition our source after a loop restart. This is done in
+    // the read after the restart, so the data up to the loop end
+    // and the head have been handed out already:
+    if (idata->repositionpending) {
+        audiosourceloop_reposition(idata);
+    }
+    if (idata->skipbytes > 0) {
+        audiosourceloop_skipAhead(idata, (size_t)bytes * SKIPAHEADFACTOR);
+    }
+
     unsigned int byteswritten = 0;
     while (bytes > 0) {
-        int i = 0;
-        if (!idata->sourceeof) {
-            i = idata->source->read(idata->source, buffer, bytes);
-            if (i == 0 && idata->looping == 1 && !rewinded) {
-                // we reached EOF. -> rewind
-                rewinded = 1;
-                idata->sourceeof = 0;
-                idata->source->rewind(idata->source);
+        if (idata->servinghead) {
+            // play the loop head from memory:
+            if (idata->headpos < idata->headbytes) {
+                size_t amount = idata->headbytes - idata->headpos;
+                if (amount > bytes) {
+                    amount = bytes;
+                }
+                memcpy(buffer, idata->head + idata->headpos, amount);
+                idata->headpos += amount;
+                idata->position += amount;
+                byteswritten += amount;
+                buffer += amount;
+                bytes -= amount;
+                continue;
+            }
+            if (idata->loopinhead) {
+                // the loop section is entirely in memory
+                if (!audiosourceloop_wrap(idata)) {
+                    break;
+                }
                 continue;
             }
+
+            // continue from the source behind the head:
+            if (idata->repositionpending) {
+                audiosourceloop_reposition(idata);
+            }
+            if (idata->skipbytes > 0) {
+                audiosourceloop_skipAhead(idata, idata->skipbytes);
+            }
+            idata->servinghead = 0;
+        }
+
+        // don't read beyond the loop end:
+        unsigned int amount = bytes;
+        int atloopend = 0;
+        if (idata->looping && idata->loopend > 0) {
+            if (idata->position >= idata->loopend) {
+                atloopend = 1;
+            } else if (idata->loopend - idata->position < amount) {
+                amount = idata->loopend - idata->position;
+            }
+        }
+
+        int i = 0;
+        if (!idata->sourceeof && !atloopend) {
+            i = idata->source->read(idata->source, buffer, amount);
         }
         if (i > 0) {
             // we got bytes from our audio source. return them:
+            audiosourceloop_captureHead(idata, buffer, i);
+            idata->position += i;
+            idata->readsincewrap = 1;
             byteswritten += i;
             buffer += i;
             bytes -= i;
-            rewinded = 0;
-        } else {
-            if (i <= 0) {
-                // EOF or error?
-                if (i < 0) {  // error!
-                    idata->returnerroroneof = 1;
-                }
-                // EOF! (this can also happen with looping enabled
-                // when the rewind of our audio source fails)
-                idata->sourceeof = 1;
-                if (byteswritten == 0) {
-                    idata->eof = 1;
-                    if (idata->returnerroroneof) {
-                        return -1;
-                    } else {
-                        return 0;
-                    }
-                }
-                return byteswritten;
+            continue;
+        }
+        if (i == 0 && idata->looping) {
+            // end of loop section, start over:
+            if (audiosourceloop_wrap(idata)) {
+                continue;
             }
-            break;
         }
+
+        // EOF or error?
+        if (i < 0) {  // error!
+            idata->returnerroroneof = 1;
+        }
+        // EOF! (this can also happen with looping enabled
+        // when the loop section is empty)
+        idata->sourceeof = 1;
+        break;
+    }
+    if (byteswritten == 0) {
+        idata->eof = 1;
+        if (idata->returnerroroneof) {
+            return -1;
+        }
+        return 0;
     }
     return byteswritten;
 }
@@ -119,12 +315,7 @@ static size_t audiosourceloop_length(struct audiosource *source) {
 
 static size_t audiosourceloop_position(struct audiosource *source) {
     struct audiosourceloop_internaldata *idata = source->internaldata;
-
-    // if our audio source supports telling the position, delegate:
-    if (idata->source->position) {
-        return idata->source->position(idata->source);
-    }
-    return 0;
+    return idata->position / FRAMESIZE;
 }
 
 static int audiosourceloop_seek(struct audiosource *source, size_t pos) {
@@ -138,6 +329,15 @@ static int audiosourceloop_seek(struct audiosource *source, size_t pos) {
     if (idata->source->seekable) {
         if (idata->source->seek(idata->source, pos)) {
             idata->eof = 0;
+            idata->sourceeof = 0;
+            idata->servinghead = 0;
+            idata->repositionpending = 0;
+            idata->skipbytes = 0;
+            idata->position = pos * FRAMESIZE;
+            if (idata->position != idata->loopstart + idata->headbytes) {
+                // the head can't be extended from here
+                idata->headcomplete = 1;
+            }
             return 1;
         }
     }
@@ -153,6 +353,7 @@ static void audiosourceloop_close(struct audiosource *source) {
         }
 
         // free all structs
+        free(idata->head);
         free(idata);
     }
     free(source);
@@ -163,8 +364,9 @@ struct audiosource *audiosourceloop_create(struct audiosource *source) {
         // no source given
         return NULL;
     }
-    if (source->channels != 2) {
-        // we only support stereo audio
+    if (source->channels != 2 ||
+            source->format != AUDIOSOURCEFORMAT_F32LE) {
+        // we only support 32bit float stereo audio
         source->close(source);
         return NULL;
     }
@@ -191,6 +393,7 @@ struct audiosource *audiosourceloop_create(struct audiosource *source) {
     idata->source = source;
     a->samplerate = source->samplerate;
     a->channels = source->channels;
+    a->format = source->format;
 
     // function pointers
     a->read = &audiosourceloop_read;
@@ -21,6 +21,18 @@
 
 */
 
+// Enable or disable looping. The memory for the retained loop head
+// is only allocated once looping gets enabled. Set looping before the
+// playback reaches the loop start, otherwise the loop restart won't
+// be gapless:
 void audiosourceloop_setLooping(struct audiosource *source, int looping);
 
+// Set the section which is looped, in sample frames. Playback starts at
+// the stream start as usual, and wraps from loopend to loopstart when
+// looping (loopend 0 is the end of the stream). The beginning of the
+// loop section is retained in memory, so the loop restarts gaplessly
+// while the source is repositioned behind it:
+void audiosourceloop_setLoopPoints(struct audiosource *source,
+    size_t loopstart, size_t loopend);
+
 struct audiosource *audiosourceloop_create(struct audiosource *source);
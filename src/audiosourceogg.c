@@ -25,6 +25,7 @@
 #include "os.h"
 
 #ifdef USE_AUDIO
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -56,11 +57,24 @@ struct audiosourceogg_internaldata {
     OggVorbis_File vorbisfile;
     int vbitstream; // required by libvorbisfile internally
     int vorbiseof;
+
+    // set when the decoder was opened with seeking support, which
+    // is done lazily on the first seek:
+    int vorbisseekable;
 };
 
 static void audiosourceogg_rewind(struct audiosource *source) {
     struct audiosourceogg_internaldata *idata = source->internaldata;
     if (!idata->eof || !idata->returnerroroneof) {
+        // a seekable decoder can simply seek back to the start:
+        if (idata->vorbisopened && idata->vorbisseekable &&
+                ov_pcm_seek(&idata->vorbisfile, 0) == 0) {
+            idata->decodedbytes = 0;
+            idata->vorbiseof = 0;
+            idata->eof = 0;
+            return;
+        }
+
         // close vorbis decoder:
         if (idata->vorbisopened) {
             ov_clear(&idata->vorbisfile);
@@ -158,6 +172,36 @@ static size_t vorbismemoryreader(void *ptr, size_t size, size_t nmemb,
     return writtenchunks;
 }
 
+// seek function for libvorbisfile (only used for seekable files):
+static int vorbisseek(void *datasource, ogg_int64_t offset, int whence) {
+    struct audiosourceogg_internaldata *idata = datasource;
+    struct audiosource *f = idata->filesource;
+
+    // get absolute position:
+    ogg_int64_t pos = offset;
+    if (whence == SEEK_CUR) {
+        pos += f->position(f) - idata->fetchedbytes;
+    } else if (whence == SEEK_END) {
+        pos += f->length(f);
+    }
+    if (pos < 0 || !f->seek(f, pos)) {
+        return -1;
+    }
+
+    // drop buffered data from the old position:
+    idata->fetchedbytes = 0;
+    idata->fetchedbufreadoffset = 0;
+    idata->filesourceeof = 0;
+    return 0;
+}
+
+// tell function for libvorbisfile (only used for seekable files):
+static long vorbistell(void *datasource) {
+    struct audiosourceogg_internaldata *idata = datasource;
+    return idata->filesource->position(idata->filesource) -
+        idata->fetchedbytes;
+}
+
 static int audiosourceogg_initOgg(struct audiosource *source) {
     struct audiosourceogg_internaldata *idata = source->internaldata;
     if (idata->vorbisopened) {
@@ -167,6 +211,11 @@ static int audiosourceogg_initOgg(struct audiosource *source) {
     ov_callbacks callbacks;
     memset(&callbacks, 0, sizeof(callbacks));
     callbacks.read_func = &vorbismemoryreader;
+    if (idata->vorbisseekable) {
+        // with these, libvorbisfile builds its seek table on open:
+        callbacks.seek_func = &vorbisseek;
+        callbacks.tell_func = &vorbistell;
+    }
 
     int v = ov_open_callbacks(idata, &idata->vorbisfile, NULL, 0, callbacks);
     if (v != 0) {
@@ -317,6 +366,66 @@ static int audiosourceogg_read(struct audiosource *source, char* buffer,
     return byteswritten;
 }
 
+static int audiosourceogg_seek(struct audiosource *source, size_t pos) {
+    struct audiosourceogg_internaldata *idata = source->internaldata;
+    if (!source->seekable || (idata->eof && idata->returnerroroneof)) {
+        return 0;
+    }
+
+    // reopen the decoder with seeking support if we don't have it yet:
+    if (!idata->vorbisseekable) {
+        if (idata->vorbisopened) {
+            ov_clear(&idata->vorbisfile);
+            idata->vorbisopened = 0;
+        }
+        idata->filesource->rewind(idata->filesource);
+        idata->filesourceeof = 0;
+        idata->fetchedbytes = 0;
+        idata->fetchedbufreadoffset = 0;
+        idata->vorbisseekable = 1;
+        if (!audiosourceogg_initOgg(source)) {
+            idata->eof = 1;
+            idata->returnerroroneof = 1;
+            return 0;
+        }
+        idata->vorbisopened = 1;
+    }
+
+    if (ov_pcm_seek(&idata->vorbisfile, pos) != 0) {
+        return 0;
+    }
+    idata->decodedbytes = 0;
+    idata->vorbiseof = 0;
+    idata->eof = 0;
+    return 1;
+}
+
+static size_t audiosourceogg_position(struct audiosource *source) {
+    struct audiosourceogg_internaldata *idata = source->internaldata;
+    if (!idata->vorbisopened || source->channels < 1) {
+        return 0;
+    }
+    ogg_int64_t pos = ov_pcm_tell(&idata->vorbisfile);
+    if (pos < 0) {
+        return 0;
+    }
+    // don't count what is decoded, but not returned yet:
+    return pos - idata->decodedbytes / (source->channels * sizeof(float));
+}
+
+static size_t audiosourceogg_length(struct audiosource *source) {
+    struct audiosourceogg_internaldata *idata = source->internaldata;
+    if (!idata->vorbisopened || !idata->vorbisseekable) {
+        // unknown
+        return 0;
+    }
+    ogg_int64_t total = ov_pcm_total(&idata->vorbisfile, -1);
+    if (total < 0) {
+        return 0;
+    }
+    return total;
+}
+
 static void audiosourceogg_close(struct audiosource *source) {
     struct audiosourceogg_internaldata *idata = source->internaldata;
     if (idata) {
@@ -368,6 +477,12 @@ struct audiosource *audiosourceogg_create(struct audiosource *filesource) {
     a->read = &audiosourceogg_read;
     a->close = &audiosourceogg_close;
     a->rewind = &audiosourceogg_rewind;
+    a->seek = &audiosourceogg_seek;
+    a->position = &audiosourceogg_position;
+    a->length = &audiosourceogg_length;
+
+    // we can seek if our file source supports it:
+    a->seekable = filesource->seekable;
 
     // ensure proper initialisation of sample rate + channels variables
     audiosourceogg_read(a, NULL, 0);
@@ -0,0 +1,132 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "config.h"
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audiosource.h"
+#include "audiosourcepcm.h"
+#include "audiopcmcache.h"
+
+struct audiosourcepcm_internaldata {
+    struct audiopcmcacheentry* entry;
+    size_t bytepos;  // read position in bytes
+};
+
+static int audiosourcepcm_read(struct audiosource* source,
+        char* buffer, unsigned int bytes) {
+    struct audiosourcepcm_internaldata* idata = source->internaldata;
+    size_t total = idata->entry->frames * 2 * sizeof(float);
+    if (idata->bytepos >= total) {
+        return 0;
+    }
+    if (bytes > total - idata->bytepos) {
+        bytes = total - idata->bytepos;
+    }
+    memcpy(buffer, (char*)idata->entry->samples + idata->bytepos, bytes);
+    idata->bytepos += bytes;
+    return bytes;
+}
+
+static void audiosourcepcm_rewind(struct audiosource* source) {
+    struct audiosourcepcm_internaldata* idata = source->internaldata;
+    idata->bytepos = 0;
+}
+
+static int audiosourcepcm_seek(struct audiosource* source, size_t pos) {
+    struct audiosourcepcm_internaldata* idata = source->internaldata;
+    if (pos > idata->entry->frames) {
+        return 0;
+    }
+    idata->bytepos = pos * 2 * sizeof(float);
+    return 1;
+}
+
+static size_t audiosourcepcm_position(struct audiosource* source) {
+    struct audiosourcepcm_internaldata* idata = source->internaldata;
+    return idata->bytepos / (2 * sizeof(float));
+}
+
+static size_t audiosourcepcm_length(struct audiosource* source) {
+    struct audiosourcepcm_internaldata* idata = source->internaldata;
+    return idata->entry->frames;
+}
+
+static void audiosourcepcm_close(struct audiosource* source) {
+    struct audiosourcepcm_internaldata* idata = source->internaldata;
+    if (idata) {
+        // give back our reference to the shared decoded sound:
+        audiopcmcache_release(idata->entry);
+        free(idata);
+    }
+    free(source);
+}
+
+struct audiosource* audiosourcepcm_create(struct audiopcmcacheentry* entry) {
+    if (!entry) {
+        return NULL;
+    }
+
+    // allocate visible data struct
+    struct audiosource* a = malloc(sizeof(*a));
+    if (!a) {
+        audiopcmcache_release(entry);
+        return NULL;
+    }
+    memset(a, 0, sizeof(*a));
+
+    // allocate internal data struct
+    a->internaldata = malloc(sizeof(struct audiosourcepcm_internaldata));
+    if (!a->internaldata) {
+        free(a);
+        audiopcmcache_release(entry);
+        return NULL;
+    }
+    struct audiosourcepcm_internaldata* idata = a->internaldata;
+    memset(idata, 0, sizeof(*idata));
+    idata->entry = entry;
+
+    // cached sounds are always float stereo:
+    a->samplerate = entry->samplerate;
+    a->channels = 2;
+    a->format = AUDIOSOURCEFORMAT_F32LE;
+    a->seekable = 1;
+
+    // function pointers
+    a->read = &audiosourcepcm_read;
+    a->rewind = &audiosourcepcm_rewind;
+    a->seek = &audiosourcepcm_seek;
+    a->position = &audiosourcepcm_position;
+    a->length = &audiosourcepcm_length;
+    a->close = &audiosourcepcm_close;
+    return a;
+}
+
+#endif  // USE_AUDIO
+
@@ -29,113 +29,459 @@
 
 #include "audiosource.h"
 #include "audiosourceprereadcache.h"
+#include "ringbuffer.h"
+#include "threading.h"
+
+// Default size of the read-ahead ring buffer (and the retained
+// stream head):
+#define DEFAULTPREREADCACHESIZE (64 * 1024)
+
+// Amount of bytes the I/O thread reads at once:
+#define IOCHUNKSIZE (4 * 1024)
 
 struct audiosourceprereadcache_internaldata {
-    struct audiosource *source;
-    unsigned int prereadcachesize;
-    char *prereadcache;
-    unsigned int prereadcachebytes;
+    struct audiosource *source;  // only used by the I/O thread
+    struct ringbuffer *ring;  // read-ahead data
     int eof;
-    int sourceeof;
-    char *path;
+
+    // retained copy of the stream head, for rewinds without I/O:
+    char *head;
+    unsigned int headsize;
+    unsigned int headbytes;  // atomic, only grows until frozen
+    int headfrozen;  // I/O thread only
+    int wholeinhead;  // atomic, 1 if the entire stream fits into head
+
+    // reader state:
+    int servinghead;  // reading from head instead of ring
+    unsigned int headpos;
+    size_t readposition;  // stream position in bytes
+    size_t length;  // stream length, if our source is seekable
+
+    // communication with the I/O thread:
+    unsigned int rewindrequest;  // atomic, bumped by reader per rewind/seek
+    unsigned int rewinddone;  // atomic, last request handled by I/O thread
+    size_t seektarget;  // atomic, where to continue after a rewind/seek
+    int ioeof;  // atomic
+    int ioerror;  // atomic
+    size_t ioposition;  // I/O thread only: stream position in bytes
+    semaphore *datasemaphore;  // posted when new data is available
+    int readerwaiting;  // atomic, reader waits for datasemaphore
+    mutex *iomutex;  // held by I/O thread while using this source
+    unsigned int servedpass;  // I/O thread only
+
+    struct audiosourceprereadcache_internaldata *next;
 };
 
+// All read-ahead caches are served by one shared I/O thread:
+static struct audiosourceprereadcache_internaldata *cachelist = NULL;
+static mutex *cachelistmutex = NULL;
+static semaphore *iosemaphore = NULL;
+static threadinfo *iothread = NULL;
+
+// this runs on application start:
+__attribute__((constructor)) static void audiosourceprereadcache_init(void) {
+    cachelistmutex = mutex_create();
+}
+
+// Wake up the reader if it waits for us. I/O thread only:
+static void audiosourceprereadcache_notifyReader(
+        struct audiosourceprereadcache_internaldata *idata) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&idata->readerwaiting, 0, __ATOMIC_SEQ_CST)) {
+        semaphore_Post(idata->datasemaphore);
+    }
+}
+
+// Check if a rewind/seek hasn't been handled by the I/O thread yet:
+static int audiosourceprereadcache_rewindPending(
+        struct audiosourceprereadcache_internaldata *idata) {
+    return (__atomic_load_n(&idata->rewindrequest, __ATOMIC_ACQUIRE) !=
+        __atomic_load_n(&idata->rewinddone, __ATOMIC_ACQUIRE));
+}
+
+// Check if the I/O thread has something to do for this cache:
+static int audiosourceprereadcache_needsIO(
+        struct audiosourceprereadcache_internaldata *idata) {
+    if (audiosourceprereadcache_rewindPending(idata)) {
+        return 1;
+    }
+    if (__atomic_load_n(&idata->ioeof, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    return (ringbuffer_writable(idata->ring) >= IOCHUNKSIZE);
+}
+
+// Value for seektarget to continue right after the retained head:
+#define SEEKTARGET_ENDOFHEAD ((size_t)-1)
+
+// Move our source to the seek target (usually the end of the data
+// we have in our retained head). I/O thread only, and only while the
+// reader doesn't use the ring:
+static void audiosourceprereadcache_processRewind(
+        struct audiosourceprereadcache_internaldata *idata) {
+    // freeze the head, so the reader knows where the ring data starts:
+    idata->headfrozen = 1;
+
+    // only mark the request we actually handle as done: if the reader
+    // seeks again meanwhile, its newer request stays pending
+    unsigned int request = __atomic_load_n(&idata->rewindrequest,
+        __ATOMIC_ACQUIRE);
+    size_t target = __atomic_load_n(&idata->seektarget, __ATOMIC_RELAXED);
+    if (target == SEEKTARGET_ENDOFHEAD) {
+        target = __atomic_load_n(&idata->headbytes, __ATOMIC_RELAXED);
+    }
+
+    // get rid of old read-ahead data:
+    ringbuffer_reset(idata->ring);
+    __atomic_store_n(&idata->ioeof, 0, __ATOMIC_RELEASE);
+
+    // seek directly if possible:
+    if (idata->source->seekable &&
+            idata->source->seek(idata->source, target)) {
+        idata->ioposition = target;
+        __atomic_store_n(&idata->rewinddone, request, __ATOMIC_RELEASE);
+        return;
+    }
+
+    // otherwise, rewind and skip up to the target:
+    idata->source->rewind(idata->source);
+    idata->ioposition = 0;
+    char skipbuf[IOCHUNKSIZE];
+    while (idata->ioposition < target) {
+        size_t amount = target - idata->ioposition;
+        if (amount > sizeof(skipbuf)) {
+            amount = sizeof(skipbuf);
+        }
+        int i = idata->source->read(idata->source, skipbuf, amount);
+        if (i <= 0) {
+            if (i < 0) {
+                __atomic_store_n(&idata->ioerror, 1, __ATOMIC_RELEASE);
+            }
+            __atomic_store_n(&idata->ioeof, 1, __ATOMIC_RELEASE);
+            break;
+        }
+        idata->ioposition += i;
+    }
+
+    // hand the ring buffer back to the reader:
+    __atomic_store_n(&idata->rewinddone, request, __ATOMIC_RELEASE);
+}
+
+// Read ahead as much as fits into the ring buffer. I/O thread only:
+static void audiosourceprereadcache_fill(
+        struct audiosourceprereadcache_internaldata *idata) {
+    if (audiosourceprereadcache_rewindPending(idata)) {
+        audiosourceprereadcache_processRewind(idata);
+        audiosourceprereadcache_notifyReader(idata);
+    }
+    while (!__atomic_load_n(&idata->ioeof, __ATOMIC_RELAXED) &&
+    ringbuffer_writable(idata->ring) >= IOCHUNKSIZE) {
+        void *p;
+        size_t space = ringbuffer_writeRegion(idata->ring, &p);
+        if (space > IOCHUNKSIZE) {
+            space = IOCHUNKSIZE;
+        }
+        int i = idata->source->read(idata->source, p, space);
+        if (i <= 0) {
+            if (i < 0) {
+                __atomic_store_n(&idata->ioerror, 1, __ATOMIC_RELEASE);
+            } else if (!idata->headfrozen &&
+            idata->ioposition == idata->headbytes) {
+                // we have the entire stream in our head copy
+                __atomic_store_n(&idata->wholeinhead, 1, __ATOMIC_RELEASE);
+            }
+            __atomic_store_n(&idata->ioeof, 1, __ATOMIC_RELEASE);
+            break;
+        }
+
+        // retain a copy of the stream head:
+        if (!idata->headfrozen && idata->ioposition == idata->headbytes &&
+        idata->headbytes < idata->headsize) {
+            unsigned int amount = idata->headsize - idata->headbytes;
+            if (amount > (unsigned int)i) {
+                amount = i;
+            }
+            memcpy(idata->head + idata->headbytes, p, amount);
+            __atomic_store_n(&idata->headbytes, idata->headbytes + amount,
+                __ATOMIC_RELEASE);
+        }
+        idata->ioposition += i;
+
+        ringbuffer_commit(idata->ring, i);
+        audiosourceprereadcache_notifyReader(idata);
+    }
+    if (__atomic_load_n(&idata->ioeof, __ATOMIC_RELAXED)) {
+        audiosourceprereadcache_notifyReader(idata);
+    }
+}
+
+static void audiosourceprereadcache_ioThread(
+        __attribute__((unused)) void *userdata) {
+    unsigned int pass = 0;
+    while (1) {
+        semaphore_Wait(iosemaphore);
+        pass++;
+
+        // serve every cache which needs something once per pass:
+        while (1) {
+            mutex_lock(cachelistmutex);
+            struct audiosourceprereadcache_internaldata *idata = cachelist;
+            while (idata) {
+                if (idata->servedpass != pass &&
+                audiosourceprereadcache_needsIO(idata)) {
+                    break;
+                }
+                idata = idata->next;
+            }
+            if (idata) {
+                mutex_lock(idata->iomutex);
+            }
+            mutex_release(cachelistmutex);
+            if (!idata) {
+                break;
+            }
+            idata->servedpass = pass;
+            audiosourceprereadcache_fill(idata);
+            mutex_release(idata->iomutex);
+        }
+    }
+}
+
+// Ask the I/O thread to continue reading at the given target. Reader only:
+static void audiosourceprereadcache_requestRewind(
+        struct audiosourceprereadcache_internaldata *idata, size_t target) {
+    __atomic_store_n(&idata->seektarget, target, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&idata->rewindrequest, 1, __ATOMIC_RELEASE);
+    semaphore_Post(iosemaphore);
+}
+
+// Check if the reader can continue without waiting. Reader only:
+static int audiosourceprereadcache_readerCanContinue(
+        struct audiosourceprereadcache_internaldata *idata) {
+    if (idata->servinghead) {
+        return (!audiosourceprereadcache_rewindPending(idata)
+            || __atomic_load_n(&idata->headbytes, __ATOMIC_ACQUIRE) >
+            idata->headpos);
+    }
+    if (audiosourceprereadcache_rewindPending(idata)) {
+        return 0;
+    }
+    return (__atomic_load_n(&idata->ioeof, __ATOMIC_ACQUIRE) ||
+        ringbuffer_readable(idata->ring) > 0);
+}
+
+// Wait for the I/O thread to provide more data. Reader only:
+static void audiosourceprereadcache_waitForIO(
+        struct audiosourceprereadcache_internaldata *idata) {
+    __atomic_store_n(&idata->readerwaiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    semaphore_Post(iosemaphore);
+    if (audiosourceprereadcache_readerCanContinue(idata)) {
+        // no need to wait after all
+        if (!__atomic_exchange_n(&idata->readerwaiting, 0,
+        __ATOMIC_SEQ_CST)) {
+            // the I/O thread has posted for us already, consume it:
+            semaphore_Wait(idata->datasemaphore);
+        }
+        return;
+    }
+    semaphore_Wait(idata->datasemaphore);
+}
+
 static void audiosourceprereadcache_rewind(struct audiosource *source) {
     struct audiosourceprereadcache_internaldata *idata = source->internaldata;
     idata->eof = 0;
-    idata->source->rewind(idata->source);
-    idata->sourceeof = 0;
-    idata->prereadcachebytes = 0;
+    idata->servinghead = 1;
+    idata->headpos = 0;
+    idata->readposition = 0;
+    if (!__atomic_load_n(&idata->wholeinhead, __ATOMIC_ACQUIRE)) {
+        // let the I/O thread continue reading after the head:
+        audiosourceprereadcache_requestRewind(idata, SEEKTARGET_ENDOFHEAD);
+    }
 }
 
-static int audiosourceprereadcache_read(struct audiosource *source,
-        char *buffer, unsigned int bytes) {
+static int audiosourceprereadcache_seek(struct audiosource *source,
+        size_t pos) {
     struct audiosourceprereadcache_internaldata *idata = source->internaldata;
-    if (idata->eof) {
-        return -1;
+    if (!source->seekable) {
+        return 0;
+    }
+    if (pos > idata->length) {
+        pos = idata->length;
     }
-    if (idata->prereadcachesize == 0) {
-        // cache was not initialised yet - initialise with standard size
-        idata->prereadcachesize = (1024 * 10);
-        idata->prereadcache = malloc(idata->prereadcachesize);
-        if (!idata->prereadcache) {
-            return -1;
+    idata->eof = 0;
+    idata->readposition = pos;
+
+    unsigned int headbytes = __atomic_load_n(&idata->headbytes,
+        __ATOMIC_ACQUIRE);
+    int wholeinhead = __atomic_load_n(&idata->wholeinhead,
+        __ATOMIC_ACQUIRE);
+    if (pos < headbytes || wholeinhead) {
+        // serve from the retained head, then continue after it:
+        idata->servinghead = 1;
+        idata->headpos = (pos < headbytes ? pos : headbytes);
+        if (wholeinhead) {
+            return 1;
         }
+        audiosourceprereadcache_requestRewind(idata, SEEKTARGET_ENDOFHEAD);
+    } else {
+        // let the I/O thread continue reading at the new position:
+        idata->servinghead = 0;
+        audiosourceprereadcache_requestRewind(idata, pos);
     }
-    if (!idata->prereadcache) {
+    return 1;
+}
+
+static size_t audiosourceprereadcache_position(struct audiosource *source) {
+    struct audiosourceprereadcache_internaldata *idata = source->internaldata;
+    return idata->readposition;
+}
+
+static size_t audiosourceprereadcache_length(struct audiosource *source) {
+    struct audiosourceprereadcache_internaldata *idata = source->internaldata;
+    return idata->length;
+}
+
+static int audiosourceprereadcache_read(struct audiosource *source,
+        char *buffer, unsigned int bytes) {
+    struct audiosourceprereadcache_internaldata *idata = source->internaldata;
+    if (idata->eof) {
         return -1;
     }
 
     unsigned int writtenbytes = 0;
     while (bytes > 0) {
-        // first, refill our cache if it cannot satisfy the demands
-        if (bytes > idata->prereadcachebytes/2
-                && (idata->prereadcachebytes < idata->prereadcachesize/4
-                || bytes > idata->prereadcachebytes) && !idata->sourceeof) {
-            int i;
-            i = idata->source->read(idata->source,
-                idata->prereadcache + idata->prereadcachebytes,
-                idata->prereadcachesize - idata->prereadcachebytes);
-            if (i > 0) {
-                idata->prereadcachebytes += i;
-            }else{
-                idata->sourceeof = 1;
-                if (i < 0) {
-                    idata->eof = 1;
-                    return -1;
+        if (idata->servinghead) {
+            // serve data from the retained head after a rewind:
+            unsigned int headbytes = __atomic_load_n(&idata->headbytes,
+                __ATOMIC_ACQUIRE);
+            if (idata->headpos < headbytes) {
+                unsigned int amount = headbytes - idata->headpos;
+                if (amount > bytes) {
+                    amount = bytes;
                 }
+                memcpy(buffer, idata->head + idata->headpos, amount);
+                idata->headpos += amount;
+                idata->readposition += amount;
+                buffer += amount;
+                bytes -= amount;
+                writtenbytes += amount;
+                continue;
+            }
+            if (__atomic_load_n(&idata->wholeinhead, __ATOMIC_ACQUIRE)) {
+                // end of stream
+                break;
             }
+            if (audiosourceprereadcache_rewindPending(idata)) {
+                // I/O thread hasn't caught up with the rewind yet
+                if (writtenbytes > 0) {
+                    break;
+                }
+                audiosourceprereadcache_waitForIO(idata);
+                continue;
+            }
+            // continue with the read-ahead data after the head:
+            idata->servinghead = 0;
         }
 
-        if (bytes > 0) {
-            if (idata->prereadcachebytes > 0) {
-                // we have some cached bytes - return them
-                unsigned int readbytes = idata->prereadcachebytes;
-                if (readbytes > bytes) {
-                    readbytes = bytes;
-                }
-                memcpy(buffer, idata->prereadcache, readbytes);
-                buffer += readbytes;
-                bytes -= readbytes;
-                writtenbytes += readbytes;
-
-                // trim data in cache buffer
-                if (readbytes < idata->prereadcachebytes) {
-                    memmove(idata->prereadcache, idata->prereadcache +
-                       readbytes, idata->prereadcachebytes - readbytes);
-                }
-                idata->prereadcachebytes -= readbytes;
-            }else{
-                // we were not able to get new cached bytes -> End of Stream
-                if (writtenbytes == 0) {
-                    idata->eof = 1;
-                }
-                return writtenbytes;
+        // after a seek, wait for the I/O thread to refill the ring:
+        if (audiosourceprereadcache_rewindPending(idata)) {
+            if (writtenbytes > 0) {
+                break;
+            }
+            audiosourceprereadcache_waitForIO(idata);
+            continue;
+        }
+
+        // check for EOF before checking the available data, so we never
+        // miss data written right before the EOF mark:
+        int ioeof = __atomic_load_n(&idata->ioeof, __ATOMIC_ACQUIRE);
+        size_t amount = ringbuffer_read(idata->ring, buffer, bytes);
+        if (amount > 0) {
+            idata->readposition += amount;
+            buffer += amount;
+            bytes -= amount;
+            writtenbytes += amount;
+            continue;
+        }
+        if (ioeof) {
+            if (writtenbytes == 0 &&
+            __atomic_load_n(&idata->ioerror, __ATOMIC_ACQUIRE)) {
+                idata->eof = 1;
+                return -1;
             }
+            break;
         }
+        if (writtenbytes > 0) {
+            // return what we have instead of waiting
+            break;
+        }
+        audiosourceprereadcache_waitForIO(idata);
+    }
+
+    // wake up I/O thread if there is a lot of space to fill up:
+    if (ringbuffer_readable(idata->ring) <
+    ringbuffer_size(idata->ring) / 2) {
+        semaphore_Post(iosemaphore);
+    }
+
+    if (writtenbytes == 0) {
+        // End of Stream
+        idata->eof = 1;
     }
     return writtenbytes;
 }
 
 static void audiosourceprereadcache_close(struct audiosource *source) {
     struct audiosourceprereadcache_internaldata *idata = source->internaldata;
+
+    // remove from list, so the I/O thread no longer picks us:
+    mutex_lock(cachelistmutex);
+    struct audiosourceprereadcache_internaldata *prev = NULL;
+    struct audiosourceprereadcache_internaldata *i = cachelist;
+    while (i) {
+        if (i == idata) {
+            if (prev) {
+                prev->next = idata->next;
+            } else {
+                cachelist = idata->next;
+            }
+            break;
+        }
+        prev = i;
+        i = i->next;
+    }
+    mutex_release(cachelistmutex);
+
+    // wait for the I/O thread to be done with us:
+    mutex_lock(idata->iomutex);
+    mutex_release(idata->iomutex);
+
     if (idata->source) {
         idata->source->close(idata->source);
     }
-    if (idata->prereadcache) {
-        free(idata->prereadcache);
-    }
+    ringbuffer_destroy(idata->ring);
+    free(idata->head);
+    semaphore_Destroy(idata->datasemaphore);
+    mutex_destroy(idata->iomutex);
     free(idata);
     free(source);
 }
 
 struct audiosource *audiosourceprereadcache_create(
-        struct audiosource *source) {
+        struct audiosource *source, unsigned int size) {
     if (!source) {
         return NULL;
     }
+    if (size == 0) {
+        size = DEFAULTPREREADCACHESIZE;
+    }
+    if (size < IOCHUNKSIZE * 2) {
+        size = IOCHUNKSIZE * 2;
+    }
     struct audiosource *a = malloc(sizeof(*a));
     if (!a) {
+        source->close(source);
         return NULL;
     }
 
@@ -144,16 +490,61 @@ struct audiosource *audiosourceprereadcache_create(
         struct audiosourceprereadcache_internaldata));
     if (!a->internaldata) {
         free(a);
+        source->close(source);
         return NULL;
     }
 
     struct audiosourceprereadcache_internaldata *idata = a->internaldata;
     memset(idata, 0, sizeof(*idata));
     idata->source = source;
+    idata->headsize = size;
+    idata->ring = ringbuffer_create(size);
+    idata->head = malloc(size);
+    idata->datasemaphore = semaphore_Create(0);
+    idata->iomutex = mutex_create();
+    if (!idata->ring || !idata->head || !idata->datasemaphore ||
+    !idata->iomutex) {
+        ringbuffer_destroy(idata->ring);
+        free(idata->head);
+        if (idata->datasemaphore) {
+            semaphore_Destroy(idata->datasemaphore);
+        }
+        if (idata->iomutex) {
+            mutex_destroy(idata->iomutex);
+        }
+        free(idata);
+        free(a);
+        source->close(source);
+        return NULL;
+    }
 
     a->read = &audiosourceprereadcache_read;
     a->close = &audiosourceprereadcache_close;
     a->rewind = &audiosourceprereadcache_rewind;
+    a->position = &audiosourceprereadcache_position;
+    a->length = &audiosourceprereadcache_length;
+    a->seek = &audiosourceprereadcache_seek;
+
+    // we can seek if our source can (the length is queried now,
+    // since the source belongs to the I/O thread afterwards):
+    if (source->seekable && source->length) {
+        idata->length = source->length(source);
+        a->seekable = (idata->length > 0);
+    }
+
+    // register with the I/O thread (and start it if not running yet):
+    mutex_lock(cachelistmutex);
+    if (!iothread) {
+        iosemaphore = semaphore_Create(0);
+        iothread = thread_createInfo();
+        thread_spawnWithPriority(iothread, 2,
+            &audiosourceprereadcache_ioThread, NULL);
+    }
+    idata->next = cachelist;
+    cachelist = idata;
+    mutex_release(cachelistmutex);
 
+    // start reading ahead right away:
+    semaphore_Post(iosemaphore);
     return a;
 }
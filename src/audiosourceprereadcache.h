@@ -24,8 +24,13 @@
 #ifndef BLITWIZARD_AUDIOSOURCEPREREADCACHE_H_
 #define BLITWIZARD_AUDIOSOURCEPREREADCACHE_H_
 
+// The preread cache reads ahead of the given audio source in a
+// background I/O thread, so reading from it usually doesn't need to
+// wait for disk or zip archive access. The head of the stream is kept
+// in memory, so rewinding (e.g. for looping) doesn't wait for I/O.
+// size: size of the read-ahead buffer in bytes, 0 for the default
 struct audiosource *audiosourceprereadcache_create(
-struct audiosource *source);
+struct audiosource *source, unsigned int size);
 
 #endif  // BLITWIZARD_AUDIOSOURCEPREREADCACHE_H_
 
@@ -30,88 +30,81 @@
 
 #include "audiosource.h"
 #include "audiosourceresample.h"
+#include "audioresampler.h"
 
-#ifndef USE_SPEEX_RESAMPLING
+// input buffer size in frames (plus the filter length):
+#define INBUFFRAMES 1024
 
-void audiosourceresample_close(struct audiosource *source) {
-    struct audiosource *internalsource = source->internaldata;
-    if (internalsource) {
-        internalsource->close(internalsource);
-    }
-    free(source);
-}
-
-void audiosourceresample_rewind(struct audiosource *source) {
-    struct audiosource *internalsource = source->internaldata;
-    internalsource->rewind(internalsource);
-}
-
-int audiosourceresample_read(struct audiosource *source, char *buffer,
-        unsigned int bytes) {
-    struct audiosource *internalsource = source->internaldata;
-    return internalsource->read(internalsource, buffer, bytes);
-}
-
-unsigned int audiosourceresample_position(struct audiosource *source) {
-    struct audiosource *internalsource = source->internaldata;
-    return internalsource->position(internalsource);
-}
-
-unsigned int audiosourceresample_length(struct audiosource *source) {
-    struct audiosource *internalsource = source->internaldata;
-    return internalsource->length(internalsource);
-}
-
-int audiosourceresample_seek(struct audiosource *source, unsigned int pos) {
-    struct audiosource *internalsource = source->internaldata;
-    return internalsource->seek(internalsource, pos);
-}
-
-struct audiosource *audiosourceresample_create(struct audiosource *source,
-        unsigned int targetrate) {
-    if (!source || source->samplerate <= 0) {
-        return NULL;
-    }
-    struct audiosource *as = malloc(sizeof(*as));
-    if (!as) {
-        return NULL;
-    }
-    memset(as,0,sizeof(*as));
-    as->internaldata = source;
-    as->read = &audiosourceresample_read;
-    as->close = &audiosourceresample_close;
-    as->rewind = &audiosourceresample_rewind;
-    as->position = &audiosourceresample_position;
-    as->length = &audiosourceresample_length;
-    as->seek = &audiosourceresample_seek;
-    as->samplerate = targetrate;
-    as->channels = source->channels;
-    as->format = source->format;
-    return as;
-}
-
-#else
-
-#include <speex/speex_resampler.h>
+// output buffer size in frames:
+#define OUTBUFFRAMES 1024
 
 struct audiosourceresample_internaldata {
     struct audiosource *source;
-    unsigned int targetrate;
+    struct audioresampler *resampler;
+    unsigned int framesize;
+    unsigned int taps;
     int sourceeof;
     int eof;
     int returnerroroneof;
 
-    SpeexResamplerState* st;
+    // input frames not yet fully used by the filter:
+    float *inbuf;
+    unsigned int inbufsize;  // in bytes
+    unsigned int inbytes;
+    unsigned long long inframebase;  // source frame at the start
+    unsigned long long inframestotal;  // source frames read since
+
+    // resampled frames not yet returned:
+    float *outbuf;
+    unsigned int outbytes;
+    unsigned int outpos;
+    unsigned long long outframestotal;
+    unsigned long long outframesexpected;  // known after source eof
+
+    size_t positionbase;  // output position we started at
+};
 
-    char unprocessedbuf[512];
-    unsigned int unprocessedbytes;
+// Reset our state to start at the given output frame. The source
+// needs to be positioned at the input frame returned by this already
+// (see audioresampler_startAt()):
+static void audiosourceresample_start(struct audiosource *source,
+        size_t pos) {
+    struct audiosourceresample_internaldata *idata = source->internaldata;
+    long long first = audioresampler_startAt(idata->resampler, pos);
+
+    // prepend silence if the filter window reaches before the start:
+    idata->inbytes = 0;
+    idata->inframebase = 0;
+    if (first < 0) {
+        idata->inbytes = (unsigned int)(-first) * idata->framesize;
+        memset(idata->inbuf, 0, idata->inbytes);
+    } else {
+        idata->inframebase = first;
+    }
+    idata->inframestotal = 0;
+    idata->outbytes = 0;
+    idata->outpos = 0;
+    idata->outframestotal = 0;
+    idata->outframesexpected = 0;
+    idata->positionbase = pos;
+    idata->sourceeof = 0;
+    idata->eof = 0;
+    idata->returnerroroneof = 0;
+}
 
-    char processedbuf[2048];
-    unsigned int processedbytes;
-};
+// The source frame at which to start for the given output frame:
+static size_t audiosourceresample_sourceStart(struct audiosource *source,
+        size_t pos) {
+    struct audiosourceresample_internaldata *idata = source->internaldata;
+    long long first = audioresampler_startAt(idata->resampler, pos);
+    if (first < 0) {
+        return 0;
+    }
+    return first;
+}
 
 static void audiosourceresample_close(struct audiosource *source) {
-    struct audiosourceresample_internaldata* idata = source->internaldata;
+    struct audiosourceresample_internaldata *idata = source->internaldata;
     if (idata) {
         // close the processed source
         if (idata->source) {
@@ -119,159 +112,133 @@ static void audiosourceresample_close(struct audiosource *source) {
         }
 
         // close resampler
-        if (idata->st) {
-            speex_resampler_destroy(idata->st);
+        if (idata->resampler) {
+            audioresampler_destroy(idata->resampler);
         }
 
         // free all structs
+        free(idata->inbuf);
+        free(idata->outbuf);
         free(idata);
     }
     free(source);
 }
 
 static void audiosourceresample_rewind(struct audiosource *source) {
-    struct audiosourceresample_internaldata* idata = source->internaldata;
+    struct audiosourceresample_internaldata *idata = source->internaldata;
     if (!idata->eof || !idata->returnerroroneof) {
         idata->source->rewind(idata->source);
-        idata->sourceeof = 0;
-        idata->eof = 0;
-        idata->returnerroroneof = 0;
-        idata->processedbytes = 0;
-        if (idata->st) {
-            speex_resampler_destroy(idata->st);
-            idata->st = NULL;
-        }
+        audiosourceresample_start(source, 0);
     }
 }
 
-
-static int audiosourceresample_read(struct audiosource *source,
-        char *buffer, unsigned int bytes) {
-    struct audiosourceresample_internaldata* idata = source->internaldata;
-    if (idata->eof) {
+// Read more source data into the input buffer.
+// Returns 1 on success, 0 if the source ended, -1 on error:
+static int audiosourceresample_fetch(struct audiosource *source) {
+    struct audiosourceresample_internaldata *idata = source->internaldata;
+
+    // leave room for the trailing silence added at the end:
+    unsigned int space = idata->inbufsize -
+        (idata->taps / 2) * idata->framesize - idata->inbytes;
+    int result = idata->source->read(idata->source,
+        (char*)idata->inbuf + idata->inbytes, space);
+    if (result < 0) {
         return -1;
     }
-
-    if (!idata->st) {
-        int error;
-#ifdef ANDROID
-        idata->st = speex_resampler_init(idata->source->channels,
-            idata->source->samplerate, source->samplerate, 1, &error);
-#else
-        idata->st = speex_resampler_init(idata->source->channels,
-            idata->source->samplerate, source->samplerate, 3, &error);
-#endif
-        if (!idata->st) {
-            idata->eof = 1;
-            idata->returnerroroneof = 1;
-            return -1;
+    if (result == 0) {
+        // drop incomplete trailing frame, if any:
+        idata->inbytes -= idata->inbytes % idata->framesize;
+
+        // append silence so the last frames can be completed:
+        unsigned int padding = (idata->taps / 2) * idata->framesize;
+        memset((char*)idata->inbuf + idata->inbytes, 0, padding);
+        idata->inbytes += padding;
+
+        unsigned long long total = audioresampler_getOutputFrames(
+            idata->resampler, idata->inframebase + idata->inframestotal);
+        idata->outframesexpected = 0;
+        if (total > idata->positionbase) {
+            idata->outframesexpected = total - idata->positionbase;
         }
+        return 0;
     }
 
-    unsigned int writtenbytes = 0;
+    // count completed frames:
+    unsigned int before = idata->inbytes / idata->framesize;
+    idata->inbytes += result;
+    idata->inframestotal += (idata->inbytes / idata->framesize) - before;
+    return 1;
+}
 
-    // If we have unreturned processed bytes left, return them
-    unsigned int returnprocessed = idata->processedbytes;
-    if (returnprocessed > bytes) {
-        returnprocessed = bytes;
-    }
-    if (returnprocessed > 0) {
-        memcpy(buffer, idata->processedbuf, returnprocessed);
-        if (returnprocessed < idata->processedbytes) {
-            // move up remaining bytes in the buffer
-            memmove(idata->processedbuf, idata->processedbuf +
-                returnprocessed, sizeof(idata->processedbuf) -
-                returnprocessed);
-        }
-        idata->processedbytes -= returnprocessed;
-        buffer += returnprocessed;
-        bytes -= returnprocessed;
-        writtenbytes += returnprocessed;
+static int audiosourceresample_read(struct audiosource *source,
+        char *buffer, unsigned int bytes) {
+    struct audiosourceresample_internaldata *idata = source->internaldata;
+    if (idata->eof) {
+        return -1;
     }
 
-    // Fetch new resampled content:
+    unsigned int writtenbytes = 0;
     while (bytes > 0) {
-        unsigned int wantbytes = idata->source->samplerate / 1000;
-        unsigned int outbytes = (source->samplerate / 1000) * 2; // doubled to avoid possible speex float bug on output limitation
-
-        // fetch new source data if required
-        if (idata->unprocessedbytes < wantbytes) {
-            int result = idata->source->read(idata->source,
-                idata->unprocessedbuf + idata->unprocessedbytes,
-                wantbytes - idata->unprocessedbytes);
-            if (result < 0) {
-                idata->returnerroroneof = 1;
-                idata->eof = 1;
-                return -1;
-            } else {
-                if (result == 0) {
-                    idata->sourceeof = 1;
-                    break;
-                }
-                idata->unprocessedbytes += result;
-                if (idata->unprocessedbytes < wantbytes) {
-                    // too short, read again:
-                    continue;
-                }
+        // return processed bytes we still have:
+        if (idata->outpos < idata->outbytes) {
+            unsigned int amount = idata->outbytes - idata->outpos;
+            if (amount > bytes) {
+                amount = bytes;
+            }
+            memcpy(buffer, (char*)idata->outbuf + idata->outpos, amount);
+            idata->outpos += amount;
+            buffer += amount;
+            bytes -= amount;
+            writtenbytes += amount;
+            continue;
+        }
+        idata->outpos = 0;
+        idata->outbytes = 0;
+
+        // limit output to what the source length amounts to:
+        unsigned int maxframes = OUTBUFFRAMES;
+        if (idata->sourceeof) {
+            unsigned long long left = idata->outframesexpected -
+                idata->outframestotal;
+            if (left == 0) {
+                break;
+            }
+            if (left < maxframes) {
+                maxframes = left;
             }
         }
 
-        // resample the data we have now:
-        unsigned int in = idata->unprocessedbytes;
-        unsigned int out = outbytes - idata->processedbytes;
-
-        // We want to have this in nice full channel samples:
-        while (in > 0 && in % (sizeof(float) * source->channels) != 0) {
-            in--;
+        // resample as much as we can:
+        unsigned int inframes = idata->inbytes / idata->framesize;
+        unsigned int consumed = 0;
+        unsigned int produced = audioresampler_process(idata->resampler,
+            idata->inbuf, inframes, &consumed, idata->outbuf, maxframes);
+        if (consumed > 0) {
+            // only the filter history and partial frames remain:
+            unsigned int consumedbytes = consumed * idata->framesize;
+            memmove(idata->inbuf, (char*)idata->inbuf + consumedbytes,
+                idata->inbytes - consumedbytes);
+            idata->inbytes -= consumedbytes;
         }
-        while (out > 0 && out % (sizeof(float) * source->channels) != 0) {
-            out--;
+        if (produced > 0) {
+            idata->outbytes = produced * idata->framesize;
+            idata->outframestotal += produced;
+            continue;
         }
-        // printf("in, out: %u, %u\n",in,out);
-        unsigned int insamples = in/(sizeof(float)*source->channels);
-        unsigned int outsamples = out/(sizeof(float)*source->channels);
-        // printf("in samples, out samples: %u, %u\n", insamples,outsamples);
-
-        memset(idata->processedbuf + idata->processedbytes, 0, out);
-        int error = speex_resampler_process_interleaved_float(idata->st,
-            (const float*)idata->unprocessedbuf, &insamples,
-            (float*)idata->processedbuf + idata->processedbytes, &outsamples);
-        if (error == 0) {
-            out = outsamples * sizeof(float) * source->channels;
-            in = insamples * sizeof(float) * source->channels;
-            // printf("result: in, out: %u(%u), %u(%u)\n", in, insamples, out, outsamples);
-            // resampling was successful:
-            idata->processedbytes += out;
-            idata->unprocessedbytes -= in;
-            if (idata->unprocessedbytes > 0) {
-                // move remaining unprocessed bytes up to beginning of buffer
-                memmove(idata->unprocessedbuf, idata->unprocessedbuf + in,
-                    sizeof(idata->unprocessedbuf) - in);
-            }
 
-            // return bytes:
-            unsigned int returnamount = bytes;
-            if (returnamount > idata->processedbytes) {
-                returnamount = idata->processedbytes;
-            }
-            if (returnamount > 0) {
-                memcpy(buffer, idata->processedbuf, returnamount);
-                if (returnamount < idata->processedbytes) {
-                    // move remaining processed bytes up to beginning
-                    memmove(idata->processedbuf, idata->processedbuf +
-                        returnamount, sizeof(idata->processedbuf) -
-                        returnamount);
-                }
-                bytes -= returnamount;
-                writtenbytes += returnamount;
-                idata->processedbytes -= returnamount;
-                buffer += returnamount;
-            }
-        } else {
+        // we need more input:
+        if (idata->sourceeof) {
+            break;
+        }
+        int result = audiosourceresample_fetch(source);
+        if (result < 0) {
             idata->returnerroroneof = 1;
             idata->eof = 1;
             return -1;
         }
+        if (result == 0) {
+            idata->sourceeof = 1;
+        }
     }
 
     if (writtenbytes > 0) {
@@ -286,45 +253,52 @@ static int audiosourceresample_read(struct audiosource *source,
 }
 
 static size_t audiosourceresample_length(struct audiosource *source) {
-    struct audiosourceresample_internaldata* idata = source->internaldata;
+    struct audiosourceresample_internaldata *idata = source->internaldata;
 
     if (idata->eof && idata->returnerroroneof) {
         return 0;
     }
 
-    return (idata->source->length(idata->source) *
-    source->samplerate) / idata->source->samplerate;
+    if (!idata->source->length) {
+        return 0;
+    }
+    return audioresampler_getOutputFrames(idata->resampler,
+        idata->source->length(idata->source));
 }
 
 static size_t audiosourceresample_position(struct audiosource *source) {
-    struct audiosourceresample_internaldata* idata = source->internaldata;
+    struct audiosourceresample_internaldata *idata = source->internaldata;
 
     if (idata->eof && idata->returnerroroneof) {
         return 0;
     }
 
-    return (idata->source->position(idata->source) *
-    source->samplerate) / idata->source->samplerate;
+    // frames handed out so far:
+    return idata->positionbase + idata->outframestotal -
+        (idata->outbytes - idata->outpos) / idata->framesize;
 }
 
 static int audiosourceresample_seek(struct audiosource *source, size_t pos) {
-    struct audiosourceresample_internaldata* idata = source->internaldata;
+    struct audiosourceresample_internaldata *idata = source->internaldata;
 
     if (!source->seekable || (idata->eof && idata->returnerroroneof)) {
         return 0;
     }
 
     // check position against valid boundaries:
-    size_t tpos = (pos * source->samplerate) / idata->source->samplerate;
-    if (tpos > idata->source->length(idata->source)) {
-        tpos = idata->source->length(idata->source);
+    size_t length = audiosourceresample_length(source);
+    if (length > 0 && pos > length) {
+        pos = length;
     }
 
-    // try seeking:
-    if (idata->source->seek(idata->source, pos)) {
-        return 1;
+    // seek the source to where the filter window starts, so the
+    // output continues sample-accurately without a filter transient:
+    if (!idata->source->seek(idata->source,
+            audiosourceresample_sourceStart(source, pos))) {
+        return 0;
     }
-    return 0;
+    audiosourceresample_start(source, pos);
+    return 1;
 }
 
 struct audiosource *audiosourceresample_create(struct audiosource *source,
@@ -336,7 +310,7 @@ struct audiosource *audiosourceresample_create(struct audiosource *source,
         }
         return NULL;
     }
-    if ((source->samplerate < 1000 || source->samplerate > 100000) &&
+    if ((source->samplerate < 1000 || source->samplerate > 100000) ||
         (targetrate < 1000 || targetrate > 100000)) {
         // possibly bogus values
         source->close(source);
@@ -372,11 +346,29 @@ struct audiosource *audiosourceresample_create(struct audiosource *source,
     struct audiosourceresample_internaldata* idata = a->internaldata;
     memset(idata, 0, sizeof(*idata));
     idata->source = source;
-    idata->targetrate = targetrate;
     a->samplerate = targetrate;
     a->channels = source->channels;
     a->format = source->format;
 
+    // set up resampler and buffers:
+    idata->resampler = audioresampler_create(source->samplerate,
+        targetrate, source->channels, audioresampler_getDefaultQuality());
+    idata->framesize = sizeof(float) * source->channels;
+    if (idata->resampler) {
+        idata->taps = audioresampler_getTaps(idata->resampler);
+        idata->inbufsize = (INBUFFRAMES + idata->taps * 2) *
+            idata->framesize;
+        idata->inbuf = malloc(idata->inbufsize);
+        idata->outbuf = malloc(OUTBUFFRAMES * idata->framesize);
+    }
+    if (!idata->inbuf || !idata->outbuf) {
+        idata->source = NULL;
+        audiosourceresample_close(a);
+        source->close(source);
+        return NULL;
+    }
+    audiosourceresample_start(a, 0);
+
     // set function pointers
     a->read = &audiosourceresample_read;
     a->close = &audiosourceresample_close;
@@ -392,5 +384,3 @@ struct audiosource *audiosourceresample_create(struct audiosource *source,
     return a;
 }
 
-#endif // ifdef USE_SPEEX_RESAMPLING
-
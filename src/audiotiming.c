@@ -0,0 +1,90 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "config.h"
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <string.h>
+
+#include "audiotiming.h"
+
+static struct audiotiming_stats stats;
+
+// end of the previous callback, audio thread only:
+static uint64_t lastendus = 0;
+
+void audiotiming_reset(unsigned int bufferframes) {
+    memset(&stats, 0, sizeof(stats));
+    __atomic_store_n(&stats.bufferframes, bufferframes, __ATOMIC_RELEASE);
+    lastendus = 0;
+}
+
+void audiotiming_callback(uint64_t startus, uint64_t endus,
+        unsigned int frames) {
+    if (frames == 0 || endus < startus) {
+        return;
+    }
+    uint64_t deadlineus = ((uint64_t)frames * 1000000) / 48000;
+    uint64_t durationus = endus - startus;
+
+    // sort into the histogram:
+    unsigned int bucket = (unsigned int)((durationus * 10) / deadlineus);
+    if (bucket >= AUDIOTIMING_BUCKETS) {
+        bucket = AUDIOTIMING_BUCKETS - 1;
+    }
+    __atomic_add_fetch(&stats.histogram[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats.callbacks, 1, __ATOMIC_RELAXED);
+    if (durationus > __atomic_load_n(&stats.maxdurationus,
+            __ATOMIC_RELAXED)) {
+        __atomic_store_n(&stats.maxdurationus, (unsigned int)durationus,
+            __ATOMIC_RELAXED);
+    }
+
+    // The device underran if we took longer than the buffer lasts, or
+    // if we weren't called for more than two buffers (the backend
+    // usually double buffers, so that is when it runs dry):
+    if (durationus > deadlineus || (lastendus > 0 &&
+            startus > lastendus + deadlineus * 2)) {
+        __atomic_add_fetch(&stats.xruns, 1, __ATOMIC_RELAXED);
+    }
+    lastendus = endus;
+}
+
+void audiotiming_getStats(struct audiotiming_stats* s) {
+    s->bufferframes = __atomic_load_n(&stats.bufferframes,
+        __ATOMIC_ACQUIRE);
+    s->callbacks = __atomic_load_n(&stats.callbacks, __ATOMIC_RELAXED);
+    s->xruns = __atomic_load_n(&stats.xruns, __ATOMIC_RELAXED);
+    s->maxdurationus = __atomic_load_n(&stats.maxdurationus,
+        __ATOMIC_RELAXED);
+    int i = 0;
+    while (i < AUDIOTIMING_BUCKETS) {
+        s->histogram[i] = __atomic_load_n(&stats.histogram[i],
+            __ATOMIC_RELAXED);
+        i++;
+    }
+}
+
+#endif  // USE_AUDIO
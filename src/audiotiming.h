@@ -0,0 +1,59 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIOTIMING_H_
+#define BLITWIZARD_AUDIOTIMING_H_
+
+#include <stdint.h>
+
+// Timing telemetry of the audio output. The audio backend reports each
+// callback from the audio thread, and the statistics can be read from
+// the main thread at any time. Nothing of this locks a mutex.
+
+// Callback durations are sorted into buckets of 10% of the time one
+// buffer lasts (the deadline). The last bucket is for everything
+// above 100%, which means the device ran out of audio:
+#define AUDIOTIMING_BUCKETS 11
+
+struct audiotiming_stats {
+    unsigned int bufferframes;  // current device buffer size in frames
+    uint64_t callbacks;  // total amount of callbacks
+    uint64_t xruns;  // callbacks which were late (device underruns)
+    unsigned int maxdurationus;  // longest callback in microseconds
+    uint64_t histogram[AUDIOTIMING_BUCKETS];
+};
+
+// Start over with the given device buffer size. Call this while the
+// audio device isn't running:
+void audiotiming_reset(unsigned int bufferframes);
+
+// Report a callback which started and ended at the given times (from
+// time_getMicroseconds()) and delivered the given amount of frames.
+// Audio thread only:
+void audiotiming_callback(uint64_t startus, uint64_t endus,
+    unsigned int frames);
+
+// Get the current statistics:
+void audiotiming_getStats(struct audiotiming_stats* stats);
+
+#endif  // BLITWIZARD_AUDIOTIMING_H_
@@ -0,0 +1,231 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+/* BENCHMARK
+ * This benchmark plays the given sound files on a configurable amount
+ * of voices and measures how much CPU time the audio mixer needs per
+ * block, including decoding and resampling. It runs without any audio
+ * device, as fast as possible.
+ *
+ * Usage: bench-audiomixer [options] file1.ogg [file2.flac ...]
+ *   -voices N        amount of simultaneously playing voices (default 8)
+ *   -seconds S       amount of audio to render (default 60)
+ *   -block N         frames per mixer block (default 1024)
+ *   -quality Q       resampling quality: low, medium or high
+ *   -s16             benchmark 16bit output (default: 32bit float)
+ *   -streamed        always stream from disk, don't use the PCM cache
+ *   -buses N         spread the voices over N buses at reduced volume
+ *                    (default 0: one bus at full volume, mixed directly)
+ *
+ * The voices are distributed over the given files, so to compare
+ * codecs or sample rates, run it with files of the respective kind.
+ */
+
+#include "config.h"
+#include "os.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "audiomixer.h"
+#include "audiopcmcache.h"
+#include "audioresampler.h"
+#include "threading.h"
+#include "timefuncs.h"
+
+static int compareTimes(const void *a, const void *b) {
+    uint64_t t1 = *(const uint64_t*)a;
+    uint64_t t2 = *(const uint64_t*)b;
+    if (t1 < t2) {
+        return -1;
+    }
+    return (t1 > t2);
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: bench-audiomixer [-voices N] [-seconds S] "
+        "[-block N] [-quality low|medium|high] [-s16] [-streamed] "
+        "[-buses N] file [file ...]\n");
+}
+
+int main(int argc, char **argv) {
+    unsigned int voices = 8;
+    double seconds = 60;
+    unsigned int blockframes = 1024;
+    int streamed = 0;
+    int buscount = 0;
+    const char *files[64];
+    int filecount = 0;
+
+    // parse arguments:
+    int i = 1;
+    while (i < argc) {
+        if (strcmp(argv[i], "-voices") == 0 && i + 1 < argc) {
+            voices = atoi(argv[i + 1]);
+            i += 2;
+            continue;
+        }
+        if (strcmp(argv[i], "-seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[i + 1]);
+            i += 2;
+            continue;
+        }
+        if (strcmp(argv[i], "-block") == 0 && i + 1 < argc) {
+            blockframes = atoi(argv[i + 1]);
+            i += 2;
+            continue;
+        }
+        if (strcmp(argv[i], "-quality") == 0 && i + 1 < argc) {
+            if (strcmp(argv[i + 1], "low") == 0) {
+                audioresampler_setDefaultQuality(
+                    AUDIORESAMPLER_QUALITY_LOW);
+            } else if (strcmp(argv[i + 1], "medium") == 0) {
+                audioresampler_setDefaultQuality(
+                    AUDIORESAMPLER_QUALITY_MEDIUM);
+            } else {
+                audioresampler_setDefaultQuality(
+                    AUDIORESAMPLER_QUALITY_HIGH);
+            }
+            i += 2;
+            continue;
+        }
+        if (strcmp(argv[i], "-s16") == 0) {
+            s16mixmode = 1;
+            i++;
+            continue;
+        }
+        if (strcmp(argv[i], "-streamed") == 0) {
+            streamed = 1;
+            i++;
+            continue;
+        }
+        if (strcmp(argv[i], "-buses") == 0 && i + 1 < argc) {
+            buscount = atoi(argv[i + 1]);
+            i += 2;
+            continue;
+        }
+        if (argv[i][0] == '-' ||
+                filecount >= (int)(sizeof(files) / sizeof(files[0]))) {
+            usage();
+            return 1;
+        }
+        files[filecount] = argv[i];
+        filecount++;
+        i++;
+    }
+    if (filecount == 0 || voices == 0 || blockframes == 0 ||
+            seconds <= 0) {
+        usage();
+        return 1;
+    }
+
+    thread_markAsMainThread();
+    if (streamed) {
+        audiopcmcache_setLimits(0, 0);
+    }
+
+    // decode in the mixer so we measure the complete audio path:
+    audiomixer_SetSynchronousDecoding(1);
+    audiomixer_Init();
+
+    // set up buses which need processing:
+    int buses[AUDIOMIXER_MAXBUSES];
+    int busesadded = 0;
+    while (busesadded < buscount && busesadded < AUDIOMIXER_MAXBUSES) {
+        char name[32];
+        snprintf(name, sizeof(name), "bench%d", busesadded);
+        int bus = audiomixer_GetBus(name, 1);
+        if (bus < 0) {
+            break;
+        }
+        audiomixer_SetBusVolume(bus, 0.8, 0);
+        buses[busesadded] = bus;
+        busesadded++;
+    }
+    buscount = busesadded;
+
+    // start all voices:
+    unsigned int v = 0;
+    while (v < voices) {
+        const char *path = files[v % filecount];
+        int id = audiomixer_PlaySoundFromDisk(path, 10, 0.5, 0, 1, 0,
+            1, 0, 0, (buscount > 0 ? buses[v % buscount] :
+            AUDIOMIXER_BUS_SFX));
+        if (id < 0) {
+            fprintf(stderr, "failed to play \"%s\"\n", path);
+            return 1;
+        }
+        v++;
+    }
+    unsigned int playing = audiomixer_ChannelCount();
+    if (playing == 0) {
+        fprintf(stderr, "no voices could be started\n");
+        return 1;
+    }
+    if (playing < voices) {
+        fprintf(stderr, "warning: the mixer only plays %u voices\n",
+            playing);
+    }
+
+    // mix all blocks and measure each of them:
+    unsigned int framesize = 2 * (s16mixmode ? sizeof(int16_t) :
+        sizeof(float));
+    char *buf = malloc(blockframes * framesize);
+    size_t blocks = (size_t)(seconds * 48000 / blockframes) + 1;
+    uint64_t *times = malloc(sizeof(*times) * blocks);
+    if (!buf || !times) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    uint64_t total = 0;
+    size_t b = 0;
+    while (b < blocks) {
+        uint64_t start = time_getMicroseconds();
+        audiomixer_GetBuffer(buf, blockframes * framesize);
+        times[b] = time_getMicroseconds() - start;
+        total += times[b];
+        b++;
+    }
+    if (audiomixer_ChannelCount() < playing) {
+        fprintf(stderr, "warning: some voices stopped playing early\n");
+    }
+
+    // report:
+    qsort(times, blocks, sizeof(*times), &compareTimes);
+    double blockus = (double)blockframes * 1000000.0 / 48000.0;
+    printf("voices: %u, buses: %d, block: %u frames (%.0f us), "
+        "output: %s, blocks: %u\n", playing, buscount, blockframes,
+        blockus, (s16mixmode ? "s16" : "float32"), (unsigned int)blocks);
+    printf("per block (us): mean %.1f, median %u, p99 %u, max %u\n",
+        (double)total / blocks, (unsigned int)times[blocks / 2],
+        (unsigned int)times[(blocks * 99) / 100],
+        (unsigned int)times[blocks - 1]);
+    printf("CPU load (of real time): %.2f%%, per voice: %.3f%%\n",
+        100.0 * total / (blocks * blockus),
+        100.0 * total / (blocks * blockus) / playing);
+    free(buf);
+    free(times);
+    return 0;
+}
+
@@ -0,0 +1,243 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+/* BENCHMARK
+ * This benchmark drops a pile of boxes onto the ground and measures
+ * how long taking and restoring a 2d physics world snapshot takes
+ * (as done by games rolling back and re-simulating for networking).
+ * It also checks how far re-simulating after a restore deviates from
+ * the original simulation (Box2D may order recreated contacts
+ * differently, so this isn't always bit-exact).
+ *
+ * Usage: bench-physicssnapshot [options]
+ *   -bodies N        amount of boxes (default 2000)
+ *   -rounds N        amount of snapshot/restore rounds (default 200)
+ *   -steps N         steps re-simulated after each restore (default 8)
+ */
+
+#include "config.h"
+#include "os.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include "physics.h"
+#include "timefuncs.h"
+
+static int compareTimes(const void *a, const void *b) {
+    uint64_t t1 = *(const uint64_t*)a;
+    uint64_t t2 = *(const uint64_t*)b;
+    if (t1 < t2) {
+        return -1;
+    }
+    return (t1 > t2);
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: bench-physicssnapshot [-bodies N] "
+        "[-rounds N] [-steps N]\n");
+}
+
+static void step(struct physicsworld *world, int steps) {
+    int i = 0;
+    while (i < steps) {
+        physics_step(world);
+        i++;
+    }
+}
+
+// Store the position of all boxes in positions (two per box):
+static void getPositions(struct physicsobject **boxes, int count,
+        double *positions) {
+    int i = 0;
+    while (i < count) {
+        physics_get2dPosition(boxes[i], &positions[i * 2],
+            &positions[i * 2 + 1]);
+        i++;
+    }
+}
+
+int main(int argc, char **argv) {
+    int bodies = 2000;
+    int rounds = 200;
+    int steps = 8;
+
+    // parse arguments:
+    int i = 1;
+    while (i < argc) {
+        if (strcmp(argv[i], "-bodies") == 0 && i + 1 < argc) {
+            bodies = atoi(argv[i + 1]);
+            i += 2;
+            continue;
+        }
+        if (strcmp(argv[i], "-rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[i + 1]);
+            i += 2;
+            continue;
+        }
+        if (strcmp(argv[i], "-steps") == 0 && i + 1 < argc) {
+            steps = atoi(argv[i + 1]);
+            i += 2;
+            continue;
+        }
+        usage();
+        return 1;
+    }
+    if (bodies <= 0 || rounds <= 0 || steps < 0) {
+        usage();
+        return 1;
+    }
+
+    struct physicsworld *world = physics_createWorld(0);
+    if (!world) {
+        fprintf(stderr, "failed to create physics world\n");
+        return 1;
+    }
+    physics_set2dWorldGravity(world, 0, 10);
+
+    // ground:
+    int columns = (int)sqrt(bodies) + 1;
+    struct physicsobjectshape *shape = physics_createEmptyShapes(1);
+    if (!shape) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    physics_set2dShapeRectangle(shape, columns * 2 + 10, 1);
+    if (!physics_createObject(world, NULL, 0, shape, 1)) {
+        fprintf(stderr, "failed to create ground\n");
+        return 1;
+    }
+    physics_destroyShapes(shape, 1);
+
+    // pile of boxes above it, slightly shifted so they tumble:
+    struct physicsobject **boxes = malloc(sizeof(*boxes) * bodies);
+    double *positions = malloc(sizeof(*positions) * bodies * 2);
+    double *positions2 = malloc(sizeof(*positions2) * bodies * 2);
+    uint64_t *snapshottimes = malloc(sizeof(*snapshottimes) * rounds);
+    uint64_t *restoretimes = malloc(sizeof(*restoretimes) * rounds);
+    shape = physics_createEmptyShapes(1);
+    if (!boxes || !positions || !positions2 || !snapshottimes ||
+            !restoretimes || !shape) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    physics_set2dShapeRectangle(shape, 1, 1);
+    i = 0;
+    while (i < bodies) {
+        boxes[i] = physics_createObject(world, NULL, 1, shape, 1);
+        if (!boxes[i]) {
+            fprintf(stderr, "failed to create box\n");
+            return 1;
+        }
+        physics_setMass(boxes[i], 1);
+        physics_warp2d(boxes[i],
+            (i % columns) * 1.5 - columns * 0.75 + (i / columns) * 0.1,
+            -1.5 - (i / columns) * 1.2, 0);
+        i++;
+    }
+    physics_destroyShapes(shape, 1);
+
+    // let them fall and pile up, so there are plenty of contacts:
+    step(world, 120);
+
+    size_t size = physics_snapshot2dWorld(world, NULL, 0);
+    char *snapshot = malloc(size);
+    if (!snapshot) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    // snapshot, simulate, restore and re-simulate, then compare:
+    int mismatches = 0;
+    double maxdeviation = 0;
+    int r = 0;
+    while (r < rounds) {
+        uint64_t start = time_getMicroseconds();
+        physics_snapshot2dWorld(world, snapshot, size);
+        snapshottimes[r] = time_getMicroseconds() - start;
+
+        step(world, steps);
+        getPositions(boxes, bodies, positions);
+
+        start = time_getMicroseconds();
+        if (!physics_restore2dWorld(world, snapshot, size)) {
+            fprintf(stderr, "restoring the snapshot failed\n");
+            return 1;
+        }
+        restoretimes[r] = time_getMicroseconds() - start;
+
+        step(world, steps);
+        getPositions(boxes, bodies, positions2);
+        if (memcmp(positions, positions2,
+                sizeof(*positions) * bodies * 2) != 0) {
+            mismatches++;
+            i = 0;
+            while (i < bodies * 2) {
+                double deviation = fabs(positions[i] - positions2[i]);
+                if (deviation > maxdeviation) {
+                    maxdeviation = deviation;
+                }
+                i++;
+            }
+        }
+
+        // the world moved on, so the snapshot needs to grow along:
+        size_t newsize = physics_snapshot2dWorld(world, NULL, 0);
+        if (newsize > size) {
+            char *newsnapshot = realloc(snapshot, newsize);
+            if (!newsnapshot) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+            snapshot = newsnapshot;
+        }
+        size = newsize;
+        r++;
+    }
+
+    // report:
+    qsort(snapshottimes, rounds, sizeof(*snapshottimes), &compareTimes);
+    qsort(restoretimes, rounds, sizeof(*restoretimes), &compareTimes);
+    printf("bodies: %d, rounds: %d, steps re-simulated: %d, "
+        "snapshot size: %u bytes\n", bodies, rounds, steps,
+        (unsigned int)size);
+    printf("snapshot (us): median %u, p99 %u, max %u\n",
+        (unsigned int)snapshottimes[rounds / 2],
+        (unsigned int)snapshottimes[(rounds * 99) / 100],
+        (unsigned int)snapshottimes[rounds - 1]);
+    printf("restore (us): median %u, p99 %u, max %u\n",
+        (unsigned int)restoretimes[rounds / 2],
+        (unsigned int)restoretimes[(rounds * 99) / 100],
+        (unsigned int)restoretimes[rounds - 1]);
+    printf("re-simulation mismatches: %d of %d, max deviation: %g\n",
+        mismatches, rounds, maxdeviation);
+    free(snapshot);
+    free(boxes);
+    free(positions);
+    free(positions2);
+    free(snapshottimes);
+    free(restoretimes);
+    return 0;
+}
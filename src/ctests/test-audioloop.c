@@ -0,0 +1,164 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+/* UNIT TEST
+ * This unit test loops a generated stream with various loop points
+ * through the loop audio source, for both seekable and non-seekable
+ * sources, and verifies each loop restart continues without a gap.
+ */
+
+#include "config.h"
+#include "os.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include "audiosource.h"
+#include "audiosourceloop.h"
+
+#ifdef NDEBUG
+#error "this makes no sense without asserts"
+#endif
+
+// a stereo float source where each frame holds its own frame number:
+struct rampsource {
+    size_t pos;  // in bytes
+    size_t frames;
+};
+
+static int ramp_read(struct audiosource *source, char *buffer,
+        unsigned int bytes) {
+    struct rampsource *r = source->internaldata;
+    unsigned int i = 0;
+    while (i < bytes && r->pos < r->frames * 8) {
+        float frame[2];
+        frame[0] = (float)(r->pos / 8);
+        frame[1] = -frame[0];
+        buffer[i] = ((char*)frame)[r->pos % 8];
+        r->pos++;
+        i++;
+    }
+    return i;
+}
+
+static void ramp_rewind(struct audiosource *source) {
+    struct rampsource *r = source->internaldata;
+    r->pos = 0;
+}
+
+static int ramp_seek(struct audiosource *source, size_t pos) {
+    struct rampsource *r = source->internaldata;
+    r->pos = pos * 8;
+    return 1;
+}
+
+static size_t ramp_length(struct audiosource *source) {
+    struct rampsource *r = source->internaldata;
+    return r->frames;
+}
+
+static void ramp_close(struct audiosource *source) {
+    free(source->internaldata);
+    free(source);
+}
+
+static struct audiosource *ramp_create(size_t frames, int seekable) {
+    struct audiosource *a = malloc(sizeof(*a));
+    assert(a);
+    memset(a, 0, sizeof(*a));
+    struct rampsource *r = malloc(sizeof(*r));
+    assert(r);
+    r->pos = 0;
+    r->frames = frames;
+    a->internaldata = r;
+    a->read = &ramp_read;
+    a->rewind = &ramp_rewind;
+    a->seek = &ramp_seek;
+    a->length = &ramp_length;
+    a->close = &ramp_close;
+    a->seekable = seekable;
+    a->channels = 2;
+    a->samplerate = 48000;
+    a->format = AUDIOSOURCEFORMAT_F32LE;
+    return a;
+}
+
+static void testLoop(size_t frames, int seekable, size_t loopstart,
+        size_t loopend) {
+    fprintf(stderr, "looping %d frames (seekable: %d) from %d to %d\n",
+        (int)frames, seekable, (int)loopstart, (int)loopend);
+    struct audiosource *l = audiosourceloop_create(
+        ramp_create(frames, seekable));
+    assert(l);
+    audiosourceloop_setLooping(l, 1);
+    audiosourceloop_setLoopPoints(l, loopstart, loopend);
+    size_t end = frames;
+    if (loopend > 0) {
+        end = loopend;
+    }
+
+    // read a few loop iterations in odd chunk sizes:
+    srand(1);
+    char buf[20000];
+    unsigned int have = 0;  // bytes of an incomplete frame kept
+    size_t expected = 0;
+    size_t checked = 0;
+    while (checked < end * 3 + 5000) {
+        unsigned int amount = (rand() % 4000 + 1) * 4 + (rand() % 2) * 3;
+        int result = l->read(l, buf + have, amount);
+        assert(result > 0);
+        have += result;
+        unsigned int i = 0;
+        while (i + 8 <= have) {
+            float frame[2];
+            memcpy(frame, buf + i, sizeof(frame));
+            assert(frame[0] == (float)expected);
+            assert(frame[1] == -(float)expected);
+            expected++;
+            if (expected == end) {
+                expected = loopstart;
+            }
+            checked++;
+            i += 8;
+        }
+        memmove(buf, buf + i, have - i);
+        have -= i;
+    }
+    l->close(l);
+}
+
+int main(int argc, char **argv) {
+    int seekable = 0;
+    while (seekable <= 1) {
+        testLoop(1000, seekable, 0, 0);
+        testLoop(100000, seekable, 0, 0);
+        testLoop(100000, seekable, 3000, 0);
+        testLoop(100000, seekable, 3000, 90000);
+        testLoop(100000, seekable, 300, 2000);
+        testLoop(50000, seekable, 49000, 0);
+        seekable++;
+    }
+    fprintf(stderr, "test complete! have fun using blitwizard\n");
+    return 0;
+}
@@ -0,0 +1,179 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+/* UNIT TEST
+ * This unit test resamples sine waves from the common sample rates
+ * to 48kHz with blitwizard's resampler and checks that the result
+ * has the expected length and matches the ideal 48kHz sine wave.
+ */
+
+#include "config.h"
+#include "os.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <math.h>
+#include "audiosource.h"
+#include "audiosourceresample.h"
+#include "audioresampler.h"
+
+#ifdef NDEBUG
+#error "this makes no sense without asserts"
+#endif
+
+#define TESTFREQ 1000.0
+#define TESTSECONDS 2
+
+// a stereo sine wave test source (right channel is inverted):
+struct sinesource {
+    unsigned int frames;
+    unsigned int pos;
+};
+
+static int sinesource_read(struct audiosource *source, char *buffer,
+        unsigned int bytes) {
+    struct sinesource *s = source->internaldata;
+    // hand out odd amounts of bytes to test partial frames:
+    if (bytes > 1001) {
+        bytes = 1001;
+    }
+    unsigned int written = 0;
+    while (written < bytes && s->pos < s->frames * 8) {
+        unsigned int frame = s->pos / 8;
+        float v = sin(2 * M_PI * TESTFREQ * frame / source->samplerate);
+        if ((s->pos / 4) % 2 == 1) {
+            v = -v;
+        }
+        buffer[written] = ((char*)&v)[s->pos % 4];
+        written++;
+        s->pos++;
+    }
+    return written;
+}
+
+static void sinesource_rewind(struct audiosource *source) {
+    ((struct sinesource*)source->internaldata)->pos = 0;
+}
+
+static int sinesource_seek(struct audiosource *source, size_t pos) {
+    ((struct sinesource*)source->internaldata)->pos = pos * 8;
+    return 1;
+}
+
+static size_t sinesource_length(struct audiosource *source) {
+    return ((struct sinesource*)source->internaldata)->frames;
+}
+
+static void sinesource_close(struct audiosource *source) {
+    free(source->internaldata);
+    free(source);
+}
+
+static struct audiosource *sinesource_create(unsigned int samplerate) {
+    struct audiosource *a = malloc(sizeof(*a));
+    assert(a);
+    memset(a, 0, sizeof(*a));
+    struct sinesource *s = malloc(sizeof(*s));
+    assert(s);
+    s->frames = samplerate * TESTSECONDS;
+    s->pos = 0;
+    a->internaldata = s;
+    a->read = &sinesource_read;
+    a->rewind = &sinesource_rewind;
+    a->seek = &sinesource_seek;
+    a->length = &sinesource_length;
+    a->close = &sinesource_close;
+    a->samplerate = samplerate;
+    a->channels = 2;
+    a->format = AUDIOSOURCEFORMAT_F32LE;
+    a->seekable = 1;
+    return a;
+}
+
+static void testrate(unsigned int samplerate, int quality,
+        double maxerror) {
+    audioresampler_setDefaultQuality(quality);
+    struct audiosource *a = audiosourceresample_create(
+        sinesource_create(samplerate), 48000);
+    assert(a);
+    assert(a->samplerate == 48000);
+    size_t expected = (samplerate * TESTSECONDS *
+        (unsigned long long)48000 + samplerate - 1) / samplerate;
+    assert(a->length(a) == expected);
+
+    // resample everything, using odd read sizes:
+    float *out = malloc(expected * 8 + 4096);
+    assert(out);
+    size_t bytes = 0;
+    while (1) {
+        int result = a->read(a, (char*)out + bytes, 777);
+        assert(result >= 0);
+        if (result == 0) {
+            break;
+        }
+        bytes += result;
+    }
+    assert(bytes == expected * 8);
+
+    // compare to the ideal sine wave (ignoring the fade-in/out of
+    // the filter at both ends):
+    double error = 0;
+    size_t i = 100;
+    while (i < expected - 100) {
+        double v = sin(2 * M_PI * TESTFREQ * i / 48000.0);
+        double e = fabs(out[i * 2] - v);
+        if (e > error) {
+            error = e;
+        }
+        assert(fabs(out[i * 2] + out[i * 2 + 1]) < 1e-5);
+        i++;
+    }
+    fprintf(stderr, "%uHz to 48000Hz, quality %d: max error %f\n",
+        samplerate, quality, error);
+    assert(error < maxerror);
+
+    // seeking needs to continue exactly as if we had read up to there:
+    size_t seekpos = expected / 3;
+    assert(a->seek(a, seekpos));
+    assert(a->position(a) == seekpos);
+    float check[1000 * 2];
+    assert(a->read(a, (char*)check, sizeof(check)) == sizeof(check));
+    assert(memcmp(check, out + seekpos * 2, sizeof(check)) == 0);
+    free(out);
+    a->close(a);
+}
+
+int main(int argc, char **argv) {
+    testrate(44100, AUDIORESAMPLER_QUALITY_HIGH, 0.0005);
+    testrate(22050, AUDIORESAMPLER_QUALITY_HIGH, 0.0005);
+    testrate(32000, AUDIORESAMPLER_QUALITY_HIGH, 0.0005);
+    testrate(44100, AUDIORESAMPLER_QUALITY_MEDIUM, 0.002);
+    testrate(44100, AUDIORESAMPLER_QUALITY_LOW, 0.01);
+    testrate(96000, AUDIORESAMPLER_QUALITY_HIGH, 0.0005);
+    testrate(44101, AUDIORESAMPLER_QUALITY_HIGH, 0.0001);
+    fprintf(stderr, "test complete! have fun using blitwizard\n");
+    return 0;
+}
+
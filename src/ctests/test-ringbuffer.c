@@ -0,0 +1,119 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+/* UNIT TEST
+ * This unit test pushes a long stream of bytes through blitwizard's
+ * lock-free ring buffer from a producer thread to a consumer thread
+ * and verifies that all bytes arrive complete and in order.
+ */
+
+#include "config.h"
+#include "os.h"
+
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include "ringbuffer.h"
+#include "threading.h"
+#include "timefuncs.h"
+
+#ifdef NDEBUG
+#error "this makes no sense without asserts"
+#endif
+
+#define TESTBYTES (1024 * 1024 * 4)
+
+static volatile int producerDone = 0;
+
+static void producer(void *userdata) {
+    struct ringbuffer *r = userdata;
+    unsigned char buf[333];
+    size_t written = 0;
+    while (written < TESTBYTES) {
+        // fill in a running byte pattern:
+        size_t amount = sizeof(buf);
+        if (amount > TESTBYTES - written) {
+            amount = TESTBYTES - written;
+        }
+        size_t i = 0;
+        while (i < amount) {
+            buf[i] = (unsigned char)((written + i) % 251);
+            i++;
+        }
+
+        // push it into the ring buffer:
+        size_t pushed = 0;
+        while (pushed < amount) {
+            pushed += ringbuffer_write(r, buf + pushed, amount - pushed);
+        }
+        written += amount;
+    }
+    producerDone = 1;
+}
+
+int main(int argc, char **argv) {
+    // basic single threaded checks:
+    struct ringbuffer *r = ringbuffer_create(1000);
+    assert(r);
+    assert(ringbuffer_size(r) == 1024);
+    assert(ringbuffer_readable(r) == 0);
+    assert(ringbuffer_writable(r) == 1024);
+    char data[2048];
+    memset(data, 'a', sizeof(data));
+    assert(ringbuffer_write(r, data, sizeof(data)) == 1024);
+    assert(ringbuffer_writable(r) == 0);
+    assert(ringbuffer_skip(r, 1000) == 1000);
+    assert(ringbuffer_readable(r) == 24);
+    assert(ringbuffer_write(r, data, 100) == 100);  // wraps around
+    assert(ringbuffer_read(r, data, sizeof(data)) == 124);
+    assert(ringbuffer_readable(r) == 0);
+    ringbuffer_destroy(r);
+
+    // stream lots of data through a small ring buffer with two threads:
+    fprintf(stderr, "streaming %d bytes through ring buffer\n",
+        (int)TESTBYTES);
+    r = ringbuffer_create(4096);
+    assert(r);
+    threadinfo *t = thread_createInfo();
+    thread_spawn(t, &producer, r);
+    size_t received = 0;
+    unsigned char buf[500];
+    while (received < TESTBYTES) {
+        size_t amount = ringbuffer_read(r, buf, sizeof(buf));
+        size_t i = 0;
+        while (i < amount) {
+            assert(buf[i] == (unsigned char)((received + i) % 251));
+            i++;
+        }
+        received += amount;
+    }
+    assert(ringbuffer_readable(r) == 0);
+    while (!producerDone) {
+        time_sleep(10);
+    }
+    thread_freeInfo(t);
+    ringbuffer_destroy(r);
+    fprintf(stderr, "test complete! have fun using blitwizard\n");
+    return 0;
+}
+
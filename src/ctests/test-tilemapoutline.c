@@ -0,0 +1,134 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+/* UNIT TEST
+ * This unit test traces the outline of some tile layouts as done for
+ * tile map collision, and checks the resulting edge chains.
+ */
+
+#include "config.h"
+#include "os.h"
+
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include "physicstilemap.h"
+
+#ifdef NDEBUG
+#error "this makes no sense without asserts"
+#endif
+
+#ifdef USE_PHYSICS2D
+
+#define MAXCHAINS 8
+
+static int chaincount;
+static int chainpoints[MAXCHAINS];
+static int chainloop[MAXCHAINS];
+static int chainfirstx[MAXCHAINS];
+static int chainfirsty[MAXCHAINS];
+static int chainghosts[MAXCHAINS][4];
+
+static void collectChain(__attribute__((unused)) void* userdata,
+        const int* points, int pointcount, int loop, const int* ghosts) {
+    assert(chaincount < MAXCHAINS);
+    assert((ghosts == NULL) == (loop != 0));
+    chainpoints[chaincount] = pointcount;
+    chainloop[chaincount] = loop;
+    chainfirstx[chaincount] = points[0];
+    chainfirsty[chaincount] = points[1];
+    if (ghosts) {
+        memcpy(chainghosts[chaincount], ghosts, sizeof(int) * 4);
+    }
+    chaincount++;
+}
+
+static void trace(const char* map, int columns, int rows,
+        int areax, int areay, int areawidth, int areaheight) {
+    unsigned char solid[64];
+    assert(columns * rows <= (int)sizeof(solid));
+    int i = 0;
+    while (i < columns * rows) {
+        solid[i] = (map[i] == '#');
+        i++;
+    }
+    chaincount = 0;
+    assert(physicstilemap_traceOutline(solid, columns, rows,
+        areax, areay, areawidth, areaheight, &collectChain, NULL));
+}
+
+int main(int argc, char** argv) {
+    // a rectangle of tiles is a single loop with four corners:
+    trace("....."
+          ".###."
+          ".###."
+          ".....", 5, 4, 0, 0, 5, 4);
+    assert(chaincount == 1);
+    assert(chainloop[0] && chainpoints[0] == 4);
+    assert(chainfirstx[0] == 1 || chainfirstx[0] == 4);  // starts at corner
+    assert(chainfirsty[0] == 1 || chainfirsty[0] == 3);
+
+    // an L shape has six corners:
+    trace("#.."
+          "#.."
+          "###", 3, 3, 0, 0, 3, 3);
+    assert(chaincount == 1);
+    assert(chainloop[0] && chainpoints[0] == 6);
+
+    // diagonal tiles only touching at a corner are separate loops:
+    trace("#."
+          ".#", 2, 2, 0, 0, 2, 2);
+    assert(chaincount == 2);
+    assert(chainloop[0] && chainpoints[0] == 4);
+    assert(chainloop[1] && chainpoints[1] == 4);
+
+    // a hole gives an inner and an outer loop:
+    trace("###"
+          "#.#"
+          "###", 3, 3, 0, 0, 3, 3);
+    assert(chaincount == 2);
+    assert(chainloop[0] && chainpoints[0] == 4);
+    assert(chainloop[1] && chainpoints[1] == 4);
+
+    // if the solid area continues outside of the traced area, the
+    // outline is an open chain ending at the area's border:
+    trace("####", 4, 1, 0, 0, 2, 1);
+    assert(chaincount == 1);
+    assert(!chainloop[0] && chainpoints[0] == 4);
+    assert(chainfirstx[0] == 2 && chainfirsty[0] == 1);
+    // it continues with the outline outside of the area on both ends:
+    assert(chainghosts[0][0] == 3 && chainghosts[0][1] == 1);
+    assert(chainghosts[0][2] == 3 && chainghosts[0][3] == 0);
+
+    fprintf(stderr, "test complete! have fun using blitwizard\n");
+    return 0;
+}
+
+#else
+
+int main(int argc, char** argv) {
+    return 0;
+}
+
+#endif  // USE_PHYSICS2D
+
@@ -44,11 +44,6 @@
 
 static mutex* m = NULL;
 
-//#define SMOOTH_SPRITES
-#ifdef SMOOTH_SPRITES
-const float smoothmaxdist = 1.0f;
-#endif
-
 // global sprite counter:
 static int spritesInListCount = 0;
 
@@ -510,10 +505,6 @@ void graphics2dsprites_destroy(struct graphics2dsprite *sprite) {
 void graphics2dsprites_move(struct graphics2dsprite *sprite,
         double x, double y, double angle) {
     mutex_lock(m);
-#ifdef SMOOTH_SPRITES
-    sprite->prevx = x;
-    sprite->prevy = y;
-#endif
     sprite->x = x;
     sprite->y = y;
     if (sprite->pinnedToCamera < 0) {
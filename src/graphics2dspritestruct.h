@@ -59,9 +59,6 @@ struct graphics2dsprite {
 
     // position, size info:
     double x, y, width, height, angle;
-#ifdef SMOOTH_SPRITES
-    double prevx, prevy;
-#endif
     // width, height = 0 means height should match texture geometry
 
     // texture clipping window:
@@ -48,6 +48,7 @@
 #include "luafuncs_object.h"
 #include "graphics2dsprites.h"
 #include "audiomixer.h"
+#include "audiotiming.h"
 
 /// Get GPU memory used for all textures loaded by blitwizard in bytes.
 // @function gpuMemoryUse
@@ -222,6 +223,68 @@ int luafuncs_debug_getAudioChannelCount(lua_State* l) {
     return 1;
 }
 
+/// Get timing information about the audio output, useful to check
+// how close the audio device is to stuttering (e.g. with the
+// -low-latency-audio option).
+//
+// The returned table has the following entries:
+//
+// <ul>
+// <li><i>bufferSize</i>: the current output buffer size in frames</li>
+// <li><i>latency</i>: the output latency of that buffer in
+// milliseconds</li>
+// <li><i>callbacks</i>: how often the device requested audio</li>
+// <li><i>xruns</i>: how often the device was late or a request took
+// longer than the buffer lasts (the device most likely stuttered)</li>
+// <li><i>decodeUnderruns</i>: how often sound decoding didn't keep up
+// with playback</li>
+// <li><i>maxCallbackTime</i>: the longest a request took, in
+// milliseconds</li>
+// <li><i>callbackTimes</i>: a list of 11 counts: how many requests
+// took 0-10%, 10-20%, ... 90-100% and more than 100% of the time
+// available</li>
+// </ul>
+//
+// The statistics start over when the buffer size changes.
+// @function getAudioTiming
+// @treturn table audio timing information
+int luafuncs_debug_getAudioTiming(lua_State* l) {
+    lua_newtable(l);
+#ifdef USE_AUDIO
+    struct audiotiming_stats stats;
+    audiotiming_getStats(&stats);
+    lua_pushstring(l, "bufferSize");
+    lua_pushnumber(l, stats.bufferframes);
+    lua_settable(l, -3);
+    lua_pushstring(l, "latency");
+    lua_pushnumber(l, (double)stats.bufferframes / 48.0);
+    lua_settable(l, -3);
+    lua_pushstring(l, "callbacks");
+    lua_pushnumber(l, stats.callbacks);
+    lua_settable(l, -3);
+    lua_pushstring(l, "xruns");
+    lua_pushnumber(l, stats.xruns);
+    lua_settable(l, -3);
+    lua_pushstring(l, "decodeUnderruns");
+    lua_pushnumber(l, audiomixer_GetUnderrunCount());
+    lua_settable(l, -3);
+    lua_pushstring(l, "maxCallbackTime");
+    lua_pushnumber(l, (double)stats.maxdurationus / 1000.0);
+    lua_settable(l, -3);
+    lua_pushstring(l, "callbackTimes");
+    lua_newtable(l);
+    int i = 0;
+    while (i < AUDIOTIMING_BUCKETS) {
+        lua_pushnumber(l, i + 1);
+        lua_pushnumber(l, stats.histogram[i]);
+        lua_settable(l, -3);
+        i++;
+    }
+    lua_settable(l, -3);
+#endif
+    return 1;
+}
+
 
 __attribute__ ((unused)) static int luafuncs_niliterator(lua_State* l) {
     lua_pushnil(l);
@@ -35,6 +35,7 @@ int luafuncs_debug_getLogicStats(lua_State* l);
 int luafuncs_debug_getTextureRequestCount(lua_State* l);
 int luafuncs_debug_get2dSpriteCount(lua_State* l);
 int luafuncs_debug_getAudioChannelCount(lua_State* l);
+int luafuncs_debug_getAudioTiming(lua_State* l);
 int luafuncs_debug_getAllTextures(lua_State* l);
 int luafuncs_debug_getServedTextureRequests(lua_State* l);
 int luafuncs_debug_getWaitingTextureRequests(lua_State* l);
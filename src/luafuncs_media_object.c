@@ -27,13 +27,21 @@
 // background music, @{blitwizard.audio.pannedSound|pannedSound}
 // for a sound with left/right panning and
 // @{blitwizard.audio.positionedSound|positionedSound} for a sound with
-// positioning in 2d or 3d space inside the game world.
+// a position in the 2d game world.
 //
-// Please note blitwizard will NEVER preload any sounds into memory,
-// so it is perfectly fine to create many sound objects from the same
+// Long sounds (e.g. music) are always streamed from disk, so it is
+// perfectly fine to create many sound objects from the same
 // sound file, it won't cause the file to be loaded into memory
 // many times.
 //
+// Short sounds (up to 5 seconds by default) are decoded once and kept
+// in a shared memory cache, so frequently played sound effects don't
+// need to be decoded again for every play. Use
+// @{blitwizard.audio.preloadSound|preloadSound} to put a sound into
+// the cache ahead of time, and
+// @{blitwizard.audio.setSoundCacheLimits|setSoundCacheLimits} to change
+// how much memory the cache may use.
+//
 // Supported audio formats are .ogg and .flac, and, if a usable FFmpeg
 // version is present on the system, many more like .mp3, .mp4 and others.
 //
@@ -46,20 +54,212 @@
 #include "luaheader.h"
 #include "luastate.h"
 #include "luaerror.h"
+#include "luafuncs.h"
 #include "audio.h"
 #include "audiomixer.h"
+#include "audiopcmcache.h"
+#include "audioresampler.h"
+#include "audiopositional.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdint.h>
+
+#include "hash.h"
 
 struct mediaobject* mediaObjects = NULL;
 
-static void mediaobject_UpdateIsPlaying(struct mediaobject* o);
+// Sound objects which are currently playing. The mixer reports when
+// their sounds stop, so only these need to be looked at:
+static struct mediaobject* playingMediaObjects = NULL;
+
+// Playing sound objects by mixer sound id (positioned sounds are
+// found through their voice instead):
+static hashmap* playingBySoundId = NULL;
+
+// Sound objects which finished and need their onFinished called:
+static struct mediaobject* finishedMediaObjects = NULL;
+
 static int garbagecollect_mediaobjref(lua_State* l);
 struct mediaobject* tomediaobject(lua_State* l,
 int type, int index, int arg, const char* func);
 
+static uint32_t mediaobject_soundIdIndex(int id) {
+    return hashmap_getIndex(playingBySoundId, (const char*)&id,
+        sizeof(id), 0);
+}
+
+static void mediaobject_indexSoundId(struct mediaobject* m, int add) {
+    if (m->type == MEDIA_TYPE_AUDIO_POSITIONED) {
+        return;
+    }
+    if (!playingBySoundId) {
+        playingBySoundId = hashmap_new(1024);
+        if (!playingBySoundId) {
+            return;
+        }
+    }
+    uint32_t i = mediaobject_soundIdIndex(m->mediainfo.sound.soundid);
+    if (add) {
+        m->nextbysoundid = playingBySoundId->items[i];
+        playingBySoundId->items[i] = m;
+        return;
+    }
+    struct mediaobject* prev = NULL;
+    struct mediaobject* m2 = playingBySoundId->items[i];
+    while (m2) {
+        if (m2 == m) {
+            if (prev) {
+                prev->nextbysoundid = m->nextbysoundid;
+            } else {
+                playingBySoundId->items[i] = m->nextbysoundid;
+            }
+            break;
+        }
+        prev = m2;
+        m2 = m2->nextbysoundid;
+    }
+    m->nextbysoundid = NULL;
+}
+
+// Find the playing (not positioned) sound object of a mixer sound:
+static struct mediaobject* mediaobject_findPlayingBySoundId(int id) {
+    if (!playingBySoundId) {
+        // no index, look at all of them:
+        struct mediaobject* m = playingMediaObjects;
+        while (m) {
+            if (m->type != MEDIA_TYPE_AUDIO_POSITIONED &&
+            m->mediainfo.sound.soundid == id) {
+                return m;
+            }
+            m = m->nextplaying;
+        }
+        return NULL;
+    }
+    struct mediaobject* m = playingBySoundId->items[
+        mediaobject_soundIdIndex(id)];
+    while (m) {
+        if (m->mediainfo.sound.soundid == id) {
+            return m;
+        }
+        m = m->nextbysoundid;
+    }
+    return NULL;
+}
+
+static void mediaobject_setPlaying(struct mediaobject* m, int playing) {
+    if (m->isPlaying == (playing != 0)) {
+        return;
+    }
+    m->isPlaying = (playing != 0);
+    mediaobject_indexSoundId(m, m->isPlaying);
+    if (m->isPlaying) {
+        m->prevplaying = NULL;
+        m->nextplaying = playingMediaObjects;
+        if (playingMediaObjects) {
+            playingMediaObjects->prevplaying = m;
+        }
+        playingMediaObjects = m;
+    } else {
+        if (m->prevplaying) {
+            m->prevplaying->nextplaying = m->nextplaying;
+        } else {
+            playingMediaObjects = m->nextplaying;
+        }
+        if (m->nextplaying) {
+            m->nextplaying->prevplaying = m->prevplaying;
+        }
+        m->prevplaying = NULL;
+        m->nextplaying = NULL;
+    }
+}
+
+// The sound of a media object stopped playing:
+static void mediaobject_finished(struct mediaobject* m) {
+    mediaobject_setPlaying(m, 0);
+    if (!m->stoprequested && m->hasonfinished && !m->finishpending) {
+        // remember to call onFinished:
+        m->finishpending = 1;
+        m->nextfinished = finishedMediaObjects;
+        finishedMediaObjects = m;
+    }
+}
+
+#ifdef USE_AUDIO
+static void mediaobject_positionalFinished(void* userdata) {
+    mediaobject_finished(userdata);
+}
+#endif
+
+// Registry entry which holds the onFinished function of an object:
+static void mediaobject_onFinishedRegName(struct mediaobject* m,
+        char* buf, size_t size) {
+    snprintf(buf, size, "bmedia_onfinished_%p", m);
+}
+
+// Push a new reference to the given media object onto the stack.
+// Returns NULL on success, or an error message (with nothing pushed):
+static const char* mediaobject_pushRef(lua_State* l,
+        struct mediaobject* m) {
+    char namespace[50];
+    switch (m->type) {
+    case MEDIA_TYPE_AUDIO_SIMPLE:
+        strcpy(namespace, "simpleSound");
+        break;
+    case MEDIA_TYPE_AUDIO_PANNED:
+        strcpy(namespace, "pannedSound");
+        break;
+    case MEDIA_TYPE_AUDIO_POSITIONED:
+    default:
+        strcpy(namespace, "positionedSound");
+        break;
+    }
+
+    lua_checkstack(l, 8);  // ensure some stack space
+    struct luaidref* iref = lua_newuserdata(l, sizeof(*iref));
+    memset(iref, 0, sizeof(*iref));
+    iref->magic = IDREF_MAGIC;
+    iref->type = IDREF_MEDIA;
+    iref->ref.mobj = m;
+    m->refcount++;
+    luastate_SetGCCallback(l, -1, (int (*)(void*))&garbagecollect_mediaobjref);
+
+    // set meta table __index field to class table
+    if (!lua_getmetatable(l, -1)) {  // on stack now: metatable
+        // no metatable so far, set one:
+        lua_newtable(l);
+        lua_setmetatable(l, -2);
+
+        // obtain it again:
+        lua_getmetatable(l, -1);
+    }
+    lua_getglobal(l, "blitwizard");
+    if (lua_type(l, -1) != LUA_TTABLE) {
+        lua_pop(l, 3);  // blitwizard, metatable, userdata
+        return "blitwizard namespace not a table";
+    }
+    lua_pushstring(l, "audio");
+    lua_gettable(l, -2);  // on stack now: metatable, blitwizard, audio
+    if (lua_type(l, -1) != LUA_TTABLE) {
+        lua_pop(l, 4);  // audio, blitwizard, metatable, userdata
+        return "blitwizard.audio namespace not a table";
+    }
+    lua_pushstring(l, namespace);
+    lua_gettable(l, -2);  // on stack now: metatable, blitwizard, audio, simpleSound
+    if (lua_type(l, -1) != LUA_TTABLE) {
+        lua_pop(l, 5);  // simpleSound, audio, blitwizard, metatable, userdata
+        return "blitwizard.audio sound namespace not a table";
+    }
+    lua_insert(l, -3);  // on stack now: metatable, simpleSound, blitwizard, audio
+    lua_pop(l, 2);  // on stack now: metatable, simpleSound
+    lua_pushstring(l, "__index");  // on stack now: metatable, simpleSound, "__index"
+    lua_insert(l, -2);  // on stack now: metatable, "__index", simpleSound
+    lua_settable(l, -3);  // on stack now: metatable
+    lua_pop(l, 1);  // done!
+    return NULL;
+}
+
 int luafuncs_media_object_new(lua_State* l, int type) {
 #ifdef USE_AUDIO
     // check which function called us:
@@ -98,21 +298,14 @@ int luafuncs_media_object_new(lua_State* l, int type) {
     }
 
     // generate new sound object:
-    struct luaidref* iref = lua_newuserdata(l, sizeof(*iref));
-    memset(iref, 0, sizeof(*iref));
-    iref->magic = IDREF_MAGIC;
-    iref->type = IDREF_MEDIA;
-    iref->ref.mobj = malloc(sizeof(struct mediaobject));
-    if (!iref->ref.mobj) {
-        lua_pop(l, 1);
+    struct mediaobject* m = malloc(sizeof(struct mediaobject));
+    if (!m) {
         return haveluaerror(l, "failed to allocate media object");
     }
-    luastate_SetGCCallback(l, -1, (int (*)(void*))&garbagecollect_mediaobjref);
-    struct mediaobject* m = iref->ref.mobj;
     memset(m, 0, sizeof(*m));
     m->type = type;
-    m->refcount++;
     m->mediainfo.sound.soundid = -1;
+    m->mediainfo.sound.bus = AUDIOMIXER_BUS_SFX;
 
     // set proper default priority:
     switch (type) {
@@ -131,10 +324,23 @@ int luafuncs_media_object_new(lua_State* l, int type) {
     m->mediainfo.sound.soundname = strdup(p);
     if (!m->mediainfo.sound.soundname) {
         // string alloc failed
-        lua_pop(l, 1);
         free(m);
         return haveluaerror(l, "allocating sound path failed");
     }
+
+    // positioned sounds are handled by the positional audio engine:
+    if (type == MEDIA_TYPE_AUDIO_POSITIONED) {
+        m->mediainfo.sound.voice = audiopositional_create(p,
+            m->mediainfo.sound.priority);
+        if (!m->mediainfo.sound.voice) {
+            free((char*)m->mediainfo.sound.soundname);
+            free(m);
+            return haveluaerror(l, "failed to allocate positional voice");
+        }
+        audiopositional_setUserdata(m->mediainfo.sound.voice, m);
+        audiopositional_setFinishedCallback(
+            &mediaobject_positionalFinished);
+    }
     
     // add to media object list:
     if (mediaObjects) {
@@ -143,52 +349,11 @@ int luafuncs_media_object_new(lua_State* l, int type) {
     m->next = mediaObjects;
     mediaObjects = m;
 
-    // set meta table __index field to class table
-    lua_checkstack(l, 8);  // ensure some stack space
-    lua_getmetatable(l, -1);  // on stack now: metatable
-    if (lua_type(l, -1) == LUA_TNIL) {
-        // no metatable so far, set one:
-        lua_newtable(l);
-        lua_setmetatable(l, -2);
-        
-        // obtain it again:
-        lua_getmetatable(l, -1);
-    }
-    lua_getglobal(l, "blitwizard");
-    if (lua_type(l, -1) != LUA_TTABLE) {
-        return haveluaerror(l, "blitwizard namespace not a table");
-    } else {
-        lua_pushstring(l, "audio");
-        lua_gettable(l, -2);  // on stack now: metatable, blitwizard, audio
-        if (lua_type(l, -1) != LUA_TTABLE) {
-            return haveluaerror(l, "blitwizard.audio namespace not a table");
-        } else {
-            char namespace[50];
-            switch (type) {
-            case MEDIA_TYPE_AUDIO_SIMPLE:
-                strcpy(namespace, "simpleSound");
-                break;
-            case MEDIA_TYPE_AUDIO_PANNED:
-                strcpy(namespace, "pannedSound");
-                break;
-            case MEDIA_TYPE_AUDIO_POSITIONED:
-                strcpy(namespace, "positionedSound");
-                break;
-            }
-            lua_pushstring(l, namespace);
-            lua_gettable(l, -2);  // on stack now: metatable, blitwizard, audio, simpleSound
-            if (lua_type(l, -1) != LUA_TTABLE) {
-                return haveluaerror(l,
-                    "blitwizard.audio.%s namespace not a table", namespace);
-            } else {
-                lua_insert(l, -3);  // on stack now: metatable, simpleSound, blitwizard, audio
-                lua_pop(l, 2);  // on stack now: metatable, simpleSound
-                lua_pushstring(l, "__index");  // on stack now: metatable, simpleSound, "__index"
-                lua_insert(l, -2);  // on stack now: metatable, "__index", simpleSound
-                lua_settable(l, -3);  // on stack now: metatable
-                lua_pop(l, 1);  // done!
-            }
-        }
+    // return a reference to it:
+    const char* error = mediaobject_pushRef(l, m);
+    if (error) {
+        // (the object is deleted again once the reference is collected)
+        return haveluaerror(l, "%s", error);
     }
     return 1;
 #else
@@ -213,8 +378,6 @@ int luafuncs_media_object_play(lua_State* l, int type) {
         break;
     case MEDIA_TYPE_AUDIO_POSITIONED:
         funcname = funcname_positioned;
-        return haveluaerror(l,
-        "positioned audio objects are not implemented yet");
         break;
     }
 
@@ -222,8 +385,6 @@ int luafuncs_media_object_play(lua_State* l, int type) {
     struct mediaobject* m = tomediaobject(l,
     type, 1, 0, funcname);
 
-    // update current playing state:
-    mediaobject_UpdateIsPlaying(m);
     if (m->isPlaying) {return 0;}
 
     float volume = 1;
@@ -291,10 +452,37 @@ int luafuncs_media_object_play(lua_State* l, int type) {
         }
     }
 
-    // play sound:
+    m->stoprequested = 0;
+
+    // positioned sounds get volume and panning from their position:
+    if (type == MEDIA_TYPE_AUDIO_POSITIONED) {
+        audiopositional_setLoopPoints(m->mediainfo.sound.voice,
+            m->mediainfo.sound.loopstart, m->mediainfo.sound.loopend);
+        audiopositional_play(m->mediainfo.sound.voice, volume, loop,
+            fadeinseconds);
+        if (audiopositional_isPlaying(m->mediainfo.sound.voice)) {
+            mediaobject_setPlaying(m, 1);
+        } else {
+            // out of hearing range, so it is done already
+            mediaobject_finished(m);
+        }
+        return 0;
+    }
+
+    // play sound (an old one still fading out isn't ours anymore,
+    // and the sound id index needs updating):
+    mediaobject_setPlaying(m, 0);
     m->mediainfo.sound.soundid = audiomixer_PlaySoundFromDisk(
     m->mediainfo.sound.soundname, m->mediainfo.sound.priority,
-    volume, panning, noamplify, fadeinseconds, loop);
+    volume, panning, noamplify, fadeinseconds, loop,
+    m->mediainfo.sound.loopstart, m->mediainfo.sound.loopend,
+    m->mediainfo.sound.bus);
+    if (audiomixer_IsSoundPlaying(m->mediainfo.sound.soundid)) {
+        mediaobject_setPlaying(m, 1);
+    } else {
+        // no channel left for this priority
+        mediaobject_finished(m);
+    }
     return 0;
 #else
     return haveluaerror(l, compiled_without_audio);
@@ -318,8 +506,6 @@ int luafuncs_media_object_stop(lua_State* l, int type) {
         break;
     case MEDIA_TYPE_AUDIO_POSITIONED:
         funcname = funcname_positioned;
-        return haveluaerror(l,
-        "positioned audio objects are not implemented yet");
         break;
     }
     
@@ -327,10 +513,7 @@ int luafuncs_media_object_stop(lua_State* l, int type) {
     struct mediaobject* m = tomediaobject(l,
     type, 1, 0, funcname);
 
-    // update current playing state:
-    mediaobject_UpdateIsPlaying(m);
-    if (!m->isPlaying ||
-    m->mediainfo.sound.soundid < 0) {return 0;}
+    if (!m->isPlaying || m->stoprequested) {return 0;}
     
     // extract fadeout length
     double fadeoutseconds = 0;
@@ -347,8 +530,19 @@ int luafuncs_media_object_stop(lua_State* l, int type) {
     }
     
     // stop sound:
+    m->stoprequested = 1;
+    if (type == MEDIA_TYPE_AUDIO_POSITIONED) {
+        audiopositional_stop(m->mediainfo.sound.voice, fadeoutseconds);
+        mediaobject_setPlaying(m, 0);
+        return 0;
+    }
     audiomixer_StopSoundWithFadeout(
         m->mediainfo.sound.soundid, fadeoutseconds);
+    if (fadeoutseconds <= 0) {
+        // stopped right away. otherwise, it counts as playing until
+        // the fade out is done
+        mediaobject_setPlaying(m, 0);
+    }
     return 0;
 #else
     return haveluaerror(l, compiled_without_audio);
@@ -363,6 +557,151 @@ int luafuncs_media_object_adjust(lua_State* l, int type) {
     return 0;
 }
 
+int luafuncs_media_object_setLoopPoints(lua_State* l, int type) {
+#ifdef USE_AUDIO
+    char funcname_simple[] = "blitwizard.audio.simpleSound:setLoopPoints";
+    char funcname_panned[] = "blitwizard.audio.pannedSound:setLoopPoints";
+    char funcname_positioned[] =
+        "blitwizard.audio.positionedSound:setLoopPoints";
+    char funcname_unknown[] = "???";
+    char* funcname = funcname_unknown;
+    switch (type) {
+    case MEDIA_TYPE_AUDIO_SIMPLE:
+        funcname = funcname_simple;
+        break;
+    case MEDIA_TYPE_AUDIO_PANNED:
+        funcname = funcname_panned;
+        break;
+    case MEDIA_TYPE_AUDIO_POSITIONED:
+        funcname = funcname_positioned;
+        break;
+    }
+
+    // obtain sound object:
+    struct mediaobject* m = tomediaobject(l,
+    type, 1, 0, funcname);
+
+    // extract loop start and end:
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1, funcname,
+        "number", lua_strtype(l, 2));
+    }
+    if (lua_type(l, 3) != LUA_TNUMBER &&
+    lua_type(l, 3) != LUA_TNIL) {
+        return haveluaerror(l, badargument1, 2, funcname,
+        "number", lua_strtype(l, 3));
+    }
+    double loopstart = lua_tonumber(l, 2);
+    double loopend = 0;
+    if (lua_type(l, 3) == LUA_TNUMBER) {
+        loopend = lua_tonumber(l, 3);
+    }
+    if (loopstart < 0) {
+        return haveluaerror(l, badargument2, 1, funcname,
+        "loop start cannot be negative");
+    }
+    if (loopend != 0 && loopend <= loopstart) {
+        return haveluaerror(l, badargument2, 2, funcname,
+        "loop end needs to be after the loop start");
+    }
+
+    // this takes effect the next time the sound is played:
+    m->mediainfo.sound.loopstart = loopstart;
+    m->mediainfo.sound.loopend = loopend;
+    return 0;
+#else
+    return haveluaerror(l, compiled_without_audio);
+#endif
+}
+
+int luafuncs_media_object_setOnFinished(lua_State* l, int type) {
+#ifdef USE_AUDIO
+    char funcname_simple[] = "blitwizard.audio.simpleSound:setOnFinished";
+    char funcname_panned[] = "blitwizard.audio.pannedSound:setOnFinished";
+    char funcname_positioned[] =
+        "blitwizard.audio.positionedSound:setOnFinished";
+    char funcname_unknown[] = "???";
+    char* funcname = funcname_unknown;
+    switch (type) {
+    case MEDIA_TYPE_AUDIO_SIMPLE:
+        funcname = funcname_simple;
+        break;
+    case MEDIA_TYPE_AUDIO_PANNED:
+        funcname = funcname_panned;
+        break;
+    case MEDIA_TYPE_AUDIO_POSITIONED:
+        funcname = funcname_positioned;
+        break;
+    }
+
+    // obtain sound object:
+    struct mediaobject* m = tomediaobject(l,
+    type, 1, 0, funcname);
+
+    if (lua_type(l, 2) != LUA_TFUNCTION &&
+    lua_type(l, 2) != LUA_TNIL) {
+        return haveluaerror(l, badargument1, 1, funcname,
+        "function", lua_strtype(l, 2));
+    }
+
+    // store function in the registry:
+    char regname[64];
+    mediaobject_onFinishedRegName(m, regname, sizeof(regname));
+    lua_pushstring(l, regname);
+    lua_pushvalue(l, 2);
+    lua_settable(l, LUA_REGISTRYINDEX);
+    m->hasonfinished = (lua_type(l, 2) == LUA_TFUNCTION);
+    return 0;
+#else
+    return haveluaerror(l, compiled_without_audio);
+#endif
+}
+
+int luafuncs_media_object_setBus(lua_State* l, int type) {
+#ifdef USE_AUDIO
+    char funcname_simple[] = "blitwizard.audio.simpleSound:setBus";
+    char funcname_panned[] = "blitwizard.audio.pannedSound:setBus";
+    char funcname_positioned[] = "blitwizard.audio.positionedSound:setBus";
+    char funcname_unknown[] = "???";
+    char* funcname = funcname_unknown;
+    switch (type) {
+    case MEDIA_TYPE_AUDIO_SIMPLE:
+        funcname = funcname_simple;
+        break;
+    case MEDIA_TYPE_AUDIO_PANNED:
+        funcname = funcname_panned;
+        break;
+    case MEDIA_TYPE_AUDIO_POSITIONED:
+        funcname = funcname_positioned;
+        break;
+    }
+
+    // obtain sound object:
+    struct mediaobject* m = tomediaobject(l,
+    type, 1, 0, funcname);
+
+    // get bus, adding it if it doesn't exist yet:
+    if (lua_type(l, 2) != LUA_TSTRING) {
+        return haveluaerror(l, badargument1, 1, funcname,
+        "string", lua_strtype(l, 2));
+    }
+    int bus = audiomixer_GetBus(lua_tostring(l, 2), 1);
+    if (bus < 0) {
+        return haveluaerror(l, badargument2, 1, funcname,
+        "invalid bus name, or too many buses");
+    }
+
+    // this takes effect the next time the sound is played:
+    m->mediainfo.sound.bus = bus;
+    if (type == MEDIA_TYPE_AUDIO_POSITIONED) {
+        audiopositional_setBus(m->mediainfo.sound.voice, bus);
+    }
+    return 0;
+#else
+    return haveluaerror(l, compiled_without_audio);
+#endif
+}
+
 /// Stop all currently playing sounds.
 // (@{blitwizard.audio.simpleSound|simpleSound},
 // @{blitwizard.audio.pannedSound|pannedSound} and
@@ -389,6 +728,21 @@ int luafuncs_media_object_stopAllPlayingSounds(lua_State* l) {
         }
     }
 #ifdef USE_AUDIO
+    // mark all sound objects as stopped:
+    struct mediaobject* m = playingMediaObjects;
+    while (m) {
+        struct mediaobject* mnext = m->nextplaying;
+        m->stoprequested = 1;
+        if (m->type == MEDIA_TYPE_AUDIO_POSITIONED) {
+            audiopositional_stop(m->mediainfo.sound.voice, fadeout);
+            mediaobject_setPlaying(m, 0);
+        } else if (fadeout <= 0) {
+            mediaobject_setPlaying(m, 0);
+        }
+        m = mnext;
+    }
+
+    // stop all sounds in the mixer:
     unsigned int i = 0;
     unsigned int c = audiomixer_HighestUsedChannel();
     while (i <= c) {
@@ -407,6 +761,158 @@ int luafuncs_media_object_stopAllPlayingSounds(lua_State* l) {
     return 0;
 }
 
+/// Decode a short sound into the sound cache ahead of time, so
+// that playing it for the first time won't need to load and decode it
+// from disk.
+//
+// Sounds longer than the maximum length specified with
+// @{blitwizard.audio.setSoundCacheLimits|setSoundCacheLimits} can't be
+// cached and will always be streamed from disk when played.
+// @function preloadSound
+// @tparam string filename the sound file to preload
+// @treturn boolean true if the sound is now cached, false if it is too long, doesn't fit into the cache or can't be decoded
+int luafuncs_media_object_preloadSound(lua_State* l) {
+    if (lua_type(l, 1) != LUA_TSTRING) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.audio.preloadSound",
+        "string", lua_strtype(l, 1));
+    }
+    const char* p = lua_tostring(l, 1);
+    if (!resources_locateResource(p, NULL)) {
+        return haveluaerror(l, "sound file \"%s\" not found", p);
+    }
+#ifdef USE_AUDIO
+    lua_pushboolean(l, audiopcmcache_preload(p));
+#else
+    lua_pushboolean(l, 0);
+#endif
+    return 1;
+}
+
+/// Change the limits of the sound cache which keeps short sounds
+// decoded in memory.
+//
+// Sounds which are currently played are never dropped from the cache,
+// other sounds are dropped as required to respect the new memory limit.
+// @function setSoundCacheLimits
+// @tparam number maxlength the maximum length of sounds which get cached in seconds (default: 5). Set this to 0 to disable the cache
+// @tparam number memory the maximum amount of memory used by the cache in megabytes (default: 32)
+int luafuncs_media_object_setSoundCacheLimits(lua_State* l) {
+    if (lua_type(l, 1) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.audio.setSoundCacheLimits",
+        "number", lua_strtype(l, 1));
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2,
+        "blitwizard.audio.setSoundCacheLimits",
+        "number", lua_strtype(l, 2));
+    }
+    double maxlength = lua_tonumber(l, 1);
+    double memory = lua_tonumber(l, 2);
+    if (maxlength < 0) {
+        return haveluaerror(l, badargument2, 1,
+        "blitwizard.audio.setSoundCacheLimits",
+        "maximum length cannot be negative");
+    }
+    if (memory < 0) {
+        return haveluaerror(l, badargument2, 2,
+        "blitwizard.audio.setSoundCacheLimits",
+        "memory limit cannot be negative");
+    }
+#ifdef USE_AUDIO
+    audiopcmcache_setLimits(maxlength,
+        (size_t)(memory * 1024.0 * 1024.0));
+#endif
+    return 0;
+}
+
+/// Set the quality of the resampling which is done for all sounds
+// which don't have a sample rate of 48kHz.
+//
+// Sounds which are already playing or cached keep the quality they
+// were started or cached with.
+// @function setResamplingQuality
+// @tparam string quality "low", "medium" or "high" (default: "high", "low" on Android)
+int luafuncs_media_object_setResamplingQuality(lua_State* l) {
+    if (lua_type(l, 1) != LUA_TSTRING) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.audio.setResamplingQuality",
+        "string", lua_strtype(l, 1));
+    }
+    const char* q = lua_tostring(l, 1);
+    int quality;
+    if (strcmp(q, "low") == 0) {
+        quality = AUDIORESAMPLER_QUALITY_LOW;
+    } else if (strcmp(q, "medium") == 0) {
+        quality = AUDIORESAMPLER_QUALITY_MEDIUM;
+    } else if (strcmp(q, "high") == 0) {
+        quality = AUDIORESAMPLER_QUALITY_HIGH;
+    } else {
+        return haveluaerror(l, badargument2, 1,
+        "blitwizard.audio.setResamplingQuality",
+        "quality must be \"low\", \"medium\" or \"high\"");
+    }
+#ifdef USE_AUDIO
+    audioresampler_setDefaultQuality(quality);
+#else
+    (void)quality;
+#endif
+    return 0;
+}
+
+/// Change the volume of a sound bus.
+//
+// Each sound plays on a bus (see
+// @{blitwizard.audio.simpleSound:setBus|setBus}), and the bus volume
+// applies to all of its sounds at once. This is the cheapest way to
+// change the volume of many sounds, e.g. to fade out all music or to
+// turn down all sound effects while a menu is open.
+//
+// The buses "music", "sfx" (used by default) and "ui" always exist,
+// and "master" applies to all sounds. Other buses are added as soon
+// as they're used.
+// @function setBusVolume
+// @tparam string bus Name of the bus
+// @tparam number volume New volume from 0 (quiet) to 1 (full volume)
+// @tparam number fade (optional) Fade to the new volume over the given amount of seconds instead of changing it instantly
+// @usage -- fade out all music in 2 seconds:
+// blitwizard.audio.setBusVolume("music", 0, 2)
+int luafuncs_media_object_setBusVolume(lua_State* l) {
+#ifdef USE_AUDIO
+    char funcname[] = "blitwizard.audio.setBusVolume";
+    if (lua_type(l, 1) != LUA_TSTRING) {
+        return haveluaerror(l, badargument1, 1, funcname,
+        "string", lua_strtype(l, 1));
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2, funcname,
+        "number", lua_strtype(l, 2));
+    }
+    if (lua_type(l, 3) != LUA_TNUMBER &&
+    lua_type(l, 3) != LUA_TNIL) {
+        return haveluaerror(l, badargument1, 3, funcname,
+        "number", lua_strtype(l, 3));
+    }
+    int bus = audiomixer_GetBus(lua_tostring(l, 1), 1);
+    if (bus < 0) {
+        return haveluaerror(l, badargument2, 1, funcname,
+        "invalid bus name, or too many buses");
+    }
+    float volume = lua_tonumber(l, 2);
+    if (volume < 0) {volume = 0;}
+    if (volume > 1) {volume = 1;}
+    double fade = 0;
+    if (lua_type(l, 3) == LUA_TNUMBER) {
+        fade = lua_tonumber(l, 3);
+    }
+    audiomixer_SetBusVolume(bus, volume, fade);
+    return 0;
+#else
+    return haveluaerror(l, compiled_without_audio);
+#endif
+}
+
 /// Implements a simple sound which has no
 // stereo left/right panning or room positioning features.
 // This is the sound object suited best for background music.
@@ -489,6 +995,68 @@ int luafuncs_media_simpleSound_setPriority(lua_State* l) {
     return luafuncs_media_object_setPriority(l, MEDIA_TYPE_AUDIO_SIMPLE);
 }
 
+/// Set the section of the sound which is repeated when it is
+// @{blitwizard.audio.simpleSound:play|played} with looping enabled.
+//
+// The part before the loop start is played once as an intro, then
+// playback repeats from the loop start to the loop end without any
+// gap. The loop points apply the next time you play the sound.
+// @function setLoopPoints
+// @tparam number loopstart Start of the looped section in seconds
+// @tparam number loopend (optional) End of the looped section in seconds. If not specified, the section lasts up to the end of the sound
+// @usage -- play music with a 4.5 seconds intro, then loop the rest:
+// mymusic = blitwizard.audio.simpleSound:new("music.ogg")
+// mymusic:setLoopPoints(4.5)
+// mymusic:play(1, true)
+
+int luafuncs_media_simpleSound_setLoopPoints(lua_State* l) {
+    return luafuncs_media_object_setLoopPoints(l, MEDIA_TYPE_AUDIO_SIMPLE);
+}
+
+/// Set the sound bus the simple sound plays on.
+//
+// A bus groups sounds so their volume can be changed all at once with
+// @{blitwizard.audio.setBusVolume|setBusVolume}. Sounds play on the
+// "sfx" bus by default. Use "music" for music and "ui" for interface
+// sounds, or any other name to add a bus of your own (up to 15 buses).
+//
+// The bus applies the next time you play the sound.
+// @function setBus
+// @tparam string bus Name of the bus
+// @usage -- play music on the music bus:
+// mymusic = blitwizard.audio.simpleSound:new("music.ogg")
+// mymusic:setBus("music")
+// mymusic:play(1, true)
+
+int luafuncs_media_simpleSound_setBus(lua_State* l) {
+    return luafuncs_media_object_setBus(l, MEDIA_TYPE_AUDIO_SIMPLE);
+}
+
+/// Set a function which is called when the sound finished playing.
+//
+// This happens when the sound reached its end, or when it was
+// replaced by a sound with higher priority (see
+// @{blitwizard.audio.simpleSound:setPriority|setPriority}). It isn't
+// called when you stop the sound yourself with
+// @{blitwizard.audio.simpleSound:stop|stop}.
+//
+// The function is called at the start of the next frame after the
+// sound ended, with the sound object as parameter. It is fine to
+// @{blitwizard.audio.simpleSound:play|play} the sound again from it.
+// @function setOnFinished
+// @tparam function func The function to be called, or nil to remove it
+// @usage -- play the next song when one is over:
+// song = blitwizard.audio.simpleSound:new("song1.ogg")
+// song:setOnFinished(function(self)
+//     nextsong = blitwizard.audio.simpleSound:new("song2.ogg")
+//     nextsong:play()
+// end)
+// song:play()
+
+int luafuncs_media_simpleSound_setOnFinished(lua_State* l) {
+    return luafuncs_media_object_setOnFinished(l, MEDIA_TYPE_AUDIO_SIMPLE);
+}
+
 /// Adjust the volume of a simple sound while it is playing
 // (does nothing if it's not)
 // @function adjust
@@ -546,6 +1114,15 @@ int luafuncs_media_pannedSound_setPriority(lua_State* l) {
     return luafuncs_media_object_setPriority(l, MEDIA_TYPE_AUDIO_SIMPLE);
 }
 
+/// Set the sound bus the panned sound plays on,
+// see @{blitwizard.audio.simpleSound:setBus}.
+// @function setBus
+// @tparam string bus Name of the bus
+
+int luafuncs_media_pannedSound_setBus(lua_State* l) {
+    return luafuncs_media_object_setBus(l, MEDIA_TYPE_AUDIO_PANNED);
+}
+
 /// Adjust the volume or panning of a panned sound
 // (does nothing if the sound is not playing)
 // @function adjust
@@ -556,23 +1133,42 @@ int luafuncs_media_pannedSound_adjust(lua_State* l) {
     return luafuncs_media_object_adjust(l, MEDIA_TYPE_AUDIO_SIMPLE);
 }
 
-/// Implements a positioned sound which can either follow a
-// specific @{blitwizard.object|blitwizard object} or which
-// you can move to any position you like. It will alter volume
-// based on distance and channels based on direction to simulate
-// its room placement.
+/// Implements a sound which is placed in the 2d game world.
+// Its volume and left/right panning are derived from the distance
+// and direction to the nearest listener (see
+// @{blitwizard.audio.setListenerPosition|setListenerPosition}), and
+// are updated automatically once per frame.
+//
+// Sounds out of hearing range aren't decoded or mixed at all, so you
+// can have hundreds of sound emitters placed in your world at little
+// cost. A looping sound will start playing again when it gets in
+// range, while a non-looping sound out of range simply ends.
+//
+// Positioned sounds default to a priority of 2.
 // @type positionedSound
-
+// @usage -- a looping waterfall sound at position 10, 5:
+// waterfall = blitwizard.audio.positionedSound:new("waterfall.ogg")
+// waterfall:setPosition(10, 5)
+// waterfall:setAttenuation(2, 30)
+// waterfall:play(1, true)
 
 /// Create a new positioned sound object.
 // @function new
 // @tparam string filename Filename of the audio file you want to play
-// @tparam userdata object (optional) Specify a @{blitwizard.object|blitwizard object} to which the sound should stick. If you don't specify an object to stick to, the sound can be freely placed with @{position}
 
 int luafuncs_media_positionedSound_new(lua_State* l) {
     return luafuncs_media_object_new(l, MEDIA_TYPE_AUDIO_POSITIONED);
 }
 
+/// Play the sound represented by the positioned sound object.
+// @function play
+// @tparam number volume (optional) Volume at which the sound plays from 0 (quiet) to 1 (full volume) when close to the listener. Defaults to 1
+// @tparam boolean loop (optional) If set to true, the sound will loop until explicitely stopped
+// @tparam number fadein (optional) Fade in from silence in the given amount of seconds
+
+int luafuncs_media_positionedSound_play(lua_State* l) {
+    return luafuncs_media_object_play(l, MEDIA_TYPE_AUDIO_POSITIONED);
+}
 
 /// Stop the sound represented by the positioned sound object.
 // Does nothing if the sound doesn't currently play
@@ -583,12 +1179,193 @@ int luafuncs_media_positionedSound_stop(lua_State* l) {
     return luafuncs_media_object_stop(l, MEDIA_TYPE_AUDIO_POSITIONED);
 }
 
+/// Set the loop section of the positioned sound,
+// see @{blitwizard.audio.simpleSound:setLoopPoints}.
+// @function setLoopPoints
+// @tparam number loopstart Start of the looped section in seconds
+// @tparam number loopend (optional) End of the looped section in seconds
+
+int luafuncs_media_positionedSound_setLoopPoints(lua_State* l) {
+    return luafuncs_media_object_setLoopPoints(l,
+        MEDIA_TYPE_AUDIO_POSITIONED);
+}
+
+/// Set the sound bus the positioned sound plays on,
+// see @{blitwizard.audio.simpleSound:setBus}.
+// @function setBus
+// @tparam string bus Name of the bus
+
+int luafuncs_media_positionedSound_setBus(lua_State* l) {
+    return luafuncs_media_object_setBus(l, MEDIA_TYPE_AUDIO_POSITIONED);
+}
+
+/// Set a function which is called when the positioned sound finished
+// playing, see @{blitwizard.audio.simpleSound:setOnFinished}.
+//
+// A non-looping positioned sound also finishes when it gets out of
+// hearing range.
+// @function setOnFinished
+// @tparam function func The function to be called, or nil to remove it
+
+int luafuncs_media_positionedSound_setOnFinished(lua_State* l) {
+    return luafuncs_media_object_setOnFinished(l,
+        MEDIA_TYPE_AUDIO_POSITIONED);
+}
+
+/// Set the position of the sound in the game world.
+// This can be changed at any time, also while the sound is playing.
+// @function setPosition
+// @tparam number x X coordinate
+// @tparam number y Y coordinate
+
+int luafuncs_media_positionedSound_setPosition(lua_State* l) {
+#ifdef USE_AUDIO
+    char funcname[] = "blitwizard.audio.positionedSound:setPosition";
+    struct mediaobject* m = tomediaobject(l,
+    MEDIA_TYPE_AUDIO_POSITIONED, 1, 0, funcname);
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1, funcname,
+        "number", lua_strtype(l, 2));
+    }
+    if (lua_type(l, 3) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2, funcname,
+        "number", lua_strtype(l, 3));
+    }
+    m->mediainfo.sound.x = lua_tonumber(l, 2);
+    m->mediainfo.sound.y = lua_tonumber(l, 3);
+    audiopositional_setPosition(m->mediainfo.sound.voice,
+        m->mediainfo.sound.x, m->mediainfo.sound.y);
+    return 0;
+#else
+    return haveluaerror(l, compiled_without_audio);
+#endif
+}
+
+/// Set how the volume of the sound decreases with distance.
+// @function setAttenuation
+// @tparam number mindistance Up to this distance to the listener, the sound plays at full volume (default: 1)
+// @tparam number maxdistance From this distance on, the sound is inaudible (default: 20)
+// @tparam string curve (optional) "inverse" for a natural, quickly decreasing volume (default), or "linear" for a linear decrease from the minimum to the maximum distance
 
+int luafuncs_media_positionedSound_setAttenuation(lua_State* l) {
+#ifdef USE_AUDIO
+    char funcname[] = "blitwizard.audio.positionedSound:setAttenuation";
+    struct mediaobject* m = tomediaobject(l,
+    MEDIA_TYPE_AUDIO_POSITIONED, 1, 0, funcname);
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1, funcname,
+        "number", lua_strtype(l, 2));
+    }
+    if (lua_type(l, 3) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2, funcname,
+        "number", lua_strtype(l, 3));
+    }
+    double mindistance = lua_tonumber(l, 2);
+    double maxdistance = lua_tonumber(l, 3);
+    if (mindistance < 0) {
+        return haveluaerror(l, badargument2, 1, funcname,
+        "minimum distance cannot be negative");
+    }
+    if (maxdistance <= mindistance) {
+        return haveluaerror(l, badargument2, 2, funcname,
+        "maximum distance needs to be larger than the minimum distance");
+    }
+    int curve = AUDIOPOSITIONAL_CURVE_INVERSE;
+    if (lua_type(l, 4) != LUA_TNIL) {
+        if (lua_type(l, 4) != LUA_TSTRING) {
+            return haveluaerror(l, badargument1, 3, funcname,
+            "string", lua_strtype(l, 4));
+        }
+        const char* c = lua_tostring(l, 4);
+        if (strcmp(c, "linear") == 0) {
+            curve = AUDIOPOSITIONAL_CURVE_LINEAR;
+        } else if (strcmp(c, "inverse") != 0) {
+            return haveluaerror(l, badargument2, 3, funcname,
+            "curve needs to be \"linear\" or \"inverse\"");
+        }
+    }
+    audiopositional_setAttenuation(m->mediainfo.sound.voice,
+        mindistance, maxdistance, curve);
+    return 0;
+#else
+    return haveluaerror(l, compiled_without_audio);
+#endif
+}
+
+/// Set the position of the listener, which hears all
+// @{blitwizard.audio.positionedSound|positioned sounds}.
+// Usually, this is the position of the camera or the player.
+//
+// There can be up to 4 listeners (e.g. for split screen), each
+// positioned sound is heard by the nearest one. Only the first
+// listener exists by default (at position 0, 0), the others are
+// added by setting their position and removed by passing nil
+// as position.
+// @function setListenerPosition
+// @tparam number x X coordinate (or nil to remove the listener)
+// @tparam number y Y coordinate (or nil to remove the listener)
+// @tparam number listener (optional) Listener from 1 to 4, defaults to 1
+// @usage -- make sounds follow the player:
+// blitwizard.audio.setListenerPosition(player:getPosition())
+int luafuncs_media_object_setListenerPosition(lua_State* l) {
+#ifdef USE_AUDIO
+    char funcname[] = "blitwizard.audio.setListenerPosition";
+    int listener = 1;
+    if (lua_type(l, 3) != LUA_TNIL) {
+        if (lua_type(l, 3) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 3, funcname,
+            "number", lua_strtype(l, 3));
+        }
+        listener = lua_tointeger(l, 3);
+        if (listener < 1 || listener > AUDIOPOSITIONAL_MAXLISTENERS) {
+            return haveluaerror(l, badargument2, 3, funcname,
+            "listener needs to be from 1 to 4");
+        }
+    }
+    if (lua_type(l, 1) == LUA_TNIL && lua_type(l, 2) == LUA_TNIL &&
+            listener > 1) {
+        audiopositional_removeListener(listener - 1);
+        return 0;
+    }
+    if (lua_type(l, 1) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1, funcname,
+        "number", lua_strtype(l, 1));
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2, funcname,
+        "number", lua_strtype(l, 2));
+    }
+    audiopositional_setListenerPosition(listener - 1,
+        lua_tonumber(l, 1), lua_tonumber(l, 2));
+    return 0;
+#else
+    return haveluaerror(l, compiled_without_audio);
+#endif
+}
 
 // Various cleanup and management functions:
 
 void cleanupMediaObject(struct mediaobject* o) {
-    
+#ifdef USE_AUDIO
+    if (o->type == MEDIA_TYPE_AUDIO_POSITIONED) {
+        audiopositional_destroy(o->mediainfo.sound.voice);
+        o->mediainfo.sound.voice = NULL;
+    }
+#endif
+    mediaobject_setPlaying(o, 0);
+
+    // forget about the onFinished function:
+    if (o->hasonfinished) {
+        lua_State* l = luastate_GetStatePtr();
+        char regname[64];
+        mediaobject_onFinishedRegName(o, regname, sizeof(regname));
+        lua_pushstring(l, regname);
+        lua_pushnil(l);
+        lua_settable(l, LUA_REGISTRYINDEX);
+        o->hasonfinished = 0;
+    }
+    free((char*)o->mediainfo.sound.soundname);
+    o->mediainfo.sound.soundname = NULL;
 }
 
 void deleteMediaObject(struct mediaobject* o) {
@@ -611,35 +1388,90 @@ void deleteMediaObject(struct mediaobject* o) {
     free(o);
 }
 
-static void mediaobject_UpdateIsPlaying(struct mediaobject* m) {
-    if (m->type == MEDIA_TYPE_AUDIO_SIMPLE ||
-    m->type == MEDIA_TYPE_AUDIO_PANNED ||
-    m->type == MEDIA_TYPE_AUDIO_POSITIONED) {
-        // it is a sound object.
-        if (m->mediainfo.sound.soundid < 0) {
-            m->isPlaying = 0;
-        } else {
-#ifdef USE_AUDIO
-            m->isPlaying = audiomixer_IsSoundPlaying(m->mediainfo.sound.soundid);
-#else
-            m->isPlaying = 0;
-#endif
-        }
+// Delete an object if no references and no playing sound is left:
+static void mediaobject_deleteIfUnused(struct mediaobject* o) {
+    if (o->refcount <= 0 && !o->isPlaying && !o->finishpending) {
+        deleteMediaObject(o);
     }
 }
 
-void checkAllMediaObjectsForCleanup() {
-    struct mediaobject* m = mediaObjects;
-    while (m) {
-        struct mediaobject* mnext = m->next;
-        if (m->refcount <= 0) {
-            mediaobject_UpdateIsPlaying(m);
-            if (!m->isPlaying) {
-                deleteMediaObject(m);
+// Call the onFinished function of the given object:
+static void mediaobject_callOnFinished(lua_State* l,
+        struct mediaobject* m) {
+    lua_checkstack(l, 8);
+
+    // push error handling function:
+    lua_pushcfunction(l, internaltracebackfunc());
+
+    // get onFinished function:
+    char regname[64];
+    mediaobject_onFinishedRegName(m, regname, sizeof(regname));
+    lua_pushstring(l, regname);
+    lua_gettable(l, LUA_REGISTRYINDEX);
+    if (lua_type(l, -1) != LUA_TFUNCTION) {
+        lua_pop(l, 2);  // pop function, error handling function
+        return;
+    }
+
+    // push the sound object as argument:
+    if (mediaobject_pushRef(l, m) != NULL) {
+        lua_pop(l, 2);  // pop function, error handling function
+        return;
+    }
+
+    // call function:
+    if (lua_pcall(l, 1, 0, -3) != 0) {
+        luacfuncs_onError("blitwizard.audio sound event function "
+            "\"onFinished\"", lua_tostring(l, -1));
+        lua_pop(l, 1);  // pop error message
+    }
+    lua_pop(l, 1);  // pop error handling function
+}
+
+void mediaobject_processFinishedSounds(void) {
+#ifdef USE_AUDIO
+    // look at the sounds the mixer reported as finished:
+    int id;
+    while ((id = audiomixer_GetFinishedSound()) != 0) {
+        if (id == AUDIOMIXER_FINISHED_LOST) {
+            // we need to check them all:
+            struct mediaobject* m = playingMediaObjects;
+            while (m) {
+                struct mediaobject* mnext = m->nextplaying;
+                if (m->type != MEDIA_TYPE_AUDIO_POSITIONED &&
+                !audiomixer_IsSoundPlaying(m->mediainfo.sound.soundid)) {
+                    mediaobject_finished(m);
+                    mediaobject_deleteIfUnused(m);
+                }
+                m = mnext;
             }
+            audiopositional_checkAllSounds();
+            continue;
         }
-        m = mnext;
-    } 
+
+        // positioned sounds report back through
+        // mediaobject_positionalFinished:
+        audiopositional_soundFinished(id);
+
+        struct mediaobject* m = mediaobject_findPlayingBySoundId(id);
+        if (m) {
+            mediaobject_finished(m);
+            mediaobject_deleteIfUnused(m);
+        }
+    }
+#endif
+
+    // call onFinished functions:
+    while (finishedMediaObjects) {
+        struct mediaobject* m = finishedMediaObjects;
+        finishedMediaObjects = m->nextfinished;
+        m->nextfinished = NULL;
+        m->finishpending = 0;
+        if (m->hasonfinished) {
+            mediaobject_callOnFinished(luastate_GetStatePtr(), m);
+        }
+        mediaobject_deleteIfUnused(m);
+    }
 }
 
 static int garbagecollect_mediaobjref(lua_State* l) {
@@ -663,12 +1495,7 @@ static int garbagecollect_mediaobjref(lua_State* l) {
 
     // if it's not playing and ref count is zero, remove it
     // entirely and free it:
-    if (o->refcount <= 0) {
-        mediaobject_UpdateIsPlaying(o);
-        if (!o->isPlaying) {
-            deleteMediaObject(o);
-        }
-    }
+    mediaobject_deleteIfUnused(o);
     return 0;
 }
 
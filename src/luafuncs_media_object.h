@@ -33,10 +33,28 @@ int luafuncs_media_simpleSound_play(lua_State* l);
 int luafuncs_media_simpleSound_stop(lua_State* l);
 int luafuncs_media_simpleSound_setPriority(lua_State* l);
 int luafuncs_media_simpleSound_adjust(lua_State* l);
+int luafuncs_media_simpleSound_setLoopPoints(lua_State* l);
+int luafuncs_media_simpleSound_setBus(lua_State* l);
+int luafuncs_media_simpleSound_setOnFinished(lua_State* l);
 int luafuncs_media_pannedSound_new(lua_State* l);
 int luafuncs_media_positionedSound_new(lua_State* l);
+int luafuncs_media_positionedSound_play(lua_State* l);
+int luafuncs_media_positionedSound_stop(lua_State* l);
+int luafuncs_media_positionedSound_setLoopPoints(lua_State* l);
+int luafuncs_media_positionedSound_setBus(lua_State* l);
+int luafuncs_media_positionedSound_setOnFinished(lua_State* l);
+int luafuncs_media_positionedSound_setPosition(lua_State* l);
+int luafuncs_media_positionedSound_setAttenuation(lua_State* l);
 int luafuncs_media_object_stopAllPlayingSounds(lua_State* l);
-void checkAllMediaObjectsForCleanup(void);
+int luafuncs_media_object_preloadSound(lua_State* l);
+int luafuncs_media_object_setSoundCacheLimits(lua_State* l);
+int luafuncs_media_object_setResamplingQuality(lua_State* l);
+int luafuncs_media_object_setListenerPosition(lua_State* l);
+int luafuncs_media_object_setBusVolume(lua_State* l);
+
+// Update the state of sound objects whose sounds stopped playing, and
+// call their onFinished functions. Call once per frame:
+void mediaobject_processFinishedSounds(void);
 
 #endif  // BLITWIZARD_LUAFUNCS_MEDIA_OBJECT_H_
 
@@ -156,7 +156,9 @@ static int luacfuncs_getObjectsIterator(lua_State* l) {
 // @{blitwizard.physics.ray2d} (see usage example below).
 //
 // Please note this function is potentially <b>slow</b> if
-// there are a lot of objects around.
+// there are a lot of objects around. If you only care about
+// objects with collision enabled, use
+// @{blitwizard.physics.query2dCircle} instead which is a lot faster.
 //
 // If you want to scan for 3d objects, use
 // @{blitwizard.scanFor3dObjects|scanFor3dObjects}.
@@ -224,13 +226,13 @@ int luafuncs_scanFor2dObjects(lua_State* l) {
 
     // ok now we validated all args, extract them:
     double range = lua_tonumber(l, 3);
-    double x = lua_tonumber(l, 0);
-    double y = lua_tonumber(l, 1);
+    double x = lua_tonumber(l, 1);
+    double y = lua_tonumber(l, 2);
 
-    // create a table with all objects for the
+    // create a table with all objects in range for the
     // iterator function:
     lua_newtable(l);
-    // FIXME: this badly needs a quadtree.
+    int index = 1;
     struct blitwizardobject* o = objects;
     while (o) {
         if (!o->is3d && !o->deleted) {
@@ -238,12 +240,21 @@ int luafuncs_scanFor2dObjects(lua_State* l) {
             if (o->graphics && o->graphics->sprite) {
                 if (o->graphics->pinnedToCamera >= 0) {
                     // skip pinned sprites
+                    o = o->next;
                     continue;
                 }
             }
 #endif
-            luacfuncs_pushbobjidref(l, o);
-        } 
+            double ox, oy, oz;
+            objectphysics_getPosition(o, &ox, &oy, &oz);
+            if ((ox - x) * (ox - x) + (oy - y) * (oy - y) <=
+                    range * range) {
+                lua_pushnumber(l, index);
+                luacfuncs_pushbobjidref(l, o);
+                lua_settable(l, -3);
+                index++;
+            }
+        }
         o = o->next;
     }
 
@@ -996,7 +1007,7 @@ int luafuncs_object_setPosition(lua_State* l) {
     }
     objectphysics_setPosition(obj, x, y, z);
 #ifdef USE_GRAPHICS
-    luacfuncs_objectgraphics_updatePosition(obj);
+    luacfuncs_objectgraphics_updatePosition(obj, 1);
 #endif
     return 0;
 }
@@ -1847,7 +1858,7 @@ int luacfuncs_object_doAllSteps(int count) {
     return count;
 }
 
-void luacfuncs_object_updateGraphics(void) {
+void luacfuncs_object_updateGraphics(double interpolation) {
 #ifdef USE_GRAPHICS
     lua_State* l = luastate_GetStatePtr();
     // update visual representations of objects:
@@ -1884,7 +1895,7 @@ void luacfuncs_object_updateGraphics(void) {
             }
         }
 
-        luacfuncs_objectgraphics_updatePosition(o);
+        luacfuncs_objectgraphics_updatePosition(o, interpolation);
         o = o->next;
     }
 #endif
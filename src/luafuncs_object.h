@@ -88,8 +88,10 @@ struct blitwizardobject* o);
 // it has done (not necessarily as much as you advised!).
 int luacfuncs_object_doAllSteps(int count);
 
-// update the object's graphics:
-void luacfuncs_object_updateGraphics(void);
+// update the object's graphics. interpolation is the fraction of the
+// current physics step which has passed (see main.c), objects driven
+// by physics are shown blended between their last two states by it:
+void luacfuncs_object_updateGraphics(double interpolation);
 
 // get/set object transparency (0 solid, 1 invisible):
 int luafuncs_object_getTransparency(lua_State* l);
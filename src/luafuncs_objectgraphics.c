@@ -130,17 +130,17 @@ void luacfuncs_objectgraphics_updateParallax(struct blitwizardobject *o) {
     }
 }
 
-void luacfuncs_objectgraphics_updatePosition(struct blitwizardobject *o) {
+void luacfuncs_objectgraphics_updatePosition(struct blitwizardobject *o,
+        double interpolation) {
     if (!object_checkgraphics(o)) {
         return;
     }
-    double x, y, z;
-    objectphysics_getPosition(o, &x, &y, &z);
     if (o->is3d) {
         // update 3d mesh position
     } else {
-        double angle;
-        objectphysics_get2dRotation(o, &angle);
+        double x, y, angle;
+        objectphysics_get2dInterpolatedTransform(o, interpolation,
+            &x, &y, &angle);
         // update sprite position
         if (o->graphics->sprite) {
             graphics2dsprites_move(o->graphics->sprite, x, y, angle);
@@ -44,8 +44,11 @@ struct blitwizardobject* o);
 int luafuncs_objectgraphics_needVisibleCallback(
 struct blitwizardobject* o);
 
-// Move graphical representation of object to correct position:
-void luacfuncs_objectgraphics_updatePosition(struct blitwizardobject* o);
+// Move graphical representation of object to correct position.
+// interpolation blends between the last two physics steps
+// (0 for the previous, 1 for the current one):
+void luacfuncs_objectgraphics_updatePosition(struct blitwizardobject* o,
+double interpolation);
 
 // Update the object's parallax effect to the sprite
 void luacfuncs_objectgraphics_updateParallax(struct blitwizardobject* o);
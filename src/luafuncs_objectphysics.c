@@ -48,6 +48,7 @@
 #include "blitwizardobject.h"
 #include "physics.h"
 #include "objectphysicsdata.h"
+#include "physicstilemap.h"
 #include "luafuncs_object.h"
 #include "luafuncs_objectphysics.h"
 #include "main.h"
@@ -178,13 +179,22 @@ int luafuncs_globalcollision3dcallback_unprotected(void* userdata, struct physic
     return 1;
 }
 
-void luacfuncs_object_initialisePhysicsCallbacks(void) {
+void luacfuncs_object_initialisePhysicsCallbacks(void* world) {
 #ifdef USE_PHYSICS2D
-    physics_set2dCollisionCallback(main_DefaultPhysics2dPtr(),
+    physics_set2dCollisionCallback(world,
     &luafuncs_globalcollision2dcallback_unprotected, NULL);
 #endif
 }
 
+// Get the physics world an object's collision shall be created in:
+static struct physicsworld* objectphysics_getWorld(
+struct blitwizardobject* obj) {
+    if (obj->physics && obj->physics->world > 0) {
+        return main_Physics2dPtr(obj->physics->world);
+    }
+    return main_DefaultPhysics2dPtr();
+}
+
 /// Disable the physics simulation on an object. It will no longer collide
 // with anything.
 // @function disableCollision
@@ -198,6 +208,13 @@ int luafuncs_object_disableCollision(lua_State* l) {
         return 0;
     }
 
+#ifdef USE_PHYSICS2D
+    if (obj->physics->tilemap) {
+        physicstilemap_destroy(obj->physics->tilemap);
+        obj->physics->tilemap = NULL;
+    }
+#endif
+
     if (obj->physics->object) {
         // transfer position/rotation first:
         if (obj->is3d) {
@@ -751,18 +768,41 @@ int luafuncs_enableCollision(lua_State* l, int movable) {
         obj->physics = malloc(sizeof(struct objectphysicsdata));
         memset(obj->physics, 0, sizeof(*(obj->physics)));
     }
+#ifdef USE_PHYSICS2D
+    if (obj->physics->tilemap) {
+        // no longer a tile map:
+        physicstilemap_destroy(obj->physics->tilemap);
+        obj->physics->tilemap = NULL;
+    }
+#endif
 
     // remember the old representation if any:
     struct physicsobject* old = obj->physics->object;
 
     // create a physics object from the shapes:
-    obj->physics->object = physics_createObject(main_DefaultPhysics2dPtr(),
+    obj->physics->object = physics_createObject(
+    objectphysics_getWorld(obj),
     obj, movable, shapes, argcount);
     physics_destroyShapes(shapes, argcount);
 
+    // apply collision filter, if any:
+#ifdef USE_PHYSICS2D
+    if (!obj->is3d && obj->physics->collisionfilterset) {
+        physics_set2dCollisionFilter(obj->physics->object,
+        obj->physics->collisioncategorybits,
+        obj->physics->collisionmaskbits,
+        obj->physics->collisiongroup);
+    }
+#endif
+
     // destroy old representation after transferring settings:
     if (old) {
         transferbodysettings(old, obj->physics->object);
+#ifdef USE_PHYSICS2D
+        if (!obj->is3d) {
+            physics_transfer2dIgnoredCollisions(old, obj->physics->object);
+        }
+#endif
         physics_destroyObject(old);
     } else {
         // if no old representation, transfer over the current position:
@@ -850,11 +890,14 @@ struct blitwizardobject* obj) {
         newscfx, newscfy, newscfz);
 #endif
     }
-    // remember we did this scaling:
-    obj->physics->phullx = newscfx;
-    obj->physics->phully = newscfy;
+    // remember the scale we did this scaling for:
     if (obj->is3d) {
-        obj->physics->phullz = newscfz;
+        obj->physics->phullx = obj->scale3d.x;
+        obj->physics->phully = obj->scale3d.y;
+        obj->physics->phullz = obj->scale3d.z;
+    } else {
+        obj->physics->phullx = obj->scale2d.x;
+        obj->physics->phully = obj->scale2d.y;
     }
 }
 
@@ -948,6 +991,12 @@ int luafuncs_object_enableStaticCollision(lua_State* l) {
 
 int luafuncs_freeObjectPhysicsData(struct objectphysicsdata* d) {
     // free the given physics data
+#ifdef USE_PHYSICS2D
+    if (d->tilemap) {
+        physicstilemap_destroy(d->tilemap);
+        d->tilemap = NULL;
+    }
+#endif
     if (d->object) {
         // void collision callback
         /*char funcname[200];
@@ -1468,6 +1517,350 @@ int luafuncs_object_setRestitution(lua_State* l) {
     return 0;
 }
 
+#ifdef USE_PHYSICS2D
+/// Turn a 2d object into a tile map with collision, e.g. for the
+// ground and walls of a platformer level. This is a lot faster than
+// enabling collision for one object per tile: the outline of all solid
+// tiles is combined into a few long collision edges, which also avoids
+// other objects getting stuck at the seams between tiles.
+//
+// The top left corner of the first tile is at the object's current
+// position, and the map extends towards positive x and y. Use
+// @{blitwizard.object:setTileCollision|setTileCollision} to change
+// single tiles later.
+//
+// Any other collision of the object is disabled, and the map doesn't
+// move when the object does.
+// @function enableTileCollision
+// @tparam number columns amount of tile columns
+// @tparam number rows amount of tile rows
+// @tparam number tilewidth width of a tile in game units
+// @tparam number tileheight height of a tile in game units
+// @tparam table solid (optional) a list with one entry per tile, row by row: true for solid tiles, false for empty ones. If not given, all tiles start out empty
+// @usage
+// -- a small room with walls on the left and right and a floor:
+// local room = blitwizard.object:new(blitwizard.object.o2d)
+// room:setPosition(-2, -1)
+// room:enableTileCollision(4, 3, 1, 1, {
+//     true, false, false, true,
+//     true, false, false, true,
+//     true, true, true, true,
+// })
+int luafuncs_object_enableTileCollision(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    struct blitwizardobject* obj = toblitwizardobject(l, 1, 0,
+    "blitwizard.object:enableTileCollision");
+    if (obj->is3d) {
+        return haveluaerror(l, "not a 2d object");
+    }
+    if (obj->parallax != 1) {
+        return haveluaerror(l, "cannot use collision on object with "
+        "parallax effect");
+    }
+    int i = 2;
+    while (i <= 5) {
+        if (lua_type(l, i) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, i,
+            "blitwizard.object:enableTileCollision", "number",
+            lua_strtype(l, i));
+        }
+        i++;
+    }
+    int columns = lua_tointeger(l, 2);
+    int rows = lua_tointeger(l, 3);
+    if (columns <= 0 || rows <= 0) {
+        return haveluaerror(l, badargument2, 2,
+        "blitwizard.object:enableTileCollision",
+        "map needs at least one column and row");
+    }
+    if (lua_tonumber(l, 4) <= 0 || lua_tonumber(l, 5) <= 0) {
+        return haveluaerror(l, badargument2, 4,
+        "blitwizard.object:enableTileCollision",
+        "tile size needs to be positive");
+    }
+    if (lua_gettop(l) >= 6 && lua_type(l, 6) != LUA_TNIL) {
+        if (lua_type(l, 6) != LUA_TTABLE) {
+            return haveluaerror(l, badargument1, 6,
+            "blitwizard.object:enableTileCollision", "table",
+            lua_strtype(l, 6));
+        }
+        if ((int)lua_rawlen(l, 6) != columns * rows) {
+            return haveluaerror(l, badargument2, 6,
+            "blitwizard.object:enableTileCollision",
+            "list needs one entry for each tile");
+        }
+    }
+
+    // get rid of any previous collision:
+    luafuncs_object_disableCollision(l);
+    if (!obj->physics) {
+        obj->physics = malloc(sizeof(struct objectphysicsdata));
+        memset(obj->physics, 0, sizeof(*(obj->physics)));
+    }
+
+    double x, y, z;
+    objectphysics_getPosition(obj, &x, &y, &z);
+    obj->physics->tilemap = physicstilemap_create(objectphysics_getWorld(obj),
+        obj, columns, rows, lua_tonumber(l, 4), lua_tonumber(l, 5), x, y);
+    if (!obj->physics->tilemap) {
+        return haveluaerror(l, "failed to allocate tile map");
+    }
+    if (lua_gettop(l) >= 6 && lua_type(l, 6) == LUA_TTABLE) {
+        i = 0;
+        while (i < columns * rows) {
+            lua_rawgeti(l, 6, i + 1);
+            int solid = lua_toboolean(l, -1);
+            if (lua_type(l, -1) == LUA_TNUMBER) {
+                solid = (lua_tonumber(l, -1) != 0);
+            }
+            lua_pop(l, 1);
+            if (solid) {
+                physicstilemap_setSolid(obj->physics->tilemap,
+                    i % columns, i / columns, 1);
+            }
+            i++;
+        }
+    }
+    if (!physicstilemap_update(obj->physics->tilemap)) {
+        return haveluaerror(l, "failed to create tile map collision");
+    }
+    return 0;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Change whether a single tile of a tile map is solid or not.
+// See @{blitwizard.object:enableTileCollision|enableTileCollision}.
+// Only the collision around the changed tile is rebuilt.
+// @function setTileCollision
+// @tparam number column the column of the tile, starting with 1
+// @tparam number row the row of the tile, starting with 1
+// @tparam boolean solid true if the tile shall be solid, false if not
+int luafuncs_object_setTileCollision(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    struct blitwizardobject* obj = toblitwizardobject(l, 1, 0,
+    "blitwizard.object:setTileCollision");
+    if (!obj->physics || !obj->physics->tilemap) {
+        return haveluaerror(l, "object has no tile collision - "
+        "use object:enableTileCollision first");
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2,
+        "blitwizard.object:setTileCollision", "number",
+        lua_strtype(l, 2));
+    }
+    if (lua_type(l, 3) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 3,
+        "blitwizard.object:setTileCollision", "number",
+        lua_strtype(l, 3));
+    }
+    if (lua_type(l, 4) != LUA_TBOOLEAN) {
+        return haveluaerror(l, badargument1, 4,
+        "blitwizard.object:setTileCollision", "boolean",
+        lua_strtype(l, 4));
+    }
+    physicstilemap_setSolid(obj->physics->tilemap,
+        lua_tointeger(l, 2) - 1, lua_tointeger(l, 3) - 1,
+        lua_toboolean(l, 4));
+    if (!physicstilemap_update(obj->physics->tilemap)) {
+        return haveluaerror(l, "failed to update tile map collision");
+    }
+    return 0;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Put this 2d object into another physics world (see
+// @{blitwizard.physics.newWorld2d}), or back into the default world.
+// Objects in different worlds never collide with each other.
+//
+// The world can only be changed while collision is disabled, so call
+// this before @{blitwizard.object:enableMovableCollision|
+// object:enableMovableCollision} and the like.
+// @function setPhysicsWorld
+// @tparam number world the world id as returned by
+// @{blitwizard.physics.newWorld2d}, or 1 for the default world
+int luafuncs_object_setPhysicsWorld(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    struct blitwizardobject* obj = toblitwizardobject(l, 1, 0,
+    "blitwizard.object:setPhysicsWorld");
+    if (obj->is3d) {
+        return haveluaerror(l, "only 2d objects can be put into "
+        "other physics worlds");
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.object:setPhysicsWorld", "number",
+        lua_strtype(l, 2));
+    }
+    int world = lua_tointeger(l, 2);
+    if (!main_Physics2dPtr(world)) {
+        return haveluaerror(l, badargument2, 1,
+        "blitwizard.object:setPhysicsWorld", "no such physics world");
+    }
+    if (obj->physics && (obj->physics->object || obj->physics->tilemap)) {
+        return haveluaerror(l, "the physics world can't be changed "
+        "while collision is enabled - use object:disableCollision first");
+    }
+    if (!obj->physics) {
+        obj->physics = malloc(sizeof(struct objectphysicsdata));
+        memset(obj->physics, 0, sizeof(*(obj->physics)));
+    }
+    obj->physics->world = world;
+    return 0;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Get the physics world this 2d object is in
+// (see @{blitwizard.object:setPhysicsWorld|object:setPhysicsWorld}).
+// @function getPhysicsWorld
+// @treturn number the world id, 1 for the default world
+int luafuncs_object_getPhysicsWorld(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    struct blitwizardobject* obj = toblitwizardobject(l, 1, 0,
+    "blitwizard.object:getPhysicsWorld");
+    if (obj->physics && obj->physics->world > 0) {
+        lua_pushnumber(l, obj->physics->world);
+    } else {
+        lua_pushnumber(l, 1);
+    }
+    return 1;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Set which other 2d objects this object collides with, based on
+// collision categories. Every object is in one category (from 1 to 16,
+// by default 1), and collides with all objects whose category is in its
+// list of categories to collide with (by default all), as long as
+// the other object's list contains its category as well.
+//
+// Additionally, objects can be put into a group. Objects in the same
+// group with a positive number always collide, objects in the same
+// group with a negative number never collide, regardless of their
+// categories.
+//
+// Objects which don't collide are sorted out before any collision
+// handling happens, so this is a lot faster than returning false in
+// the onCollision event.
+// @function setCollisionFilter
+// @tparam number category the category of the object from 1 to 16
+// @tparam table collides_with (optional) a list of categories the object collides with, or nil for all
+// @tparam number group (optional) the group of the object, or 0 for none (the default)
+// @usage
+// -- bullets (category 2) only hit enemies (category 3):
+// bullet:setCollisionFilter(2, {3})
+// enemy:setCollisionFilter(3, {1, 2})
+int luafuncs_object_setCollisionFilter(lua_State* l) {
+    char func[] = "blitwizard.object:setCollisionFilter";
+    struct blitwizardobject* obj = toblitwizardobject(l, 1, 0, func);
+    if (!obj->physics || !obj->physics->object) {
+        lua_pushstring(l, "object has no shape");
+        return lua_error(l);
+    }
+    if (obj->is3d) {
+        return haveluaerror(l, "collision filters are only "
+        "supported for 2d objects");
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1, func, "number",
+        lua_strtype(l, 2));
+    }
+    int category = lua_tointeger(l, 2);
+    if (category < 1 || category > 16) {
+        return haveluaerror(l, badargument2, 1, func,
+        "category needs to be between 1 and 16");
+    }
+    unsigned int mask = 0xFFFF;
+    if (lua_gettop(l) >= 3 && lua_type(l, 3) != LUA_TNIL) {
+        if (lua_type(l, 3) != LUA_TTABLE) {
+            return haveluaerror(l, badargument1, 2, func, "table",
+            lua_strtype(l, 3));
+        }
+        mask = 0;
+        int i = 1;
+        while (1) {
+            lua_pushnumber(l, i);
+            lua_gettable(l, 3);
+            if (lua_type(l, -1) == LUA_TNIL) {
+                lua_pop(l, 1);
+                break;
+            }
+            int c = lua_tointeger(l, -1);
+            if (lua_type(l, -1) != LUA_TNUMBER || c < 1 || c > 16) {
+                return haveluaerror(l, badargument2, 2, func,
+                "list entries need to be categories between 1 and 16");
+            }
+            lua_pop(l, 1);
+            mask |= (1 << (c - 1));
+            i++;
+        }
+    }
+    int group = 0;
+    if (lua_gettop(l) >= 4 && lua_type(l, 4) != LUA_TNIL) {
+        if (lua_type(l, 4) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 3, func, "number",
+            lua_strtype(l, 4));
+        }
+        group = lua_tointeger(l, 4);
+        if (group < -32768 || group > 32767) {
+            return haveluaerror(l, badargument2, 3, func,
+            "group needs to be between -32768 and 32767");
+        }
+    }
+    obj->physics->collisionfilterset = 1;
+    obj->physics->collisioncategorybits = (1 << (category - 1));
+    obj->physics->collisionmaskbits = mask;
+    obj->physics->collisiongroup = group;
+    physics_set2dCollisionFilter(obj->physics->object,
+    obj->physics->collisioncategorybits, obj->physics->collisionmaskbits,
+    obj->physics->collisiongroup);
+    return 0;
+}
+
+/// Make this 2d object never collide with one specific other object,
+// or collide with it again. Unlike returning false in the onCollision
+// event, this happens before any collision handling.
+//
+// This is kept when collision is enabled again with another shape,
+// but it is forgotten when collision is disabled on either object.
+// @function ignoreCollisionWith
+// @tparam userdata object the other object
+// @tparam boolean ignore (optional) true to ignore collisions (the default), false to collide again
+int luafuncs_object_ignoreCollisionWith(lua_State* l) {
+    char func[] = "blitwizard.object:ignoreCollisionWith";
+    struct blitwizardobject* obj = toblitwizardobject(l, 1, 0, func);
+    struct blitwizardobject* other = toblitwizardobject(l, 2, 1, func);
+    if (!obj->physics || !obj->physics->object ||
+    !other->physics || !other->physics->object) {
+        lua_pushstring(l, "object has no shape");
+        return lua_error(l);
+    }
+    if (obj->is3d || other->is3d) {
+        return haveluaerror(l, "ignoring collisions is only "
+        "supported for 2d objects");
+    }
+    int ignore = 1;
+    if (lua_gettop(l) >= 3 && lua_type(l, 3) != LUA_TNIL) {
+        if (lua_type(l, 3) != LUA_TBOOLEAN) {
+            return haveluaerror(l, badargument1, 2, func, "boolean",
+            lua_strtype(l, 3));
+        }
+        ignore = lua_toboolean(l, 3);
+    }
+    if (!physics_set2dIgnoreCollision(obj->physics->object,
+    other->physics->object, ignore)) {
+        return haveluaerror(l, "failed to allocate ignored collision");
+    }
+    return 0;
+}
+#endif
+
 
 void transferbodysettings(struct physicsobject* oldbody,
 struct physicsobject* newbody) {
@@ -1625,6 +2018,20 @@ double* angle) {
 #endif
 }
 
+void objectphysics_get2dInterpolatedTransform(struct blitwizardobject* obj,
+double interpolation, double* x, double* y, double* angle) {
+#ifdef USE_PHYSICS2D
+    if (!obj->is3d && obj->physics && obj->physics->object) {
+        physics_get2dInterpolatedTransform(obj->physics->object,
+        interpolation, x, y, angle);
+        return;
+    }
+#endif
+    double z;
+    objectphysics_getPosition(obj, x, y, &z);
+    objectphysics_get2dRotation(obj, angle);
+}
+
 void objectphysics_get3dRotation(struct blitwizardobject* obj,
 double* qx, double* qy, double* qz, double* qrot) {
 #ifdef USE_PHYSICS3D
@@ -1642,11 +2049,3 @@ double* qx, double* qy, double* qz, double* qrot) {
 #endif
 }
 
-#if (defined(USE_PHYSICS2D) || defined(USE_PHYSICS3D))
-void luacfuncs_objectphysics_replaceObjectRef(
-        struct physicsobject* old, struct physicsobject* new) {
-    struct blitwizardobject* obj = physics_getObjectUserdata(old);
-    obj->physics->object = new;    
-}
-#endif
-
@@ -49,6 +49,12 @@ int luafuncs_object_setFriction(lua_State* l);
 int luafuncs_object_setAngularDamping(lua_State* l);
 int luafuncs_object_setLinearDamping(lua_State* l);
 int luafuncs_object_setGravity(lua_State* l);
+int luafuncs_object_setCollisionFilter(lua_State* l);
+int luafuncs_object_enableTileCollision(lua_State* l);
+int luafuncs_object_setTileCollision(lua_State* l);
+int luafuncs_object_setPhysicsWorld(lua_State* l);
+int luafuncs_object_getPhysicsWorld(lua_State* l);
+int luafuncs_object_ignoreCollisionWith(lua_State* l);
 
 int luafuncs_freeObjectPhysicsData(struct objectphysicsdata* d);
 
@@ -75,6 +81,10 @@ void objectphysics_set2dRotation(struct blitwizardobject* obj,
 double angle);
 void objectphysics_get3dRotation(struct blitwizardobject* obj,
 double* qx, double* qy, double* qz, double* qrot);
+// position/rotation blended between the last two physics steps,
+// interpolation being 0 for the previous and 1 for the current one:
+void objectphysics_get2dInterpolatedTransform(struct blitwizardobject* obj,
+double interpolation, double* x, double* y, double* angle);
 void objectphysics_getPosition(struct blitwizardobject* obj,
 double* x, double* y, double* z);
 void objectphysics_setPosition(struct blitwizardobject* obj,
@@ -84,13 +94,7 @@ double angle, int anglespecified);
 void objectphysics_warp3d(struct blitwizardobject* obj, double x, double y,
 double z, double qx, double qy, double qz, double qrot, int anglespecified);
 
-void luacfuncs_object_initialisePhysicsCallbacks(void);
-
-// replace all usages of a given physics object ref with another:
-#if (defined(USE_PHYSICS2D) || defined(USE_PHYSICS3D))
-void luacfuncs_objectphysics_replaceObjectRef(
-    struct physicsobject* old, struct physicsobject* new);
-#endif
+void luacfuncs_object_initialisePhysicsCallbacks(void* world);
 
 #endif  // BLITWIZARD_LUAFUNCS_OBJECTPHYSICS_H_
 
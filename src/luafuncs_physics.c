@@ -52,6 +52,29 @@
 #include "luafuncs_physics.h"
 #include "main.h"
 
+#ifdef USE_PHYSICS2D
+// get the 2d physics world from the optional world id at the given
+// index, or the default world if none. raises an error if there is
+// no such world:
+static struct physicsworld* luacfuncs_physics_toWorld2d(lua_State* l,
+        int index, const char* func) {
+    if (lua_gettop(l) < index || lua_type(l, index) == LUA_TNIL) {
+        return main_DefaultPhysics2dPtr();
+    }
+    if (lua_type(l, index) != LUA_TNUMBER) {
+        haveluaerror(l, badargument1, index, func, "number",
+        lua_strtype(l, index));
+        return NULL;
+    }
+    struct physicsworld* world = main_Physics2dPtr(lua_tointeger(l, index));
+    if (!world) {
+        haveluaerror(l, badargument2, index, func,
+        "no such physics world");
+        return NULL;
+    }
+    return world;
+}
+#endif
 
 int luafuncs_ray(lua_State* l, int use3d) {
     char func[64];
@@ -108,6 +131,16 @@ int luafuncs_ray(lua_State* l, int use3d) {
     double normalx,normaly;
     double normalz = 0;
 
+#ifdef USE_PHYSICS2D
+    struct physicsworld* world2d = NULL;
+    if (!use3d) {
+        world2d = luacfuncs_physics_toWorld2d(l, 5, func);
+        if (!world2d) {
+            return 0;
+        }
+    }
+#endif
+
     int returnvalue;
     if (use3d) {
 #ifdef USE_PHYSICS3D
@@ -122,7 +155,7 @@ int luafuncs_ray(lua_State* l, int use3d) {
 #endif
     } else {
 #ifdef USE_PHYSICS2D
-        returnvalue = physics_ray2d(main_DefaultPhysics2dPtr(),
+        returnvalue = physics_ray2d(world2d,
         startx, starty,
         targetx, targety,
         &hitpointx, &hitpointy,
@@ -163,6 +196,7 @@ int luafuncs_ray(lua_State* l, int use3d) {
 // @tparam number starty Ray starting point, y coordinate
 // @tparam number targetx Ray target point, x coordinate
 // @tparam number targety Ray target point, y coordinate
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to use, the default world if not specified
 // @treturn userdata Returns a @{blitwizard.object|blitwizard object} if an object was hit by the ray (the closest object that was hit), or otherwise it returns nil
 int luafuncs_ray2d(lua_State* l) {
     return luafuncs_ray(l, 0);
@@ -182,10 +216,322 @@ int luafuncs_ray3d(lua_State* l) {
     return luafuncs_ray(l, 1);
 }
 
+#ifdef USE_PHYSICS2D
+// check for a number argument, returns 0 and raises an error if it isn't:
+static int luacfuncs_physics_checkNumbers(lua_State* l, int count,
+        const char* func) {
+    int i = 1;
+    while (i <= count) {
+        if (lua_type(l, i) != LUA_TNUMBER) {
+            haveluaerror(l, badargument1, i, func, "number",
+            lua_strtype(l, i));
+            return 0;
+        }
+        i++;
+    }
+    return 1;
+}
+
+// read a table of numbers into a newly allocated array. count has to
+// be a multiple of multipleof, returns NULL and raises an error if not:
+static double* luacfuncs_physics_toNumberArray(lua_State* l, int index,
+        int multipleof, int* count, const char* func) {
+    if (lua_type(l, index) != LUA_TTABLE) {
+        haveluaerror(l, badargument1, index, func, "table",
+        lua_strtype(l, index));
+        return NULL;
+    }
+    int len = lua_rawlen(l, index);
+    if (len <= 0 || len % multipleof != 0) {
+        haveluaerror(l, badargument2, index, func,
+        "table has wrong amount of numbers");
+        return NULL;
+    }
+    double* numbers = malloc(sizeof(*numbers) * len);
+    if (!numbers) {
+        haveluaerror(l, "failed to allocate memory");
+        return NULL;
+    }
+    int i = 0;
+    while (i < len) {
+        lua_rawgeti(l, index, i + 1);
+        if (lua_type(l, -1) != LUA_TNUMBER) {
+            free(numbers);
+            haveluaerror(l, badargument2, index, func,
+            "table contains something which isn't a number");
+            return NULL;
+        }
+        numbers[i] = lua_tonumber(l, -1);
+        lua_pop(l, 1);
+        i++;
+    }
+    *count = len;
+    return numbers;
+}
+
+// push a table list with the blitwizard objects of the given
+// physics objects:
+static int luacfuncs_physics_pushObjectList(lua_State* l,
+        struct physicsobject** objects, int count) {
+    if (count < 0) {
+        return haveluaerror(l, "failed to allocate memory");
+    }
+    lua_createtable(l, count, 0);
+    int index = 1;
+    int i = 0;
+    while (i < count) {
+        struct blitwizardobject* o = physics_getObjectUserdata(objects[i]);
+        if (o && !o->deleted) {
+            lua_pushnumber(l, index);
+            luacfuncs_pushbobjidref(l, o);
+            lua_settable(l, -3);
+            index++;
+        }
+        i++;
+    }
+    return 1;
+}
+#endif
+
+/// Find all 2d objects with a collision shape whose bounding box
+// overlaps the given rectangle.
+//
+// This is a very fast way to find out what is in a given area, since
+// only the objects close to it are checked. If you need exact
+// overlap tests, use @{blitwizard.physics.query2dPolygon|query2dPolygon}.
+//
+// Objects without collision enabled are never found.
+// @function query2dBox
+// @tparam number x1 x coordinate of the first rectangle corner
+// @tparam number y1 y coordinate of the first rectangle corner
+// @tparam number x2 x coordinate of the opposite rectangle corner
+// @tparam number y2 y coordinate of the opposite rectangle corner
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to search, the default world if not specified
+// @treturn table a list of all @{blitwizard.object|objects} found
+int luafuncs_query2dBox(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    if (!luacfuncs_physics_checkNumbers(l, 4,
+            "blitwizard.physics.query2dBox")) {
+        return 0;
+    }
+    struct physicsworld* world = luacfuncs_physics_toWorld2d(l, 5,
+        "blitwizard.physics.query2dBox");
+    if (!world) {
+        return 0;
+    }
+    struct physicsobject** objects;
+    int count = physics_query2dBox(world,
+        lua_tonumber(l, 1), lua_tonumber(l, 2),
+        lua_tonumber(l, 3), lua_tonumber(l, 4), &objects);
+    return luacfuncs_physics_pushObjectList(l, objects, count);
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Find all 2d objects whose collision shape overlaps the given circle.
+// @function query2dCircle
+// @tparam number x x coordinate of the circle's center
+// @tparam number y y coordinate of the circle's center
+// @tparam number radius the radius of the circle
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to search, the default world if not specified
+// @treturn table a list of all @{blitwizard.object|objects} found
+// @usage
+// -- find everything an explosion at 3, 2 affects:
+// for _, obj in ipairs(blitwizard.physics.query2dCircle(3, 2, 1.5)) do
+//     print("Object caught in explosion: " .. tostring(obj))
+// end
+int luafuncs_query2dCircle(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    if (!luacfuncs_physics_checkNumbers(l, 3,
+            "blitwizard.physics.query2dCircle")) {
+        return 0;
+    }
+    struct physicsworld* world = luacfuncs_physics_toWorld2d(l, 4,
+        "blitwizard.physics.query2dCircle");
+    if (!world) {
+        return 0;
+    }
+    struct physicsobject** objects;
+    int count = physics_query2dCircle(world,
+        lua_tonumber(l, 1), lua_tonumber(l, 2), lua_tonumber(l, 3),
+        &objects);
+    return luacfuncs_physics_pushObjectList(l, objects, count);
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Find all 2d objects whose collision shape overlaps the given polygon.
+// @function query2dPolygon
+// @tparam table points a list of x, y coordinates of the polygon's points, e.g. { x1, y1, x2, y2, x3, y3 }. The polygon needs to be convex and can have 3 to 8 points
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to search, the default world if not specified
+// @treturn table a list of all @{blitwizard.object|objects} found
+// @usage
+// -- check what is in a guard's triangular field of view:
+// local seen = blitwizard.physics.query2dPolygon({0, 0, 5, -2, 5, 2})
+int luafuncs_query2dPolygon(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    struct physicsworld* world = luacfuncs_physics_toWorld2d(l, 2,
+        "blitwizard.physics.query2dPolygon");
+    if (!world) {
+        return 0;
+    }
+    int count;
+    double* points = luacfuncs_physics_toNumberArray(l, 1, 2, &count,
+        "blitwizard.physics.query2dPolygon");
+    if (!points) {
+        return 0;
+    }
+    struct physicsobject** objects;
+    int found = physics_query2dPolygon(world,
+        points, count / 2, &objects);
+    free(points);
+    if (found < 0) {
+        return haveluaerror(l, badargument2, 1,
+        "blitwizard.physics.query2dPolygon",
+        "not a valid convex polygon with 3 to 8 points");
+    }
+    return luacfuncs_physics_pushObjectList(l, objects, found);
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Shoot out a ray like @{blitwizard.physics.ray2d|ray2d}, but return
+// all objects hit along it instead of just the first one.
+// @function ray2dAll
+// @tparam number startx Ray starting point, x coordinate
+// @tparam number starty Ray starting point, y coordinate
+// @tparam number targetx Ray target point, x coordinate
+// @tparam number targety Ray target point, y coordinate
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to use, the default world if not specified
+// @treturn table a list of all @{blitwizard.object|objects} hit, the closest one first
+// @treturn table a list with the x, y coordinates of the hit point of each object, e.g. { x1, y1, x2, y2, ... }
+int luafuncs_ray2dAll(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    if (!luacfuncs_physics_checkNumbers(l, 4,
+            "blitwizard.physics.ray2dAll")) {
+        return 0;
+    }
+    struct physicsworld* world = luacfuncs_physics_toWorld2d(l, 5,
+        "blitwizard.physics.ray2dAll");
+    if (!world) {
+        return 0;
+    }
+    struct physicsrayhit2d* hits;
+    int count = physics_ray2dAll(world,
+        lua_tonumber(l, 1), lua_tonumber(l, 2),
+        lua_tonumber(l, 3), lua_tonumber(l, 4), &hits);
+    if (count < 0) {
+        return haveluaerror(l, "failed to allocate memory");
+    }
+    lua_createtable(l, count, 0);
+    lua_createtable(l, count * 2, 0);
+    int index = 1;
+    int i = 0;
+    while (i < count) {
+        struct blitwizardobject* o = physics_getObjectUserdata(
+            hits[i].object);
+        if (o && !o->deleted) {
+            lua_pushnumber(l, index);
+            luacfuncs_pushbobjidref(l, o);
+            lua_settable(l, -4);
+            lua_pushnumber(l, index * 2 - 1);
+            lua_pushnumber(l, hits[i].hitpointx);
+            lua_settable(l, -3);
+            lua_pushnumber(l, index * 2);
+            lua_pushnumber(l, hits[i].hitpointy);
+            lua_settable(l, -3);
+            index++;
+        }
+        i++;
+    }
+    return 2;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Shoot out many rays at once, e.g. for line of sight checks of all
+// your AI agents. Each ray works like one @{blitwizard.physics.ray2d|ray2d}
+// call, but all of them are done in one go which is a lot faster than
+// calling ray2d repeatedly.
+// @function ray2dBatch
+// @tparam table rays a list of rays with four numbers for each: startx, starty, targetx, targety
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to use, the default world if not specified
+// @treturn table a list with one entry per ray: the first @{blitwizard.object|object} it hit, or false if it hit nothing
+// @treturn table a list with the x, y coordinates of the hit point for each ray, or its target if it hit nothing
+// @usage
+// -- check which of two enemies can see the player at px, py:
+// local hit = blitwizard.physics.ray2dBatch({
+//     e1x, e1y, px, py,
+//     e2x, e2y, px, py,
+// })
+// if hit[1] == player then
+//     print("Enemy 1 can see the player")
+// end
+int luafuncs_ray2dBatch(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    struct physicsworld* world = luacfuncs_physics_toWorld2d(l, 2,
+        "blitwizard.physics.ray2dBatch");
+    if (!world) {
+        return 0;
+    }
+    int count;
+    double* rays = luacfuncs_physics_toNumberArray(l, 1, 4, &count,
+        "blitwizard.physics.ray2dBatch");
+    if (!rays) {
+        return 0;
+    }
+    count /= 4;
+    struct physicsrayhit2d* hits = malloc(sizeof(*hits) * count);
+    if (!hits) {
+        free(rays);
+        return haveluaerror(l, "failed to allocate memory");
+    }
+    physics_ray2dBatch(world, count, rays, hits);
+
+    lua_createtable(l, count, 0);
+    lua_createtable(l, count * 2, 0);
+    int i = 0;
+    while (i < count) {
+        struct blitwizardobject* o = NULL;
+        double x = rays[i * 4 + 2];
+        double y = rays[i * 4 + 3];
+        if (hits[i].object) {
+            o = physics_getObjectUserdata(hits[i].object);
+            x = hits[i].hitpointx;
+            y = hits[i].hitpointy;
+        }
+        lua_pushnumber(l, i + 1);
+        if (o && !o->deleted) {
+            luacfuncs_pushbobjidref(l, o);
+        } else {
+            lua_pushboolean(l, 0);
+        }
+        lua_settable(l, -4);
+        lua_pushnumber(l, i * 2 + 1);
+        lua_pushnumber(l, x);
+        lua_settable(l, -3);
+        lua_pushnumber(l, i * 2 + 2);
+        lua_pushnumber(l, y);
+        lua_settable(l, -3);
+        i++;
+    }
+    free(hits);
+    free(rays);
+    return 2;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
 /// Set the world gravity for all 2d objects.
 // @function set2dGravity
 // @tparam number x gravity force on x axis
 // @tparam number y gravity force on y axis
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to change, the default world if not specified
 int luafuncs_set2dGravity(lua_State* l) {
 #ifdef USE_PHYSICS2D
     if (lua_type(l, 1) != LUA_TNUMBER) {
@@ -196,12 +542,336 @@ int luafuncs_set2dGravity(lua_State* l) {
         return haveluaerror(l, badargument1, 2,
         "blitwizard.physics.set2dGravity", "number", lua_strtype(l, 2));
     }
-    physics_set2dWorldGravity(main_DefaultPhysics2dPtr(),
+    struct physicsworld* world = luacfuncs_physics_toWorld2d(l, 3,
+        "blitwizard.physics.set2dGravity");
+    if (!world) {
+        return 0;
+    }
+    physics_set2dWorldGravity(world,
     lua_tonumber(l, 1), lua_tonumber(l, 2));
     return 0;
 #endif
 }
 
+/// Create a new 2d physics world. Objects in different worlds never
+// collide with each other, and each world has its own gravity (see
+// @{blitwizard.physics.set2dGravity|set2dGravity}). Use
+// @{blitwizard.object:setPhysicsWorld|object:setPhysicsWorld} to put
+// objects into it.
+//
+// This is useful to simulate multiple independent areas, e.g. the
+// arenas of a game server. Worlds exist until blitwizard quits.
+// @function newWorld2d
+// @treturn number the id of the new world (the default world has id 1)
+// @usage
+// local arena = blitwizard.physics.newWorld2d()
+// local obj = blitwizard.object:new(blitwizard.object.o2d)
+// obj:setPhysicsWorld(arena)
+// obj:enableMovableCollision({type="circle", diameter=1})
+int luafuncs_newWorld2d(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    int world = main_Create2dPhysicsWorld();
+    if (!world) {
+        return haveluaerror(l, "failed to create physics world "
+        "(out of memory, or too many worlds)");
+    }
+    lua_pushnumber(l, world);
+    return 1;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Enable or disable parallel stepping. With parallel stepping enabled,
+// all 2d physics worlds (see @{blitwizard.physics.newWorld2d|newWorld2d})
+// are simulated concurrently on multiple threads, which is a lot faster
+// if you have many busy worlds.
+//
+// Collision events are still reported on the main thread after
+// all worlds did their step, one world after another in the order the
+// worlds were created. This is disabled by default.
+// @function setParallelStepping
+// @tparam boolean enabled true to step all worlds concurrently, false to step them one after another
+int luafuncs_setParallelStepping(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    if (lua_type(l, 1) != LUA_TBOOLEAN) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.physics.setParallelStepping", "boolean",
+        lua_strtype(l, 1));
+    }
+    main_SetParallelPhysics2d(lua_toboolean(l, 1));
+    return 0;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Take a snapshot of a 2d physics world: the position, rotation,
+// velocity and sleep state of all objects and the current contacts
+// between them. Use @{blitwizard.physics.restore2d|restore2d} to put
+// the world back to that state later, e.g. to roll back and re-simulate
+// a few steps in a networked game.
+//
+// Snapshots are only valid for the same world in the same running
+// blitwizard instance, and only as long as no object of the world was
+// created, removed or resized, or had its collision shape changed.
+// @function snapshot2d
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to snapshot, the default world if not specified
+// @treturn string the snapshot
+// @usage
+// local before = blitwizard.physics.snapshot2d()
+// -- ... some steps later:
+// if not blitwizard.physics.restore2d(before) then
+//     print("Objects changed, cannot roll back")
+// end
+int luafuncs_snapshot2d(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    struct physicsworld* world = luacfuncs_physics_toWorld2d(l, 1,
+        "blitwizard.physics.snapshot2d");
+    if (!world) {
+        return 0;
+    }
+    // reuse the buffer, since games will usually do this every step:
+    static char* buffer = NULL;
+    static size_t buffersize = 0;
+    size_t size = physics_snapshot2dWorld(world, buffer, buffersize);
+    if (size > buffersize) {
+        char* newbuffer = realloc(buffer, size);
+        if (!newbuffer) {
+            return haveluaerror(l, "failed to allocate memory");
+        }
+        buffer = newbuffer;
+        buffersize = size;
+        physics_snapshot2dWorld(world, buffer, buffersize);
+    }
+    lua_pushlstring(l, buffer, size);
+    return 1;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Restore a 2d physics world to a snapshot taken with
+// @{blitwizard.physics.snapshot2d|snapshot2d}. This fails if objects
+// of the world were created, removed or resized since the snapshot was
+// taken, or if the snapshot is from a different world. It also fails
+// when called from inside a collision callback.
+//
+// Stepping the world after restoring gives the same results as it did
+// the first time, with the exception of objects which were about to
+// fall asleep.
+// @function restore2d
+// @tparam string snapshot the snapshot to restore
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to restore, the default world if not specified
+// @treturn boolean true if the snapshot was restored, false if it doesn't match the world
+int luafuncs_restore2d(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    if (lua_type(l, 1) != LUA_TSTRING) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.physics.restore2d", "string", lua_strtype(l, 1));
+    }
+    struct physicsworld* world = luacfuncs_physics_toWorld2d(l, 2,
+        "blitwizard.physics.restore2d");
+    if (!world) {
+        return 0;
+    }
+    size_t size;
+    const char* snapshot = lua_tolstring(l, 1, &size);
+    lua_pushboolean(l, physics_restore2dWorld(world, snapshot, size));
+    return 1;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Set the solver quality of all 2d physics worlds. Each physics step
+// is split into the given amount of substeps, which are solved with the
+// given amount of iterations. Lower values are faster but objects
+// become less stable, e.g. stacks start to jitter and fast objects may
+// pass through thin walls.
+//
+// The defaults are 8 velocity and 3 position iterations with 2 substeps
+// (4 and 2 iterations on Android). If the
+// @{blitwizard.physics.setQualityGovernor|quality governor} is enabled,
+// this is the quality it returns to when there is enough time.
+// @function setStepQuality
+// @tparam number velocityIterations iterations for solving velocities (at least 1)
+// @tparam number positionIterations iterations for solving positions (at least 1)
+// @tparam number substeps substeps per physics step (1 to 16)
+int luafuncs_setStepQuality(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    int i = 1;
+    while (i <= 3) {
+        if (lua_type(l, i) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, i,
+            "blitwizard.physics.setStepQuality", "number",
+            lua_strtype(l, i));
+        }
+        if (lua_tointeger(l, i) < 1 || (i == 3 &&
+                lua_tointeger(l, i) > 16)) {
+            return haveluaerror(l, badargument2, i,
+            "blitwizard.physics.setStepQuality",
+            "value out of range");
+        }
+        i++;
+    }
+    main_SetPhysics2dQuality(lua_tointeger(l, 1), lua_tointeger(l, 2),
+        lua_tointeger(l, 3));
+    return 0;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Enable or disable the physics quality governor. While enabled, it
+// watches how long the physics steps take. If they take more than the
+// given share of real time, it lowers the
+// @{blitwizard.physics.setStepQuality|solver quality} step by step
+// (velocity iterations first, then position iterations, then substeps)
+// down to the given minimum. Once the steps are fast again, it raises
+// the quality back up.
+//
+// This keeps the game running smoothly with lots of physics objects,
+// instead of falling further and further behind. The governor is
+// disabled by default.
+// @function setQualityGovernor
+// @tparam boolean enabled true to enable the governor, false to disable it and return to full quality
+// @tparam number minVelocityIterations (optional) lowest amount of velocity iterations, defaults to 2
+// @tparam number minPositionIterations (optional) lowest amount of position iterations, defaults to 1
+// @tparam number minSubsteps (optional) lowest amount of substeps, defaults to 1
+// @tparam number budget (optional) share of real time physics steps may take before quality is lowered, defaults to 0.5
+// @usage
+// -- never go below 4 velocity iterations, and start lowering
+// -- the quality when physics take more than 30% of the time:
+// blitwizard.physics.setQualityGovernor(true, 4, 1, 1, 0.3)
+int luafuncs_setQualityGovernor(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    if (lua_type(l, 1) != LUA_TBOOLEAN) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.physics.setQualityGovernor", "boolean",
+        lua_strtype(l, 1));
+    }
+    int minimum[3] = {2, 1, 1};
+    int i = 2;
+    while (i <= 4) {
+        if (lua_gettop(l) >= i && lua_type(l, i) != LUA_TNIL) {
+            if (lua_type(l, i) != LUA_TNUMBER) {
+                return haveluaerror(l, badargument1, i,
+                "blitwizard.physics.setQualityGovernor", "number",
+                lua_strtype(l, i));
+            }
+            if (lua_tointeger(l, i) < 1) {
+                return haveluaerror(l, badargument2, i,
+                "blitwizard.physics.setQualityGovernor",
+                "value needs to be at least 1");
+            }
+            minimum[i - 2] = lua_tointeger(l, i);
+        }
+        i++;
+    }
+    double budget = 0.5;
+    if (lua_gettop(l) >= 5 && lua_type(l, 5) != LUA_TNIL) {
+        if (lua_type(l, 5) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 5,
+            "blitwizard.physics.setQualityGovernor", "number",
+            lua_strtype(l, 5));
+        }
+        budget = lua_tonumber(l, 5);
+        if (budget <= 0) {
+            return haveluaerror(l, badargument2, 5,
+            "blitwizard.physics.setQualityGovernor",
+            "budget needs to be positive");
+        }
+    }
+    main_SetPhysics2dGovernor(lua_toboolean(l, 1), minimum[0],
+        minimum[1], minimum[2], budget);
+    return 0;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
+/// Get timings and counts of the last physics step of a 2d world,
+// e.g. to find out why physics are slow. The returned table has
+// the following fields:
+// <ul>
+// <li><i>total</i>: how long the whole step took, including collision
+// callbacks, in milliseconds</li>
+// <li><i>broadphase</i>: time spent finding new contacts between
+// objects, in milliseconds</li>
+// <li><i>narrowphase</i>: time spent updating the contacts between
+// objects, in milliseconds</li>
+// <li><i>solve</i>: time spent solving contacts and joints and moving
+// the objects, in milliseconds</li>
+// <li><i>callbacks</i>: time spent in collision callbacks, including
+// your @{blitwizard.object:onCollision|onCollision} functions, in
+// milliseconds</li>
+// <li><i>bodies</i>: amount of objects with collision</li>
+// <li><i>awakeBodies</i>: amount of those which aren't sleeping</li>
+// <li><i>contacts</i>: amount of contacts between object shapes</li>
+// <li><i>velocityIterations</i>, <i>positionIterations</i>,
+// <i>substeps</i>: the @{blitwizard.physics.setStepQuality|solver
+// quality} currently used</li>
+// </ul>
+// @function getStepStats
+// @tparam number world (optional) the @{blitwizard.physics.newWorld2d|physics world} to query, the default world if not specified
+// @treturn table a table with the fields listed above
+// @usage
+// local stats = blitwizard.physics.getStepStats()
+// print("physics step took " .. stats.total .. "ms for " ..
+//     stats.awakeBodies .. " moving objects")
+int luafuncs_getStepStats(lua_State* l) {
+#ifdef USE_PHYSICS2D
+    struct physicsworld* world = luacfuncs_physics_toWorld2d(l, 1,
+        "blitwizard.physics.getStepStats");
+    if (!world) {
+        return 0;
+    }
+    struct physicsstepstats stats;
+    physics_get2dStepStats(world, &stats);
+    int quality[3];
+    physics_get2dStepQuality(world, &quality[0], &quality[1],
+        &quality[2]);
+    lua_newtable(l);
+    lua_pushstring(l, "total");
+    lua_pushnumber(l, stats.total);
+    lua_settable(l, -3);
+    lua_pushstring(l, "broadphase");
+    lua_pushnumber(l, stats.broadphase);
+    lua_settable(l, -3);
+    lua_pushstring(l, "narrowphase");
+    lua_pushnumber(l, stats.narrowphase);
+    lua_settable(l, -3);
+    lua_pushstring(l, "solve");
+    lua_pushnumber(l, stats.solve);
+    lua_settable(l, -3);
+    lua_pushstring(l, "callbacks");
+    lua_pushnumber(l, stats.callbacks);
+    lua_settable(l, -3);
+    lua_pushstring(l, "bodies");
+    lua_pushnumber(l, stats.bodies);
+    lua_settable(l, -3);
+    lua_pushstring(l, "awakeBodies");
+    lua_pushnumber(l, stats.awakebodies);
+    lua_settable(l, -3);
+    lua_pushstring(l, "contacts");
+    lua_pushnumber(l, stats.contacts);
+    lua_settable(l, -3);
+    lua_pushstring(l, "velocityIterations");
+    lua_pushnumber(l, quality[0]);
+    lua_settable(l, -3);
+    lua_pushstring(l, "positionIterations");
+    lua_pushnumber(l, quality[1]);
+    lua_settable(l, -3);
+    lua_pushstring(l, "substeps");
+    lua_pushnumber(l, quality[2]);
+    lua_settable(l, -3);
+    return 1;
+#else
+    return haveluaerror(l, error_nophysics2d);
+#endif
+}
+
 /// Set the world gravity for all 3d objects.
 // @function set3dGravity
 int luafuncs_set3dGravity(__attribute__((unused)) lua_State* l) {
@@ -39,8 +39,20 @@ extern "C" {
 
 int luafuncs_ray2d(lua_State* l);
 int luafuncs_ray3d(lua_State* l);
+int luafuncs_ray2dAll(lua_State* l);
+int luafuncs_ray2dBatch(lua_State* l);
+int luafuncs_query2dBox(lua_State* l);
+int luafuncs_query2dCircle(lua_State* l);
+int luafuncs_query2dPolygon(lua_State* l);
 int luafuncs_set2dGravity(lua_State* l);
 int luafuncs_set3dGravity(lua_State* l);
+int luafuncs_newWorld2d(lua_State* l);
+int luafuncs_setParallelStepping(lua_State* l);
+int luafuncs_snapshot2d(lua_State* l);
+int luafuncs_restore2d(lua_State* l);
+int luafuncs_setStepQuality(lua_State* l);
+int luafuncs_setQualityGovernor(lua_State* l);
+int luafuncs_getStepStats(lua_State* l);
 
 #ifdef __cplusplus
 }
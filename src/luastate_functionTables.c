@@ -154,6 +154,22 @@ void luastate_CreatePhysicsTable(lua_State* l) {
     lua_newtable(l);
     luastate_register2dphysics(l, &luafuncs_set2dGravity, "set2dGravity");
     luastate_register2dphysics(l, &luafuncs_ray2d, "ray2d");
+    luastate_register2dphysics(l, &luafuncs_ray2dAll, "ray2dAll");
+    luastate_register2dphysics(l, &luafuncs_ray2dBatch, "ray2dBatch");
+    luastate_register2dphysics(l, &luafuncs_query2dBox, "query2dBox");
+    luastate_register2dphysics(l, &luafuncs_query2dCircle, "query2dCircle");
+    luastate_register2dphysics(l, &luafuncs_query2dPolygon,
+        "query2dPolygon");
+    luastate_register2dphysics(l, &luafuncs_newWorld2d, "newWorld2d");
+    luastate_register2dphysics(l, &luafuncs_setParallelStepping,
+    "setParallelStepping");
+    luastate_register2dphysics(l, &luafuncs_snapshot2d, "snapshot2d");
+    luastate_register2dphysics(l, &luafuncs_restore2d, "restore2d");
+    luastate_register2dphysics(l, &luafuncs_setStepQuality,
+    "setStepQuality");
+    luastate_register2dphysics(l, &luafuncs_setQualityGovernor,
+    "setQualityGovernor");
+    luastate_register2dphysics(l, &luafuncs_getStepStats, "getStepStats");
     luastate_register3dphysics(l, &luafuncs_set3dGravity, "set3dGravity");
     luastate_register3dphysics(l, &luafuncs_ray3d, "ray3d");
 }
@@ -315,6 +331,18 @@ void luastate_CreateObjectTable(lua_State* l) {
     "setLinearDamping");
     luastate_register2d3dphysics(l, &luafuncs_object_setGravity,
     "setGravity");
+    luastate_register2dphysics(l, &luafuncs_object_setCollisionFilter,
+    "setCollisionFilter");
+    luastate_register2dphysics(l, &luafuncs_object_enableTileCollision,
+    "enableTileCollision");
+    luastate_register2dphysics(l, &luafuncs_object_setTileCollision,
+    "setTileCollision");
+    luastate_register2dphysics(l, &luafuncs_object_setPhysicsWorld,
+    "setPhysicsWorld");
+    luastate_register2dphysics(l, &luafuncs_object_getPhysicsWorld,
+    "getPhysicsWorld");
+    luastate_register2dphysics(l, &luafuncs_object_ignoreCollisionWith,
+    "ignoreCollisionWith");
 }
 
 void luastate_CreateDebugTable(lua_State* l) {
@@ -337,6 +365,8 @@ void luastate_CreateDebugTable(lua_State* l) {
         "get2dSpriteCount");
     luastate_registerfunc(l, &luafuncs_debug_getAudioChannelCount,
         "getAudioChannelCount");
+    luastate_registerfunc(l, &luafuncs_debug_getAudioTiming,
+        "getAudioTiming");
     luastate_registerfunc(l, &luafuncs_debug_getAllTextures,
         "getAllTextures");
     luastate_registerfunc(l, &luafuncs_debug_getWaitingTextureRequests,
@@ -353,9 +383,24 @@ void luastate_CreateSimpleSoundTable(lua_State* l) {
     luastate_registerfunc(l, &luafuncs_media_simpleSound_play, "play");
     luastate_registerfunc(l, &luafuncs_media_simpleSound_adjust, "adjust");
     luastate_registerfunc(l, &luafuncs_media_simpleSound_setPriority, "setPriority");
+    luastate_registerfunc(l, &luafuncs_media_simpleSound_setLoopPoints, "setLoopPoints");
+    luastate_registerfunc(l, &luafuncs_media_simpleSound_setBus, "setBus");
+    luastate_registerfunc(l, &luafuncs_media_simpleSound_setOnFinished, "setOnFinished");
     luastate_registerfunc(l, &luafuncs_media_simpleSound_stop, "stop");
 }
 
+void luastate_CreatePositionedSoundTable(lua_State* l) {
+    lua_newtable(l);
+    luastate_registerfunc(l, &luafuncs_media_positionedSound_new, "new");
+    luastate_registerfunc(l, &luafuncs_media_positionedSound_play, "play");
+    luastate_registerfunc(l, &luafuncs_media_positionedSound_stop, "stop");
+    luastate_registerfunc(l, &luafuncs_media_positionedSound_setLoopPoints, "setLoopPoints");
+    luastate_registerfunc(l, &luafuncs_media_positionedSound_setBus, "setBus");
+    luastate_registerfunc(l, &luafuncs_media_positionedSound_setOnFinished, "setOnFinished");
+    luastate_registerfunc(l, &luafuncs_media_positionedSound_setPosition, "setPosition");
+    luastate_registerfunc(l, &luafuncs_media_positionedSound_setAttenuation, "setAttenuation");
+}
+
 void luastate_CreateAudioTable(lua_State* l) {
     lua_newtable(l);
 
@@ -363,9 +408,33 @@ void luastate_CreateAudioTable(lua_State* l) {
     luastate_CreateSimpleSoundTable(l);
     lua_settable(l, -3);
 
+    lua_pushstring(l, "positionedSound");
+    luastate_CreatePositionedSoundTable(l);
+    lua_settable(l, -3);
+
     lua_pushstring(l, "stopAllPlayingSounds");
     lua_pushcfunction(l, &luafuncs_media_object_stopAllPlayingSounds);
     lua_settable(l, -3);
+
+    lua_pushstring(l, "preloadSound");
+    lua_pushcfunction(l, &luafuncs_media_object_preloadSound);
+    lua_settable(l, -3);
+
+    lua_pushstring(l, "setSoundCacheLimits");
+    lua_pushcfunction(l, &luafuncs_media_object_setSoundCacheLimits);
+    lua_settable(l, -3);
+
+    lua_pushstring(l, "setResamplingQuality");
+    lua_pushcfunction(l, &luafuncs_media_object_setResamplingQuality);
+    lua_settable(l, -3);
+
+    lua_pushstring(l, "setListenerPosition");
+    lua_pushcfunction(l, &luafuncs_media_object_setListenerPosition);
+    lua_settable(l, -3);
+
+    lua_pushstring(l, "setBusVolume");
+    lua_pushcfunction(l, &luafuncs_media_object_setBusVolume);
+    lua_settable(l, -3);
 }
 
 void luastate_CreateTimeTable(lua_State* l) {
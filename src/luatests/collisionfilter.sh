@@ -0,0 +1,72 @@
+#!/bin/bash
+
+# This test checks that objects excluded through collision filters
+# or ignored pairs fall through the ground, while others land on it.
+
+source luatests/preparetest.sh
+
+# Run blitwizard test:
+echo "-- don't spill out log output:
+function blitwizard.onLog() end
+
+-- ground in category 1:
+local ground = blitwizard.object:new(blitwizard.object.o2d)
+ground:enableStaticCollision({
+    type='rectangle', width=20, height=1
+})
+ground:setPosition(0, 5)
+
+-- one box landing on the ground, and two falling through:
+local function newBox(x)
+    local obj = blitwizard.object:new(blitwizard.object.o2d)
+    obj:enableMovableCollision({
+        type='rectangle', width=1, height=1
+    })
+    obj:setPosition(x, 0)
+    return obj
+end
+local lands = newBox(-4)
+local filtered = newBox(0)
+filtered:setCollisionFilter(2, {2})
+local ignored = newBox(4)
+ignored:ignoreCollisionWith(ground)
+
+-- the filtered box must never be reported colliding:
+function filtered:onCollision(other)
+    print(\"unexpected collision\")
+    os.exit(1)
+end
+
+-- set graphics mode so blitwizard keeps running:
+blitwizard.graphics.setMode(20, 20, 'test', false)
+
+local steps = 0
+function lands:doAlways()
+    steps = steps + 1
+    if steps < 180 then
+        return
+    end
+    local _, y1 = lands:getPosition()
+    local _, y2 = filtered:getPosition()
+    local _, y3 = ignored:getPosition()
+    if y1 < 5 and y2 > 6 and y3 > 6 then
+        print(\"success\")
+    end
+    os.exit(0)
+end
+" > ./test.lua
+$RUNBLITWIZARD ./test.lua > ./testoutput
+rm ./test.lua
+
+# Get output which we want to check for \"success\"
+testoutput="`cat ./testoutput | grep success | sed 's/[ \n\r]*$//g'`"
+
+rm ./testoutput
+
+if [ "x$testoutput" = "xsuccess" ]; then
+    exit 0
+else
+    echo "Error: invalid test output: '$testoutput'"
+    exit 1
+fi
+
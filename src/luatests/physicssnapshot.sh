@@ -0,0 +1,88 @@
+#!/bin/bash
+
+# This test checks a 2d physics snapshot puts objects back where they
+# were, and that it is refused once the world's objects changed.
+
+source luatests/preparetest.sh
+
+# Run blitwizard test:
+echo "-- don't spill out log output:
+function blitwizard.onLog() end
+
+local ground = blitwizard.object:new(blitwizard.object.o2d)
+ground:enableStaticCollision({
+    type='rectangle', width=20, height=1
+})
+ground:setPosition(0, 5)
+local box = blitwizard.object:new(blitwizard.object.o2d)
+box:enableMovableCollision({
+    type='rectangle', width=1, height=1
+})
+box:setPosition(0, 0)
+
+local function fail(msg)
+    print(\"error: \" .. msg)
+    os.exit(1)
+end
+
+-- set graphics mode so blitwizard keeps running:
+blitwizard.graphics.setMode(20, 20, 'test', false)
+
+local steps = 0
+local snapshot = nil
+local snapshoty = nil
+function box:doAlways()
+    steps = steps + 1
+    if steps == 10 then
+        snapshot = blitwizard.physics.snapshot2d()
+        local _
+        _, snapshoty = box:getPosition()
+        return
+    end
+    if steps < 60 then
+        return
+    end
+
+    -- the box has fallen further, roll back:
+    local _, y = box:getPosition()
+    if y <= snapshoty then
+        fail(\"box didn't fall\")
+    end
+    if blitwizard.physics.restore2d(snapshot,
+            blitwizard.physics.newWorld2d()) then
+        fail(\"snapshot restored to a different world\")
+    end
+    if not blitwizard.physics.restore2d(snapshot) then
+        fail(\"restoring the snapshot failed\")
+    end
+    _, y = box:getPosition()
+    if math.abs(y - snapshoty) > 0.0001 then
+        fail(\"box not at its snapshot position\")
+    end
+
+    -- new objects make the snapshot invalid:
+    local box2 = blitwizard.object:new(blitwizard.object.o2d)
+    box2:enableMovableCollision({
+        type='rectangle', width=1, height=1
+    })
+    if blitwizard.physics.restore2d(snapshot) then
+        fail(\"outdated snapshot restored\")
+    end
+    print(\"success\")
+    os.exit(0)
+end
+" > ./test.lua
+$RUNBLITWIZARD ./test.lua > ./testoutput
+rm ./test.lua
+
+# Get output which we want to check for \"success\"
+testoutput="`cat ./testoutput | grep success | sed 's/[ \n\r]*$//g'`"
+
+rm ./testoutput
+
+if [ "x$testoutput" = "xsuccess" ]; then
+    exit 0
+else
+    echo "Error: invalid test output: '$testoutput'"
+    exit 1
+fi
@@ -0,0 +1,100 @@
+#!/bin/bash
+
+# This test checks objects can be created and destroyed in large numbers
+# from inside collision callbacks, and that objects created there are
+# simulated right away at the position they were given.
+
+source luatests/preparetest.sh
+
+# Run blitwizard test:
+echo "-- don't spill out log output:
+function blitwizard.onLog() end
+
+local function fail(msg)
+    print(\"error: \" .. msg)
+    os.exit(1)
+end
+
+local ground = blitwizard.object:new(blitwizard.object.o2d)
+ground:enableStaticCollision({
+    type='rectangle', width=200, height=1
+})
+ground:setPosition(0, 5)
+
+-- bullets which hit the ground are replaced by a new one up in the air:
+local spawned = 0
+local bullets = {}
+local function spawnBullet(x)
+    local bullet = blitwizard.object:new(blitwizard.object.o2d)
+    bullet:enableMovableCollision({
+        type='circle', diameter=0.2
+    })
+    bullet:setPosition(x, 0)
+    bullets[bullet] = true
+    spawned = spawned + 1
+    function bullet:onCollision(other)
+        if not bullets[self] then
+            return
+        end
+        if other ~= ground then
+            return false
+        end
+        bullets[self] = nil
+        local x, y = self:getPosition()
+        self:destroy()
+        local newbullet = spawnBullet(x)
+        local newx, newy = newbullet:getPosition()
+        if math.abs(newy) > 0.001 then
+            fail(\"new object not at its position\")
+        end
+        return false
+    end
+    return bullet
+end
+local i = 0
+while i < 200 do
+    spawnBullet((i - 100) * 0.5)
+    i = i + 1
+end
+
+-- set graphics mode so blitwizard keeps running:
+blitwizard.graphics.setMode(20, 20, 'test', false)
+
+local steps = 0
+function ground:doAlways()
+    steps = steps + 1
+    if steps < 300 then
+        return
+    end
+    local count = 0
+    for bullet, _ in pairs(bullets) do
+        local _, y = bullet:getPosition()
+        if y > 6 then
+            fail(\"bullet fell through the ground\")
+        end
+        count = count + 1
+    end
+    if count ~= 200 then
+        fail(\"wrong amount of bullets left\")
+    end
+    if spawned < 400 then
+        fail(\"bullets weren't respawned\")
+    end
+    print(\"success\")
+    os.exit(0)
+end
+" > ./test.lua
+$RUNBLITWIZARD ./test.lua > ./testoutput
+rm ./test.lua
+
+# Get output which we want to check for \"success\"
+testoutput="`cat ./testoutput | grep success | sed 's/[ \n\r]*$//g'`"
+
+rm ./testoutput
+
+if [ "x$testoutput" = "xsuccess" ]; then
+    exit 0
+else
+    echo "Error: invalid test output: '$testoutput'"
+    exit 1
+fi
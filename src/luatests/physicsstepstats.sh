@@ -0,0 +1,74 @@
+#!/bin/bash
+
+# This test checks physics step statistics are reported, and that the
+# solver quality can be changed and is reflected in them.
+
+source luatests/preparetest.sh
+
+# Run blitwizard test:
+echo "-- don't spill out log output:
+function blitwizard.onLog() end
+
+local ground = blitwizard.object:new(blitwizard.object.o2d)
+ground:enableStaticCollision({
+    type='rectangle', width=20, height=1
+})
+ground:setPosition(0, 5)
+local box = blitwizard.object:new(blitwizard.object.o2d)
+box:enableMovableCollision({
+    type='rectangle', width=1, height=1
+})
+box:setPosition(0, 0)
+
+local function fail(msg)
+    print(\"error: \" .. msg)
+    os.exit(1)
+end
+
+blitwizard.physics.setStepQuality(4, 2, 1)
+blitwizard.physics.setQualityGovernor(true, 2, 1, 1, 0.5)
+
+-- set graphics mode so blitwizard keeps running:
+blitwizard.graphics.setMode(20, 20, 'test', false)
+
+local steps = 0
+function box:doAlways()
+    steps = steps + 1
+    if steps < 120 then
+        return
+    end
+    local stats = blitwizard.physics.getStepStats()
+    if stats.bodies ~= 2 or stats.contacts < 1 then
+        fail(\"wrong amount of bodies or contacts\")
+    end
+    if stats.total < 0 or stats.solve < 0 or stats.callbacks < 0 then
+        fail(\"invalid timings\")
+    end
+    if stats.substeps ~= 1 or stats.positionIterations > 2 or
+            stats.velocityIterations > 4 then
+        fail(\"solver quality not applied\")
+    end
+
+    -- the box should still land with just one substep:
+    local _, y = box:getPosition()
+    if y < 3 or y > 5 then
+        fail(\"box didn't land on the ground\")
+    end
+    print(\"success\")
+    os.exit(0)
+end
+" > ./test.lua
+$RUNBLITWIZARD ./test.lua > ./testoutput
+rm ./test.lua
+
+# Get output which we want to check for \"success\"
+testoutput="`cat ./testoutput | grep success | sed 's/[ \n\r]*$//g'`"
+
+rm ./testoutput
+
+if [ "x$testoutput" = "xsuccess" ]; then
+    exit 0
+else
+    echo "Error: invalid test output: '$testoutput'"
+    exit 1
+fi
@@ -0,0 +1,78 @@
+#!/bin/bash
+
+# This test checks that a sleeping object which is woken up because
+# the object it rested on is destroyed is reported as awake again.
+
+source luatests/preparetest.sh
+
+# Run blitwizard test:
+echo "-- don't spill out log output:
+function blitwizard.onLog() end
+
+local function fail(msg)
+    print(\"error: \" .. msg)
+    os.exit(1)
+end
+
+local ground = blitwizard.object:new(blitwizard.object.o2d)
+ground:enableStaticCollision({
+    type='rectangle', width=20, height=1
+})
+ground:setPosition(0, 5)
+
+-- two boxes stacked on the ground:
+local function newBox(y)
+    local obj = blitwizard.object:new(blitwizard.object.o2d)
+    obj:enableMovableCollision({
+        type='rectangle', width=1, height=1
+    })
+    obj:setPosition(0, y)
+    return obj
+end
+local lower = newBox(4)
+local upper = newBox(3)
+
+-- set graphics mode so blitwizard keeps running:
+blitwizard.graphics.setMode(20, 20, 'test', false)
+
+local steps = 0
+local destroyedstep = nil
+function ground:doAlways()
+    steps = steps + 1
+    local stats = blitwizard.physics.getStepStats()
+    if not destroyedstep then
+        -- wait for both boxes to fall asleep:
+        if stats.awakeBodies > 0 then
+            if steps > 1000 then
+                fail(\"boxes didn't fall asleep\")
+            end
+            return
+        end
+        lower:destroy()
+        destroyedstep = steps
+        return
+    end
+    if steps < destroyedstep + 2 then
+        return
+    end
+    if stats.awakeBodies ~= 1 then
+        fail(\"falling box not reported as awake\")
+    end
+    print(\"success\")
+    os.exit(0)
+end
+" > ./test.lua
+$RUNBLITWIZARD ./test.lua > ./testoutput
+rm ./test.lua
+
+# Get output which we want to check for \"success\"
+testoutput="`cat ./testoutput | grep success | sed 's/[ \n\r]*$//g'`"
+
+rm ./testoutput
+
+if [ "x$testoutput" = "xsuccess" ]; then
+    exit 0
+else
+    echo "Error: invalid test output: '$testoutput'"
+    exit 1
+fi
@@ -0,0 +1,102 @@
+#!/bin/bash
+
+# This test checks objects in separate physics worlds don't collide
+# with each other, and that all worlds are stepped in parallel mode.
+
+source luatests/preparetest.sh
+
+# Run blitwizard test:
+echo "-- don't spill out log output:
+function blitwizard.onLog() end
+
+-- step all worlds concurrently:
+blitwizard.physics.setParallelStepping(true)
+
+-- a ground and a falling box in the given world:
+local function newArena(world)
+    local ground = blitwizard.object:new(blitwizard.object.o2d)
+    ground:setPhysicsWorld(world)
+    ground:enableStaticCollision({
+        type='rectangle', width=20, height=1
+    })
+    ground:setPosition(0, 5)
+    local box = blitwizard.object:new(blitwizard.object.o2d)
+    box:setPhysicsWorld(world)
+    box:enableMovableCollision({
+        type='rectangle', width=1, height=1
+    })
+    box:setPosition(0, 0)
+    return ground, box
+end
+local arena1 = blitwizard.physics.newWorld2d()
+local arena2 = blitwizard.physics.newWorld2d()
+local ground1, box1 = newArena(arena1)
+local ground2, box2 = newArena(arena2)
+
+-- no gravity in the second arena:
+blitwizard.physics.set2dGravity(0, 0, arena2)
+
+-- a box in the default world which has no ground:
+local box3 = blitwizard.object:new(blitwizard.object.o2d)
+box3:enableMovableCollision({
+    type='rectangle', width=1, height=1
+})
+box3:setPosition(0, 0)
+
+local function fail(msg)
+    print(\"error: \" .. msg)
+    os.exit(1)
+end
+
+if box1:getPhysicsWorld() ~= arena1 or box3:getPhysicsWorld() ~= 1 then
+    fail(\"wrong physics world reported\")
+end
+if #blitwizard.physics.query2dBox(-10, 4, 10, 6) ~= 0 or
+        #blitwizard.physics.query2dBox(-10, 4, 10, 6, arena1) ~= 1 then
+    fail(\"query2dBox searched the wrong world\")
+end
+
+-- only the box in the first arena lands on its ground:
+local landed = false
+function box1:onCollision(other)
+    if other ~= ground1 then
+        fail(\"collision with object from another world\")
+    end
+    landed = true
+end
+function box3:onCollision(other)
+    fail(\"collision with object from another world\")
+end
+
+-- set graphics mode so blitwizard keeps running:
+blitwizard.graphics.setMode(20, 20, 'test', false)
+
+local steps = 0
+function box1:doAlways()
+    steps = steps + 1
+    if steps < 180 then
+        return
+    end
+    local _, y1 = box1:getPosition()
+    local _, y2 = box2:getPosition()
+    local _, y3 = box3:getPosition()
+    if landed and y1 < 5 and math.abs(y2) < 0.01 and y3 > 6 then
+        print(\"success\")
+    end
+    os.exit(0)
+end
+" > ./test.lua
+$RUNBLITWIZARD ./test.lua > ./testoutput
+rm ./test.lua
+
+# Get output which we want to check for \"success\"
+testoutput="`cat ./testoutput | grep success | sed 's/[ \n\r]*$//g'`"
+
+rm ./testoutput
+
+if [ "x$testoutput" = "xsuccess" ]; then
+    exit 0
+else
+    echo "Error: invalid test output: '$testoutput'"
+    exit 1
+fi
@@ -0,0 +1,93 @@
+#!/bin/bash
+
+# This test checks that a collision rejected by onCollision stays
+# disabled until the two objects separate, even while the object keeps
+# starting and ending contacts with other objects.
+
+source luatests/preparetest.sh
+
+# Run blitwizard test:
+echo "-- don't spill out log output:
+function blitwizard.onLog() end
+
+local function fail(msg)
+    print(\"error: \" .. msg)
+    os.exit(1)
+end
+
+-- a wall made of short segments, so contacts with it keep ending
+-- while something slides down along it:
+local i = 0
+while i < 60 do
+    local segment = blitwizard.object:new(blitwizard.object.o2d)
+    segment:enableStaticCollision({
+        type='rectangle', width=1, height=0.5
+    })
+    segment:setPosition(-1, -1 + i * 0.5)
+    i = i + 1
+end
+
+-- a block which the ball passes through:
+local ghost = blitwizard.object:new(blitwizard.object.o2d)
+ghost:enableStaticCollision({
+    type='rectangle', width=2, height=4
+})
+ghost:setPosition(1, 5)
+
+-- the ball is pushed against the wall while falling:
+local ball = blitwizard.object:new(blitwizard.object.o2d)
+ball:enableMovableCollision({
+    type='circle', diameter=1
+})
+ball:setFriction(0)
+ball:setGravity(-5, 10)
+ball:setPosition(0, 0)
+
+local ghostcollisions = 0
+local wallcollisions = 0
+function ball:onCollision(other)
+    if other == ghost then
+        ghostcollisions = ghostcollisions + 1
+        return false
+    end
+    wallcollisions = wallcollisions + 1
+end
+
+-- set graphics mode so blitwizard keeps running:
+blitwizard.graphics.setMode(20, 20, 'test', false)
+
+local steps = 0
+function ball:doAlways()
+    steps = steps + 1
+    local _, y = ball:getPosition()
+    if y < 8 then
+        if steps > 600 then
+            fail(\"ball got stuck in the rejected block\")
+        end
+        return
+    end
+    if wallcollisions < 2 then
+        fail(\"ball didn't slide along the wall\")
+    end
+    if ghostcollisions ~= 1 then
+        fail(\"rejected collision was reported \" .. ghostcollisions ..
+            \" times\")
+    end
+    print(\"success\")
+    os.exit(0)
+end
+" > ./test.lua
+$RUNBLITWIZARD ./test.lua > ./testoutput
+rm ./test.lua
+
+# Get output which we want to check for \"success\"
+testoutput="`cat ./testoutput | grep success | sed 's/[ \n\r]*$//g'`"
+
+rm ./testoutput
+
+if [ "x$testoutput" = "xsuccess" ]; then
+    exit 0
+else
+    echo "Error: invalid test output: '$testoutput'"
+    exit 1
+fi
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# This test renders audio with -render-audio and checks that a valid
+# .wav file of the requested length is written, and that rendering
+# the same script twice gives exactly the same result.
+
+source luatests/preparetest.sh
+
+# Lua test code (keeps running for 3 seconds of script time):
+echo "
+function blitwizard.onInit()
+    blitwizard.runDelayed(function()
+        print(\"done\")
+    end, 3000)
+end
+" > ./test.lua
+
+$RUNBLITWIZARD -render-audio ./render1.wav -render-length 1 ./test.lua > ./testoutput
+$RUNBLITWIZARD -render-audio ./render2.wav -render-length 1 ./test.lua >> ./testoutput
+rm ./test.lua
+rm ./testoutput
+
+if [ ! -e ./render1.wav ]; then
+    # apparently, audio is disabled
+    echo "WARNING: This build has no audio, test cannot run meaningfully."
+    exit 0
+fi
+
+# Check the header and size of the rendered file:
+header="`head -c 4 ./render1.wav`"
+size=`wc -c < ./render1.wav`
+same=0
+if cmp -s ./render1.wav ./render2.wav; then
+    same=1
+fi
+rm -f ./render1.wav ./render2.wav
+
+if [ "x$header" != "xRIFF" ]; then
+    echo "Error: rendered file has no RIFF header"
+    exit 1
+fi
+# 1 second at 48kHz 16bit stereo plus header, less than one step more:
+if [ $size -lt 192044 ] || [ $size -gt 200000 ]; then
+    echo "Error: rendered file has unexpected size: $size"
+    exit 1
+fi
+if [ "x$same" != "x1" ]; then
+    echo "Error: rendering the same script twice gave different output"
+    exit 1
+fi
+exit 0
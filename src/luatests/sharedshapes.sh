@@ -0,0 +1,87 @@
+#!/bin/bash
+
+# This test checks objects with identical shapes (which share their
+# collision geometry) can still be scaled and deleted independently.
+
+source luatests/preparetest.sh
+
+# Run blitwizard test:
+echo "-- don't spill out log output:
+function blitwizard.onLog() end
+
+-- many identical boxes stacked along the y axis, 10 units apart:
+local boxes = {}
+local i = 1
+while i <= 50 do
+    local obj = blitwizard.object:new(blitwizard.object.o2d)
+    obj:enableStaticCollision({
+        type='rectangle', width=1, height=1
+    })
+    obj:setPosition(0, i * 10)
+    boxes[i] = obj
+    i = i + 1
+end
+
+local function fail(msg)
+    print(\"error: \" .. msg)
+    os.exit(1)
+end
+
+-- where a ray from the left hits the box at the given height:
+local function hitX(y)
+    local obj, x = blitwizard.physics.ray2d(-10, y, 10, y)
+    if not obj then
+        return nil
+    end
+    return x
+end
+
+-- scale some of them, two of them alike:
+boxes[1]:setScale(2, 1)
+boxes[2]:setScale(2, 1)
+boxes[3]:setScale(4, 4)
+
+-- delete some others:
+boxes[4]:delete()
+boxes[5]:delete()
+
+-- set graphics mode so blitwizard keeps running:
+blitwizard.graphics.setMode(20, 20, 'test', false)
+
+function boxes[6]:doAlways()
+    if math.abs(hitX(10) + 1) > 0.05 or math.abs(hitX(20) + 1) > 0.05 then
+        fail(\"box scaled to 2, 1 has the wrong size\")
+    end
+    if math.abs(hitX(30) + 2) > 0.05 then
+        fail(\"box scaled to 4, 4 has the wrong size\")
+    end
+    if hitX(40) ~= nil then
+        fail(\"deleted box is still there\")
+    end
+    if math.abs(hitX(60) + 0.5) > 0.05 then
+        fail(\"unscaled box has the wrong size\")
+    end
+
+    -- scale back, and the original shape should be used again:
+    boxes[3]:setScale(1, 1)
+    if math.abs(hitX(30) + 0.5) > 0.05 then
+        fail(\"box scaled back has the wrong size\")
+    end
+    print(\"success\")
+    os.exit(0)
+end
+" > ./test.lua
+$RUNBLITWIZARD ./test.lua > ./testoutput
+rm ./test.lua
+
+# Get output which we want to check for \"success\"
+testoutput="`cat ./testoutput | grep success | sed 's/[ \n\r]*$//g'`"
+
+rm ./testoutput
+
+if [ "x$testoutput" = "xsuccess" ]; then
+    exit 0
+else
+    echo "Error: invalid test output: '$testoutput'"
+    exit 1
+fi
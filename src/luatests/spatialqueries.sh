@@ -0,0 +1,84 @@
+#!/bin/bash
+
+# This test checks the 2d physics box/circle/polygon queries and
+# the ray queries return the expected objects.
+
+source luatests/preparetest.sh
+
+# Run blitwizard test:
+echo "-- don't spill out log output:
+function blitwizard.onLog() end
+
+-- three boxes in a row at x = 0, 4 and 8:
+local function newBox(x)
+    local obj = blitwizard.object:new(blitwizard.object.o2d)
+    obj:enableStaticCollision({
+        type='rectangle', width=1, height=1
+    })
+    obj:setPosition(x, 0)
+    return obj
+end
+local a = newBox(0)
+local b = newBox(4)
+local c = newBox(8)
+
+local function fail(msg)
+    print(\"error: \" .. msg)
+    os.exit(1)
+end
+
+-- set graphics mode so blitwizard keeps running:
+blitwizard.graphics.setMode(20, 20, 'test', false)
+
+function a:doAlways()
+    local found = blitwizard.physics.query2dBox(-1, -1, 5, 1)
+    if #found ~= 2 then
+        fail(\"query2dBox found \" .. #found .. \" objects\")
+    end
+    found = blitwizard.physics.query2dCircle(8, 2, 1)
+    if #found ~= 0 then
+        fail(\"query2dCircle found objects out of range\")
+    end
+    found = blitwizard.physics.query2dCircle(8, 1, 1)
+    if #found ~= 1 or found[1] ~= c then
+        fail(\"query2dCircle didn't find the right object\")
+    end
+    found = blitwizard.physics.query2dPolygon({3, 0, 9, -3, 9, 3})
+    if #found ~= 2 then
+        fail(\"query2dPolygon found \" .. #found .. \" objects\")
+    end
+
+    -- all boxes along the ray, closest first:
+    local hit, points = blitwizard.physics.ray2dAll(10, 0, -2, 0)
+    if #hit ~= 3 or hit[1] ~= c or hit[3] ~= a or
+            math.abs(points[1] - 8.5) > 0.01 then
+        fail(\"ray2dAll returned wrong hits\")
+    end
+
+    -- one ray hitting b, one missing everything:
+    hit, points = blitwizard.physics.ray2dBatch({
+        2, 0, 6, 0,
+        2, 5, 6, 5,
+    })
+    if hit[1] ~= b or hit[2] ~= false or points[3] ~= 6 then
+        fail(\"ray2dBatch returned wrong hits\")
+    end
+    print(\"success\")
+    os.exit(0)
+end
+" > ./test.lua
+$RUNBLITWIZARD ./test.lua > ./testoutput
+rm ./test.lua
+
+# Get output which we want to check for \"success\"
+testoutput="`cat ./testoutput | grep success | sed 's/[ \n\r]*$//g'`"
+
+rm ./testoutput
+
+if [ "x$testoutput" = "xsuccess" ]; then
+    exit 0
+else
+    echo "Error: invalid test output: '$testoutput'"
+    exit 1
+fi
+
@@ -44,7 +44,7 @@
 #define MAXSCRIPTARGS 1024
 
 // set physics callbacks:
-void luacfuncs_object_initialisePhysicsCallbacks(void);
+void luacfuncs_object_initialisePhysicsCallbacks(void* world);
 
 // report sprite visibility:
 void graphics2dsprites_reportVisibility(void);
@@ -53,18 +53,13 @@ void graphics2dsprites_reportVisibility(void);
 int luacfuncs_object_doAllSteps(int count);
 
 // update all object graphics:
-void luacfuncs_object_updateGraphics(void);
+void luacfuncs_object_updateGraphics(double interpolation);
 
 // informing lua graphics code of new frame:
 void luacfuncs_objectgraphics_newFrame(void);
 
-// update object physics references:
-struct physicsobject;
-void luacfuncs_objectphysics_replaceObjectRef(
-    struct physicsobject* old, struct physicsobject* new);
-
-// media cleanup callback:
-void checkAllMediaObjectsForCleanup(void);
+// media object updates once per frame:
+void mediaobject_processFinishedSounds(void);
 
 // counting current amount of scheduled functions (runDelayed):
 size_t luacfuncs_runDelayed_getScheduledCount(void);
@@ -85,6 +80,7 @@ char* templatepath = NULL; // global template directory path as determined at ru
 char* gameluapath = NULL; // game.lua path as determined at runtime
 char* binpath = NULL;  // path to blitwizard binary
 extern int failsafeaudio;  // whether audio is set to failsafe or not
+extern int lowlatencyaudio;  // whether to use small audio buffers
 
 #include "threading.h"
 #include "luastate.h"
@@ -93,6 +89,8 @@ extern int failsafeaudio;  // whether audio is set to failsafe or not
 #include "audio.h"
 #include "main.h"
 #include "audiomixer.h"
+#include "audiorender.h"
+#include "audiopositional.h"
 #include "logging.h"
 #include "audiosourceffmpeg.h"
 #include "signalhandling.h"
@@ -110,7 +108,7 @@ extern int failsafeaudio;  // whether audio is set to failsafe or not
 int TIMESTEP = 16;
 int MAXLOGICITERATIONS = 50;  // 50 * 16 = 800ms
 int MAXBATCHEDLOGIC = 50/3;
-int MAXPHYSICSITERATIONS = 50;
+int MAXPHYSICSITERATIONS = 100;  // single physics steps
 
 void main_SetTimestep(int timestep) {
     if (timestep < 16) {
@@ -133,6 +131,191 @@ void* main_DefaultPhysics2dPtr() {
     return physics2ddefaultworld;
 }
 
+#ifdef USE_PHYSICS2D
+// all 2d physics worlds, starting with the default world:
+#define MAXPHYSICS2DWORLDS 64
+static struct physicsworld* physics2dworlds[MAXPHYSICS2DWORLDS];
+static int physics2dworldcount = 0;
+static int physics2dparallel = 0;  // step all worlds concurrently
+
+// Solver quality used for all 2d worlds. The governor lowers it down to
+// the given minimum while physics steps take more than their budget,
+// and raises it back up to the maximum once there is time again:
+struct physics2dquality {
+    int velocityiterations, positioniterations, substeps;
+};
+static struct physics2dquality physics2dmaxquality;
+static struct physics2dquality physics2dminquality = {2, 1, 1};
+static struct physics2dquality physics2dcurrentquality;
+static int physics2dgovernor = 0;  // governor enabled
+static double physics2dbudget = 0.5;  // share of real time for physics
+static double physics2dload = 0;  // smoothed share used recently
+static int physics2dcooldown = 0;  // steps to wait for the next change
+
+// Use the current quality for all worlds:
+static void main_Apply2dPhysicsQuality(void) {
+    int i = 0;
+    while (i < physics2dworldcount) {
+        physics_set2dStepQuality(physics2dworlds[i],
+            physics2dcurrentquality.velocityiterations,
+            physics2dcurrentquality.positioniterations,
+            physics2dcurrentquality.substeps);
+        i++;
+    }
+}
+
+int main_Create2dPhysicsWorld(void) {
+    if (physics2dworldcount >= MAXPHYSICS2DWORLDS) {
+        return 0;
+    }
+    struct physicsworld* world = physics_createWorld(0);
+    if (!world) {
+        return 0;
+    }
+    if (physics2dworldcount == 0) {
+        // the default world's quality is the default for all worlds:
+        physics_get2dStepQuality(world,
+            &physics2dmaxquality.velocityiterations,
+            &physics2dmaxquality.positioniterations,
+            &physics2dmaxquality.substeps);
+        physics2dcurrentquality = physics2dmaxquality;
+    } else {
+        physics_set2dStepQuality(world,
+            physics2dcurrentquality.velocityiterations,
+            physics2dcurrentquality.positioniterations,
+            physics2dcurrentquality.substeps);
+    }
+    luacfuncs_object_initialisePhysicsCallbacks(world);
+    physics2dworlds[physics2dworldcount] = world;
+    physics2dworldcount++;
+    return physics2dworldcount;
+}
+
+void* main_Physics2dPtr(int id) {
+    if (id < 1 || id > physics2dworldcount) {
+        return NULL;
+    }
+    return physics2dworlds[id - 1];
+}
+
+void main_SetParallelPhysics2d(int parallel) {
+    physics2dparallel = (parallel != 0);
+}
+
+void main_SetPhysics2dQuality(int velocityiterations,
+        int positioniterations, int substeps) {
+    physics2dmaxquality.velocityiterations = velocityiterations;
+    physics2dmaxquality.positioniterations = positioniterations;
+    physics2dmaxquality.substeps = substeps;
+    physics2dcurrentquality = physics2dmaxquality;
+    main_Apply2dPhysicsQuality();
+}
+
+void main_SetPhysics2dGovernor(int enabled, int minvelocityiterations,
+        int minpositioniterations, int minsubsteps, double budget) {
+    physics2dgovernor = (enabled != 0);
+    physics2dminquality.velocityiterations = minvelocityiterations;
+    physics2dminquality.positioniterations = minpositioniterations;
+    physics2dminquality.substeps = minsubsteps;
+    physics2dbudget = budget;
+    physics2dload = 0;
+    physics2dcooldown = 0;
+    if (!physics2dgovernor) {
+        // back to full quality:
+        physics2dcurrentquality = physics2dmaxquality;
+        main_Apply2dPhysicsQuality();
+    }
+}
+
+// Lower the quality by one level. Returns 0 if at the minimum already:
+static int main_Lower2dPhysicsQuality(void) {
+    struct physics2dquality* q = &physics2dcurrentquality;
+    // velocity iterations are the most expensive and matter the least:
+    if (q->velocityiterations > physics2dminquality.velocityiterations) {
+        q->velocityiterations /= 2;
+        if (q->velocityiterations <
+                physics2dminquality.velocityiterations) {
+            q->velocityiterations = physics2dminquality.velocityiterations;
+        }
+        return 1;
+    }
+    if (q->positioniterations > physics2dminquality.positioniterations) {
+        q->positioniterations--;
+        return 1;
+    }
+    // fewer substeps make fast objects tunnel, so do that last:
+    if (q->substeps > physics2dminquality.substeps) {
+        q->substeps--;
+        return 1;
+    }
+    return 0;
+}
+
+// Raise the quality by one level, in the reverse order of lowering it.
+// Returns 0 if at the maximum already:
+static int main_Raise2dPhysicsQuality(void) {
+    struct physics2dquality* q = &physics2dcurrentquality;
+    if (q->substeps < physics2dmaxquality.substeps) {
+        q->substeps++;
+        return 1;
+    }
+    if (q->positioniterations < physics2dmaxquality.positioniterations) {
+        q->positioniterations++;
+        return 1;
+    }
+    if (q->velocityiterations < physics2dmaxquality.velocityiterations) {
+        q->velocityiterations *= 2;
+        if (q->velocityiterations >
+                physics2dmaxquality.velocityiterations) {
+            q->velocityiterations = physics2dmaxquality.velocityiterations;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// Adjust the quality to the time the last step took (in microseconds):
+static void main_Govern2dPhysics(uint64_t steptime) {
+    double load = (steptime / 1000.0) /
+        physics_getStepSize(physics2ddefaultworld);
+    physics2dload = physics2dload * 0.9 + load * 0.1;
+    if (physics2dcooldown > 0) {
+        // let the load settle after the last change
+        physics2dcooldown--;
+        return;
+    }
+    int changed = 0;
+    if (physics2dload > physics2dbudget) {
+        changed = main_Lower2dPhysicsQuality();
+    } else if (physics2dload < physics2dbudget * 0.5) {
+        changed = main_Raise2dPhysicsQuality();
+    }
+    if (changed) {
+        main_Apply2dPhysicsQuality();
+        physics2dcooldown = 30;
+    }
+}
+
+// Do one physics step in all 2d worlds:
+static void main_Step2dPhysics(void) {
+    uint64_t start = time_getMicroseconds();
+    // (remember the count, since collision callbacks may add worlds)
+    int count = physics2dworldcount;
+    if (physics2dparallel && count > 1) {
+        physics_stepWorlds(physics2dworlds, count);
+    } else {
+        int i = 0;
+        while (i < count) {
+            physics_step(physics2dworlds[i]);
+            i++;
+        }
+    }
+    if (physics2dgovernor) {
+        main_Govern2dPhysics(time_getMicrosecondsSince(start));
+    }
+}
+#endif
+
 void main_Quit(int returncode) {
     listeners_CloseAll();
     // close graphics first since that is fast:
@@ -155,6 +338,8 @@ void fatalscripterror(void) {
 
 int simulateaudio = 0;
 int audioinitialised = 0;
+static char* option_renderaudio = NULL;  // render audio to this file
+static double option_renderlength = 0;  // seconds to render, 0: no limit
 void main_initAudio(void) {
 #ifdef USE_AUDIO
     if (audioinitialised) {
@@ -172,6 +357,19 @@ void main_initAudio(void) {
         audiosourceffmpeg_disableFFmpeg();
     }
 
+    // render into a file instead of using an audio device:
+    if (option_renderaudio) {
+        if (p) {
+            free(p);
+        }
+        if (!audiorender_open(option_renderaudio)) {
+            printfatalerror("Error: failed to open \"%s\" for "
+                "rendering audio", option_renderaudio);
+            main_Quit(1);
+        }
+        return;
+    }
+
 #if defined(USE_SDL_AUDIO) || defined(WINDOWS)
     char* error;
 
@@ -565,6 +763,8 @@ static int scriptargfound = 0;
 static int option_changedir = 0;
 static char* option_templatepath = NULL;
 static int nextoptionistemplatepath = 0;
+static int nextoptionisrenderaudio = 0;
+static int nextoptionisrenderlength = 0;
 static int nextoptionisscriptarg = 0;
 static int gcframecount = 0;
 static char** scriptargs = NULL;
@@ -621,6 +821,32 @@ int main_startup_do(int argc, char** argv) {
                 continue;
             }
 
+            // process audio rendering option parameters:
+            if (nextoptionisrenderaudio) {
+                nextoptionisrenderaudio = 0;
+                if (option_renderaudio) {
+                    free(option_renderaudio);
+                }
+                option_renderaudio = strdup(argv[i]);
+                if (!option_renderaudio) {
+                    printfatalerror("Error: failed to strdup() render "
+                    "audio argument");
+                    main_Quit(1);
+                    return 1;
+                }
+                i++;
+                continue;
+            }
+            if (nextoptionisrenderlength) {
+                nextoptionisrenderlength = 0;
+                option_renderlength = atof(argv[i]);
+                if (option_renderlength < 0) {
+                    option_renderlength = 0;
+                }
+                i++;
+                continue;
+            }
+
             // various options:
             if ((argv[i][0] == '-' || strcasecmp(argv[i],"/?") == 0)
             && !nextoptionisscriptarg) {
@@ -649,8 +875,15 @@ int main_startup_do(int argc, char** argv) {
                     printf("   -failsafe-audio        Use 16bit signed int audio and avoid\n"
                            "                          audio backends known as troublesome\n");
                     printf("   -help                  Show this help text and quit\n");
+                    printf("   -low-latency-audio     Start with a small audio buffer and\n"
+                           "                          only grow it if audio stutters\n");
                     printf("   -long-execution        Default to lengthier script execution\n"
                            "                          time\n");
+                    printf("   -render-audio [file]   Write all audio to a .wav file instead\n"
+                           "                          of playing it, running as fast as\n"
+                           "                          possible with reproducible timing\n");
+                    printf("   -render-length [secs]  Quit after rendering the given amount\n"
+                           "                          of audio (with -render-audio)\n");
                     printf("   -templatepath [path]   Check another place for "
                            "templates\n"
                            "                          (not the default "
@@ -664,6 +897,11 @@ int main_startup_do(int argc, char** argv) {
                     i++;
                     continue;
                 }
+                if (strcasecmp(argv[i], "-low-latency-audio") == 0) {
+                    lowlatencyaudio = 1;
+                    i++;
+                    continue;
+                }
                 if (strcasecmp(argv[i], "-long-execution") == 0) {
                     scriptMaxRuntime = 20000;
                     scriptTerminateTime = time_getMilliseconds() +
@@ -681,6 +919,16 @@ int main_startup_do(int argc, char** argv) {
                     i++;
                     continue;
                 }
+                if (strcasecmp(argv[i], "-render-audio") == 0) {
+                    nextoptionisrenderaudio = 1;
+                    i++;
+                    continue;
+                }
+                if (strcasecmp(argv[i], "-render-length") == 0) {
+                    nextoptionisrenderlength = 1;
+                    i++;
+                    continue;
+                }
                 if (strcmp(argv[i], "-v") == 0 || strcasecmp(argv[i], "-version") == 0
                 || strcasecmp(argv[i], "--version") == 0) {
                     printf("blitwizard %s (C) 2011-2013 Jonas Thiem et al\n",VERSION);
@@ -720,11 +968,7 @@ int main_startup_do(int argc, char** argv) {
                     ""
                     #endif
                     );
-                    #if defined(USE_SPEEX_RESAMPLING)
-                    printf("     Resampling: libspeex\n");
-                    #else
-                    printf("     Resampling: none (non-48kHz audio will sound wrong!)\n");
-                    #endif
+                    printf("     Resampling: built-in (polyphase windowed sinc)\n");
                     #endif
 
                     #ifdef USE_GRAPHICS
@@ -799,6 +1043,13 @@ int main_startup_do(int argc, char** argv) {
     }
 
 #ifdef USE_AUDIO
+    if (option_renderaudio) {
+        // when rendering audio, we decode everything in sync with
+        // the mixer and time only advances as we render:
+        audiomixer_SetSynchronousDecoding(1);
+        time_setFixedTimebase(1);
+    }
+
     // This needs to be done at some point before we actually 
     // initialise audio so that the mixer is ready for use then
     audiomixer_Init();
@@ -1009,14 +1260,13 @@ int main(int argc, char** argv) {
 
 #ifdef USE_PHYSICS2D
     // initialise physics
-    physics2ddefaultworld = physics_createWorld(0);
-    if (!physics2ddefaultworld) {
+    if (!main_Create2dPhysicsWorld()) {
         printfatalerror("Error: Failed to initialise Box2D physics");
         fatalscripterror();
         main_Quit(1);
         return 1;
     }
-    luacfuncs_object_initialisePhysicsCallbacks();
+    physics2ddefaultworld = main_Physics2dPtr(1);
 #endif
 
 #if defined(ANDROID) || defined(__ANDROID__)
@@ -1151,6 +1401,8 @@ int main(int argc, char** argv) {
     if (simulateaudio) {
         simulateaudiotime = time_getMilliseconds();
     }
+    unsigned int reportedaudiounderruns = 0;
+    uint64_t lastaudiounderrunreport = 0;
 #endif
 
     uint64_t logictimestamp = time_getMilliseconds();
@@ -1162,6 +1414,27 @@ int main(int argc, char** argv) {
 
         // do console logging:
         doConsoleLog(); 
+
+#ifdef USE_AUDIO
+        // when rendering audio, advance the time by one step and
+        // render the audio for it:
+        if (option_renderaudio) {
+            time_advanceFixedTimebase(TIMESTEP);
+            if (!audiorender_render(TIMESTEP)) {
+                printfatalerror("Error: failed to write rendered audio "
+                    "to \"%s\"", option_renderaudio);
+                main_Quit(1);
+            }
+            if (option_renderlength > 0 &&
+                    audiorender_renderedFrames() >=
+                    option_renderlength * 48000) {
+                printinfo("[main] rendered %f seconds of audio; quit!",
+                    (double)audiorender_renderedFrames() / 48000.0);
+                main_Quit(0);
+            }
+        }
+#endif
+
         uint64_t timeNow = time_getMilliseconds();
 
 #ifdef USE_AUDIO
@@ -1174,10 +1447,29 @@ int main(int argc, char** argv) {
                     // channels per second = simulated 48kHz 32bit stereo audio
             }
         }
+
+        // report if sound decoding doesn't keep up (at most every 5s):
+        if (audiomixer_GetUnderrunCount() != reportedaudiounderruns &&
+        lastaudiounderrunreport + 5000 < timeNow) {
+            reportedaudiounderruns = audiomixer_GetUnderrunCount();
+            lastaudiounderrunreport = timeNow;
+            printwarning("[audio] warning: sound decoding is too slow, "
+            "%u buffer underrun(s) so far", reportedaudiounderruns);
+        }
+
+        // update volume and panning of positioned sounds:
+        audiopositional_update();
+
+#if defined(USE_SDL_AUDIO) || defined(WINDOWS)
+        // adapt the audio buffer size to the measured timing:
+        if (!simulateaudio) {
+            audio_AdjustLatency();
+        }
+#endif
 #endif // ifdef USE_AUDIO
 
-        // check for unused, no longer playing media objects:
-        checkAllMediaObjectsForCleanup();
+        // handle sounds which stopped playing since the last frame:
+        mediaobject_processFinishedSounds();
 
         // slow sleep: check if we can safe some cpu by waiting longer
         unsigned int deltaspan = TIMESTEP;
@@ -1239,11 +1531,6 @@ int main(int argc, char** argv) {
         int physicsiterations = 0;
         int logiciterations = 0;
         time_t iterationStart = time(NULL);
-#if defined(USE_PHYSICS2D)
-        int psteps2d_max = ((float)TIMESTEP/
-        (float)physics_getStepSize(physics2ddefaultworld));
-        psteps2d_max++;
-#endif
         while (
                 // allow maximum of iterations in an attempt to keep up:
                 (logictimestamp < timeNow || physicstimestamp < timeNow) &&
@@ -1260,14 +1547,11 @@ int main(int argc, char** argv) {
                     physicstimestamp < timeNow &&
                     (physicstimestamp <= logictimestamp
                     || logiciterations >= MAXLOGICITERATIONS)) {
-                int psteps = psteps2d_max;
-                while (psteps > 0) {
-                    physics_step(physics2ddefaultworld,
-                        &luacfuncs_objectphysics_replaceObjectRef);
-                    physicstimestamp += physics_getStepSize(
-                        physics2ddefaultworld);
-                    psteps--;
-                }
+                // one step at a time, so physics never ends up more
+                // than one step ahead (see the interpolation below):
+                main_Step2dPhysics();
+                physicstimestamp += physics_getStepSize(
+                    physics2ddefaultworld);
                 physicsiterations++;
             }
 #else
@@ -1307,6 +1591,14 @@ int main(int argc, char** argv) {
                  logictimestamp < timeNow) {
                 // we got a problem: we aren't finished,
                 // but we hit the iteration limit
+#ifdef USE_PHYSICS2D
+                if (physics2dgovernor) {
+                    // don't wait for the governor to catch up:
+                    physics2dcurrentquality = physics2dminquality;
+                    main_Apply2dPhysicsQuality();
+                    physics2dcooldown = 30;
+                }
+#endif
                 physicstimestamp = time_getMilliseconds();
                 logictimestamp = time_getMilliseconds();
                 printwarning("[main] warning: logic is too slow, "
@@ -1330,8 +1622,23 @@ int main(int argc, char** argv) {
         texturemanager_tick();
 #endif
 
+        // physics usually ends up a bit ahead of the current time.
+        // find out how far into the last step we are, so objects can
+        // be shown in between their last two states:
+        double interpolation = 1;
+#ifdef USE_PHYSICS2D
+        int stepsize = physics_getStepSize(physics2ddefaultworld);
+        if (physicstimestamp > timeNow && stepsize > 0) {
+            interpolation = 1.0 -
+                ((double)(physicstimestamp - timeNow)) / stepsize;
+            if (interpolation < 0) {
+                interpolation = 0;
+            }
+        }
+#endif
+
         // update object graphics:
-        luacfuncs_object_updateGraphics();
+        luacfuncs_object_updateGraphics(interpolation);
         doConsoleLog();
 
 #ifdef USE_GRAPHICS
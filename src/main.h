@@ -26,6 +26,14 @@ void main_initAudio(void);
 void main_Quit(int returncode);
 void* main_DefaultPhysics2dPtr(void);  // pointer to 2d physics world
 void* main_DefaultPhysics3dPtr(void);  // pointer to 3d physics world
+int main_Create2dPhysicsWorld(void);  // returns id of new world, 0 on error
+void* main_Physics2dPtr(int id);  // 2d physics world by id (default is 1)
+void main_SetParallelPhysics2d(int parallel);  // step worlds concurrently
+// solver quality of all 2d worlds, and the bounds of lowering it under load:
+void main_SetPhysics2dQuality(int velocityiterations,
+    int positioniterations, int substeps);
+void main_SetPhysics2dGovernor(int enabled, int minvelocityiterations,
+    int minpositioniterations, int minsubsteps, double budget);
 void main_SetTimestep(int timestep);
 extern char* templatepath;  // template path as determined at runtime
 extern char* gameluapath;  // loaded game.lua path as determined at runtime
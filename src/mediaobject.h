@@ -30,6 +30,8 @@
 #define MEDIA_TYPE_AUDIO_PANNED 2
 #define MEDIA_TYPE_AUDIO_POSITIONED 3
 
+struct audiopositional_voice;
+
 struct mediaobject {
     int type;
     int isPlaying;
@@ -41,11 +43,20 @@ struct mediaobject {
             float panning;
             int is3d;
             double x,y,z;  // 2d: x,y, 3d: x,y,z with z pointing up
+            double loopstart, loopend;  // in seconds, 0 for none
+            int bus;  // mixer bus, see audiomixer.h
             int soundid;
             const char* soundname;
+            struct audiopositional_voice* voice;  // positioned only
         } sound;
     } mediainfo;
+    int stoprequested;  // stopped by the script, not finished on its own
+    int finishpending;  // onFinished callback needs to be called
+    int hasonfinished;  // an onFinished callback is set
     struct mediaobject* prev,*next;
+    struct mediaobject* prevplaying,*nextplaying;  // if isPlaying
+    struct mediaobject* nextbysoundid;  // hash bucket, if isPlaying
+    struct mediaobject* nextfinished;  // if finishpending
 };
 
 extern struct mediaobject* mediaObjects;
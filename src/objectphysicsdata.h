@@ -36,6 +36,8 @@
 #include <assert.h>
 #include "physics.h"
 
+struct physicstilemap;
+
 struct objectphysicsdata {
     int refcount;
     int movable;
@@ -58,6 +60,18 @@ struct objectphysicsdata {
     double rotationrestriction3daxisx;
     double rotationrestriction3daxisy;
     double rotationrestriction3daxisz;
+
+    // collision filter (2d only):
+    int collisionfilterset;
+    unsigned int collisioncategorybits;
+    unsigned int collisionmaskbits;
+    int collisiongroup;
+
+    // tile map collision, used instead of object (2d only):
+    struct physicstilemap* tilemap;
+
+    // physics world id (see main_Physics2dPtr), 0 for the default world:
+    int world;
 };
 
 #endif  // USE_PHYSICS2D || USE_PHYSICS3D
@@ -29,6 +29,8 @@
 
 #if (defined(USE_PHYSICS2D) || defined(USE_PHYSICS3D))
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -42,18 +44,41 @@ struct physicsjoint;
 struct physicsworld* physics_createWorld(int use3dphysics);
 void physics_destroyWorld(struct physicsworld* world);
 
-// Step a world.
-// IMPORTANT: A step can cause physics objects to be "replaced"  by different
-// ones:
-// When that happens, the exchangeObjectCallback is issued, and you need to
-// replace all your references to the given old object with the new object.
-// All object settings (e.g. userdata) are automatically present on the new
-// object as well, you don't need to do anything except exchange your pointers.
-void physics_step(struct physicsworld* world,
-    void (*exchangeObjectCallback)(struct physicsobject* oldobject,
-    struct physicsobject* newobject));
+// Step a world. The collision callback is called at the end of the step,
+// and objects may be created and destroyed from inside it. Objects
+// destroyed there are removed once all collision callbacks are done:
+void physics_step(struct physicsworld* world);
 int physics_getStepSize(struct physicsworld* world);
 
+// Step multiple independent worlds at once. They are simulated
+// concurrently on worker threads, then the collision callbacks of
+// each world are called on the calling thread, one world after another
+// in the given order:
+void physics_stepWorlds(struct physicsworld** worlds, int count);
+
+#ifdef USE_PHYSICS2D
+// Solver quality of a world's steps. Each step is done as the given
+// amount of substeps with the given Box2D iteration counts. Lower values
+// are faster but less accurate. The amount of substeps doesn't change
+// how much time a step covers:
+void physics_set2dStepQuality(struct physicsworld* world,
+    int velocityiterations, int positioniterations, int substeps);
+void physics_get2dStepQuality(struct physicsworld* world,
+    int* velocityiterations, int* positioniterations, int* substeps);
+
+// Timings (in milliseconds) and counts of the last step of a world:
+struct physicsstepstats {
+    double total;  // the whole step including collision callbacks
+    double broadphase;  // finding new contacts
+    double narrowphase;  // updating contacts
+    double solve;  // solving constraints and integrating
+    double callbacks;  // collision callbacks (including Lua code)
+    int bodies, awakebodies, contacts;
+};
+void physics_get2dStepStats(struct physicsworld* world,
+    struct physicsstepstats* stats);
+#endif
+
 // Set a collision callback:
 #ifdef USE_PHYSICS2D
 void physics_set2dCollisionCallback(
@@ -75,10 +100,14 @@ void* userdata);
 // the position in the center of the collision/overlap,
 // the collision penetration normal pointing from object b to object a,
 // and the impact force's strength.
-// If the callback returns 0, the collision will be ignored.
+// If the callback returns 0, the collision will be ignored from the next
+// step on until the two objects stop touching.
 // If it returns 1, the collision will be processed.
 //
-// The callback will be called during physics_step.
+// The callback will be called at the end of physics_step, once per pair
+// of objects that touched during the step (all their contacts are merged:
+// the position is the average, the normal and force are the ones of the
+// strongest contact).
 // All operations in the callback are supported including deleting the object
 // for which the callback was called.
 
@@ -111,6 +140,13 @@ struct physicsobjectshape* shape, double xoffset, double yoffset);
 void physics_add2dShapeEdgeList(
 struct physicsobjectshape* shape, double x1, double y1,
 double x2, double y2);
+// Continue the open end at x, y of an edge chain in an edge shape with
+// a ghost vertex, which isn't part of the shape (e.g. where the outline
+// goes on in another object). Objects sliding over the end of the chain
+// then don't catch on it. Call after adding all edges:
+void physics_set2dShapeEdgeListGhostVertex(
+struct physicsobjectshape* shape, double x, double y,
+double ghostx, double ghosty);
 
 // Use those commands to move your shapes around from the center:
 void physics_set2dShapeOffsetRotation(
@@ -199,6 +235,24 @@ void physics_set3dRotationRestrictionAllAxis(
 struct physicsobject* obj);
 void physics_set3dNoRotationRestriction(void);
 #endif
+#ifdef USE_PHYSICS2D
+// Set which other objects this object collides with. Objects collide if
+// the category bits of each match the mask bits of the other one, unless
+// they share a group: objects of the same positive group always collide,
+// objects of the same negative group never collide. Group 0 is no group.
+// Only the lower 16 bits of category and mask are used.
+// Filtered pairs are rejected before any contact is made, so they
+// never show up in the collision callback.
+void physics_set2dCollisionFilter(struct physicsobject* obj,
+unsigned int categorybits, unsigned int maskbits, int group);
+// Make two specific objects not collide with each other (ignore = 1)
+// or collide again (ignore = 0). Returns 0 if out of memory:
+int physics_set2dIgnoreCollision(struct physicsobject* obj1,
+struct physicsobject* obj2, int ignore);
+// Move all ignored collisions of an object to its replacement:
+void physics_transfer2dIgnoredCollisions(struct physicsobject* oldobj,
+struct physicsobject* newobj);
+#endif
 void physics_setFriction(struct physicsobject* obj, double friction);
 void physics_setAngularDamping(struct physicsobject* obj, double damping);
 void physics_setLinearDamping(struct physicsobject* obj, double damping);
@@ -208,6 +262,12 @@ void physics_setRestitution(struct physicsobject* obj, double restitution);
 #ifdef USE_PHYSICS2D
 void physics_get2dPosition(struct physicsobject* obj, double* x, double* y);
 void physics_get2dRotation(struct physicsobject* obj, double* angle);
+// Get position and rotation blended between the state before and after
+// the last step. alpha is 0 for the previous state and 1 for the current
+// one. Objects which didn't move in the last step (e.g. sleeping ones)
+// or which were warped simply return their current transform:
+void physics_get2dInterpolatedTransform(struct physicsobject* obj,
+double alpha, double* x, double* y, double* angle);
 void physics_warp2d(struct physicsobject* obj, double x, double y, double angle);
 void physics_apply2dImpulse(struct physicsobject* obj, double forcex, double forcey, double sourcex, double sourcey);
 #endif
@@ -264,6 +324,53 @@ int physics_ray2d(
     struct physicsobject** objecthit,
     double* hitnormalx, double* hitnormaly
 ); // returns 1 when something is hit, otherwise 0  -- XXX: not thread-safe!
+
+// Spatial queries using the world's broadphase.
+// They return the amount of objects found (-1 when out of memory or for
+// invalid polygons) and point *objects/*hits to a list owned by the world
+// which remains valid until the next query on it. Every object is
+// reported once, even if multiple of its shapes match.
+struct physicsrayhit2d {
+    struct physicsobject* object;  // NULL if nothing was hit
+    double hitpointx, hitpointy;
+    double normalx, normaly;
+    double fraction;  // 0 at the ray's start, 1 at its target
+};
+// Objects with a shape whose bounding box overlaps the given rectangle:
+int physics_query2dBox(struct physicsworld* world,
+    double minx, double miny, double maxx, double maxy,
+    struct physicsobject*** objects);
+// Objects with a shape actually overlapping the given circle or polygon.
+// The polygon is given as count x,y pairs, needs to be convex and
+// may have at most 8 points:
+int physics_query2dCircle(struct physicsworld* world,
+    double x, double y, double radius,
+    struct physicsobject*** objects);
+int physics_query2dPolygon(struct physicsworld* world,
+    const double* points, int count,
+    struct physicsobject*** objects);
+// All objects hit by a ray, closest first (with the closest hit on each):
+int physics_ray2dAll(struct physicsworld* world,
+    double startx, double starty, double targetx, double targety,
+    struct physicsrayhit2d** hits);
+// Cast count rays given as startx, starty, targetx, targety each, and
+// store the closest hit of each in hits (which needs count entries).
+// Returns the amount of rays which hit something:
+int physics_ray2dBatch(struct physicsworld* world,
+    int count, const double* rays, struct physicsrayhit2d* hits);
+
+// Snapshot the state of all bodies and contacts of a world into buffer,
+// e.g. for rollback. Returns the size needed for the snapshot. Nothing
+// is written if buffer is NULL or buffersize is smaller than that.
+// Snapshots contain pointers and are only valid in the same process:
+size_t physics_snapshot2dWorld(struct physicsworld* world, void* buffer,
+    size_t buffersize);
+// Put a world back to the state of a snapshot taken from it. Fails and
+// returns 0 if objects were created, destroyed or rescaled since the
+// snapshot was taken or if called from a collision callback.
+// Returns 1 on success:
+int physics_restore2dWorld(struct physicsworld* world, const void* buffer,
+    size_t size);
 #endif
 #ifdef USE_PHYSICS3D
 int physics_ray3d
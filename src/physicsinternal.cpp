@@ -52,13 +52,25 @@ extern "C" {
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define EPSILON 0.0001
 
+// Upper limit for Box2D steps done per physics step:
+#define MAXSUBSTEPS 16
+
+// The gravity impulses we used to apply manually added up to twice
+// the gravity vector per step, so keep objects falling at that speed:
+#define GRAVITYFACTOR 2
+
 #include "physics.h"
 #include "physicsinternal.h"
 #include "mathhelpers.h"
 #include "logging.h"
+extern "C" {
+#include "timefuncs.h"
+}
 
 #ifndef NDEBUG
 #define BW_E_NO3DYET "Error: 3D is not yet implemented."
@@ -72,6 +84,7 @@ extern "C" {
     Unsorted 2D-specific stuff
 */
 class mycontactlistener;
+class mycontactfilter;
 class mycallback;
 
 /*
@@ -106,8 +119,33 @@ struct physicsobjectshape3d;
 
 struct physicsworld2d {
     mycontactlistener* listener;
+    mycontactfilter* filter;
     b2World* w;
     double gravityx,gravityy;
+    struct physicsobject* customgravity;  // objects with their own gravity
+    unsigned int stepcount;  // increased at the start of each step
+
+    // solver quality, see physics_set2dStepQuality():
+    int velocityiterations, positioniterations, substeps;
+    struct physicsstepstats stats;  // of the last step
+
+    // objects which were awake after the last step or were woken up
+    // since. only those can move during a step:
+    struct physicsobject** moving;
+    int movingcount, movingalloc;
+
+    // changed whenever bodies or fixtures are added or removed, so
+    // snapshots of a different set of them can be told apart:
+    unsigned int bodygeneration;
+    int* snapshothash;  // contact lookup when restoring snapshots
+    int snapshothashsize;
+
+    // results of the last query, see physics_query2d*/physics_ray2dAll:
+    unsigned int querystamp;  // increased for each query
+    struct physicsobject** queryresults;
+    int queryresultcount, queryresultalloc;
+    struct physicsrayhit2d* rayhits;
+    int rayhitcount, rayhitalloc;
     void* callbackuserdata; // FIXME: remove once appropriate
     int (*callback)(void* userdata, struct physicsobject2d* a, struct physicsobject2d* b, double x, double y, double normalx, double normaly, double force); // FIXME: remove once appropriate
 };
@@ -115,6 +153,11 @@ struct physicsworld2d {
 #define DISABLEDCONTACTBLOCKSIZE 16
 #define MAXDISABLEDBLOCKS 16
 
+struct bodyuserdata {
+    void* userdata;
+    struct physicsobject* pobj;
+};
+
 struct physicsobject2d {
 #ifdef USE_PHYSICS2D
     int movable;
@@ -126,19 +169,35 @@ struct physicsobject2d {
     int _deleted;
 #endif   
  
-    // needed for scaling, NULL on creation, init on scale
-    // Array of pointers
-    b2Shape** orig_shapes;
-    int orig_shape_count;
-    // XXX Is currently only allocated for shapes that need it (ugly as fuck).
-    // I.e. length(orig_shape_info) <= length(orig_shapes)
-    struct b2_shape_info* orig_shape_info;
+    // shared shapes the fixtures were created from, and the scale
+    // they were created at (see physics_set2dScale_internal):
+    struct physicsshapedef2d* shapedef;
+    double scalex, scaley;
     
     int gravityset;
     double gravityx,gravityy;
-    void* userdata;
+    struct physicsobject* prevcustomgravity;  // in world's customgravity
+    struct physicsobject* nextcustomgravity;
+    struct bodyuserdata bodydata;  // the body's userdata
     struct physicsworld2d* pworld; // FIXME: remove once appropriate
 
+    // transform before the last step, for render interpolation.
+    // only valid if prevstep matches the world's current stepcount.
+    // while the object is asleep, this is where it rests:
+    double prevx, prevy, prevangle;
+    unsigned int prevstep;
+    int movingindex;  // index + 1 in the world's moving list, or 0
+
+    // world's querystamp when last found by a query, and the index
+    // in the query results then (so every object is reported once):
+    unsigned int querystamp;
+    int queryindex;
+
+    // collision filter applied to all fixtures:
+    uint16 filtercategorybits, filtermaskbits;
+    int16 filtergroup;
+    int ignoredpaircount;  // pairs with this object in world's ignore set
+
     // we store disabled contacts here because
     // box2d won't let us keep it in b2Contact
     // (which sucks!)
@@ -168,11 +227,6 @@ struct physicsobjectshape2d {
 #endif
 };
 
-struct bodyuserdata {
-    void* userdata;
-    struct physicsobject* pobj;
-};
-
 struct rectangle2d {
     double width, height;
 };
@@ -182,6 +236,9 @@ struct edge {
     int processed;
     int adjacentcount;
     double x1,y1,x2,y2;
+    // ghost vertices continuing an open chain before x1,y1 / after x2,y2:
+    int hasghost1, hasghost2;
+    double ghostx1,ghosty1,ghostx2,ghosty2;
     struct edge* next;
     struct edge* adjacent1, *adjacent2;
 };
@@ -202,6 +259,29 @@ struct physicsjoint2d {
     b2Joint* b2joint;
 };
 
+// Box2D shapes built from a shape list. Objects created from identical
+// shape lists share one of these, so the geometry is only built once.
+// The shapes are never changed (Box2D copies them into each fixture):
+struct physicsshapedef2d {
+    unsigned int hash;
+    double* key;  // flattened shape list this was built from
+    int keylength;
+    int refcount;
+    b2Shape** shapes;  // at scale 1
+    int* isloop;  // chain shapes only: 1 for loops, 0 for open chains
+    int count;
+    struct physicsshapescale2d* scales;  // most recently used first
+    int scalecount;
+    struct physicsshapedef2d* next;  // in the same hash bucket
+};
+
+// A scaled variant of the shapes of a shape definition:
+struct physicsshapescale2d {
+    double scalex, scaley;
+    b2Shape** shapes;
+    struct physicsshapescale2d* next;
+};
+
 
 /*
     3d-specific structs
@@ -237,6 +317,24 @@ struct physicsobject {
     struct physicsworld* pworld;
 };
 
+// A collision between two objects during a step, merged from all
+// contacts between them:
+struct physicscontactevent {
+    struct physicsobject* a;
+    struct physicsobject* b;
+    double x, y;  // sum of all contact points
+    double normalx, normaly;  // normal of the strongest contact
+    double force;  // strongest impact
+    int count;
+};
+
+// A pair of objects which shall never collide with each other:
+struct physicsignoredpair {
+    struct physicsobject* a;
+    struct physicsobject* b;
+    struct physicsignoredpair* next;
+};
+
 struct physicsworld {
     union {
         struct physicsworld2d world2d;
@@ -249,9 +347,24 @@ struct physicsworld {
     int (*callback)(void* userdata,
         struct physicsobject* a, struct physicsobject* b,
         double x, double y, double normalx, double normaly, double force);
-    // exchange object callback:
-    void (*exchangeObjectCallback)(struct physicsobject* oold,
-        struct physicsobject* onew);
+
+    // collision events collected during the current step:
+    struct physicscontactevent* contactevents;
+    int contacteventcount;
+    int contacteventalloc;
+    int* contacthash;  // event index + 1 per slot, 0 for empty
+    int contacthashsize;
+
+    // hash set of object pairs which shall never collide:
+    struct physicsignoredpair** ignoredpairs;
+    int ignoredpairbuckets;
+    int ignoredpaircount;
+
+    // objects destroyed while the collision events are dispatched:
+    int dispatchingcontacts;
+    struct physicsobject** deferreddeletions;
+    int deferreddeletioncount;
+    int deferreddeletionalloc;
 };
 
 struct physicsjoint {
@@ -270,12 +383,6 @@ struct physicsobjectshape {
     int is3d;
 };
 
-struct b2_shape_info {
-    // b2ChainShape only
-    int is_loop; // or chain if not
-    //no: struct b2_shape_info* next;
-};
-
 
 /*
     Purely internal functions
@@ -290,17 +397,19 @@ void _physics_apply2dOffsetRotation(struct physicsobjectshape2d* shape2d,
  b2Vec2* targets, int count);
 static int _physics_create2dObj(struct physicsworld2d* world,
 struct physicsobject* object, void* userdata, int movable);
-void _physics_create2dObjectEdges_End(struct edge* edges, struct physicsobject2d* object, struct physicsobjectshape2d* shape2d);
-void _physics_create2dObjectPoly_End(struct polygonpoint* polygonpoints, struct physicsobject2d* object, struct physicsobjectshape2d* shape2d);
-// Scaling aux
-b2ChainShape* _physics_copyb2ChainShape(b2ChainShape* src, b2_shape_info*
- shape_info);
-b2CircleShape* _physics_copyb2CircleShape(b2CircleShape* src, b2_shape_info*
- shape_info);
-b2PolygonShape* _physics_copyb2PolygonShape(b2PolygonShape* src, b2_shape_info*
- shape_info);
-void _physics_fill2dOrigShapeCache(struct physicsobject2d* object);
-void _physics_delete2dOrigShapeCache(struct physicsobject2d* object);
+static int _physics_create2dObjectEdges_End(struct edge* edges,
+ struct physicsshapedef2d* def, int* alloc,
+ struct physicsobjectshape2d* shape2d);
+static b2PolygonShape* _physics_create2dObjectPoly_End(
+ struct polygonpoint* polygonpoints, struct physicsobjectshape2d* shape2d);
+// Shape library
+static struct physicsshapedef2d* _physics_get2dShapeDef(
+ struct physicsobjectshape* shapelist, int shapecount);
+static void _physics_release2dShapeDef(struct physicsshapedef2d* def);
+static b2Shape** _physics_get2dScaledShapes(struct physicsshapedef2d* def,
+ double scalex, double scaley);
+static void _physics_add2dFixtures(struct physicsobject2d* object,
+ b2Shape** shapes, int count, double friction, double restitution);
 
 
 class mycontactlistener : public b2ContactListener {
@@ -316,6 +425,38 @@ private:
 mycontactlistener::mycontactlistener() {return;}
 mycontactlistener::~mycontactlistener() {return;}
 
+// Rejects object pairs in Box2D's broadphase before any contact
+// is created, based on the fixture filter and the world's ignore set:
+class mycontactfilter : public b2ContactFilter {
+public:
+    bool ShouldCollide(b2Fixture* fixtureA, b2Fixture* fixtureB);
+};
+
+static int physics_pairIsIgnored(struct physicsobject* obj1,
+    struct physicsobject* obj2);
+
+bool mycontactfilter::ShouldCollide(b2Fixture* fixtureA,
+        b2Fixture* fixtureB) {
+    // categories, masks and groups:
+    if (!b2ContactFilter::ShouldCollide(fixtureA, fixtureB)) {
+        return false;
+    }
+    struct physicsobject* obj1 = ((struct bodyuserdata*)fixtureA->
+        GetBody()->GetUserData())->pobj;
+    struct physicsobject* obj2 = ((struct bodyuserdata*)fixtureB->
+        GetBody()->GetUserData())->pobj;
+    if (obj1->deleted || obj2->deleted) {
+        return false;
+    }
+    // explicitely ignored pairs:
+    if (obj1->object2d.ignoredpaircount > 0 &&
+            obj2->object2d.ignoredpaircount > 0 &&
+            physics_pairIsIgnored(obj1, obj2)) {
+        return false;
+    }
+    return true;
+}
+
 static void physics_handleContact(b2Contact* contact);
 
 void mycontactlistener::PreSolve(b2Contact *contact, const b2Manifold *oldManifold) {
@@ -326,20 +467,32 @@ void mycontactlistener::BeginContact(b2Contact* contact) {
     physics_handleContact(contact);
 }
 
+static void physics_removeDisabledContact(struct physicsobject* obj,
+    b2Contact* contact);
+static void _physics_add2dRestingObject(struct physicsobject* obj);
+
 void mycontactlistener::EndContact(b2Contact* contact) {
-    // since we assume all EndContact events roughly occur
-    // at the same point (when stepping of all contacts is
-    // finished), we no longer want to keep the disabled
-    // contact information - it was kept to avoid refiring
-    // the events during presolve, which is now done with
-    // endcontact.
-    // Hence, clear all disabled contacts up:
+    // the contact stops touching or is destroyed, so it no longer
+    // needs to stay disabled (and box2d may reuse its memory for a
+    // new contact). Other disabled contacts of the two objects
+    // remain disabled until they end aswell:
     struct physicsobject* obj1 = ((struct bodyuserdata*)contact->GetFixtureA()
         ->GetBody()->GetUserData())->pobj;
     struct physicsobject* obj2 = ((struct bodyuserdata*)contact->GetFixtureB()
         ->GetBody()->GetUserData())->pobj;
-    obj1->object2d.disabledContactCount = 0;
-    obj2->object2d.disabledContactCount = 0;
+    physics_removeDisabledContact(obj1, contact);
+    physics_removeDisabledContact(obj2, contact);
+
+    // Box2D wakes both bodies when a touching contact ends, also
+    // outside of steps (e.g. when the body one rested on is destroyed,
+    // or when their collision gets filtered). It does so only after
+    // this event, so they are added to the moving objects right away:
+    if (!obj1->deleted) {
+        _physics_add2dRestingObject(obj1);
+    }
+    if (!obj2->deleted) {
+        _physics_add2dRestingObject(obj2);
+    }
 }
 
 #include "timefuncs.h"
@@ -410,7 +563,200 @@ b2Contact* contact) {
     return 0;
 }
 
-// handle the contact event and pass it on to the physics callback:
+// remove a contact from the disabled list (if it is in there) by
+// moving the last disabled contact into its place:
+static void physics_removeDisabledContact(struct physicsobject* obj,
+b2Contact* contact) {
+    int c = 0;
+    while (c < obj->object2d.disabledContactCount) {
+        b2Contact** entry = &obj->object2d.disabledContacts
+            [c / DISABLEDCONTACTBLOCKSIZE][c % DISABLEDCONTACTBLOCKSIZE];
+        if (*entry == contact) {
+            int last = obj->object2d.disabledContactCount - 1;
+            *entry = obj->object2d.disabledContacts
+                [last / DISABLEDCONTACTBLOCKSIZE]
+                [last % DISABLEDCONTACTBLOCKSIZE];
+            obj->object2d.disabledContactCount--;
+            return;
+        }
+        c++;
+    }
+}
+
+#define CONTACTHASHMINSIZE 64
+#define IGNOREDPAIRMINBUCKETS 64
+
+static unsigned int physics_hashContactPair(struct physicsobject* a,
+    struct physicsobject* b);
+
+// Find the ignored pair entry for the two objects (in any order).
+// Returns a pointer to the list link pointing to it, or NULL:
+static struct physicsignoredpair** physics_findIgnoredPair(
+        struct physicsworld* world, struct physicsobject* obj1,
+        struct physicsobject* obj2) {
+    if (world->ignoredpairbuckets == 0) {
+        return NULL;
+    }
+    if (obj2 < obj1) {
+        struct physicsobject* swap = obj1;
+        obj1 = obj2;
+        obj2 = swap;
+    }
+    struct physicsignoredpair** p = &world->ignoredpairs[
+        physics_hashContactPair(obj1, obj2) %
+        world->ignoredpairbuckets];
+    while (*p) {
+        if ((*p)->a == obj1 && (*p)->b == obj2) {
+            return p;
+        }
+        p = &((*p)->next);
+    }
+    return NULL;
+}
+
+static int physics_pairIsIgnored(struct physicsobject* obj1,
+        struct physicsobject* obj2) {
+    return (physics_findIgnoredPair(obj1->pworld, obj1, obj2) != NULL);
+}
+
+// Resize the bucket array of the ignored pair set:
+static int physics_resizeIgnoredPairs(struct physicsworld* world,
+        int buckets) {
+    struct physicsignoredpair** newbuckets = (struct physicsignoredpair**)
+        malloc(sizeof(*newbuckets) * buckets);
+    if (!newbuckets) {
+        return 0;
+    }
+    memset(newbuckets, 0, sizeof(*newbuckets) * buckets);
+    int i = 0;
+    while (i < world->ignoredpairbuckets) {
+        struct physicsignoredpair* p = world->ignoredpairs[i];
+        while (p) {
+            struct physicsignoredpair* next = p->next;
+            unsigned int bucket = physics_hashContactPair(p->a, p->b) %
+                buckets;
+            p->next = newbuckets[bucket];
+            newbuckets[bucket] = p;
+            p = next;
+        }
+        i++;
+    }
+    free(world->ignoredpairs);
+    world->ignoredpairs = newbuckets;
+    world->ignoredpairbuckets = buckets;
+    return 1;
+}
+
+static void physics_removeIgnoredPairLink(struct physicsworld* world,
+        struct physicsignoredpair** link) {
+    struct physicsignoredpair* p = *link;
+    *link = p->next;
+    p->a->object2d.ignoredpaircount--;
+    p->b->object2d.ignoredpaircount--;
+    world->ignoredpaircount--;
+    free(p);
+}
+
+// Remove all ignored pairs the given object is part of:
+static void physics_removeAllIgnoredPairs(struct physicsobject* obj) {
+    struct physicsworld* world = obj->pworld;
+    int i = 0;
+    while (i < world->ignoredpairbuckets &&
+            obj->object2d.ignoredpaircount > 0) {
+        struct physicsignoredpair** p = &world->ignoredpairs[i];
+        while (*p) {
+            if ((*p)->a == obj || (*p)->b == obj) {
+                physics_removeIgnoredPairLink(world, p);
+                continue;
+            }
+            p = &((*p)->next);
+        }
+        i++;
+    }
+}
+
+static unsigned int physics_hashContactPair(struct physicsobject* a,
+        struct physicsobject* b) {
+    uint64_t h = ((uint64_t)(uintptr_t)a) * 2654435761u;
+    h ^= ((uint64_t)(uintptr_t)b) * 40503u;
+    return (unsigned int)(h ^ (h >> 16));
+}
+
+// Get the event for the given pair (with a < b) collected during
+// this step, or add a new one. Returns NULL if out of memory:
+static struct physicscontactevent* physics_getContactEvent(
+        struct physicsworld* world, struct physicsobject* a,
+        struct physicsobject* b) {
+    // look for an existing event first:
+    if (world->contacthashsize > 0) {
+        unsigned int mask = world->contacthashsize - 1;
+        unsigned int slot = physics_hashContactPair(a, b) & mask;
+        while (world->contacthash[slot] != 0) {
+            struct physicscontactevent* ev = &world->contactevents[
+                world->contacthash[slot] - 1];
+            if (ev->a == a && ev->b == b) {
+                return ev;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    // we need a new one. make sure we have enough space:
+    if (world->contacteventcount + 1 > world->contacteventalloc) {
+        int newalloc = world->contacteventalloc * 2;
+        if (newalloc < CONTACTHASHMINSIZE / 2) {
+            newalloc = CONTACTHASHMINSIZE / 2;
+        }
+        struct physicscontactevent* newevents =
+            (struct physicscontactevent*)realloc(world->contactevents,
+            sizeof(*newevents) * newalloc);
+        if (!newevents) {
+            return NULL;
+        }
+        world->contactevents = newevents;
+        int* newhash = (int*)malloc(sizeof(int) * newalloc * 2);
+        if (!newhash) {
+            return NULL;
+        }
+        world->contacteventalloc = newalloc;
+
+        // rebuild hash table with the new size:
+        free(world->contacthash);
+        world->contacthash = newhash;
+        world->contacthashsize = newalloc * 2;
+        memset(world->contacthash, 0, sizeof(int) * world->contacthashsize);
+        int i = 0;
+        while (i < world->contacteventcount) {
+            unsigned int slot = physics_hashContactPair(
+                world->contactevents[i].a, world->contactevents[i].b) &
+                (world->contacthashsize - 1);
+            while (world->contacthash[slot] != 0) {
+                slot = (slot + 1) & (world->contacthashsize - 1);
+            }
+            world->contacthash[slot] = i + 1;
+            i++;
+        }
+    }
+
+    // add new event:
+    struct physicscontactevent* ev =
+        &world->contactevents[world->contacteventcount];
+    memset(ev, 0, sizeof(*ev));
+    ev->a = a;
+    ev->b = b;
+    ev->force = -1;
+    world->contacteventcount++;
+    unsigned int slot = physics_hashContactPair(a, b) &
+        (world->contacthashsize - 1);
+    while (world->contacthash[slot] != 0) {
+        slot = (slot + 1) & (world->contacthashsize - 1);
+    }
+    world->contacthash[slot] = world->contacteventcount;
+    return ev;
+}
+
+// handle the contact event and remember it for the physics callback
+// which is called when the step is complete:
 static void physics_handleContact(b2Contact* contact) {
     struct physicsobject* obj1 = ((struct bodyuserdata*)contact->GetFixtureA()
         ->GetBody()->GetUserData())->pobj;
@@ -461,22 +807,96 @@ static void physics_handleContact(b2Contact* contact) {
 
     // find our current world
     struct physicsworld* w = obj1->pworld;
+    if (!w->callback) {
+        return;
+    }
 
-    // return the information through the callback
-    if (w->callback) {
-        if (!w->callback(w->callbackuserdata, obj1, obj2,
-        collidex, collidey, normalx, normaly, impact)) {
-            // contact should be disabled:
-            contact->SetEnabled(false);
+    // merge with other contacts of the same two objects in this step,
+    // with the normal pointing from b to a:
+    if (obj2 < obj1) {
+        struct physicsobject* swap = obj1;
+        obj1 = obj2;
+        obj2 = swap;
+        normalx = -normalx;
+        normaly = -normaly;
+    }
+    struct physicscontactevent* ev = physics_getContactEvent(w, obj1, obj2);
+    if (!ev) {
+        // out of memory. this collision will go unreported
+        return;
+    }
+    ev->x += collidex;
+    ev->y += collidey;
+    ev->count++;
+    if (impact > ev->force) {
+        ev->force = impact;
+        ev->normalx = normalx;
+        ev->normaly = normaly;
+    }
+}
 
-            // remember it being disabled:
-            physics_storeDisabledContact(obj1, contact);
-            physics_storeDisabledContact(obj2, contact);
-        } else {
-            // contact should remain enabled:
-            contact->SetEnabled(true);
+// Disable all current contacts between the two objects until they
+// stop touching. Only touching contacts are remembered, since only
+// those get an EndContact event which removes them again:
+static void physics_disableContacts(struct physicsobject* obj1,
+        struct physicsobject* obj2) {
+    b2ContactEdge* e = obj1->object2d.body->GetContactList();
+    while (e) {
+        if (e->other == obj2->object2d.body &&
+                e->contact->IsTouching() &&
+                !physics_contactIsDisabled(obj1, e->contact)) {
+            e->contact->SetEnabled(false);
+            physics_storeDisabledContact(obj1, e->contact);
+            physics_storeDisabledContact(obj2, e->contact);
+        }
+        e = e->next;
+    }
+}
+
+// Pass all collisions collected during the step on to the physics
+// callback, once per pair of objects:
+static void physics_dispatchContactEvents(struct physicsworld* world) {
+    if (world->contacteventcount == 0) {
+        return;
+    }
+    int i = 0;
+    while (i < world->contacteventcount) {
+        struct physicscontactevent* ev = &world->contactevents[i];
+        i++;
+        if (ev->a->deleted || ev->b->deleted) {
+            // destroyed in a previous callback
+            continue;
+        }
+        if (!world->callback(world->callbackuserdata, ev->a, ev->b,
+                ev->x / ev->count, ev->y / ev->count,
+                ev->normalx, ev->normaly, ev->force)) {
+            if (!ev->a->deleted && !ev->b->deleted) {
+                physics_disableContacts(ev->a, ev->b);
+            }
         }
     }
+
+    // clear events for the next step:
+    world->contacteventcount = 0;
+    memset(world->contacthash, 0, sizeof(int) * world->contacthashsize);
+}
+
+void physics_beginContactDispatch_internal(struct physicsworld* world) {
+    world->dispatchingcontacts = 1;
+}
+
+void physics_endContactDispatch_internal(struct physicsworld* world) {
+    world->dispatchingcontacts = 0;
+
+    // destroy objects the callbacks wanted to get rid of:
+    int i = 0;
+    while (i < world->deferreddeletioncount) {
+        struct physicsobject* obj = world->deferreddeletions[i];
+        obj->deleted = 0;
+        physics_destroyObject_internal(obj);
+        i++;
+    }
+    world->deferreddeletioncount = 0;
 }
 
 /*
@@ -568,8 +988,22 @@ struct physicsworld* physics_createWorld(int use3dphysics) {
         world2d->w->SetAllowSleeping(true);
         world2d->gravityx = 0;
         world2d->gravityy = 9.81;
+        world2d->w->SetGravity(b2Vec2(world2d->gravityx * GRAVITYFACTOR,
+            world2d->gravityy * GRAVITYFACTOR));
         world2d->listener = new mycontactlistener();
         world2d->w->SetContactListener(world2d->listener);
+        world2d->filter = new mycontactfilter();
+        world2d->w->SetContactFilter(world2d->filter);
+#if defined(ANDROID) || defined(__ANDROID__)
+        // less accurate on Android
+        world2d->velocityiterations = 4;
+        world2d->positioniterations = 2;
+#else
+        // more accurate on desktop
+        world2d->velocityiterations = 8;
+        world2d->positioniterations = 3;
+#endif
+        world2d->substeps = 2;
         _physics_setWorldIs3D(world, 0);
         
         // set step size now that everything else is initialised:
@@ -595,8 +1029,27 @@ struct physicsworld* physics_createWorld(int use3dphysics) {
 
 void physics_destroyWorld(struct physicsworld* world) {
     if (not world->is3d) {
-        delete world->world2d.listener;
         delete world->world2d.w;
+        delete world->world2d.listener;
+        delete world->world2d.filter;
+        int i = 0;
+        while (i < world->ignoredpairbuckets) {
+            struct physicsignoredpair* p = world->ignoredpairs[i];
+            while (p) {
+                struct physicsignoredpair* next = p->next;
+                free(p);
+                p = next;
+            }
+            i++;
+        }
+        free(world->ignoredpairs);
+        free(world->contactevents);
+        free(world->contacthash);
+        free(world->deferreddeletions);
+        free(world->world2d.queryresults);
+        free(world->world2d.rayhits);
+        free(world->world2d.snapshothash);
+        free(world->world2d.moving);
         free(world);
     } else {
         printerror(BW_E_NO3DYET);
@@ -607,59 +1060,193 @@ int physics_worldIs3d_internal(struct physicsworld* world) {
     return _physics_worldIs3D(world);
 }
 
-void physics_step_internal(struct physicsworld* world) {
+#ifdef USE_PHYSICS2D
+// Add an object to its world's list of moving objects:
+static void _physics_add2dMoving(struct physicsobject* obj) {
+    struct physicsobject2d* obj2d = &obj->object2d;
+    if (obj2d->movingindex > 0 || !obj2d->body ||
+            obj2d->body->GetType() == b2_staticBody) {
+        return;
+    }
+    struct physicsworld2d* world2d = obj2d->pworld;
+    if (world2d->movingcount + 1 > world2d->movingalloc) {
+        int newalloc = world2d->movingalloc * 2 + 64;
+        struct physicsobject** newlist = (struct physicsobject**)
+            realloc(world2d->moving, sizeof(*newlist) * newalloc);
+        if (!newlist) {
+            // it simply won't be interpolated
+            return;
+        }
+        world2d->moving = newlist;
+        world2d->movingalloc = newalloc;
+    }
+    world2d->moving[world2d->movingcount] = obj;
+    world2d->movingcount++;
+    obj2d->movingindex = world2d->movingcount;
+}
+
+static void _physics_remove2dMoving(struct physicsobject* obj) {
+    struct physicsobject2d* obj2d = &obj->object2d;
+    if (obj2d->movingindex == 0) {
+        return;
+    }
+    struct physicsworld2d* world2d = obj2d->pworld;
+    struct physicsobject* last = world2d->moving[world2d->movingcount - 1];
+    world2d->moving[obj2d->movingindex - 1] = last;
+    last->object2d.movingindex = obj2d->movingindex;
+    world2d->movingcount--;
+    obj2d->movingindex = 0;
+}
+
+// Remember the current transform as the one before the next step:
+static void _physics_remember2dTransform(struct physicsobject2d* obj2d) {
+    obj2d->prevx = obj2d->body->GetPosition().x;
+    obj2d->prevy = obj2d->body->GetPosition().y;
+    obj2d->prevangle = obj2d->body->GetAngle();
+}
+
+// Add an object which was resting until now to the moving objects:
+static void _physics_add2dRestingObject(struct physicsobject* obj) {
+    if (obj->object2d.movingindex > 0) {
+        return;
+    }
+    _physics_add2dMoving(obj);
+    if (obj->object2d.movingindex > 0) {
+        // it rested where its previous transform was remembered:
+        obj->object2d.prevstep = obj->object2d.pworld->stepcount;
+    }
+}
+
+// Add a body which might have been woken up during the step:
+static void _physics_add2dWokenBody(b2Body* b) {
+    if (!b->IsAwake() || b->GetType() == b2_staticBody) {
+        return;
+    }
+    _physics_add2dRestingObject(
+        ((struct bodyuserdata*)b->GetUserData())->pobj);
+}
+
+// Update the moving objects after a step: drop those which fell asleep
+// and add those woken up by touching a moving one (or by a joint to
+// one), which is how Box2D wakes sleeping bodies during a step.
+// (bodies woken by contacts which ended were added in EndContact)
+static void _physics_update2dMoving(struct physicsworld2d* world2d) {
+    int i = 0;
+    while (i < world2d->movingcount) {
+        struct physicsobject* obj = world2d->moving[i];
+        b2Body* b = obj->object2d.body;
+        if (!b->IsAwake()) {
+            // it stays where it is now until woken up. (it has barely
+            // moved for a while, or it wouldn't have fallen asleep)
+            _physics_remember2dTransform(&obj->object2d);
+            _physics_remove2dMoving(obj);
+            continue;  // the last object was moved to index i
+        }
+        b2ContactEdge* e = b->GetContactList();
+        while (e) {
+            if (e->contact->IsTouching()) {
+                _physics_add2dWokenBody(e->other);
+            }
+            e = e->next;
+        }
+        b2JointEdge* j = b->GetJointList();
+        while (j) {
+            _physics_add2dWokenBody(j->other);
+            j = j->next;
+        }
+        i++;
+    }
+}
+#endif
+
+void physics_simulate_internal(struct physicsworld* world) {
     if (!world->is3d) {
 #ifdef USE_PHYSICS2D
         struct physicsworld2d* world2d = &(world->world2d);
-        // Do a collision step
+        struct physicsstepstats* stats = &world2d->stats;
+        memset(stats, 0, sizeof(*stats));
+        uint64_t start = time_getMicroseconds();
+
+        // remember where moving objects were for render interpolation:
+        world2d->stepcount++;
         int i = 0;
-        while (i < 2) {
-            double forcefactor = (1.0/(1000.0f/physics_getStepSize(world)))*2;
-            b2Body* b = world2d->w->GetBodyList();
-            while (b) {
-                // obtain physics object struct from body
-                struct physicsobject* obj = ((struct bodyuserdata*)b->GetUserData())->pobj;
+        while (i < world2d->movingcount) {
+            struct physicsobject2d* obj2d = &world2d->moving[i]->object2d;
+            _physics_remember2dTransform(obj2d);
+            obj2d->prevstep = world2d->stepcount;
+            i++;
+        }
+
+        // Do a collision step. It always covers two step sizes, no
+        // matter how many substeps it is split into:
+        double substeptime = (1.0 /(1000.0f/physics_getStepSize(world))) *
+            2.0 / world2d->substeps;
+        i = 0;
+        while (i < world2d->substeps) {
+            // world gravity is applied by Box2D. apply custom gravity
+            // to the objects which have it, unless they are sleeping:
+            double forcefactor = substeptime * GRAVITYFACTOR;
+            struct physicsobject* obj = world2d->customgravity;
+            while (obj) {
                 struct physicsobject2d* obj2d = &obj->object2d;
-                if (obj) {
-                    b2MassData mdata;
-                    obj2d->body->GetMassData(&mdata);
-                    double mass = mdata.mass;
-                    if (obj2d->gravityset) {
-                        // custom gravity which we want to apply
-                        b->ApplyLinearImpulse(
-                            b2Vec2(obj2d->gravityx * forcefactor * mass,
-                            obj2d->gravityy * forcefactor * mass),
-                            b2Vec2(b->GetPosition().x, b->GetPosition().y)
-                        );
-                    } else {
-                        // no custom gravity -> apply world gravity
-                        b->ApplyLinearImpulse(
-                            b2Vec2(world2d->gravityx * forcefactor * mass,
-                            world2d->gravityy * forcefactor * mass),
-                            b2Vec2(b->GetPosition().x, b->GetPosition().y)
-                        );
-                    }
+                b2Body* b = obj2d->body;
+                if (b->IsAwake()) {
+                    double mass = b->GetMass();
+                    b->ApplyLinearImpulse(
+                        b2Vec2(obj2d->gravityx * forcefactor * mass,
+                        obj2d->gravityy * forcefactor * mass),
+                        b->GetWorldCenter()
+                    );
                 }
-                b = b->GetNext();
+                obj = obj2d->nextcustomgravity;
+            }
+            world2d->w->Step(substeptime, world2d->velocityiterations,
+                world2d->positioniterations);
+
+            // add up Box2D's own timings. its solve time includes
+            // finding new contacts, but not the time of impact solving:
+            const b2Profile& profile = world2d->w->GetProfile();
+            stats->broadphase += profile.broadphase;
+            stats->narrowphase += profile.collide;
+            double solve = profile.solve - profile.broadphase +
+                profile.solveTOI;
+            if (solve > 0) {
+                stats->solve += solve;
             }
-#if defined(ANDROID) || defined(__ANDROID__)
-            // less accurate on Android
-            int it1 = 4;
-            int it2 = 2;
-#else
-            // more accurate on desktop
-            int it1 = 8;
-            int it2 = 3;
-#endif
-            world2d->w->Step(1.0 /(1000.0f/physics_getStepSize(world)), it1, it2);
             i++;
         }
+        _physics_update2dMoving(world2d);
+        stats->bodies = world2d->w->GetBodyCount();
+        stats->awakebodies = world2d->movingcount;
+        stats->contacts = world2d->w->GetContactCount();
+        stats->total = time_getMicrosecondsSince(start) / 1000.0;
 #endif
     } else {
         printerror(BW_E_NO3DYET);
     }
 }
 
+void physics_dispatchContactEvents_internal(struct physicsworld* world) {
+    if (!world->is3d) {
+#ifdef USE_PHYSICS2D
+        uint64_t start = time_getMicroseconds();
+        physics_dispatchContactEvents(world);
+        struct physicsstepstats* stats = &world->world2d.stats;
+        stats->callbacks = time_getMicrosecondsSince(start) / 1000.0;
+        stats->total += stats->callbacks;
+#endif
+    }
+}
+
+void physics_step_internal(struct physicsworld* world) {
+    physics_simulate_internal(world);
+
+    // report collisions now that the world is no longer locked:
+    physics_beginContactDispatch_internal(world);
+    physics_dispatchContactEvents_internal(world);
+    physics_endContactDispatch_internal(world);
+}
+
 int physics_getStepSize(struct physicsworld* world) {
     // TODO: 3D?
 #if defined(ANDROID) || defined(__ANDROID__)
@@ -671,18 +1258,40 @@ int physics_getStepSize(struct physicsworld* world) {
 #endif
 }
 
-void physics_setWorldExchangeObjectCallback_internal(
-        struct physicsworld* world,
-        void (*exchangeObjectCallback)(struct physicsobject* oold,
-        struct physicsobject* onew)) {
-    world->exchangeObjectCallback = exchangeObjectCallback;
+#ifdef USE_PHYSICS2D
+void physics_set2dStepQuality(struct physicsworld* world,
+        int velocityiterations, int positioniterations, int substeps) {
+    if (velocityiterations < 1) {
+        velocityiterations = 1;
+    }
+    if (positioniterations < 1) {
+        positioniterations = 1;
+    }
+    if (substeps < 1) {
+        substeps = 1;
+    }
+    if (substeps > MAXSUBSTEPS) {
+        substeps = MAXSUBSTEPS;
+    }
+    struct physicsworld2d* world2d = &(world->world2d);
+    world2d->velocityiterations = velocityiterations;
+    world2d->positioniterations = positioniterations;
+    world2d->substeps = substeps;
+}
+
+void physics_get2dStepQuality(struct physicsworld* world,
+        int* velocityiterations, int* positioniterations, int* substeps) {
+    struct physicsworld2d* world2d = &(world->world2d);
+    *velocityiterations = world2d->velocityiterations;
+    *positioniterations = world2d->positioniterations;
+    *substeps = world2d->substeps;
 }
 
-void (*physics_getWorldExchangeObjectCallback_internal
-        (struct physicsworld* world))
-        (struct physicsobject* oold, struct physicsobject* onew) {
-    return world->exchangeObjectCallback;
+void physics_get2dStepStats(struct physicsworld* world,
+        struct physicsstepstats* stats) {
+    memcpy(stats, &world->world2d.stats, sizeof(*stats));
 }
+#endif
 
 
 #ifdef USE_PHYSICS2D
@@ -1059,6 +1668,35 @@ void physics_add2dShapeEdgeList(struct physicsobjectshape* shape, double x1, dou
 }
 #endif
 
+#ifdef USE_PHYSICS2D
+void physics_set2dShapeEdgeListGhostVertex(struct physicsobjectshape* shape,
+ double x, double y, double ghostx, double ghosty) {
+    if (_physics_shapeType(shape) != 0 ||
+            shape->shape2d.type != BW_S2D_EDGE) {
+        return;
+    }
+    // find the edge with an open end at the given point:
+    struct edge* e = shape->shape2d.b2.edges;
+    while (e) {
+        if (!e->adjacent1 && fabs(e->x1 - x) < EPSILON &&
+                fabs(e->y1 - y) < EPSILON) {
+            e->hasghost1 = 1;
+            e->ghostx1 = ghostx;
+            e->ghosty1 = ghosty;
+            return;
+        }
+        if (!e->adjacent2 && fabs(e->x2 - x) < EPSILON &&
+                fabs(e->y2 - y) < EPSILON) {
+            e->hasghost2 = 1;
+            e->ghostx2 = ghostx;
+            e->ghosty2 = ghosty;
+            return;
+        }
+        e = e->next;
+    }
+}
+#endif
+
 #ifdef USE_PHYSICS2D
 inline void _physics_rotateThenOffset2dPoint(double xoffset, double yoffset,
  double rotation, double* x, double* y) {
@@ -1106,6 +1744,43 @@ void physics_get2dShapeOffsetRotation(struct physicsobjectshape* shape, double*
 }
 #endif
 
+// Destroyed objects are kept for reuse, so games spawning and removing
+// lots of objects don't keep going through the heap. Objects are
+// allocated in blocks and never handed back to the heap.
+// (objects are only created and destroyed on the main thread)
+#define OBJECTPOOLBLOCKSIZE 64
+union pooledobject {
+    struct physicsobject obj;
+    union pooledobject* next;  // next unused object
+};
+static union pooledobject* unusedobjects = NULL;
+
+static struct physicsobject* _physics_allocObject(void) {
+    if (!unusedobjects) {
+        union pooledobject* block = (union pooledobject*)malloc(
+            sizeof(*block) * OBJECTPOOLBLOCKSIZE);
+        if (!block) {
+            return NULL;
+        }
+        int i = 0;
+        while (i < OBJECTPOOLBLOCKSIZE) {
+            block[i].next = unusedobjects;
+            unusedobjects = &block[i];
+            i++;
+        }
+    }
+    union pooledobject* p = unusedobjects;
+    unusedobjects = p->next;
+    memset(&p->obj, 0, sizeof(p->obj));
+    return &p->obj;
+}
+
+static void _physics_freeObject(struct physicsobject* obj) {
+    union pooledobject* p = (union pooledobject*)obj;
+    p->next = unusedobjects;
+    unusedobjects = p;
+}
+
 // Everything about object creation starts here
 #ifdef USE_PHYSICS2D
 static int _physics_create2dObj(struct physicsworld2d* world,
@@ -1113,49 +1788,83 @@ struct physicsobject* object, void* userdata, int movable) {
     struct physicsobject2d* obj2d = &object->object2d;
     memset(obj2d, 0, sizeof(*obj2d));
 
-    struct bodyuserdata* pdata = (struct bodyuserdata*)malloc(sizeof(*pdata));
-    if (!pdata) {
-        return 0;
-    }
-    memset(pdata, 0, sizeof(*pdata));
-    pdata->userdata = userdata;
-    pdata->pobj = object;
+    obj2d->bodydata.userdata = userdata;
+    obj2d->bodydata.pobj = object;
 
     b2BodyDef bodyDef;
     if (movable) {
         bodyDef.type = b2_dynamicBody;
     }
     obj2d->movable = movable;
-    bodyDef.userData = (void*)pdata;
-    obj2d->userdata = pdata;
+    bodyDef.userData = (void*)&obj2d->bodydata;
     obj2d->body = world->w->CreateBody(&bodyDef);
     if (!obj2d->body) {
-        free(pdata);
         return 0;
     }
     obj2d->body->SetFixedRotation(false);
     obj2d->world = world->w;
     obj2d->pworld = world;
+    world->bodygeneration++;
+    b2Filter defaultfilter;
+    obj2d->filtercategorybits = defaultfilter.categoryBits;
+    obj2d->filtermaskbits = defaultfilter.maskBits;
+    obj2d->filtergroup = defaultfilter.groupIndex;
+    _physics_add2dMoving(object);
     return 1;
 }
 #endif
 
 #ifdef USE_PHYSICS2D
-// TODO: Weaken coupling, i.e. no direct reference to physicsobject2d,
-// instead take edges and return b2 chains
-// (goal: common code for fixture etc. in outer function)
-// problem: memory mgmt., variable number of returned edge shapes, scaling sh-t
-void _physics_create2dObjectEdges_End(struct edge* edges,
- struct physicsobject2d* object, struct physicsobjectshape2d* shape2d) {
-    /* not sure if this is needed anymore, probably not
-    if (!context->edgelist) {
-        physics2d_DestroyObject(context->obj);
-        free(context);
-        return NULL;
-    }*/
-    
-    int num_shapes = 0;
+// Append a shape to a shape definition that is being built:
+static int _physics_add2dDefShape(struct physicsshapedef2d* def, int* alloc,
+ b2Shape* shape, int isloop) {
+    if (def->count + 1 > *alloc) {
+        int newalloc = (*alloc) * 2 + 4;
+        b2Shape** newshapes = (b2Shape**)realloc(def->shapes,
+            sizeof(*newshapes) * newalloc);
+        if (!newshapes) {
+            return 0;
+        }
+        def->shapes = newshapes;
+        int* newisloop = (int*)realloc(def->isloop,
+            sizeof(*newisloop) * newalloc);
+        if (!newisloop) {
+            return 0;
+        }
+        def->isloop = newisloop;
+        *alloc = newalloc;
+    }
+    def->shapes[def->count] = shape;
+    def->isloop[def->count] = isloop;
+    def->count++;
+    return 1;
+}
+#endif
+
+#ifdef USE_PHYSICS2D
+// Get the ghost vertex beyond the given end (1: x1,y1, 2: x2,y2)
+// of an edge. Returns 0 if there is none:
+static int _physics_get2dEdgeGhost(struct edge* e, int end, b2Vec2* v) {
+    if (end == 1) {
+        v->Set(e->ghostx1, e->ghosty1);
+        return e->hasghost1;
+    }
+    v->Set(e->ghostx2, e->ghosty2);
+    return e->hasghost2;
+}
+
+// Turn the edges into chain shapes and add them to the shape definition:
+static int _physics_create2dObjectEdges_End(struct edge* edges,
+ struct physicsshapedef2d* def, int* alloc,
+ struct physicsobjectshape2d* shape2d) {
+    // the same shape list may be built more than once:
     struct edge* e = edges;
+    while (e) {
+        e->processed = 0;
+        e = e->next;
+    }
+
+    e = edges;
     while (e) {
         //skip edges we already processed
         if (e->processed) {
@@ -1171,19 +1880,24 @@ void _physics_create2dObjectEdges_End(struct edge* edges,
 
         int varraysize = e->adjacentcount+1;
         b2Vec2* varray = new b2Vec2[varraysize];
-        b2ChainShape chain;
         e->processed = 1;
 
         //see into which direction we want to go
         struct edge* eprev = e;
         struct edge* e2;
+        b2Vec2 prevghost, nextghost;
+        int hasprevghost, hasnextghost;
         if (e->adjacent1) {
             varray[0] = b2Vec2(e->x2, e->y2);
             varray[1] = b2Vec2(e->x1, e->y1);
+            hasprevghost = _physics_get2dEdgeGhost(e, 2, &prevghost);
+            hasnextghost = _physics_get2dEdgeGhost(e, 1, &nextghost);
             e2 = e->adjacent1;
         } else {
             varray[0] = b2Vec2(e->x1, e->y1);
             varray[1] = b2Vec2(e->x2, e->y2);
+            hasprevghost = _physics_get2dEdgeGhost(e, 1, &prevghost);
+            hasnextghost = _physics_get2dEdgeGhost(e, 2, &nextghost);
             e2 = e->adjacent2;
         }
 
@@ -1197,8 +1911,10 @@ void _physics_create2dObjectEdges_End(struct edge* edges,
             //Check which vertex we want to add
             if (e2->adjacent1 == eprev) {
                 varray[i] = b2Vec2(e2->x2, e2->y2);
+                hasnextghost = _physics_get2dEdgeGhost(e2, 2, &nextghost);
             } else {
                 varray[i] = b2Vec2(e2->x1, e2->y1);
+                hasnextghost = _physics_get2dEdgeGhost(e2, 1, &nextghost);
             }
 
             //advance to next edge
@@ -1215,53 +1931,39 @@ void _physics_create2dObjectEdges_End(struct edge* edges,
             i++;
         }
 
-        //debug print values
-        /*int u = 0;
-        while (u < e->adjacentcount + 1 - (1 * e->inaloop)) {
-            printf("Chain vertex: %f, %f\n", varray[u].x, varray[u].y);
-            u++;
-        }*/
-        
         // Rotate and offset every vector in varray
         _physics_apply2dOffsetRotation(shape2d, varray, varraysize);
-        
-        // Needed for scaling lolmao good coding 10/10
-        // TODO: put into a separate fn, make the whole thing more oop
-        num_shapes++;
-        object->orig_shape_count = num_shapes;
-        object->orig_shape_info = (b2_shape_info*) realloc(
-         object->orig_shape_info, sizeof(*(object->orig_shape_info)) *
-         num_shapes);
-        
+
         //construct an edge shape from this
+        b2ChainShape* chain = new b2ChainShape;
         if (e->inaloop) {
-            chain.CreateLoop(varray, e->adjacentcount);
-            // More scaling workaround stuff
-            object->orig_shape_info[num_shapes-1].is_loop = 1;
+            chain->CreateLoop(varray, e->adjacentcount);
         } else {
-            chain.CreateChain(varray, e->adjacentcount+1);
-            // And again
-            object->orig_shape_info[num_shapes-1].is_loop = 0;
+            chain->CreateChain(varray, e->adjacentcount+1);
+            if (hasprevghost) {
+                _physics_apply2dOffsetRotation(shape2d, &prevghost, 1);
+                chain->SetPrevVertex(prevghost);
+            }
+            if (hasnextghost) {
+                _physics_apply2dOffsetRotation(shape2d, &nextghost, 1);
+                chain->SetNextVertex(nextghost);
+            }
         }
-
-        //add it to our body
-        b2FixtureDef fixtureDef;
-        fixtureDef.shape = &chain;
-        fixtureDef.friction = 0.5; // TODO: ???
-        fixtureDef.density = 1; // TODO: ???
-        object->body->CreateFixture(&fixtureDef);
-
         delete[] varray;
+
+        if (!_physics_add2dDefShape(def, alloc, chain, e->inaloop)) {
+            delete chain;
+            return 0;
+        }
     }
+    return 1;
 }
 #endif
 
 #ifdef USE_PHYSICS2D
-// TODO: cf. function above
-void _physics_create2dObjectPoly_End(struct polygonpoint* polygonpoints,
- struct physicsobject2d* object, struct physicsobjectshape2d* shape2d) {
+static b2PolygonShape* _physics_create2dObjectPoly_End(
+ struct polygonpoint* polygonpoints, struct physicsobjectshape2d* shape2d) {
     struct polygonpoint* p = polygonpoints;
-    // TODO: cache this instead?
     int i = 0;
     while (p != NULL) {
         ++i;
@@ -1279,81 +1981,471 @@ void _physics_create2dObjectPoly_End(struct polygonpoint* polygonpoints,
         p = p->next;
     }
     _physics_apply2dOffsetRotation(shape2d, varray, i);
-    
-    b2PolygonShape shape;
-    shape.Set(varray, i);
-    
+
+    b2PolygonShape* shape = new b2PolygonShape;
+    shape->Set(varray, i);
+
+    delete[] varray;
+    return shape;
+}
+#endif
+
+// The shape library starts here
+#ifdef USE_PHYSICS2D
+// Buckets of the shape definition hash table:
+#define SHAPEDEFBUCKETS 256
+// Scaled variants kept per shape definition:
+#define MAXSCALEDSHAPES 8
+
+static struct physicsshapedef2d* shapedefs[SHAPEDEFBUCKETS];
+
+// Append a value to a shape list key:
+static int _physics_add2dShapeKey(double** key, int* length, int* alloc,
+ double value) {
+    if (*length + 1 > *alloc) {
+        int newalloc = (*alloc) * 2 + 32;
+        double* newkey = (double*)realloc(*key,
+            sizeof(*newkey) * newalloc);
+        if (!newkey) {
+            return 0;
+        }
+        *key = newkey;
+        *alloc = newalloc;
+    }
+    (*key)[*length] = value;
+    (*length)++;
+    return 1;
+}
+
+// Flatten the shape list into a list of numbers, so identical shape
+// lists can be recognised. Returns 0 when out of memory:
+static int _physics_get2dShapeKey(struct physicsobjectshape* shapelist,
+ int shapecount, double** key, int* length) {
+    *key = NULL;
+    *length = 0;
+    int alloc = 0;
+#define ADDKEY(v) if (!_physics_add2dShapeKey(key, length, &alloc, (v))) {\
+free(*key); *key = NULL; return 0;}
+    int i = 0;
+    while (i < shapecount) {
+        struct physicsobjectshape* s = &(shapelist[i]);
+        if (_physics_shapeType(s) != 0) {
+            // object creation stops here, too
+            break;
+        }
+        struct physicsobjectshape2d* s2d = &(s->shape2d);
+        ADDKEY((double)s2d->type);
+        ADDKEY(s2d->xoffset);
+        ADDKEY(s2d->yoffset);
+        ADDKEY(s2d->rotation);
+        switch ((int)(s2d->type)) {
+            case BW_S2D_RECT:
+                ADDKEY(s2d->b2.rectangle->width);
+                ADDKEY(s2d->b2.rectangle->height);
+            break;
+            case BW_S2D_POLY: {
+                struct polygonpoint* p = s2d->b2.polygonpoints;
+                while (p) {
+                    ADDKEY(p->x);
+                    ADDKEY(p->y);
+                    p = p->next;
+                }
+                break;
+            }
+            case BW_S2D_CIRCLE:
+                ADDKEY(s2d->b2.circle->m_radius);
+            break;
+            case BW_S2D_EDGE: {
+                struct edge* e = s2d->b2.edges;
+                while (e) {
+                    ADDKEY(e->x1);
+                    ADDKEY(e->y1);
+                    ADDKEY(e->x2);
+                    ADDKEY(e->y2);
+                    ADDKEY((double)e->hasghost1);
+                    ADDKEY(e->ghostx1);
+                    ADDKEY(e->ghosty1);
+                    ADDKEY((double)e->hasghost2);
+                    ADDKEY(e->ghostx2);
+                    ADDKEY(e->ghosty2);
+                    e = e->next;
+                }
+                break;
+            }
+        }
+        // separate the variable length point lists of two shapes:
+        ADDKEY(-1);
+        i++;
+    }
+#undef ADDKEY
+    return 1;
+}
+
+static unsigned int _physics_hash2dShapeKey(const double* key, int length) {
+    // FNV-1a:
+    const unsigned char* p = (const unsigned char*)key;
+    size_t bytes = sizeof(*key) * length;
+    unsigned int hash = 2166136261u;
+    size_t i = 0;
+    while (i < bytes) {
+        hash ^= p[i];
+        hash *= 16777619u;
+        i++;
+    }
+    return hash;
+}
+
+static void _physics_free2dShapes(b2Shape** shapes, int count) {
+    if (!shapes) {
+        return;
+    }
+    int i = 0;
+    while (i < count) {
+        delete shapes[i];
+        i++;
+    }
+    free(shapes);
+}
+
+static void _physics_free2dShapeDef(struct physicsshapedef2d* def) {
+    struct physicsshapescale2d* scale = def->scales;
+    while (scale) {
+        struct physicsshapescale2d* next = scale->next;
+        _physics_free2dShapes(scale->shapes, def->count);
+        free(scale);
+        scale = next;
+    }
+    _physics_free2dShapes(def->shapes, def->count);
+    free(def->isloop);
+    free(def->key);
+    free(def);
+}
+
+// Build the Box2D shapes for a shape list:
+static struct physicsshapedef2d* _physics_create2dShapeDef(
+ struct physicsobjectshape* shapelist, int shapecount) {
+    struct physicsshapedef2d* def = (struct physicsshapedef2d*)
+        malloc(sizeof(*def));
+    if (!def) {
+        return NULL;
+    }
+    memset(def, 0, sizeof(*def));
+    int alloc = 0;
+
+    struct physicsobjectshape* s = shapelist;
+    int i = 0;
+    while (i < shapecount) {
+        if (_physics_shapeType(s) != 0) {
+            // TODO: error msg?
+            break;
+        }
+        b2Shape* shape = NULL;
+        switch ((int)(s->shape2d.type)) {
+            case BW_S2D_RECT: {
+                b2PolygonShape* poly = new b2PolygonShape;
+                poly->SetAsBox(
+                 s->shape2d.b2.rectangle->width / 2,
+                 s->shape2d.b2.rectangle->height / 2,
+                 b2Vec2(s->shape2d.xoffset, s->shape2d.yoffset),
+                 s->shape2d.rotation);
+                shape = poly;
+                break;
+            }
+            case BW_S2D_POLY:
+                shape = _physics_create2dObjectPoly_End(
+                 s->shape2d.b2.polygonpoints, &(s->shape2d));
+            break;
+            case BW_S2D_CIRCLE: {
+                b2CircleShape* circle = new b2CircleShape;
+                circle->m_p = b2Vec2(s->shape2d.xoffset, s->shape2d.yoffset);
+                circle->m_radius = s->shape2d.b2.circle->m_radius;
+                shape = circle;
+                break;
+            }
+            case BW_S2D_EDGE:
+                if (!_physics_create2dObjectEdges_End(s->shape2d.b2.edges,
+                        def, &alloc, &(s->shape2d))) {
+                    _physics_free2dShapeDef(def);
+                    return NULL;
+                }
+            break;
+        }
+        if (shape && !_physics_add2dDefShape(def, &alloc, shape, 0)) {
+            delete shape;
+            _physics_free2dShapeDef(def);
+            return NULL;
+        }
+        s += 1;
+        ++i;
+    }
+    return def;
+}
+
+// Get the shared shape definition for a shape list, building it if no
+// object with an identical shape list exists yet:
+static struct physicsshapedef2d* _physics_get2dShapeDef(
+ struct physicsobjectshape* shapelist, int shapecount) {
+    double* key;
+    int keylength;
+    if (!_physics_get2dShapeKey(shapelist, shapecount, &key, &keylength)) {
+        return NULL;
+    }
+    unsigned int hash = _physics_hash2dShapeKey(key, keylength);
+
+    // see if we already have it:
+    struct physicsshapedef2d* def = shapedefs[hash % SHAPEDEFBUCKETS];
+    while (def) {
+        if (def->hash == hash && def->keylength == keylength &&
+                (keylength == 0 ||
+                memcmp(def->key, key, sizeof(*key) * keylength) == 0)) {
+            free(key);
+            def->refcount++;
+            return def;
+        }
+        def = def->next;
+    }
+
+    // build a new one:
+    def = _physics_create2dShapeDef(shapelist, shapecount);
+    if (!def) {
+        free(key);
+        return NULL;
+    }
+    def->hash = hash;
+    def->key = key;
+    def->keylength = keylength;
+    def->refcount = 1;
+    def->next = shapedefs[hash % SHAPEDEFBUCKETS];
+    shapedefs[hash % SHAPEDEFBUCKETS] = def;
+    return def;
+}
+
+static void _physics_release2dShapeDef(struct physicsshapedef2d* def) {
+    assert(def->refcount > 0);
+    def->refcount--;
+    if (def->refcount > 0) {
+        return;
+    }
+
+    // remove from hash table:
+    struct physicsshapedef2d** p = &(shapedefs[def->hash % SHAPEDEFBUCKETS]);
+    while (*p && *p != def) {
+        p = &((*p)->next);
+    }
+    assert(*p == def);
+    *p = def->next;
+    _physics_free2dShapeDef(def);
+}
+
+// Get a scaled copy of a single shape:
+static b2Shape* _physics_scale2dShape(b2Shape* s, int isloop,
+ double scalex, double scaley) {
+    switch (s->GetType()) {
+        case b2Shape::e_chain: {
+            b2ChainShape* src = (b2ChainShape*)s;
+            // loops store their first vertex again at the end:
+            int count = src->m_count;
+            if (isloop) {
+                count--;
+            }
+            b2Vec2* varray = new b2Vec2[count];
+            int i = 0;
+            while (i < count) {
+                varray[i].Set(src->m_vertices[i].x * scalex,
+                    src->m_vertices[i].y * scaley);
+                i++;
+            }
+            b2ChainShape* chain = new b2ChainShape;
+            if (isloop) {
+                chain->CreateLoop(varray, count);
+            } else {
+                chain->CreateChain(varray, count);
+                if (src->m_hasPrevVertex) {
+                    chain->SetPrevVertex(b2Vec2(src->m_prevVertex.x * scalex,
+                        src->m_prevVertex.y * scaley));
+                }
+                if (src->m_hasNextVertex) {
+                    chain->SetNextVertex(b2Vec2(src->m_nextVertex.x * scalex,
+                        src->m_nextVertex.y * scaley));
+                }
+            }
+            delete[] varray;
+            return chain;
+        }
+        case b2Shape::e_circle: {
+            b2CircleShape* src = (b2CircleShape*)s;
+            b2Vec2 center(src->m_p.x * scalex, src->m_p.y * scaley);
+            if (fabs(fabs(scalex) - fabs(scaley)) < EPSILON) {
+                b2CircleShape* circle = new b2CircleShape;
+                circle->m_p = center;
+                circle->m_radius = src->m_radius * fabs(scalex);
+                return circle;
+            }
+            // scaled unevenly, so approximate the oval:
+            b2Vec2 varray[OVALVERTICES];
+            int i = 0;
+            while (i < OVALVERTICES) {
+                double angle = (2 * M_PI * i) / ((double)OVALVERTICES);
+                varray[i].Set(
+                    center.x + cos(angle) * src->m_radius * fabs(scalex),
+                    center.y + sin(angle) * src->m_radius * fabs(scaley));
+                i++;
+            }
+            b2PolygonShape* poly = new b2PolygonShape;
+            poly->Set(varray, OVALVERTICES);
+            return poly;
+        }
+        case b2Shape::e_polygon: {
+            b2PolygonShape* src = (b2PolygonShape*)s;
+            int count = src->m_vertexCount;
+            b2Vec2 varray[b2_maxPolygonVertices];
+            int i = 0;
+            while (i < count) {
+                // mirroring flips the winding, so keep it counter clockwise:
+                int k = i;
+                if (scalex * scaley < 0) {
+                    k = (count - 1) - i;
+                }
+                varray[k].Set(src->m_vertices[i].x * scalex,
+                    src->m_vertices[i].y * scaley);
+                i++;
+            }
+            b2PolygonShape* poly = new b2PolygonShape;
+            poly->Set(varray, count);
+            return poly;
+        }
+        default:
+            printerror("fatal error: unknown physics shape");
+        break;
+    }
+    return NULL;
+}
+
+// Get the shapes of a shape definition at the given scale. Recently
+// used scales are kept around, so objects scaled alike share them:
+static b2Shape** _physics_get2dScaledShapes(struct physicsshapedef2d* def,
+ double scalex, double scaley) {
+    if (fabs(scalex - 1) < EPSILON && fabs(scaley - 1) < EPSILON) {
+        return def->shapes;
+    }
+
+    // look for the variant, and move it to the front if found:
+    struct physicsshapescale2d* prev = NULL;
+    struct physicsshapescale2d* scale = def->scales;
+    while (scale) {
+        if (fabs(scale->scalex - scalex) < EPSILON &&
+                fabs(scale->scaley - scaley) < EPSILON) {
+            if (prev) {
+                prev->next = scale->next;
+                scale->next = def->scales;
+                def->scales = scale;
+            }
+            return scale->shapes;
+        }
+        prev = scale;
+        scale = scale->next;
+    }
+
+    // build a new variant:
+    scale = (struct physicsshapescale2d*)malloc(sizeof(*scale));
+    if (!scale) {
+        return NULL;
+    }
+    scale->scalex = scalex;
+    scale->scaley = scaley;
+    scale->shapes = NULL;
+    if (def->count > 0) {
+        scale->shapes = (b2Shape**)malloc(sizeof(b2Shape*) * def->count);
+        if (!scale->shapes) {
+            free(scale);
+            return NULL;
+        }
+        int i = 0;
+        while (i < def->count) {
+            scale->shapes[i] = _physics_scale2dShape(def->shapes[i],
+                def->isloop[i], scalex, scaley);
+            if (!scale->shapes[i]) {
+                _physics_free2dShapes(scale->shapes, i);
+                free(scale);
+                return NULL;
+            }
+            i++;
+        }
+    }
+
+    // drop the least recently used variant if we have too many:
+    if (def->scalecount >= MAXSCALEDSHAPES) {
+        struct physicsshapescale2d** last = &(def->scales);
+        while ((*last)->next) {
+            last = &((*last)->next);
+        }
+        _physics_free2dShapes((*last)->shapes, def->count);
+        free(*last);
+        *last = NULL;
+        def->scalecount--;
+    }
+    scale->next = def->scales;
+    def->scales = scale;
+    def->scalecount++;
+    return scale->shapes;
+}
+
+// Add a fixture for each of the shapes to the object's body.
+// A negative friction picks the default for the respective shape:
+static void _physics_add2dFixtures(struct physicsobject2d* object,
+ b2Shape** shapes, int count, double friction, double restitution) {
     b2FixtureDef fixtureDef;
-    fixtureDef.shape = &shape;
-    fixtureDef.friction = 1; // TODO: ???
     fixtureDef.density = 1; // TODO: ???
-    object->body->CreateFixture(&fixtureDef);
-    
-    delete[] varray;
+    fixtureDef.restitution = restitution;
+    fixtureDef.filter.categoryBits = object->filtercategorybits;
+    fixtureDef.filter.maskBits = object->filtermaskbits;
+    fixtureDef.filter.groupIndex = object->filtergroup;
+    int i = 0;
+    while (i < count) {
+        fixtureDef.shape = shapes[i];
+        fixtureDef.friction = friction;
+        if (friction < 0) {
+            fixtureDef.friction = 1; // TODO: ???
+            if (shapes[i]->GetType() == b2Shape::e_chain) {
+                fixtureDef.friction = 0.5;
+            }
+        }
+        object->body->CreateFixture(&fixtureDef);
+        i++;
+    }
 }
 #endif
 
 struct physicsobject* physics_createObject_internal(struct physicsworld* world,
         void* userdata, int movable, struct physicsobjectshape* shapelist,
         int shapecount) {
-    struct physicsobject* obj = (struct physicsobject*)malloc(sizeof(*obj));
-    memset(obj, 0, sizeof(*obj));
+    struct physicsobject* obj = _physics_allocObject();
+    if (!obj) {
+        return NULL;
+    }
     if (!(world->is3d)) {
 #ifdef USE_PHYSICS2D
         if (!_physics_create2dObj(&(world->world2d), obj, userdata,
         movable)) {
-            free(obj);
+            _physics_freeObject(obj);
             return NULL;
         }
-        
-        struct physicsobjectshape* s = shapelist;
-        int i = 0;
-        while (i < shapecount) {
-            if (_physics_shapeType(s) != 0) {
-                // TODO: error msg?
-                break;
-            }
-            b2FixtureDef fixtureDef;
-            switch ((int)(s->shape2d.type)) {
-                case BW_S2D_RECT:
-                    // TODO: bit messy (no memory avail. check)
-                    fixtureDef.shape = new b2PolygonShape;
-                    ((b2PolygonShape*)(fixtureDef.shape))->SetAsBox(
-                     s->shape2d.b2.rectangle->width / 2,
-                     s->shape2d.b2.rectangle->height / 2,
-                     b2Vec2(s->shape2d.xoffset, s->shape2d.yoffset),
-                     s->shape2d.rotation);
-                    fixtureDef.friction = 1; // TODO: ???
-                    fixtureDef.density = 1;
-                    obj->object2d.body->SetFixedRotation(false);
-                    obj->object2d.body->CreateFixture(&fixtureDef);
-                    delete fixtureDef.shape;
-                break;
-                case BW_S2D_POLY:
-                    _physics_create2dObjectPoly_End(s->shape2d.b2.polygonpoints,
-                     &obj->object2d, &(s->shape2d));
-                break;
-                case BW_S2D_CIRCLE:
-                    fixtureDef.shape = (new b2CircleShape);
-                    ((b2CircleShape*)(fixtureDef.shape))->m_p = b2Vec2(
-                     s->shape2d.xoffset, s->shape2d.yoffset);
-                    ((b2CircleShape*)(fixtureDef.shape))->m_radius =
-                        s->shape2d.b2.circle->m_radius;
-                    fixtureDef.friction = 1; // TODO: ???
-                    fixtureDef.density = 1;
-                    obj->object2d.body->SetFixedRotation(false);
-                    obj->object2d.body->CreateFixture(&fixtureDef);
-                    delete fixtureDef.shape;
-                break;
-                case BW_S2D_EDGE:
-                    _physics_create2dObjectEdges_End(s->shape2d.b2.edges,
-                    &obj->object2d, &(s->shape2d));
-                break;
-            }
-            s += 1;
-            ++i;
+
+        // get the (possibly shared) shapes and add them to the body:
+        struct physicsshapedef2d* def = _physics_get2dShapeDef(shapelist,
+            shapecount);
+        if (!def) {
+            obj->object2d.world->DestroyBody(obj->object2d.body);
+            _physics_remove2dMoving(obj);
+            _physics_freeObject(obj);
+            return NULL;
         }
-        
+        obj->object2d.shapedef = def;
+        obj->object2d.scalex = 1;
+        obj->object2d.scaley = 1;
+        _physics_add2dFixtures(&obj->object2d, def->shapes, def->count,
+            -1, 0);
+
         obj->is3d = 0;
 #endif
     } else {
@@ -1371,14 +2463,29 @@ struct physicsobject* physics_createObject_internal(struct physicsworld* world,
     return obj;
 }
 
-
 // Everything about object deletion starts here
 static void _physics_destroyObjectDo(struct physicsobject* obj) {
     if (!obj->is3d) {
 #ifdef USE_PHYSICS2D
-        _physics_delete2dOrigShapeCache(&(obj->object2d));
+        physics_unsetGravity_internal(obj);
+        if (obj->object2d.ignoredpaircount > 0) {
+            physics_removeAllIgnoredPairs(obj);
+        }
+#ifndef NDEBUG
+        // prevent double delete.
+        assert(!obj->object2d._deleted);
+        obj->object2d._deleted = 1;
+#endif
+        if (obj->object2d.shapedef) {
+            _physics_release2dShapeDef(obj->object2d.shapedef);
+            obj->object2d.shapedef = NULL;
+        }
         if (obj->object2d.body) {
             obj->object2d.world->DestroyBody(obj->object2d.body);
+            // (after destroying the body, since its ended contacts
+            // add it again)
+            _physics_remove2dMoving(obj);
+            obj->object2d.pworld->bodygeneration++;
         }
         if (obj->object2d.disabledContactBlockCount > 0) {
             int i = 0;
@@ -1389,13 +2496,36 @@ static void _physics_destroyObjectDo(struct physicsobject* obj) {
         }
 #endif
     }
-    free(obj);
+    _physics_freeObject(obj);
 }
 
 void physics_destroyObject_internal(struct physicsobject* obj) {
     if (obj->deleted == 1) {
         return;
     }
+    struct physicsworld* world = obj->pworld;
+    if (world && world->dispatchingcontacts) {
+        // other collision events might still refer to this object,
+        // so destroy it once they are all dispatched:
+        if (world->deferreddeletioncount + 1 >
+                world->deferreddeletionalloc) {
+            int newalloc = world->deferreddeletionalloc * 2 + 16;
+            struct physicsobject** newlist = (struct physicsobject**)
+                realloc(world->deferreddeletions,
+                sizeof(*newlist) * newalloc);
+            if (!newlist) {
+                // we can't defer it. better leak it than crash:
+                obj->deleted = 1;
+                return;
+            }
+            world->deferreddeletions = newlist;
+            world->deferreddeletionalloc = newalloc;
+        }
+        world->deferreddeletions[world->deferreddeletioncount] = obj;
+        world->deferreddeletioncount++;
+        obj->deleted = 1;
+        return;
+    }
     _physics_destroyObjectDo(obj);
 }
 
@@ -1415,250 +2545,48 @@ void* physics_getObjectUserdata_internal(struct physicsobject* object) {
     return NULL;
 }
 
-// Scaling aux functions begin here
-
 #ifdef USE_PHYSICS2D
-b2ChainShape* _physics_copyb2ChainShape(b2ChainShape* src, b2_shape_info*
- shape_info) {
-    b2ChainShape* dest;
-    dest = new b2ChainShape();
-    if (shape_info->is_loop)
-        dest->CreateLoop(src->m_vertices, src->m_count);
-    else
-        dest->CreateChain(src->m_vertices, src->m_count);
-    return dest;
-}
-#endif
-
-#ifdef USE_PHYSICS2D
-b2CircleShape* _physics_copyb2CircleShape(b2CircleShape* src, b2_shape_info*
- shape_info) {
-    b2CircleShape* dest;
-    dest = new b2CircleShape();
-    dest->m_p = src->m_p;
-    dest->m_radius = src->m_radius;
-    return dest;
-}
-#endif
-
-#ifdef USE_PHYSICS2D
-b2PolygonShape* _physics_copyb2PolygonShape(b2PolygonShape* src, b2_shape_info*
- shape_info) {
-    b2PolygonShape* dest;
-    dest = new b2PolygonShape();
-    dest->Set(src->m_vertices, src->m_vertexCount);
-    return dest;
-}
-#endif
-
-#ifdef USE_PHYSICS2D
-void _physics_fill2dOrigShapeCache(struct physicsobject2d* object) {
-    b2Body* body = object->body;
-    b2Fixture* f = body->GetFixtureList();
-    union {
-        b2ChainShape* chain;
-        b2CircleShape* circle;
-        b2EdgeShape* edge;
-        b2PolygonShape* poly;
-    };
-    /* XXX IMPORTANT: This relies on b2Body::GetFixtureList() returning
-     fixtures in the reverse order they were added in.
-     */
-#warning "Code relies on b2Body::GetFixtureList() returning fixtures in the \
-reverse order they were added in."
-    int fixture_count = 0;
-    int orig_shape_info_count = 0;
-    while (f != NULL) {
-        if (f->GetType() == b2Shape::e_chain)
-            ++orig_shape_info_count;
-        ++fixture_count;
-        f = f->GetNext();
-    }
-    object->orig_shapes = (b2Shape**)malloc(sizeof(b2Shape*)*fixture_count);
-    if (!object->orig_shapes) {
-        object->orig_shape_count = 0;
+void physics_set2dScale_internal(struct physicsobject* object, double scalex,
+ double scaley) {
+    struct physicsobject2d* object2d = &(object->object2d);
+    if (!object2d->shapedef) {
         return;
     }
-    object->orig_shape_count = fixture_count;
-    // those conditions should now hold true:
-    assert(object->orig_shape_count == fixture_count);
- 
-    int orig_shape_info_index = orig_shape_info_count-1;
-    int fixture_index = fixture_count-1;
-    f = body->GetFixtureList();
-    while (f != NULL) {
-        switch (f->GetType()) {
-            case b2Shape::e_chain:
-                chain = _physics_copyb2ChainShape(
-                 (b2ChainShape*)(f->GetShape()),
-                 &(object->orig_shape_info[orig_shape_info_index]));
-                object->orig_shapes[fixture_index] = (b2Shape*)chain;
-                --orig_shape_info_index;
-            break;
-            case b2Shape::e_circle:
-                circle = _physics_copyb2CircleShape(
-                 (b2CircleShape*)(f->GetShape()), NULL);
-                object->orig_shapes[fixture_index] = (b2Shape*)circle;
-            break;
-            case b2Shape::e_edge:
-                // never happens.
-                assert(0);
-                //edge = f->GetShape();
-            break;
-            case b2Shape::e_polygon:
-                poly = _physics_copyb2PolygonShape(
-                 (b2PolygonShape*)(f->GetShape()), NULL);
-                //object->orig_shapes[fixture_index] = (b2Shape*)malloc(
-                // sizeof(b2PolygonShape*));
-                object->orig_shapes[fixture_index] = (b2Shape*)poly;
-            break;
-            default:
-                assert(0);
-                printerror("unknown fixture type in "
-                "_physics_fill2dOrigShapeCache");
-            break;
-        }
-        fixture_index--;
-        f = f->GetNext();
+    if (fabs(object2d->scalex - scalex) < EPSILON &&
+            fabs(object2d->scaley - scaley) < EPSILON) {
+        // nothing changes
+        return;
     }
-}
-#endif
 
-#ifdef USE_PHYSICS2D
-void _physics_delete2dOrigShapeCache(struct physicsobject2d* object) {
-#ifndef NDEBUG
-    // prevent double delete.
-    assert(!object->_deleted);
-    object->_deleted = 1;
-#endif
-    // negative count is invalid:
-    assert(object->orig_shape_count >= 0);
-    // delete the original shape info:
-    if (object->orig_shapes) {
-        for (int i = 0; i < object->orig_shape_count; ++i) {
-            delete object->orig_shapes[i]; // delete shape
-        }
+    // get the shapes at the new scale first, so we can keep the old
+    // fixtures if that fails:
+    b2Shape** shapes = _physics_get2dScaledShapes(object2d->shapedef,
+        scalex, scaley);
+    if (!shapes) {
+        return;
     }
-    free(object->orig_shapes); // delete array of pointers to shapes
-    free(object->orig_shape_info); // delete array of shape info structs
-    // Just in case:
-    object->orig_shape_count = 0;
-}
-#endif
 
-#ifdef USE_PHYSICS2D
-void physics_set2dScale_internal(struct physicsobject* object, double scalex,
- double scaley) {
-    // TODO maybe (though it's stupid): do nothing when old_scale == new_scale
-    struct physicsobject2d* object2d = &(object->object2d);
+    // delete all the old fixtures:
     b2Body* body = object2d->body;
-    b2Fixture* f = body->GetFixtureList();
     double mass = physics_getMass_internal(object);
-    union {
-        b2ChainShape* chain;
-        b2CircleShape* circle;
-        b2EdgeShape* edge;
-        b2PolygonShape* poly;
-    };
-    
-    // Firstly, make sure the original shape cache thingy is initialised
-    if (object2d->orig_shape_count == 0) {
-        _physics_fill2dOrigShapeCache(object2d);
-        if (object2d->orig_shape_count == 0) {
-            // it didn't work. what to do? probably nothing.
-            return;
-        }
+    double friction = 0.5;
+    double restitution = 0;
+    b2Fixture* f = body->GetFixtureList();
+    if (f) {
+        friction = f->GetFriction();
+        restitution = f->GetRestitution();
     }
-    // Secondly, delete all the old fixtures+
-    float oldfriction = 0.5f;
     while (f != NULL) {
-        oldfriction = f->GetFriction();
         body->DestroyFixture(f);
         f = body->GetFixtureList();
     }
-    /* TODO: Write the rest of this function.
-     PROTIP: In order to do just that, we should first clean up the shape
-     creation functions we already have so we can re-use the one for ovals
-     when scaling circles. Also, the way orig_shape_info is filled in the one
-     on edges->chains might not be correct, so look into it.
-    */
-    
-    // Should be able to re-use this
-    b2FixtureDef fixtureDef;
-    fixtureDef.friction = oldfriction;
-    fixtureDef.density = 1; // TODO: ???
-    
-    int i = 0; // orig_shapes[i]
-    int j = 0; // orig_shape_info[j]
-    b2Shape* s = NULL;
-    b2Shape* new_shape = NULL;
-    while (i < object2d->orig_shape_count) {
-        s = object2d->orig_shapes[i];
-        if (scalex == 1 and scaley == 1) {
-            fixtureDef.shape = s;
-            object2d->body->CreateFixture(&fixtureDef);
-        } else {
-            switch (s->GetType()) {
-                case b2Shape::e_chain:
-                    chain = _physics_copyb2ChainShape((b2ChainShape*)s,
-                     &(object2d->orig_shape_info[j]));
-                    // Actual scaling:
-                    for (int k = 0; k < chain->m_count; ++k) {
-                        chain->m_vertices[k].x *= scalex;
-                        chain->m_vertices[k].y *= scaley;
-                    }
-                    fixtureDef.shape = chain;
-                    object2d->body->CreateFixture(&fixtureDef);
-                    ++j;
-                break;
-                case b2Shape::e_circle: // Re-use functions for ovals
-                    if (new_shape->GetType() == b2Shape::e_circle) {
-                        circle = (b2CircleShape*)new_shape;
-                        circle->m_p = ((b2CircleShape*)s)->m_p;
-                        circle->m_p.x *= scalex;
-                        circle->m_p.y *= scaley;
-                    } else { // polygon-approximated oval
-                        poly = (b2PolygonShape*)new_shape;
-                        // Adjust vertices for m_p; normals are unaffected.
-                        for (int k = 0; k < poly->m_vertexCount; ++k) {
-                            poly->m_vertices[k].x +=
-                             (((b2CircleShape*)s)->m_p.x) * scalex;
-                            poly->m_vertices[k].y +=
-                             (((b2CircleShape*)s)->m_p.y) * scaley;
-                            poly->m_centroid = ((b2CircleShape*)s)->m_p;
-                            poly->m_centroid.x *= scalex;
-                            poly->m_centroid.y *= scaley;
-                            fixtureDef.shape = poly;
-                        }
-                    }
-                    fixtureDef.shape = new_shape;
-                    object2d->body->CreateFixture(&fixtureDef);
-                break;
-                case b2Shape::e_edge:
-                    //never happens
-                break;
-                case b2Shape::e_polygon:
-                    /* Here, normals do change. */
-                    poly = _physics_copyb2PolygonShape((b2PolygonShape*)s,
-                     NULL);
-                    for (int k = 0; k < poly->m_vertexCount; ++k) {
-                        poly->m_vertices[k].x *= scalex;
-                        poly->m_vertices[k].y *= scaley;
-                    }
-                    // Hilarious way to have Box2D recalculate normals:
-#warning "Code relies on b2PolygonShape::Set() just copying vertices without \
-re-allocation of memory for m_vertices."
-                    poly->Set(poly->m_vertices, poly->m_vertexCount);
-                    fixtureDef.shape = poly;
-                    object2d->body->CreateFixture(&fixtureDef);
-                break;
-                default:
-                    printerror("fatal error: unknown physics shape");
-                break;
-            } // switch
-        } // else
-        ++i;
-    } // while
+
+    // add the new ones:
+    _physics_add2dFixtures(object2d, shapes, object2d->shapedef->count,
+        friction, restitution);
+    object2d->pworld->bodygeneration++;
+    object2d->scalex = scalex;
+    object2d->scaley = scaley;
     physics_setMass_internal(object, mass);
 }
 #endif
@@ -1742,9 +2670,25 @@ double* offsetx, double* offsety) {
 
 #ifdef USE_PHYSICS2D
 void physics_set2dGravity_internal(struct physicsobject* obj, double x, double y) {
-    obj->object2d.gravityset = 1;
-    obj->object2d.gravityx = x;
-    obj->object2d.gravityy = y;
+    struct physicsobject2d* obj2d = &obj->object2d;
+    if (!obj2d->gravityset) {
+        // add to the world's list of objects with custom gravity:
+        struct physicsworld2d* world2d = obj2d->pworld;
+        obj2d->prevcustomgravity = NULL;
+        obj2d->nextcustomgravity = world2d->customgravity;
+        if (world2d->customgravity) {
+            world2d->customgravity->object2d.prevcustomgravity = obj;
+        }
+        world2d->customgravity = obj;
+
+        // Box2D's world gravity no longer applies:
+        obj2d->body->SetGravityScale(0);
+    }
+    obj2d->gravityset = 1;
+    obj2d->gravityx = x;
+    obj2d->gravityy = y;
+    obj2d->body->SetAwake(true);
+    _physics_add2dMoving(obj);
 }
 #endif
 
@@ -1753,13 +2697,47 @@ void physics_set2dWorldGravity(struct physicsworld* world, double x, double y) {
     struct physicsworld2d* world2d = &(world->world2d);
     world2d->gravityx = x;
     world2d->gravityy = y;
+    world2d->w->SetGravity(b2Vec2(x * GRAVITYFACTOR, y * GRAVITYFACTOR));
+
+    // sleeping objects need to notice the change:
+    b2Body* b = world2d->w->GetBodyList();
+    while (b) {
+        if (b->GetType() == b2_dynamicBody) {
+            b->SetAwake(true);
+            _physics_add2dMoving(
+                ((struct bodyuserdata*)b->GetUserData())->pobj);
+        }
+        b = b->GetNext();
+    }
 }
 #endif
 
 void physics_unsetGravity_internal(struct physicsobject* obj) {
     if (not obj->is3d) {
 #ifdef USE_PHYSICS2D
-        obj->object2d.gravityset = 0;
+        struct physicsobject2d* obj2d = &obj->object2d;
+        if (!obj2d->gravityset) {
+            return;
+        }
+        // remove from the world's list of objects with custom gravity:
+        if (obj2d->prevcustomgravity) {
+            obj2d->prevcustomgravity->object2d.nextcustomgravity =
+                obj2d->nextcustomgravity;
+        } else {
+            obj2d->pworld->customgravity = obj2d->nextcustomgravity;
+        }
+        if (obj2d->nextcustomgravity) {
+            obj2d->nextcustomgravity->object2d.prevcustomgravity =
+                obj2d->prevcustomgravity;
+        }
+        obj2d->prevcustomgravity = NULL;
+        obj2d->nextcustomgravity = NULL;
+        obj2d->gravityset = 0;
+        if (obj2d->body) {
+            obj2d->body->SetGravityScale(1);
+            obj2d->body->SetAwake(true);
+            _physics_add2dMoving(obj);
+        }
 #endif
     } else {
 #ifdef USE_PHYSICS3D
@@ -1768,6 +2746,138 @@ void physics_unsetGravity_internal(struct physicsobject* obj) {
     }
 }
 
+#ifdef USE_PHYSICS2D
+void physics_set2dCollisionFilter_internal(struct physicsobject* obj,
+        unsigned int categorybits, unsigned int maskbits, int group) {
+    b2Filter filter;
+    filter.categoryBits = (uint16)categorybits;
+    filter.maskBits = (uint16)maskbits;
+    filter.groupIndex = (int16)group;
+    obj->object2d.filtercategorybits = filter.categoryBits;
+    obj->object2d.filtermaskbits = filter.maskBits;
+    obj->object2d.filtergroup = filter.groupIndex;
+
+    // apply to all fixtures. this also makes Box2D check the
+    // current contacts again:
+    b2Fixture* f = obj->object2d.body->GetFixtureList();
+    while (f) {
+        f->SetFilterData(filter);
+        f = f->GetNext();
+    }
+}
+#endif
+
+#ifdef USE_PHYSICS2D
+int physics_set2dIgnoreCollision_internal(struct physicsobject* obj1,
+        struct physicsobject* obj2, int ignore) {
+    if (obj1 == obj2 || obj1->pworld != obj2->pworld) {
+        return 1;
+    }
+    struct physicsworld* world = obj1->pworld;
+    struct physicsignoredpair** link = physics_findIgnoredPair(world,
+        obj1, obj2);
+    if (!ignore) {
+        if (link) {
+            physics_removeIgnoredPairLink(world, link);
+            // have Box2D create contacts again if they overlap:
+            obj1->object2d.body->SetAwake(true);
+            obj2->object2d.body->SetAwake(true);
+            _physics_add2dMoving(obj1);
+            _physics_add2dMoving(obj2);
+            b2Fixture* f = obj1->object2d.body->GetFixtureList();
+            while (f) {
+                f->Refilter();
+                f = f->GetNext();
+            }
+        }
+        return 1;
+    }
+    if (link) {
+        // already ignored
+        return 1;
+    }
+
+    // grow hash table if it is getting crowded:
+    if (world->ignoredpaircount + 1 > world->ignoredpairbuckets * 2) {
+        int buckets = world->ignoredpairbuckets * 4;
+        if (buckets < IGNOREDPAIRMINBUCKETS) {
+            buckets = IGNOREDPAIRMINBUCKETS;
+        }
+        if (!physics_resizeIgnoredPairs(world, buckets) &&
+                world->ignoredpairbuckets == 0) {
+            return 0;
+        }
+    }
+
+    struct physicsignoredpair* p = (struct physicsignoredpair*)
+        malloc(sizeof(*p));
+    if (!p) {
+        return 0;
+    }
+    if (obj2 < obj1) {
+        struct physicsobject* swap = obj1;
+        obj1 = obj2;
+        obj2 = swap;
+    }
+    p->a = obj1;
+    p->b = obj2;
+    unsigned int bucket = physics_hashContactPair(obj1, obj2) %
+        world->ignoredpairbuckets;
+    p->next = world->ignoredpairs[bucket];
+    world->ignoredpairs[bucket] = p;
+    world->ignoredpaircount++;
+    obj1->object2d.ignoredpaircount++;
+    obj2->object2d.ignoredpaircount++;
+
+    // remove contacts which might exist already:
+    b2Fixture* f = obj1->object2d.body->GetFixtureList();
+    while (f) {
+        f->Refilter();
+        f = f->GetNext();
+    }
+    return 1;
+}
+#endif
+
+#ifdef USE_PHYSICS2D
+void physics_transfer2dIgnoredCollisions_internal(
+        struct physicsobject* oldobj, struct physicsobject* newobj) {
+    if (oldobj->object2d.ignoredpaircount == 0) {
+        return;
+    }
+    struct physicsworld* world = oldobj->pworld;
+
+    // collect the partner objects first, since adding new pairs
+    // can rehash the table:
+    int count = oldobj->object2d.ignoredpaircount;
+    struct physicsobject** others = (struct physicsobject**)
+        malloc(sizeof(*others) * count);
+    if (!others) {
+        return;
+    }
+    int k = 0;
+    int i = 0;
+    while (i < world->ignoredpairbuckets && k < count) {
+        struct physicsignoredpair* p = world->ignoredpairs[i];
+        while (p) {
+            if (p->a == oldobj) {
+                others[k++] = p->b;
+            } else if (p->b == oldobj) {
+                others[k++] = p->a;
+            }
+            p = p->next;
+        }
+        i++;
+    }
+    i = 0;
+    while (i < k) {
+        physics_set2dIgnoreCollision_internal(newobj, others[i], 1);
+        i++;
+    }
+    free(others);
+}
+#endif
+
 #ifdef USE_PHYSICS2D
 void physics_set2dRotationRestriction_internal(struct physicsobject* obj, int restricted) {
     double mass = physics_getMass_internal(obj);
@@ -1870,9 +2980,31 @@ void physics_get2dRotation_internal(struct physicsobject* obj, double* angle) {
 }
 #endif
 
+#ifdef USE_PHYSICS2D
+void physics_get2dInterpolatedTransform_internal(struct physicsobject* obj,
+double alpha, double* x, double* y, double* angle) {
+    struct physicsobject2d* obj2d = &obj->object2d;
+    b2Vec2 pos = obj2d->body->GetPosition();
+    double a = obj2d->body->GetAngle();
+    if (obj2d->prevstep == obj2d->pworld->stepcount) {
+        // moved in the last step -> blend with where it was before.
+        // (Box2D doesn't wrap angles, so they can be blended directly)
+        pos.x = obj2d->prevx + (pos.x - obj2d->prevx) * alpha;
+        pos.y = obj2d->prevy + (pos.y - obj2d->prevy) * alpha;
+        a = obj2d->prevangle + (a - obj2d->prevangle) * alpha;
+    }
+    *x = pos.x;
+    *y = pos.y;
+    *angle = (a * 180)/M_PI;
+}
+#endif
+
 #ifdef USE_PHYSICS2D
 void physics_warp2d_internal(struct physicsobject* obj, double x, double y, double angle) {
     obj->object2d.body->SetTransform(b2Vec2(x, y), angle * M_PI / 180);
+    // don't blend a warp with the old position:
+    _physics_remember2dTransform(&obj->object2d);
+    obj->object2d.prevstep = 0;
 }
 #endif
 
@@ -1880,6 +3012,7 @@ void physics_warp2d_internal(struct physicsobject* obj, double x, double y, doub
 void physics_apply2dImpulse_internal(struct physicsobject* obj, double forcex, double forcey, double sourcex, double sourcey) {
     obj->object2d.body->ApplyLinearImpulse(b2Vec2(forcex, forcey),
     b2Vec2(sourcex, sourcey));
+    _physics_add2dMoving(obj);
 }
 #endif
 
@@ -1900,18 +3033,21 @@ double physics_get2dAngularVelocity_internal(struct physicsobject* obj) {
 #ifdef USE_PHYSICS2D
 void physics_set2dVelocity_internal(struct physicsobject* obj, double vx, double vy) {
     obj->object2d.body->SetLinearVelocity(b2Vec2(vx, vy));
+    _physics_add2dMoving(obj);
 }
 #endif
 
 #ifdef USE_PHYSICS2D
 void physics_set2dAngularVelocity_internal(struct physicsobject* obj, double omega) {
     obj->object2d.body->SetAngularVelocity(omega);
+    _physics_add2dMoving(obj);
 }
 #endif
 
 #ifdef USE_PHYSICS2D
 void physics_apply2dAngularImpulse_internal(struct physicsobject* obj, double impulse) {
     obj->object2d.body->ApplyAngularImpulse(impulse);
+    _physics_add2dMoving(obj);
 }
 #endif
 
@@ -1930,6 +3066,9 @@ physicsjoint* physics_add2dObjectDistanceJoint_internal(
     def.bodyA = obj1->object2d.body;
     def.bodyB = obj2->object2d.body;
     obj1->pworld->world2d.w->CreateJoint(&def);
+    // (creating a joint wakes up both bodies)
+    _physics_add2dMoving(obj1);
+    _physics_add2dMoving(obj2);
     // TODO? def.userData? def.collideConnected?
     // TODO: Create physicsjoint instance etc. etc. and return it
     return NULL; // lol
@@ -1943,9 +3082,11 @@ public:
     b2Vec2 closestcollidedposition;
     b2Vec2 closestcollidednormal;
     b2Vec2 rayStartingPoint;
+    float32 closestfraction;
 
     mycallback() {
         closestcollidedbody = NULL;
+        closestfraction = 1;
     }
 
     virtual float ReportFixture(b2Fixture* fixture,
@@ -1959,6 +3100,7 @@ public:
         closestcollidedbody = fixture->GetBody();
         closestcollidedposition = point;
         closestcollidednormal = normal;
+        closestfraction = fraction;
         return fraction;  // only check fixtures up to this point
     }
 };
@@ -1990,6 +3132,530 @@ int physics_ray2d(struct physicsworld* world, double startx, double starty, doub
 }
 #endif
 
+#ifdef USE_PHYSICS2D
+#define QUERYRESULTMINSIZE 16
+
+// Start a new query, which forgets about the previous results:
+static void physics_startQuery(struct physicsworld2d* world2d) {
+    world2d->querystamp++;
+    if (world2d->querystamp == 0) {
+        // 0 is what objects start with, skip it
+        world2d->querystamp++;
+    }
+    world2d->queryresultcount = 0;
+    world2d->rayhitcount = 0;
+}
+
+// Add an object to the query results unless it is in there already.
+// Returns 0 if out of memory, otherwise 1:
+static int physics_addQueryResult(struct physicsworld2d* world2d,
+        struct physicsobject* obj) {
+    if (obj->deleted || obj->object2d.querystamp == world2d->querystamp) {
+        return 1;
+    }
+    if (world2d->queryresultcount + 1 > world2d->queryresultalloc) {
+        int newalloc = world2d->queryresultalloc * 2;
+        if (newalloc < QUERYRESULTMINSIZE) {
+            newalloc = QUERYRESULTMINSIZE;
+        }
+        struct physicsobject** newresults = (struct physicsobject**)
+            realloc(world2d->queryresults, sizeof(*newresults) * newalloc);
+        if (!newresults) {
+            return 0;
+        }
+        world2d->queryresults = newresults;
+        world2d->queryresultalloc = newalloc;
+    }
+    obj->object2d.querystamp = world2d->querystamp;
+    obj->object2d.queryindex = world2d->queryresultcount;
+    world2d->queryresults[world2d->queryresultcount] = obj;
+    world2d->queryresultcount++;
+    return 1;
+}
+
+class myquerycallback : public b2QueryCallback {
+public:
+    struct physicsworld2d* world2d;
+    b2AABB aabb;
+    const b2Shape* shape;  // NULL to only test the bounding box
+    b2Transform transform;
+    int outofmemory;
+
+    myquerycallback() {
+        shape = NULL;
+        transform.SetIdentity();
+        outofmemory = 0;
+    }
+
+    virtual bool ReportFixture(b2Fixture* fixture) {
+        // the broadphase only knows about rough bounding boxes,
+        // so check the actual overlap:
+        b2Body* body = fixture->GetBody();
+        const b2Shape* fixtureshape = fixture->GetShape();
+        int32 i = 0;
+        while (i < fixtureshape->GetChildCount()) {
+            bool overlaps;
+            if (shape) {
+                overlaps = b2TestOverlap(shape, 0, fixtureshape, i,
+                    transform, body->GetTransform());
+            } else {
+                b2AABB fixtureaabb;
+                fixtureshape->ComputeAABB(&fixtureaabb,
+                    body->GetTransform(), i);
+                overlaps = b2TestOverlap(aabb, fixtureaabb);
+            }
+            if (overlaps) {
+                if (!physics_addQueryResult(world2d,
+                        ((struct bodyuserdata*)body->GetUserData())->pobj)) {
+                    outofmemory = 1;
+                    return false;
+                }
+                break;
+            }
+            i++;
+        }
+        return true;
+    }
+};
+
+static int physics_query2d(struct physicsworld* world,
+        myquerycallback* callbackobj, struct physicsobject*** objects) {
+    struct physicsworld2d* world2d = &(world->world2d);
+    physics_startQuery(world2d);
+    callbackobj->world2d = world2d;
+    world2d->w->QueryAABB(callbackobj, callbackobj->aabb);
+    *objects = world2d->queryresults;
+    if (callbackobj->outofmemory) {
+        return -1;
+    }
+    return world2d->queryresultcount;
+}
+
+int physics_query2dBox(struct physicsworld* world,
+        double minx, double miny, double maxx, double maxy,
+        struct physicsobject*** objects) {
+    if (minx > maxx) {
+        double swap = minx;
+        minx = maxx;
+        maxx = swap;
+    }
+    if (miny > maxy) {
+        double swap = miny;
+        miny = maxy;
+        maxy = swap;
+    }
+    myquerycallback callbackobj;
+    callbackobj.aabb.lowerBound.Set(minx, miny);
+    callbackobj.aabb.upperBound.Set(maxx, maxy);
+    return physics_query2d(world, &callbackobj, objects);
+}
+
+int physics_query2dCircle(struct physicsworld* world,
+        double x, double y, double radius,
+        struct physicsobject*** objects) {
+    if (radius <= 0) {
+        *objects = NULL;
+        return 0;
+    }
+    b2CircleShape circle;
+    circle.m_p.Set(x, y);
+    circle.m_radius = radius;
+    myquerycallback callbackobj;
+    callbackobj.shape = &circle;
+    callbackobj.aabb.lowerBound.Set(x - radius, y - radius);
+    callbackobj.aabb.upperBound.Set(x + radius, y + radius);
+    return physics_query2d(world, &callbackobj, objects);
+}
+
+int physics_query2dPolygon(struct physicsworld* world,
+        const double* points, int count,
+        struct physicsobject*** objects) {
+    *objects = NULL;
+    if (count < 3 || count > b2_maxPolygonVertices) {
+        return -1;
+    }
+
+    // Box2D wants counter-clockwise points:
+    double area = 0;
+    int i = 0;
+    while (i < count) {
+        int next = (i + 1) % count;
+        area += points[i * 2] * points[next * 2 + 1] -
+            points[next * 2] * points[i * 2 + 1];
+        i++;
+    }
+    if (fabs(area) < EPSILON) {
+        return -1;
+    }
+    b2Vec2 vertices[b2_maxPolygonVertices];
+    myquerycallback callbackobj;
+    i = 0;
+    while (i < count) {
+        int k = i;
+        if (area < 0) {
+            k = count - 1 - i;
+        }
+        vertices[i].Set(points[k * 2], points[k * 2 + 1]);
+        if (i == 0) {
+            callbackobj.aabb.lowerBound = vertices[i];
+            callbackobj.aabb.upperBound = vertices[i];
+        } else {
+            callbackobj.aabb.lowerBound = b2Min(
+                callbackobj.aabb.lowerBound, vertices[i]);
+            callbackobj.aabb.upperBound = b2Max(
+                callbackobj.aabb.upperBound, vertices[i]);
+        }
+        i++;
+    }
+    b2PolygonShape polygon;
+    polygon.Set(vertices, count);
+    callbackobj.shape = &polygon;
+    return physics_query2d(world, &callbackobj, objects);
+}
+
+class myrayallcallback : public b2RayCastCallback {
+public:
+    struct physicsworld2d* world2d;
+    b2Vec2 rayStartingPoint;
+    int outofmemory;
+
+    myrayallcallback() {
+        outofmemory = 0;
+    }
+
+    virtual float ReportFixture(b2Fixture* fixture,
+    const b2Vec2& point, const b2Vec2& normal, float32 fraction) {
+        // ignore fixtures containing the starting point like ray2d:
+        if (fixture->TestPoint(rayStartingPoint)) {
+            return 1;
+        }
+        struct physicsobject* obj = ((struct bodyuserdata*)
+            fixture->GetBody()->GetUserData())->pobj;
+        if (obj->deleted) {
+            return 1;
+        }
+        struct physicsrayhit2d* hit;
+        if (obj->object2d.querystamp == world2d->querystamp) {
+            // object was hit before. keep the closer hit:
+            hit = &world2d->rayhits[obj->object2d.queryindex];
+            if (hit->fraction <= fraction) {
+                return 1;
+            }
+        } else {
+            int index = world2d->queryresultcount;
+            if (!physics_addQueryResult(world2d, obj)) {
+                outofmemory = 1;
+                return 0;
+            }
+            if (world2d->queryresultcount > world2d->rayhitalloc) {
+                struct physicsrayhit2d* newhits = (struct physicsrayhit2d*)
+                    realloc(world2d->rayhits, sizeof(*newhits) *
+                    world2d->queryresultalloc);
+                if (!newhits) {
+                    outofmemory = 1;
+                    return 0;
+                }
+                world2d->rayhits = newhits;
+                world2d->rayhitalloc = world2d->queryresultalloc;
+            }
+            hit = &world2d->rayhits[index];
+            hit->object = obj;
+            world2d->rayhitcount++;
+        }
+        hit->hitpointx = point.x;
+        hit->hitpointy = point.y;
+        hit->normalx = normal.x;
+        hit->normaly = normal.y;
+        hit->fraction = fraction;
+        return 1;  // continue with full ray length
+    }
+};
+
+static int physics_compareRayHits(const void* a, const void* b) {
+    double fa = ((const struct physicsrayhit2d*)a)->fraction;
+    double fb = ((const struct physicsrayhit2d*)b)->fraction;
+    if (fa < fb) {
+        return -1;
+    }
+    if (fa > fb) {
+        return 1;
+    }
+    return 0;
+}
+
+int physics_ray2dAll(struct physicsworld* world,
+        double startx, double starty, double targetx, double targety,
+        struct physicsrayhit2d** hits) {
+    struct physicsworld2d* world2d = &(world->world2d);
+    physics_startQuery(world2d);
+    *hits = world2d->rayhits;
+    if (fabs(targetx - startx) < EPSILON && fabs(targety - starty) < EPSILON) {
+        return 0;
+    }
+
+    myrayallcallback callbackobj;
+    callbackobj.world2d = world2d;
+    callbackobj.rayStartingPoint = b2Vec2(startx, starty);
+    world2d->w->RayCast(&callbackobj, b2Vec2(startx, starty),
+        b2Vec2(targetx, targety));
+    *hits = world2d->rayhits;
+    if (callbackobj.outofmemory) {
+        return -1;
+    }
+
+    // Box2D reports hits in no particular order:
+    qsort(world2d->rayhits, world2d->rayhitcount,
+        sizeof(*world2d->rayhits), &physics_compareRayHits);
+    return world2d->rayhitcount;
+}
+
+int physics_ray2dBatch(struct physicsworld* world,
+        int count, const double* rays, struct physicsrayhit2d* hits) {
+    struct physicsworld2d* world2d = &(world->world2d);
+    int hitcount = 0;
+    int i = 0;
+    while (i < count) {
+        const double* ray = &rays[i * 4];
+        struct physicsrayhit2d* hit = &hits[i];
+        memset(hit, 0, sizeof(*hit));
+        if (fabs(ray[2] - ray[0]) < EPSILON &&
+                fabs(ray[3] - ray[1]) < EPSILON) {
+            i++;
+            continue;
+        }
+
+        // same as physics_ray2d, but without the extra calls:
+        mycallback callbackobj;
+        callbackobj.rayStartingPoint = b2Vec2(ray[0], ray[1]);
+        world2d->w->RayCast(&callbackobj, b2Vec2(ray[0], ray[1]),
+            b2Vec2(ray[2], ray[3]));
+        if (callbackobj.closestcollidedbody) {
+            hit->object = ((struct bodyuserdata*)callbackobj.
+                closestcollidedbody->GetUserData())->pobj;
+            hit->hitpointx = callbackobj.closestcollidedposition.x;
+            hit->hitpointy = callbackobj.closestcollidedposition.y;
+            hit->normalx = callbackobj.closestcollidednormal.x;
+            hit->normaly = callbackobj.closestcollidednormal.y;
+            hit->fraction = callbackobj.closestfraction;
+            hitcount++;
+        }
+        i++;
+    }
+    return hitcount;
+}
+#endif
+
+// Snapshots start here
+#ifdef USE_PHYSICS2D
+#define SNAPSHOTMAGIC 0x42575331  // "BWS1"
+
+// The snapshot buffer holds the header, then one entry per body in the
+// world's body list order, then one entry per contact. Entries aren't
+// aligned, so they are always copied out with memcpy:
+struct physicssnapshotheader2d {
+    uint32_t magic;
+    uint32_t generation;  // world's bodygeneration
+    uint32_t bodycount;
+    uint32_t contactcount;
+    uint64_t world;  // address of the world it was taken from
+};
+
+struct physicssnapshotbody2d {
+    float x, y, angle;
+    float velocityx, velocityy, angularvelocity;
+    uint32_t awake;
+};
+
+struct physicssnapshotcontact2d {
+    b2Fixture* fixturea;
+    b2Fixture* fixtureb;
+    int32 childa, childb;
+    b2Manifold manifold;  // contact points and their impulses
+};
+
+size_t physics_snapshot2dWorld(struct physicsworld* world, void* buffer,
+        size_t buffersize) {
+    b2World* w = world->world2d.w;
+    struct physicssnapshotheader2d header;
+    header.magic = SNAPSHOTMAGIC;
+    header.generation = world->world2d.bodygeneration;
+    header.bodycount = w->GetBodyCount();
+    header.contactcount = w->GetContactCount();
+    header.world = (uint64_t)(uintptr_t)world;
+    size_t size = sizeof(header) +
+        sizeof(struct physicssnapshotbody2d) * header.bodycount +
+        sizeof(struct physicssnapshotcontact2d) * header.contactcount;
+    if (!buffer || buffersize < size) {
+        return size;
+    }
+    char* p = (char*)buffer;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+
+    b2Body* b = w->GetBodyList();
+    while (b) {
+        struct physicssnapshotbody2d body;
+        body.x = b->GetPosition().x;
+        body.y = b->GetPosition().y;
+        body.angle = b->GetAngle();
+        body.velocityx = b->GetLinearVelocity().x;
+        body.velocityy = b->GetLinearVelocity().y;
+        body.angularvelocity = b->GetAngularVelocity();
+        body.awake = b->IsAwake();
+        memcpy(p, &body, sizeof(body));
+        p += sizeof(body);
+        b = b->GetNext();
+    }
+
+    b2Contact* c = w->GetContactList();
+    while (c) {
+        struct physicssnapshotcontact2d contact;
+        memset(&contact, 0, sizeof(contact));
+        contact.fixturea = c->GetFixtureA();
+        contact.fixtureb = c->GetFixtureB();
+        contact.childa = c->GetChildIndexA();
+        contact.childb = c->GetChildIndexB();
+        contact.manifold = *(c->GetManifold());
+        memcpy(p, &contact, sizeof(contact));
+        p += sizeof(contact);
+        c = c->GetNext();
+    }
+    return size;
+}
+
+static unsigned int physics_hashSnapshotContact(b2Fixture* a, b2Fixture* b,
+        int32 childa, int32 childb) {
+    uintptr_t hash = (((uintptr_t)a) >> 3) * 2654435761u;
+    hash ^= (((uintptr_t)b) >> 3) * 40503u;
+    hash ^= ((uintptr_t)childa * 31) ^ (uintptr_t)childb;
+    return (unsigned int)hash;
+}
+
+// Build a hash table (index + 1 per slot, 0 for empty) of the contacts
+// in a snapshot. Returns 0 when out of memory:
+static int physics_hashSnapshotContacts(struct physicsworld2d* world2d,
+        const char* contacts, int count) {
+    int size = 16;
+    while (size < count * 2) {
+        size *= 2;
+    }
+    if (size > world2d->snapshothashsize) {
+        int* newhash = (int*)realloc(world2d->snapshothash,
+            sizeof(*newhash) * size);
+        if (!newhash) {
+            return 0;
+        }
+        world2d->snapshothash = newhash;
+        world2d->snapshothashsize = size;
+    }
+    size = world2d->snapshothashsize;
+    memset(world2d->snapshothash, 0, sizeof(int) * size);
+    int i = 0;
+    while (i < count) {
+        struct physicssnapshotcontact2d contact;
+        memcpy(&contact, contacts + sizeof(contact) * i, sizeof(contact));
+        unsigned int slot = physics_hashSnapshotContact(contact.fixturea,
+            contact.fixtureb, contact.childa, contact.childb) % size;
+        while (world2d->snapshothash[slot] != 0) {
+            slot = (slot + 1) % size;
+        }
+        world2d->snapshothash[slot] = i + 1;
+        i++;
+    }
+    return 1;
+}
+
+int physics_restore2dWorld(struct physicsworld* world, const void* buffer,
+        size_t size) {
+    struct physicsworld2d* world2d = &(world->world2d);
+    b2World* w = world2d->w;
+    if (w->IsLocked() || size < sizeof(struct physicssnapshotheader2d)) {
+        return 0;
+    }
+
+    // check this snapshot matches the world:
+    struct physicssnapshotheader2d header;
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != SNAPSHOTMAGIC ||
+            header.world != (uint64_t)(uintptr_t)world ||
+            header.generation != world2d->bodygeneration ||
+            header.bodycount != (uint32_t)w->GetBodyCount() ||
+            size != sizeof(header) +
+            sizeof(struct physicssnapshotbody2d) * header.bodycount +
+            sizeof(struct physicssnapshotcontact2d) * header.contactcount) {
+        return 0;
+    }
+    const char* p = (const char*)buffer + sizeof(header);
+
+    // restore bodies:
+    b2Body* b = w->GetBodyList();
+    while (b) {
+        struct physicssnapshotbody2d body;
+        memcpy(&body, p, sizeof(body));
+        p += sizeof(body);
+        // (moving a body in the broadphase is expensive, so only do it
+        // for those which actually moved)
+        if (b->GetPosition().x != body.x || b->GetPosition().y != body.y ||
+                b->GetAngle() != body.angle) {
+            b->SetTransform(b2Vec2(body.x, body.y), body.angle);
+        }
+        if (b->GetType() != b2_staticBody) {
+            b->SetAwake(body.awake != 0);
+            if (body.awake) {
+                b->SetLinearVelocity(b2Vec2(body.velocityx,
+                    body.velocityy));
+                b->SetAngularVelocity(body.angularvelocity);
+            }
+            // don't interpolate from where it was before:
+            struct physicsobject* obj =
+                ((struct bodyuserdata*)b->GetUserData())->pobj;
+            _physics_remember2dTransform(&obj->object2d);
+            obj->object2d.prevstep = 0;
+            if (body.awake) {
+                _physics_add2dMoving(obj);
+            }
+        }
+        b = b->GetNext();
+    }
+
+    // have Box2D create contacts for bodies which overlap again, so the
+    // remembered contacts can be put back into them:
+    const_cast<b2ContactManager&>(w->GetContactManager()).
+        FindNewContacts();
+
+    // restore contact points and impulses for warm-starting. contacts
+    // which didn't exist back then start out fresh:
+    int hashed = (header.contactcount > 0 &&
+        physics_hashSnapshotContacts(world2d, p, header.contactcount));
+    b2Contact* c = w->GetContactList();
+    while (c) {
+        b2Manifold* manifold = c->GetManifold();
+        manifold->pointCount = 0;
+        if (hashed) {
+            int size = world2d->snapshothashsize;
+            unsigned int slot = physics_hashSnapshotContact(
+                c->GetFixtureA(), c->GetFixtureB(),
+                c->GetChildIndexA(), c->GetChildIndexB()) % size;
+            while (world2d->snapshothash[slot] != 0) {
+                struct physicssnapshotcontact2d contact;
+                memcpy(&contact, p + sizeof(contact) *
+                    (world2d->snapshothash[slot] - 1), sizeof(contact));
+                if (contact.fixturea == c->GetFixtureA() &&
+                        contact.fixtureb == c->GetFixtureB() &&
+                        contact.childa == c->GetChildIndexA() &&
+                        contact.childb == c->GetChildIndexB()) {
+                    *manifold = contact.manifold;
+                    break;
+                }
+                slot = (slot + 1) % size;
+            }
+        }
+        c = c->GetNext();
+    }
+    return 1;
+}
+#endif
+
 
 } //extern "C"
 
@@ -115,6 +115,14 @@ void physics_set3dRotationRestrictionAroundAxis_internal(struct physicsobject* o
 void physics_set3dRotationRestrictionAllAxis_internal(struct physicsobject* obj);
 void physics_set3dNoRotationRestriction_internal(void);
 #endif
+#ifdef USE_PHYSICS2D
+void physics_set2dCollisionFilter_internal(struct physicsobject* obj,
+    unsigned int categorybits, unsigned int maskbits, int group);
+int physics_set2dIgnoreCollision_internal(struct physicsobject* obj1,
+    struct physicsobject* obj2, int ignore);
+void physics_transfer2dIgnoredCollisions_internal(
+    struct physicsobject* oldobj, struct physicsobject* newobj);
+#endif
 void physics_setFriction_internal(struct physicsobject* obj, double friction);
 void physics_setAngularDamping_internal(struct physicsobject* obj, double damping);
 void physics_setLinearDamping_internal(struct physicsobject* obj, double damping);
@@ -124,6 +132,8 @@ void physics_setRestitution_internal(struct physicsobject* obj, double restituti
 #ifdef USE_PHYSICS2D
 void physics_get2dPosition_internal(struct physicsobject* obj, double* x, double* y);
 void physics_get2dRotation_internal(struct physicsobject* obj, double* angle);
+void physics_get2dInterpolatedTransform_internal(struct physicsobject* obj,
+double alpha, double* x, double* y, double* angle);
 void physics_warp2d_internal(struct physicsobject* obj, double x, double y, double angle);
 void physics_apply2dImpulse_internal(struct physicsobject* obj, double forcex, double forcey, double sourcex, double sourcey);
 #endif
@@ -179,22 +189,25 @@ int physics_ray2d(struct physicsworld* world, double startx, double starty, doub
 int physics_ray3d(struct physicsworld* world, double startx, double starty, double startz, double targetx, double targety, double targetz, double* hitpointx, double* hitpointy, double* hitpointz, struct physicsobject** objecthit, double* hitnormalx, double* hitnormaly, double* hitnormalz); // returns 1 when something is hit, otherwise 0  -- XXX: not thread-safe!
 #endif
 
-// Set the callback that shall be called when an object ptr is exhanged:
-void physics_setWorldExchangeObjectCallback_internal(
-    struct physicsworld* world,
-    void (*exchangeObjectCallback)(struct physicsobject* oold,
-    struct physicsobject* onew));
-
-// Get the callback that was previously set (or NULL):
-typedef void (*WorldObjectExchangeCallback)(struct physicsobject* oold,
-    struct physicsobject* onew);
-WorldObjectExchangeCallback physics_getWorldExchangeObjectCallback_internal
-    (struct physicsworld* world);
-
 
 // Step:
 void physics_step_internal(struct physicsworld* world);
 
+// A step split in two parts, for stepping multiple worlds concurrently.
+// Simulating calls no callbacks and only touches the given world, so
+// it can run on any thread. The collision events collected by it are
+// reported to the collision callback when they are dispatched:
+void physics_simulate_internal(struct physicsworld* world);
+void physics_dispatchContactEvents_internal(struct physicsworld* world);
+
+// Objects destroyed while collision events are dispatched are only
+// destroyed once the dispatching ends, since events not dispatched yet
+// may still refer to them. When dispatching the events of multiple
+// worlds, begin it for all of them first (callbacks may destroy objects
+// of any world) and end it once all events were dispatched:
+void physics_beginContactDispatch_internal(struct physicsworld* world);
+void physics_endContactDispatch_internal(struct physicsworld* world);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,487 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "config.h"
+#include "os.h"
+
+#ifdef USE_PHYSICS2D
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "physics.h"
+#include "physicstilemap.h"
+
+struct physicstilemapchunk {
+    struct physicsobject* object;  // NULL if no solid tiles
+    int dirty;
+};
+
+struct physicstilemap {
+    struct physicsworld* world;
+    void* userdata;
+    int columns, rows;
+    double tilewidth, tileheight;
+    double x, y;
+    unsigned char* solid;
+    int chunkcolumns, chunkrows;
+    struct physicstilemapchunk* chunks;
+};
+
+// The sides of a tile in the order the outline goes around it:
+#define SIDE_TOP 0
+#define SIDE_RIGHT 1
+#define SIDE_BOTTOM 2
+#define SIDE_LEFT 3
+
+// direction towards the neighbour tile on each side:
+static const int sidenormalx[4] = {0, 1, 0, -1};
+static const int sidenormaly[4] = {-1, 0, 1, 0};
+// corner at which the outline along a side starts:
+static const int sidestartx[4] = {0, 1, 1, 0};
+static const int sidestarty[4] = {0, 0, 1, 1};
+
+// A piece of the outline: the given side of a tile.
+struct tileedge {
+    int x, y, side;
+};
+
+static int physicstilemap_isSolid(const unsigned char* solid,
+        int columns, int rows, int x, int y) {
+    if (x < 0 || y < 0 || x >= columns || y >= rows) {
+        return 0;
+    }
+    return (solid[x + y * columns] != 0);
+}
+
+// The outline runs along all sides of solid tiles facing a non-solid one:
+static int physicstilemap_isEdge(const unsigned char* solid,
+        int columns, int rows, int x, int y, int side) {
+    return (physicstilemap_isSolid(solid, columns, rows, x, y) &&
+        !physicstilemap_isSolid(solid, columns, rows,
+        x + sidenormalx[side], y + sidenormaly[side]));
+}
+
+// Advance to the next piece of the outline:
+static void physicstilemap_nextEdge(const unsigned char* solid,
+        int columns, int rows, struct tileedge* e) {
+    // outer corner -> continue around the same tile:
+    int nextside = (e->side + 1) % 4;
+    if (physicstilemap_isEdge(solid, columns, rows, e->x, e->y, nextside)) {
+        e->side = nextside;
+        return;
+    }
+    // straight on along the neighbour tile:
+    int x = e->x + sidenormalx[nextside];
+    int y = e->y + sidenormaly[nextside];
+    if (physicstilemap_isEdge(solid, columns, rows, x, y, e->side)) {
+        e->x = x;
+        e->y = y;
+        return;
+    }
+    // inner corner -> continue along the diagonal tile:
+    e->x = x + sidenormalx[e->side];
+    e->y = y + sidenormaly[e->side];
+    e->side = (e->side + 3) % 4;
+}
+
+// Go back to the previous piece of the outline (reverse of the above):
+static void physicstilemap_prevEdge(const unsigned char* solid,
+        int columns, int rows, struct tileedge* e) {
+    int prevside = (e->side + 3) % 4;
+    if (physicstilemap_isEdge(solid, columns, rows, e->x, e->y, prevside)) {
+        e->side = prevside;
+        return;
+    }
+    int nextside = (e->side + 1) % 4;
+    int x = e->x - sidenormalx[nextside];
+    int y = e->y - sidenormaly[nextside];
+    if (physicstilemap_isEdge(solid, columns, rows, x, y, e->side)) {
+        e->x = x;
+        e->y = y;
+        return;
+    }
+    e->x = x + sidenormalx[e->side];
+    e->y = y + sidenormaly[e->side];
+    e->side = nextside;
+}
+
+static int physicstilemap_addPoint(int** points, int* count, int* alloc,
+        int x, int y) {
+    if (*count + 1 > *alloc) {
+        int newalloc = (*alloc) * 2;
+        if (newalloc < 16) {
+            newalloc = 16;
+        }
+        int* newpoints = realloc(*points, sizeof(int) * 2 * newalloc);
+        if (!newpoints) {
+            return 0;
+        }
+        *points = newpoints;
+        *alloc = newalloc;
+    }
+    (*points)[(*count) * 2] = x;
+    (*points)[(*count) * 2 + 1] = y;
+    (*count)++;
+    return 1;
+}
+
+int physicstilemap_traceOutline(const unsigned char* solid,
+        int columns, int rows, int areax, int areay,
+        int areawidth, int areaheight,
+        void (*chain)(void* userdata, const int* points, int pointcount,
+        int loop, const int* ghosts), void* userdata) {
+    if (areawidth <= 0 || areaheight <= 0) {
+        return 1;
+    }
+
+    // remember which sides we already traced, 4 bits per tile:
+    unsigned char* used = malloc(areawidth * areaheight);
+    if (!used) {
+        return 0;
+    }
+    memset(used, 0, areawidth * areaheight);
+#define INAREA(e) ((e).x >= areax && (e).y >= areay && \
+    (e).x < areax + areawidth && (e).y < areay + areaheight)
+#define USEDBITS(e) used[((e).x - areax) + ((e).y - areay) * areawidth]
+
+    int* points = NULL;
+    int pointalloc = 0;
+    int y = areay;
+    while (y < areay + areaheight) {
+        int x = areax;
+        while (x < areax + areawidth) {
+            int side = 0;
+            while (side < 4) {
+                struct tileedge start;
+                start.x = x;
+                start.y = y;
+                start.side = side;
+                side++;
+                if ((USEDBITS(start) & (1 << start.side)) ||
+                        !physicstilemap_isEdge(solid, columns, rows,
+                        start.x, start.y, start.side)) {
+                    continue;
+                }
+
+                // go back to where the outline enters our area,
+                // or find out it is a loop:
+                int loop = 0;
+                struct tileedge first = start;
+                while (1) {
+                    struct tileedge prev = first;
+                    physicstilemap_prevEdge(solid, columns, rows, &prev);
+                    if (!INAREA(prev)) {
+                        break;
+                    }
+                    if (prev.x == start.x && prev.y == start.y &&
+                            prev.side == start.side) {
+                        loop = 1;
+                        break;
+                    }
+                    first = prev;
+                }
+                if (loop) {
+                    // start loops at a corner:
+                    while (1) {
+                        struct tileedge prev = first;
+                        physicstilemap_prevEdge(solid, columns, rows, &prev);
+                        if (prev.side != first.side) {
+                            break;
+                        }
+                        physicstilemap_nextEdge(solid, columns, rows, &first);
+                    }
+                }
+
+                // an open piece continues outside the area, the
+                // outline points there are passed on as ghosts:
+                int ghosts[4];
+                if (!loop) {
+                    struct tileedge prev = first;
+                    physicstilemap_prevEdge(solid, columns, rows, &prev);
+                    ghosts[0] = prev.x + sidestartx[prev.side];
+                    ghosts[1] = prev.y + sidestarty[prev.side];
+                }
+
+                // walk along the outline and collect the corners:
+                int pointcount = 0;
+                struct tileedge e = first;
+                if (!physicstilemap_addPoint(&points, &pointcount,
+                        &pointalloc, e.x + sidestartx[e.side],
+                        e.y + sidestarty[e.side])) {
+                    free(points);
+                    free(used);
+                    return 0;
+                }
+                while (1) {
+                    USEDBITS(e) |= (1 << e.side);
+                    struct tileedge next = e;
+                    physicstilemap_nextEdge(solid, columns, rows, &next);
+                    int end = 0;
+                    if (!INAREA(next)) {
+                        end = 1;
+                    } else if (loop && next.x == first.x &&
+                            next.y == first.y && next.side == first.side) {
+                        break;
+                    }
+                    if (end || next.side != e.side) {
+                        // the end of this side is a corner:
+                        int endside = (e.side + 1) % 4;
+                        if (!physicstilemap_addPoint(&points, &pointcount,
+                                &pointalloc, e.x + sidestartx[endside],
+                                e.y + sidestarty[endside])) {
+                            free(points);
+                            free(used);
+                            return 0;
+                        }
+                    }
+                    if (end) {
+                        // the outline goes on to the end of the next side:
+                        int endside = (next.side + 1) % 4;
+                        ghosts[2] = next.x + sidestartx[endside];
+                        ghosts[3] = next.y + sidestarty[endside];
+                        break;
+                    }
+                    e = next;
+                }
+                chain(userdata, points, pointcount, loop,
+                    (loop ? NULL : ghosts));
+            }
+            x++;
+        }
+        y++;
+    }
+#undef INAREA
+#undef USEDBITS
+    free(points);
+    free(used);
+    return 1;
+}
+
+struct physicstilemap* physicstilemap_create(struct physicsworld* world,
+        void* userdata, int columns, int rows, double tilewidth,
+        double tileheight, double x, double y) {
+    if (columns <= 0 || rows <= 0) {
+        return NULL;
+    }
+    struct physicstilemap* map = malloc(sizeof(*map));
+    if (!map) {
+        return NULL;
+    }
+    memset(map, 0, sizeof(*map));
+    map->world = world;
+    map->userdata = userdata;
+    map->columns = columns;
+    map->rows = rows;
+    map->tilewidth = tilewidth;
+    map->tileheight = tileheight;
+    map->x = x;
+    map->y = y;
+    map->chunkcolumns = (columns + PHYSICSTILEMAP_CHUNKSIZE - 1) /
+        PHYSICSTILEMAP_CHUNKSIZE;
+    map->chunkrows = (rows + PHYSICSTILEMAP_CHUNKSIZE - 1) /
+        PHYSICSTILEMAP_CHUNKSIZE;
+    map->solid = malloc(columns * rows);
+    map->chunks = malloc(sizeof(*map->chunks) *
+        map->chunkcolumns * map->chunkrows);
+    if (!map->solid || !map->chunks) {
+        free(map->solid);
+        free(map->chunks);
+        free(map);
+        return NULL;
+    }
+    memset(map->solid, 0, columns * rows);
+    memset(map->chunks, 0, sizeof(*map->chunks) *
+        map->chunkcolumns * map->chunkrows);
+    return map;
+}
+
+static void physicstilemap_markDirty(struct physicstilemap* map,
+        int column, int row) {
+    if (column < 0 || row < 0 || column >= map->columns ||
+            row >= map->rows) {
+        return;
+    }
+    map->chunks[(column / PHYSICSTILEMAP_CHUNKSIZE) +
+        (row / PHYSICSTILEMAP_CHUNKSIZE) * map->chunkcolumns].dirty = 1;
+}
+
+void physicstilemap_setSolid(struct physicstilemap* map,
+        int column, int row, int solid) {
+    if (column < 0 || row < 0 || column >= map->columns ||
+            row >= map->rows) {
+        return;
+    }
+    solid = (solid != 0);
+    if (map->solid[column + row * map->columns] == solid) {
+        return;
+    }
+    map->solid[column + row * map->columns] = solid;
+
+    // the outline of the neighbours changes too, which might
+    // be in another chunk:
+    physicstilemap_markDirty(map, column, row);
+    physicstilemap_markDirty(map, column - 1, row);
+    physicstilemap_markDirty(map, column + 1, row);
+    physicstilemap_markDirty(map, column, row - 1);
+    physicstilemap_markDirty(map, column, row + 1);
+}
+
+int physicstilemap_getSolid(struct physicstilemap* map,
+        int column, int row) {
+    if (column < 0 || row < 0 || column >= map->columns ||
+            row >= map->rows) {
+        return 0;
+    }
+    return map->solid[column + row * map->columns];
+}
+
+struct physicstilemapbuild {
+    struct physicstilemap* map;
+    struct physicsobjectshape* shape;
+    int edgecount;
+};
+
+static void physicstilemap_addChain(void* userdata, const int* points,
+        int pointcount, int loop, const int* ghosts) {
+    struct physicstilemapbuild* build = userdata;
+    double w = build->map->tilewidth;
+    double h = build->map->tileheight;
+
+    // add the edges in order, so they get joined to one chain:
+    int i = 0;
+    while (i < pointcount - 1 + loop) {
+        int next = (i + 1) % pointcount;
+        physics_add2dShapeEdgeList(build->shape,
+            points[i * 2] * w, points[i * 2 + 1] * h,
+            points[next * 2] * w, points[next * 2 + 1] * h);
+        build->edgecount++;
+        i++;
+    }
+
+    // continue open chains with the outline of the neighbouring chunks,
+    // so nothing catches on the seams between chunks:
+    if (!loop && pointcount > 1) {
+        physics_set2dShapeEdgeListGhostVertex(build->shape,
+            points[0] * w, points[1] * h, ghosts[0] * w, ghosts[1] * h);
+        physics_set2dShapeEdgeListGhostVertex(build->shape,
+            points[(pointcount - 1) * 2] * w,
+            points[(pointcount - 1) * 2 + 1] * h,
+            ghosts[2] * w, ghosts[3] * h);
+    }
+}
+
+static int physicstilemap_buildChunk(struct physicstilemap* map,
+        int chunkx, int chunky) {
+    struct physicstilemapchunk* chunk = &map->chunks[chunkx +
+        chunky * map->chunkcolumns];
+
+    // trace the outline of all solid tiles in this chunk:
+    struct physicstilemapbuild build;
+    memset(&build, 0, sizeof(build));
+    build.map = map;
+    build.shape = physics_createEmptyShapes(1);
+    if (!build.shape) {
+        return 0;
+    }
+    int areax = chunkx * PHYSICSTILEMAP_CHUNKSIZE;
+    int areay = chunky * PHYSICSTILEMAP_CHUNKSIZE;
+    int areawidth = PHYSICSTILEMAP_CHUNKSIZE;
+    int areaheight = PHYSICSTILEMAP_CHUNKSIZE;
+    if (areax + areawidth > map->columns) {
+        areawidth = map->columns - areax;
+    }
+    if (areay + areaheight > map->rows) {
+        areaheight = map->rows - areay;
+    }
+    if (!physicstilemap_traceOutline(map->solid, map->columns, map->rows,
+            areax, areay, areawidth, areaheight,
+            &physicstilemap_addChain, &build)) {
+        physics_destroyShapes(build.shape, 1);
+        return 0;
+    }
+
+    // replace the old physics object:
+    struct physicsobject* obj = NULL;
+    if (build.edgecount > 0) {
+        obj = physics_createObject(map->world, map->userdata, 0,
+            build.shape, 1);
+        if (!obj) {
+            physics_destroyShapes(build.shape, 1);
+            return 0;
+        }
+        physics_warp2d(obj, map->x, map->y, 0);
+    }
+    physics_destroyShapes(build.shape, 1);
+    if (chunk->object) {
+        physics_destroyObject(chunk->object);
+    }
+    chunk->object = obj;
+    chunk->dirty = 0;
+    return 1;
+}
+
+int physicstilemap_update(struct physicstilemap* map) {
+    int y = 0;
+    while (y < map->chunkrows) {
+        int x = 0;
+        while (x < map->chunkcolumns) {
+            if (map->chunks[x + y * map->chunkcolumns].dirty) {
+                if (!physicstilemap_buildChunk(map, x, y)) {
+                    return 0;
+                }
+            }
+            x++;
+        }
+        y++;
+    }
+    return 1;
+}
+
+int physicstilemap_getObjectCount(struct physicstilemap* map) {
+    int count = 0;
+    int i = 0;
+    while (i < map->chunkcolumns * map->chunkrows) {
+        if (map->chunks[i].object) {
+            count++;
+        }
+        i++;
+    }
+    return count;
+}
+
+void physicstilemap_destroy(struct physicstilemap* map) {
+    int i = 0;
+    while (i < map->chunkcolumns * map->chunkrows) {
+        if (map->chunks[i].object) {
+            physics_destroyObject(map->chunks[i].object);
+        }
+        i++;
+    }
+    free(map->chunks);
+    free(map->solid);
+    free(map);
+}
+
+#endif  // USE_PHYSICS2D
+
@@ -0,0 +1,91 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_PHYSICSTILEMAP_H_
+#define BLITWIZARD_PHYSICSTILEMAP_H_
+
+#include "config.h"
+#include "os.h"
+
+#ifdef USE_PHYSICS2D
+
+#include "physics.h"
+
+// Collision for 2d tile maps. Instead of one physics object per solid
+// tile, the outline of all solid tiles is traced and turned into a few
+// long edge chains, which avoids both the huge amount of bodies and
+// objects getting stuck on the seams between tiles.
+//
+// The map is split into square chunks of tiles, with one static physics
+// object for each chunk that contains solid tiles. When tiles change,
+// only the collision of the affected chunks is rebuilt.
+
+#define PHYSICSTILEMAP_CHUNKSIZE 32  // in tiles
+
+struct physicstilemap;
+
+// Create a tile map with the given amount of columns and rows, all tiles
+// initially not solid. Tile 0,0 has its top left corner at x, y in the
+// world and the map extends towards positive x and y.
+// The userdata is set on all physics objects created for the map.
+// Returns NULL when out of memory:
+struct physicstilemap* physicstilemap_create(struct physicsworld* world,
+    void* userdata, int columns, int rows, double tilewidth,
+    double tileheight, double x, double y);
+
+// Make a tile solid or not. The collision is only changed by the next
+// physicstilemap_update(), so you can change many tiles at once:
+void physicstilemap_setSolid(struct physicstilemap* map,
+    int column, int row, int solid);
+int physicstilemap_getSolid(struct physicstilemap* map,
+    int column, int row);
+
+// Rebuild the collision of all chunks with changed tiles.
+// Returns 1 on success, 0 when out of memory:
+int physicstilemap_update(struct physicstilemap* map);
+
+// Amount of physics objects currently used by the map:
+int physicstilemap_getObjectCount(struct physicstilemap* map);
+
+// Destroy the map and all its physics objects:
+void physicstilemap_destroy(struct physicstilemap* map);
+
+// Trace the outline of the solid tiles (one byte per tile, row by row,
+// non-zero for solid) inside the given area of tiles, as done for each
+// chunk. The outline runs clockwise around solid tiles (with y pointing
+// down), and parts leaving the area end there.
+// For each piece, the chain callback gets its corner points in tile
+// coordinates (x, y pairs) and whether it is a closed loop (then the
+// last point connects back to the first one). For open pieces, ghosts
+// holds the outline points right before the first and after the last
+// point outside of the area (x, y pairs), for loops it is NULL.
+// Returns 1 on success, 0 when out of memory:
+int physicstilemap_traceOutline(const unsigned char* solid,
+    int columns, int rows, int areax, int areay,
+    int areawidth, int areaheight,
+    void (*chain)(void* userdata, const int* points, int pointcount,
+    int loop, const int* ghosts), void* userdata);
+
+#endif  // USE_PHYSICS2D
+
+#endif  // BLITWIZARD_PHYSICSTILEMAP_H_
@@ -0,0 +1,188 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "config.h"
+#include "os.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ringbuffer.h"
+
+struct ringbuffer {
+    char* data;
+    size_t size;  // always a power of two
+    size_t mask;  // size - 1
+
+    // Both positions count up endlessly (and wrap around naturally),
+    // the actual buffer offset is position & mask.
+    // writepos is only modified by the producer, readpos only by the
+    // consumer:
+    size_t writepos;
+    size_t readpos;
+};
+
+struct ringbuffer* ringbuffer_create(size_t size) {
+    size_t realsize = 64;
+    while (realsize < size) {
+        realsize *= 2;
+    }
+    struct ringbuffer* r = malloc(sizeof(*r));
+    if (!r) {
+        return NULL;
+    }
+    memset(r, 0, sizeof(*r));
+    r->data = malloc(realsize);
+    if (!r->data) {
+        free(r);
+        return NULL;
+    }
+    r->size = realsize;
+    r->mask = realsize - 1;
+    return r;
+}
+
+size_t ringbuffer_readable(struct ringbuffer* r) {
+    size_t w = __atomic_load_n(&r->writepos, __ATOMIC_ACQUIRE);
+    size_t rp = __atomic_load_n(&r->readpos, __ATOMIC_RELAXED);
+    return w - rp;
+}
+
+size_t ringbuffer_writable(struct ringbuffer* r) {
+    size_t w = __atomic_load_n(&r->writepos, __ATOMIC_RELAXED);
+    size_t rp = __atomic_load_n(&r->readpos, __ATOMIC_ACQUIRE);
+    return r->size - (w - rp);
+}
+
+size_t ringbuffer_size(struct ringbuffer* r) {
+    return r->size;
+}
+
+size_t ringbuffer_write(struct ringbuffer* r, const void* data,
+        size_t bytes) {
+    size_t w = __atomic_load_n(&r->writepos, __ATOMIC_RELAXED);
+    size_t rp = __atomic_load_n(&r->readpos, __ATOMIC_ACQUIRE);
+    size_t space = r->size - (w - rp);
+    if (bytes > space) {
+        bytes = space;
+    }
+    if (bytes == 0) {
+        return 0;
+    }
+
+    // copy in up to two parts (before and after the wrap-around):
+    size_t offset = w & r->mask;
+    size_t first = r->size - offset;
+    if (first > bytes) {
+        first = bytes;
+    }
+    memcpy(r->data + offset, data, first);
+    if (bytes > first) {
+        memcpy(r->data, (const char*)data + first, bytes - first);
+    }
+
+    // publish the new data to the consumer:
+    __atomic_store_n(&r->writepos, w + bytes, __ATOMIC_RELEASE);
+    return bytes;
+}
+
+static size_t ringbuffer_consume(struct ringbuffer* r, void* data,
+        size_t bytes) {
+    size_t rp = __atomic_load_n(&r->readpos, __ATOMIC_RELAXED);
+    size_t w = __atomic_load_n(&r->writepos, __ATOMIC_ACQUIRE);
+    size_t available = w - rp;
+    if (bytes > available) {
+        bytes = available;
+    }
+    if (bytes == 0) {
+        return 0;
+    }
+
+    // copy out in up to two parts:
+    if (data) {
+        size_t offset = rp & r->mask;
+        size_t first = r->size - offset;
+        if (first > bytes) {
+            first = bytes;
+        }
+        memcpy(data, r->data + offset, first);
+        if (bytes > first) {
+            memcpy((char*)data + first, r->data, bytes - first);
+        }
+    }
+
+    // hand the space back to the producer:
+    __atomic_store_n(&r->readpos, rp + bytes, __ATOMIC_RELEASE);
+    return bytes;
+}
+
+size_t ringbuffer_read(struct ringbuffer* r, void* data, size_t bytes) {
+    return ringbuffer_consume(r, data, bytes);
+}
+
+size_t ringbuffer_skip(struct ringbuffer* r, size_t bytes) {
+    return ringbuffer_consume(r, NULL, bytes);
+}
+
+size_t ringbuffer_readRegion(struct ringbuffer* r, void** data) {
+    size_t rp = __atomic_load_n(&r->readpos, __ATOMIC_RELAXED);
+    size_t w = __atomic_load_n(&r->writepos, __ATOMIC_ACQUIRE);
+    size_t offset = rp & r->mask;
+    size_t available = w - rp;
+    if (available > r->size - offset) {
+        available = r->size - offset;
+    }
+    *data = r->data + offset;
+    return available;
+}
+
+size_t ringbuffer_writeRegion(struct ringbuffer* r, void** data) {
+    size_t w = __atomic_load_n(&r->writepos, __ATOMIC_RELAXED);
+    size_t rp = __atomic_load_n(&r->readpos, __ATOMIC_ACQUIRE);
+    size_t offset = w & r->mask;
+    size_t space = r->size - (w - rp);
+    if (space > r->size - offset) {
+        space = r->size - offset;
+    }
+    *data = r->data + offset;
+    return space;
+}
+
+void ringbuffer_commit(struct ringbuffer* r, size_t bytes) {
+    size_t w = __atomic_load_n(&r->writepos, __ATOMIC_RELAXED);
+    __atomic_store_n(&r->writepos, w + bytes, __ATOMIC_RELEASE);
+}
+
+void ringbuffer_reset(struct ringbuffer* r) {
+    __atomic_store_n(&r->readpos, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->writepos, 0, __ATOMIC_RELEASE);
+}
+
+void ringbuffer_destroy(struct ringbuffer* r) {
+    if (!r) {
+        return;
+    }
+    free(r->data);
+    free(r);
+}
+
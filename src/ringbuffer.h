@@ -0,0 +1,86 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2014 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_RINGBUFFER_H_
+#define BLITWIZARD_RINGBUFFER_H_
+
+// This implements a lock-free ring buffer for bytes with one
+// producer thread and one consumer thread (single producer, single
+// consumer). Writing and reading never blocks and never locks a mutex,
+// so it can be used safely from the real-time audio thread.
+
+#include <stddef.h>
+
+struct ringbuffer;
+
+// Set up a new ring buffer. The size is rounded up to the next
+// power of two. Returns NULL if out of memory.
+struct ringbuffer* ringbuffer_create(size_t size);
+
+// Write up to the given amount of bytes. Returns the amount of bytes
+// actually written, which is less if the ring buffer is too full.
+// Only call this from the producer thread.
+size_t ringbuffer_write(struct ringbuffer* r, const void* data,
+    size_t bytes);
+
+// Read up to the given amount of bytes. Returns the amount of bytes
+// actually read, which is less if not enough data is available.
+// Only call this from the consumer thread.
+size_t ringbuffer_read(struct ringbuffer* r, void* data, size_t bytes);
+
+// Drop up to the given amount of bytes without copying them out.
+// Returns the amount of bytes dropped. Consumer thread only.
+size_t ringbuffer_skip(struct ringbuffer* r, size_t bytes);
+
+// Zero-copy access: get a pointer to the data which can be read right
+// now without wrapping around. Returns the amount of bytes available at
+// that pointer, which can be less than ringbuffer_readable() returns.
+// Consume the data with ringbuffer_skip afterwards. Consumer thread only.
+size_t ringbuffer_readRegion(struct ringbuffer* r, void** data);
+
+// Zero-copy access: get a pointer to the space which can be written
+// right now without wrapping around. Returns the amount of bytes
+// available at that pointer. Publish the written data with
+// ringbuffer_commit afterwards. Producer thread only.
+size_t ringbuffer_writeRegion(struct ringbuffer* r, void** data);
+void ringbuffer_commit(struct ringbuffer* r, size_t bytes);
+
+// Amount of bytes which can be read right now:
+size_t ringbuffer_readable(struct ringbuffer* r);
+
+// Amount of bytes which can be written right now:
+size_t ringbuffer_writable(struct ringbuffer* r);
+
+// Total size of the ring buffer in bytes:
+size_t ringbuffer_size(struct ringbuffer* r);
+
+// Drop all contents. Neither the producer nor the consumer may use the
+// ring buffer while this is done (they need to sync up otherwise):
+void ringbuffer_reset(struct ringbuffer* r);
+
+// Destroy the ring buffer. Make sure neither the producer nor the
+// consumer uses it anymore.
+void ringbuffer_destroy(struct ringbuffer* r);
+
+#endif  // BLITWIZARD_RINGBUFFER_H_
+
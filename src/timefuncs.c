@@ -35,6 +35,9 @@
 #endif
 #endif
 #include "timefuncs.h"
+#ifdef WINDOWS
+#include <windows.h>
+#endif
 #ifdef MAC
 #include <CoreServices/CoreServices.h>
 #include <mach/mach.h>
@@ -53,7 +56,27 @@ int startinitialised = 0;
 
 uint64_t oldtime = 0;
 uint64_t timeoffset = 0;
+
+static int fixedtimebase = 0;
+static uint64_t fixedtime = 0;  // accessed atomically
+
+void time_setFixedTimebase(int enabled) {
+    if (enabled && !fixedtimebase) {
+        // continue from the current time:
+        __atomic_store_n(&fixedtime, time_getMilliseconds(),
+            __ATOMIC_RELEASE);
+    }
+    fixedtimebase = enabled;
+}
+
+void time_advanceFixedTimebase(uint32_t milliseconds) {
+    __atomic_add_fetch(&fixedtime, milliseconds, __ATOMIC_ACQ_REL);
+}
+
 uint64_t time_getMilliseconds() {
+    if (fixedtimebase) {
+        return __atomic_load_n(&fixedtime, __ATOMIC_ACQUIRE);
+    }
 #if defined(HAVE_SDL) || defined(WINDOWS)
 #ifdef HAVE_SDL
     uint64_t i = SDL_GetTicks();
@@ -109,24 +132,74 @@ uint64_t time_getMilliseconds() {
     return i;
 }
 
+// The microsecond clock uses the monotonic high resolution clock of
+// each platform, counted from the program start:
+#if defined(WINDOWS)
+static LARGE_INTEGER microsecondsstart;
+static LARGE_INTEGER microsecondsfrequency;
+#elif defined(MAC)
+static uint64_t microsecondsstart;
+static mach_timebase_info_data_t microsecondstimebase;
+#else
+static struct timespec microsecondsstart;
+#endif
+static uint64_t lastmicroseconds = 0;  // accessed atomically
+
+// this runs on application start, before any other thread exists:
+__attribute__((constructor)) static void time_initMicroseconds(void) {
+#if defined(WINDOWS)
+    QueryPerformanceFrequency(&microsecondsfrequency);
+    QueryPerformanceCounter(&microsecondsstart);
+#elif defined(MAC)
+    mach_timebase_info(&microsecondstimebase);
+    microsecondsstart = mach_absolute_time();
+#else
+    clock_gettime(CLOCK_MONOTONIC, &microsecondsstart);
+#endif
+}
+
 uint64_t time_getMicroseconds() {
-#ifdef LINUX
-    if (!startinitialised) {
-        clock_gettime(CLOCK_MONOTONIC, &lastunixtime);
-        startinitialised = 1;
-        lasttimestamp = 0;
-        return 0;
-    }
+#if defined(WINDOWS)
+    LARGE_INTEGER current;
+    QueryPerformanceCounter(&current);
+    uint64_t ticks = current.QuadPart - microsecondsstart.QuadPart;
+    uint64_t frequency = microsecondsfrequency.QuadPart;
+    // split up to avoid an overflow of ticks * 1000000:
+    uint64_t i = (ticks / frequency) * 1000000 +
+        ((ticks % frequency) * 1000000) / frequency;
+#elif defined(MAC)
+    uint64_t elapsed = mach_absolute_time() - microsecondsstart;
+    uint64_t numer = microsecondstimebase.numer;
+    uint64_t denom = microsecondstimebase.denom;
+    uint64_t i = ((elapsed / denom) * numer +
+        ((elapsed % denom) * numer) / denom) / 1000;
+#else
     struct timespec current;
     clock_gettime(CLOCK_MONOTONIC, &current);
-    int64_t seconds = current.tv_sec - lastunixtime.tv_sec;
-    int64_t nseconds = current.tv_nsec - lastunixtime.tv_nsec;
-    uint64_t i = (uint64_t)((double)((seconds) * 1000000 + nseconds / 1000.0) + 0.5);
-    i += lasttimestamp * 1000;
-    return i;
-#else
-    return 0;
+    int64_t seconds = current.tv_sec - microsecondsstart.tv_sec;
+    int64_t nseconds = current.tv_nsec - microsecondsstart.tv_nsec;
+    uint64_t i = (uint64_t)(seconds * 1000000 + nseconds / 1000);
 #endif
+    // never go backwards, not even with counters which differ slightly
+    // between CPU cores:
+    uint64_t last = __atomic_load_n(&lastmicroseconds, __ATOMIC_RELAXED);
+    while (1) {
+        if (i <= last) {
+            return last;
+        }
+        if (__atomic_compare_exchange_n(&lastmicroseconds, &last, i, 0,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return i;
+        }
+    }
+}
+
+uint64_t time_getMicrosecondsSince(uint64_t start) {
+    uint64_t now = time_getMicroseconds();
+    if (now < start) {
+        return 0;
+    }
+    return now - start;
 }
 
 void time_sleep(uint32_t milliseconds) {
@@ -42,14 +42,30 @@ uint64_t time_getMilliseconds(void);
 // jump backwards until uint64_t is exceeded.
 
 uint64_t time_getMicroseconds(void);
-// Time which has passed in micro seconds since an undefined
-// point in time (e.g. program start).
+// Time which has passed in micro seconds since the program start,
+// from the monotonic high resolution clock of the platform.
 //
-// Please note this is unimplemented on some systems
-// (returns always 0).
+// It never goes backwards, so the difference of two timestamps
+// taken one after another is never negative.
+
+uint64_t time_getMicrosecondsSince(uint64_t start);
+// Micro seconds passed since the given time_getMicroseconds()
+// timestamp. This is 0 instead of wrapping around if the start
+// is in the future.
 
 void time_sleep(uint32_t milliseconds);
 // Sleep for a specified amount of time.
 
+void time_setFixedTimebase(int enabled);
+// With a fixed timebase, time_getMilliseconds() no longer follows
+// the real time. Instead, it only advances when
+// time_advanceFixedTimebase() is called, which allows running
+// things faster than real time with reproducible timing.
+// time_getMicroseconds() is unaffected and keeps measuring real time.
+
+void time_advanceFixedTimebase(uint32_t milliseconds);
+// Advance the time returned by time_getMilliseconds() while
+// a fixed timebase is in use.
+
 #endif  // BLITWIZARD_TIMEFUNCS_H_
 